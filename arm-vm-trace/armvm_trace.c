@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <armvm.h>
+#include <isa/armv6_m.h>
+#include <libarmvm_trace.h>
+
+const struct option long_options[] = {
+    {"program",         required_argument, 0, 'p'},
+    {"help",            no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+const char short_options[] = "p:h";
+
+const char usage_message[] =
+"-p, --program=FILE          The program which was executed while the trace was recorded.\n"
+"-h, --help                  Display this help message and exit.\n";
+
+
+/**
+ * @brief The program image, which is mapped to the program address and to 0x0.
+ */
+struct program {
+    uint8_t *data;
+    uint32_t size;
+    uint32_t address;
+};
+
+
+int _program_load(struct program *program, const char *file)
+{
+    FILE *f = fopen(file, "rb");
+    if (!f) {
+        fprintf(stderr, "ERROR: Could not open program: %s\n", file);
+        return 1;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    program->data = malloc(size > 0 ? size : 1);
+    if (!program->data) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        fclose(f);
+        return 1;
+    }
+
+    program->size = size;
+    if (size != fread(program->data, 1, size, f)) {
+        fprintf(stderr, "ERROR: Could not read program: %s\n", file);
+        fclose(f);
+        return 1;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+
+int _program_read_halfword(const struct program *program, uint32_t addr, uint16_t *halfword)
+{
+    uint32_t offset = addr - program->address;
+    if (offset >= program->size) {
+        offset = addr;
+    }
+    if (offset >= program->size || offset + 2 > program->size) {
+        return 1;
+    }
+
+    *halfword = program->data[offset] | (program->data[offset + 1] << 8);
+    return 0;
+}
+
+
+int _program_load_instruction(const struct program *program, uint32_t addr, struct armv6m_instruction *instruction)
+{
+    uint16_t ins;
+    if (_program_read_halfword(program, addr, &ins)) {
+        return 1;
+    }
+
+    instruction->addr = addr;
+    instruction->is32Bit = (ins >> 11) >= 0b11101;
+    if (!instruction->is32Bit) {
+        instruction->i._16bit = ins;
+        return 0;
+    }
+
+    uint16_t ins2;
+    if (_program_read_halfword(program, addr + 2, &ins2)) {
+        return 1;
+    }
+    instruction->i._32bit = (ins << 16) | ins2;
+    return 0;
+}
+
+
+int _read_leb128(FILE *f, uint32_t *value)
+{
+    int c;
+    uint8_t shift = 0;
+
+    *value = 0;
+    do {
+        c = getc(f);
+        if (EOF == c || shift > 28) {
+            return 1;
+        }
+        *value |= (uint32_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return 0;
+}
+
+
+int _read_zigzag(FILE *f, int32_t *value)
+{
+    uint32_t raw;
+    if (_read_leb128(f, &raw)) {
+        return 1;
+    }
+    *value = (int32_t)(raw >> 1) ^ -(int32_t)(raw & 0x1);
+    return 0;
+}
+
+
+uint32_t _read_uint32(const uint8_t *src)
+{
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+
+int _decode(FILE *f, struct program *program)
+{
+    uint8_t header[LIBARMVM_TRACE_HEADER_SIZE];
+    uint32_t gpr[LIBARMVM_GPR_SIZE] = {0};
+    uint32_t psr = 0;
+    uint32_t addr = 0;
+    uint32_t write_addr = 0;
+    uint64_t instructions = 0;
+    char asm_buf[64];
+    int tag;
+
+    if (sizeof(header) != fread(header, 1, sizeof(header), f) || memcmp(header, LIBARMVM_TRACE_MAGIC, 8)) {
+        fprintf(stderr, "ERROR: Not a trace file.\n");
+        return 1;
+    }
+
+    if (LIBARMVM_TRACE_VERSION != _read_uint32(header + 8)) {
+        fprintf(stderr, "ERROR: Unsupported trace version: %u\n", _read_uint32(header + 8));
+        return 1;
+    }
+    program->address = _read_uint32(header + 16);
+
+    while (1) {
+        tag = getc(f);
+        if (EOF == tag) {
+            fprintf(stderr, "WARN: The trace is truncated.\n");
+            break;
+        }
+
+        if (LIBARMVM_TRACE_TAG_END == tag) {
+            break;
+
+        } else if (LIBARMVM_TRACE_TAG_RUN == (tag & 0xc0)) {
+            for (int i = 0; i <= (tag & 0x3f); ++i) {
+                struct armv6m_instruction instruction;
+                if (_program_load_instruction(program, addr, &instruction)) {
+                    fprintf(stderr, "ERROR: The address 0x%08x is not part of the program.\n", addr);
+                    return 1;
+                }
+                armv6m_disassemble(&instruction, asm_buf, sizeof(asm_buf));
+                printf("0x%08x: %s\n", addr, asm_buf);
+                addr += instruction.is32Bit ? 4 : 2;
+                instructions++;
+            }
+
+        } else if (LIBARMVM_TRACE_TAG_BRANCH == tag) {
+            int32_t delta;
+            if (_read_zigzag(f, &delta)) {
+                goto err_format;
+            }
+            addr += (uint32_t)delta << 1;
+
+        } else if (LIBARMVM_TRACE_TAG_GPR == (tag & 0xf0)) {
+            uint32_t delta;
+            if (_read_leb128(f, &delta)) {
+                goto err_format;
+            }
+            gpr[tag & 0xf] ^= delta;
+            printf("    %s = 0x%08x\n", armv6m_reg_idx_to_string(tag & 0xf), gpr[tag & 0xf]);
+
+        } else if (LIBARMVM_TRACE_TAG_PSR == tag) {
+            uint32_t delta;
+            if (_read_leb128(f, &delta)) {
+                goto err_format;
+            }
+            psr ^= delta;
+            printf("    PSR = 0x%08x\n", psr);
+
+        } else if (LIBARMVM_TRACE_TAG_WRITE == (tag & 0xfc) && (tag & 0x3) < 3) {
+            int32_t delta;
+            uint32_t value;
+            if (_read_zigzag(f, &delta) || _read_leb128(f, &value)) {
+                goto err_format;
+            }
+            write_addr += delta;
+            printf("    [0x%08x] <- 0x%0*x\n", write_addr, 2 << (tag & 0x3), value);
+
+        } else {
+            goto err_format;
+        }
+    }
+
+    printf("%lu instructions.\n", (unsigned long)instructions);
+    return 0;
+
+err_format:
+    fprintf(stderr, "ERROR: Invalid record 0x%02x in trace.\n", tag);
+    return 1;
+}
+
+
+void _usage(char **argv)
+{
+    printf("Usage: %s [options] TRACE\n", argv[0]);
+    printf("\n");
+    printf("Decodes an execution trace written by arm-vm --trace and prints its disassembly.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("%s\n", usage_message);
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret_val = 0;
+    char *program_file = NULL;
+    struct program program;
+    FILE *f = NULL;
+
+    memset(&program, 0, sizeof(program));
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, short_options, long_options, &option_index);
+
+        if (-1 == c) {
+            break;
+        }
+
+        switch (c) {
+            case 'p':
+                program_file = optarg;
+                break;
+            case 'h':
+                _usage(argv);
+                return 0;
+            default:
+                _usage(argv);
+                return 1;
+        }
+    }
+
+    if (!program_file || optind + 1 != argc) {
+        _usage(argv);
+        return 1;
+    }
+
+    if (_program_load(&program, program_file)) {
+        ret_val = 1;
+        goto err;
+    }
+
+    f = fopen(argv[optind], "rb");
+    if (!f) {
+        fprintf(stderr, "ERROR: Could not open trace: %s\n", argv[optind]);
+        ret_val = 1;
+        goto err;
+    }
+
+    if (_decode(f, &program)) {
+        ret_val = 1;
+    }
+
+err:
+    if (f) {
+        fclose(f);
+    }
+    free(program.data);
+    return ret_val;
+}
@@ -58,6 +58,43 @@ int main(int argc, char **argv)
     conf.program = NULL;
     opts.program_address = conf.program_address;
     opts.steps = conf.steps;
+    opts.core_clock = conf.core_clock;
+    opts.lockstep = conf.lockstep;
+    opts.symbol_file = conf.symbol_file;
+    conf.symbol_file = NULL;
+    opts.profile_file = conf.profile_file;
+    conf.profile_file = NULL;
+    opts.trace_file = conf.trace_file;
+    conf.trace_file = NULL;
+    opts.trace_flags = conf.trace_flags;
+    opts.callgraph_file = conf.callgraph_file;
+    conf.callgraph_file = NULL;
+    opts.folded_file = conf.folded_file;
+    conf.folded_file = NULL;
+    opts.coverage_file = conf.coverage_file;
+    conf.coverage_file = NULL;
+    opts.coverage_format = conf.coverage_format;
+    opts.heatmap_file = conf.heatmap_file;
+    conf.heatmap_file = NULL;
+    opts.heatmap_bucket_size = conf.heatmap_bucket_size;
+    opts.stack_file = conf.stack_file;
+    conf.stack_file = NULL;
+    opts.stack_guard_main = conf.stack_guard_main;
+    opts.stack_guard_process = conf.stack_guard_process;
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        opts.usart_output[i] = conf.usart_output[i];
+        conf.usart_output[i] = NULL;
+        opts.usart_input[i] = conf.usart_input[i];
+        conf.usart_input[i] = NULL;
+    }
+    opts.gpio_vcd_file = conf.gpio_vcd_file;
+    conf.gpio_vcd_file = NULL;
+    opts.gpio_stimulus_file = conf.gpio_stimulus_file;
+    conf.gpio_stimulus_file = NULL;
+    for (size_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        opts.adc_input[i] = conf.adc_input[i];
+        conf.adc_input[i] = NULL;
+    }
 
     // we currently only suppart one device
     opts.device_id = malloc(sizeof(DEVICE_ID));
@@ -75,6 +112,9 @@ int main(int argc, char **argv)
         goto err_opts;
     }
 
+    // the exit code of the program, if it stopped the vm through the semihosting
+    ret_val = armvm.exit_code;
+
 err_opts:
     if (armvm_opts_cleanup(&opts)) {
         fprintf(stderr, "WARN: armvm_opts_cleanup() faild.\n");
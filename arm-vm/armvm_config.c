@@ -6,17 +6,51 @@
 #include <errno.h>
 #include <assert.h>
 
+/*
+ * Options without a short option.
+ */
+#define OPT_USART1_OUT (0x100)
+#define OPT_USART1_IN  (0x101)
+#define OPT_USART2_OUT (0x102)
+#define OPT_USART2_IN  (0x103)
+#define OPT_GPIO_VCD   (0x104)
+#define OPT_GPIO_IN    (0x105)
+#define OPT_ADC_IN     (0x106)
+
 const struct option long_options[] = {
     {"program",         required_argument, 0, 'p'},
     {"address",         required_argument, 0, 'a'},
     {"steps",           required_argument, 0, 's'},
     {"isa",             required_argument, 0, 'i'},
+    {"clock",           required_argument, 0, 'c'},
+    {"lockstep",        required_argument, 0, 'l'},
+    {"elf",             required_argument, 0, 'e'},
+    {"profile",         required_argument, 0, 'P'},
+    {"trace",           required_argument, 0, 't'},
+    {"trace-registers", no_argument,       0, 'R'},
+    {"trace-memory",    no_argument,       0, 'M'},
+    {"callgraph",       required_argument, 0, 'g'},
+    {"folded",          required_argument, 0, 'F'},
+    {"coverage",        required_argument, 0, 'C'},
+    {"coverage-format", required_argument, 0, 'f'},
+    {"heatmap",         required_argument, 0, 'H'},
+    {"heatmap-bucket",  required_argument, 0, 'B'},
+    {"stack",           required_argument, 0, 'S'},
+    {"msp-guard",       required_argument, 0, 'm'},
+    {"psp-guard",       required_argument, 0, 'u'},
+    {"usart1-out",      required_argument, 0, OPT_USART1_OUT},
+    {"usart1-in",       required_argument, 0, OPT_USART1_IN},
+    {"usart2-out",      required_argument, 0, OPT_USART2_OUT},
+    {"usart2-in",       required_argument, 0, OPT_USART2_IN},
+    {"gpio-vcd",        required_argument, 0, OPT_GPIO_VCD},
+    {"gpio-in",         required_argument, 0, OPT_GPIO_IN},
+    {"adc-in",          required_argument, 0, OPT_ADC_IN},
     {"help",            no_argument,       0, 'h'},
     {"version",         no_argument,       0, 'v'},
     {0, 0, 0, 0}
 };
 
-const char short_options[] = "s:p:a:i:hv";
+const char short_options[] = "s:p:a:i:c:l:e:P:t:RMg:F:C:f:H:B:S:m:u:hv";
 
 const char usage_message[] =
 "-p, --program=FILE          Specifies the program, which shall be loaded by the vm.\n"
@@ -24,6 +58,29 @@ const char usage_message[] =
 "-s, --steps=AMOUNT          Sets how many steps will be executed. If not specified, there will be no limit.\n"
 "-i, --isa=ISA               Sets the instruction set architecture.\n"
 "                            Valid values are: Armv6-M, Armv7-M, Armv8-M\n"
+"-c, --clock=HZ              Frequency of the core clock after reset (default: 8000000).\n"
+"-l, --lockstep=AMOUNT       Runs a reference instance of the vm in lockstep and compares both every AMOUNT steps.\n"
+"-e, --elf=FILE              ELF file of the program. Its symbols are used in reports.\n"
+"-P, --profile=FILE          Counts the executions per instruction and writes a hot-spot report to FILE ('-' for stdout).\n"
+"-t, --trace=FILE            Writes a compact binary execution trace to FILE. Use arm-vm-trace to decode it.\n"
+"-R, --trace-registers       Adds the changes of the registers to the trace.\n"
+"-M, --trace-memory          Adds all memory writes to the trace.\n"
+"-g, --callgraph=FILE        Tracks calls and returns and writes the inclusive and exclusive counts per function to FILE ('-' for stdout).\n"
+"-F, --folded=FILE           Writes the cycles per call path as folded stacks (for flame graphs) to FILE ('-' for stdout).\n"
+"-C, --coverage=FILE         Records the executed instructions and branch outcomes and writes the coverage to FILE ('-' for stdout).\n"
+"-f, --coverage-format=FMT   Format of the coverage: drcov (default) or lcov. lcov needs the ELF file (-e).\n"
+"-H, --heatmap=FILE          Counts the memory accesses per area, width and bucket and writes a heatmap to FILE ('-' for stdout).\n"
+"-B, --heatmap-bucket=BYTES  Size of one bucket of the heatmap, a power of two (default: 64).\n"
+"-S, --stack=FILE            Tracks the lowest values of MSP and PSP and writes them to FILE ('-' for stdout).\n"
+"-m, --msp-guard=ADDR        Stops when the MSP is set below ADDR.\n"
+"-u, --psp-guard=ADDR        Stops when the PSP is set below ADDR.\n"
+"    --usart1-out=FILE       Writes the bytes transmitted by USART1 to FILE or a pipe ('-' for stdout).\n"
+"    --usart1-in=FILE        USART1 receives the bytes read from FILE or a pipe ('-' for stdin).\n"
+"    --usart2-out=FILE       Writes the bytes transmitted by USART2 to FILE or a pipe ('-' for stdout).\n"
+"    --usart2-in=FILE        USART2 receives the bytes read from FILE or a pipe ('-' for stdin).\n"
+"    --gpio-vcd=FILE         Writes the changes of the GPIO pins to FILE as value change dump (time in cycles).\n"
+"    --gpio-in=FILE          Drives the GPIO input pins with the changes in FILE (lines \"CYCLES PIN 0|1|z\", e.g. \"1000 PA0 1\").\n"
+"    --adc-in=CH:FILE        The conversions of the ADC channel CH take their samples from FILE (raw int16 or, if it ends with .csv, CSV).\n"
 "-h, --help                  Display this help message and exit.\n"
 "-v, --version               Display the version information and exit.\n"
 "\n"
@@ -38,6 +95,7 @@ int armvm_config_init(struct armvm_config *config, int argc, char **argv)
     config->isa = ARMV6_M;
     config->program_address = 0x08000000;
     config->steps = 0;
+    config->core_clock = 8000000;
 
     while(1) {
         int option_index = 0;
@@ -111,6 +169,204 @@ int armvm_config_init(struct armvm_config *config, int argc, char **argv)
                     config->steps = steps;
                 }
                 break;
+            case 'c':
+                {
+                    errno = 0;
+                    uint64_t core_clock;
+                    char *endpoint;
+                    if (0 == strncmp("0x", optarg, 2)) {
+                        core_clock = strtoull(optarg, &endpoint, 16);
+                    } else {
+                        core_clock = strtoull(optarg, &endpoint, 10);
+                    }
+                    if (errno || *endpoint != 0 || !core_clock) {
+                        fprintf(stderr, "ERROR: Argument to option -c/--clock is invalid.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                    config->core_clock = core_clock;
+                }
+                break;
+            case 'e':
+                config->symbol_file = strdup(optarg);
+                if (!config->symbol_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'P':
+                config->profile_file = strdup(optarg);
+                if (!config->profile_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 't':
+                config->trace_file = strdup(optarg);
+                if (!config->trace_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'g':
+                config->callgraph_file = strdup(optarg);
+                if (!config->callgraph_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'F':
+                config->folded_file = strdup(optarg);
+                if (!config->folded_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'C':
+                config->coverage_file = strdup(optarg);
+                if (!config->coverage_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'f':
+                if (0 == strcmp("drcov", optarg)) {
+                    config->coverage_format = ARMVM_COVERAGE_DRCOV;
+                } else if (0 == strcmp("lcov", optarg)) {
+                    config->coverage_format = ARMVM_COVERAGE_LCOV;
+                } else {
+                    fprintf(stderr, "ERROR: Argument to option -f/--coverage-format is invalid.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'H':
+                config->heatmap_file = strdup(optarg);
+                if (!config->heatmap_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'B':
+                {
+                    errno = 0;
+                    uint64_t bucket_size;
+                    char *endpoint;
+                    if (0 == strncmp("0x", optarg, 2)) {
+                        bucket_size = strtoull(optarg, &endpoint, 16);
+                    } else {
+                        bucket_size = strtoull(optarg, &endpoint, 10);
+                    }
+                    if (errno || *endpoint != 0 || bucket_size < 4 || bucket_size > 0x80000000 || (bucket_size & (bucket_size - 1))) {
+                        fprintf(stderr, "ERROR: Argument to option -B/--heatmap-bucket is invalid.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                    config->heatmap_bucket_size = bucket_size;
+                }
+                break;
+            case 'S':
+                config->stack_file = strdup(optarg);
+                if (!config->stack_file) {
+                    fprintf(stderr, "ERROR: not enough memory.\n");
+                    return ARMVM_CONFIG_FAIL;
+                }
+                break;
+            case 'm':
+            case 'u':
+                {
+                    errno = 0;
+                    uint64_t guard;
+                    char *endpoint;
+                    if (0 == strncmp("0x", optarg, 2)) {
+                        guard = strtoull(optarg, &endpoint, 16);
+                    } else {
+                        guard = strtoull(optarg, &endpoint, 10);
+                    }
+                    if (errno || *endpoint != 0 || guard > 0xffffffff) {
+                        fprintf(stderr, "ERROR: Argument to option -%c/--%s is invalid.\n", c, 'm' == c ? "msp-guard" : "psp-guard");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                    if ('m' == c) {
+                        config->stack_guard_main = guard;
+                    } else {
+                        config->stack_guard_process = guard;
+                    }
+                }
+                break;
+            case 'R':
+                config->trace_flags |= ARMVM_TRACE_REGISTERS;
+                break;
+            case 'M':
+                config->trace_flags |= ARMVM_TRACE_MEMORY;
+                break;
+            case 'l':
+                {
+                    errno = 0;
+                    uint64_t lockstep;
+                    char *endpoint;
+                    if (0 == strncmp("0x", optarg, 2)) {
+                        lockstep = strtoull(optarg, &endpoint, 16);
+                    } else {
+                        lockstep = strtoull(optarg, &endpoint, 10);
+                    }
+                    if (errno || *endpoint != 0) {
+                        fprintf(stderr, "ERROR: Argument to option -l/--lockstep is invalid.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                    config->lockstep = lockstep;
+                }
+                break;
+            case OPT_USART1_OUT:
+            case OPT_USART2_OUT:
+                {
+                    char **file = &config->usart_output[(c - OPT_USART1_OUT) / 2];
+                    free(*file);
+                    *file = strdup(optarg);
+                    if (!*file) {
+                        fprintf(stderr, "ERROR: not enough memory.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                }
+                break;
+            case OPT_USART1_IN:
+            case OPT_USART2_IN:
+                {
+                    char **file = &config->usart_input[(c - OPT_USART1_IN) / 2];
+                    free(*file);
+                    *file = strdup(optarg);
+                    if (!*file) {
+                        fprintf(stderr, "ERROR: not enough memory.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                }
+                break;
+            case OPT_GPIO_VCD:
+            case OPT_GPIO_IN:
+                {
+                    char **file = OPT_GPIO_VCD == c ? &config->gpio_vcd_file : &config->gpio_stimulus_file;
+                    free(*file);
+                    *file = strdup(optarg);
+                    if (!*file) {
+                        fprintf(stderr, "ERROR: not enough memory.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                }
+                break;
+            case OPT_ADC_IN:
+                {
+                    errno = 0;
+                    char *endpoint;
+                    const unsigned long channel = strtoul(optarg, &endpoint, 10);
+                    if (errno || endpoint == optarg || ':' != *endpoint || !endpoint[1] || channel >= ARMVM_ADC_CHANNELS) {
+                        fprintf(stderr, "ERROR: Argument to option --adc-in is invalid.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                    free(config->adc_input[channel]);
+                    config->adc_input[channel] = strdup(endpoint + 1);
+                    if (!config->adc_input[channel]) {
+                        fprintf(stderr, "ERROR: not enough memory.\n");
+                        return ARMVM_CONFIG_FAIL;
+                    }
+                }
+                break;
             case '?':
                 return ARMVM_CONFIG_FAIL;
             default:
@@ -138,5 +394,51 @@ int armvm_config_cleanup(struct armvm_config *config)
         free(config->program);
         config->program = NULL;
     }
+    if (config->symbol_file) {
+        free(config->symbol_file);
+        config->symbol_file = NULL;
+    }
+    if (config->profile_file) {
+        free(config->profile_file);
+        config->profile_file = NULL;
+    }
+    if (config->trace_file) {
+        free(config->trace_file);
+        config->trace_file = NULL;
+    }
+    if (config->callgraph_file) {
+        free(config->callgraph_file);
+        config->callgraph_file = NULL;
+    }
+    if (config->folded_file) {
+        free(config->folded_file);
+        config->folded_file = NULL;
+    }
+    if (config->coverage_file) {
+        free(config->coverage_file);
+        config->coverage_file = NULL;
+    }
+    if (config->heatmap_file) {
+        free(config->heatmap_file);
+        config->heatmap_file = NULL;
+    }
+    if (config->stack_file) {
+        free(config->stack_file);
+        config->stack_file = NULL;
+    }
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        free(config->usart_output[i]);
+        config->usart_output[i] = NULL;
+        free(config->usart_input[i]);
+        config->usart_input[i] = NULL;
+    }
+    free(config->gpio_vcd_file);
+    config->gpio_vcd_file = NULL;
+    free(config->gpio_stimulus_file);
+    config->gpio_stimulus_file = NULL;
+    for (size_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        free(config->adc_input[i]);
+        config->adc_input[i] = NULL;
+    }
     return ARMVM_CONFIG_SUCCESS;
 }
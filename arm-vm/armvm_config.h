@@ -21,6 +21,26 @@ struct armvm_config {
     char *program;
     uint64_t program_address;
     uint64_t steps;
+    uint64_t core_clock;
+    uint64_t lockstep;
+    char *symbol_file;
+    char *profile_file;
+    char *trace_file;
+    uint32_t trace_flags;
+    char *callgraph_file;
+    char *folded_file;
+    char *coverage_file;
+    enum armvm_coverage_format coverage_format;
+    char *heatmap_file;
+    uint32_t heatmap_bucket_size;
+    char *stack_file;
+    uint32_t stack_guard_main;
+    uint32_t stack_guard_process;
+    char *usart_output[ARMVM_USARTS];
+    char *usart_input[ARMVM_USARTS];
+    char *gpio_vcd_file;
+    char *gpio_stimulus_file;
+    char *adc_input[ARMVM_ADC_CHANNELS];
 };
 
 /**
@@ -0,0 +1,314 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+
+/*
+ * Benchmark of the virtual machine. Every workload is a program image, which is
+ * executed for a fixed amount of steps. The results are written as one JSON object
+ * per workload and line to stdout.
+ */
+
+#define DEVICE_ID "STM32F070CB"
+
+#define DEFAULT_STEPS         (20000000)
+#define DEFAULT_LATENCY_STEPS (200000)
+#define DEFAULT_ITERATIONS    (1000)
+
+struct bench_config {
+    uint64_t steps;          /**< Steps for the throughput measurement. */
+    uint64_t latency_steps;  /**< Steps which are timed one by one. */
+    uint64_t iterations;     /**< Iterations of the create/reset/destroy measurement. */
+};
+
+const struct option long_options[] = {
+    {"steps",         required_argument, 0, 's'},
+    {"latency-steps", required_argument, 0, 'l'},
+    {"iterations",    required_argument, 0, 'i'},
+    {"help",          no_argument,       0, 'h'},
+    {0, 0, 0, 0}
+};
+
+const char short_options[] = "s:l:i:h";
+
+const char usage_message[] =
+"Executes every workload and writes one JSON object per workload to stdout.\n"
+"A workload is given as NAME=FILE, where FILE is a program image for 0x08000000.\n"
+"\n"
+"Options:\n"
+"-s, --steps=AMOUNT          Steps for the throughput measurement (default: 20000000).\n"
+"-l, --latency-steps=AMOUNT  Steps which are timed one by one for the latency percentiles (default: 200000).\n"
+"-i, --iterations=AMOUNT     Iterations of the create/reset/destroy measurement (default: 1000).\n"
+"-h, --help                  Display this help message and exit.\n";
+
+
+uint64_t _bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+int _bench_compare(const void *a, const void *b)
+{
+    const uint64_t *value_a = a;
+    const uint64_t *value_b = b;
+
+    if (*value_a < *value_b) {
+        return -1;
+    }
+    return *value_a > *value_b;
+}
+
+
+/**
+ * @brief Returns the value at the permille-th position of the sorted vector values.
+ */
+uint64_t _bench_percentile(const uint64_t *values, size_t values_size, size_t permille)
+{
+    size_t idx = (values_size * permille) / 1000;
+    if (idx >= values_size) {
+        idx = values_size - 1;
+    }
+    return values[idx];
+}
+
+
+int _bench_create(struct armvm *armvm, const char *program_file)
+{
+    memset(armvm, 0, sizeof(*armvm));
+    armvm_opts_init(&armvm->opts);
+    armvm->opts.program_file = strdup(program_file);
+    armvm->opts.device_id = strdup(DEVICE_ID);
+    if (!armvm->opts.program_file || !armvm->opts.device_id) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        armvm_opts_cleanup(&armvm->opts);
+        return ARMVM_RET_NO_MEM;
+    }
+
+    if (_libarmvm_init(armvm)) {
+        armvm_opts_cleanup(&armvm->opts);
+        return ARMVM_RET_FAIL;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _bench_destroy(struct armvm *armvm)
+{
+    _libarmvm_cleanup(armvm);
+    armvm_opts_cleanup(&armvm->opts);
+}
+
+
+/**
+ * @brief Measures the mean latency of creating (including the reset), resetting and destroying a vm.
+ */
+int _bench_lifecycle(const struct bench_config *config, const char *program_file, uint64_t *create_ns, uint64_t *reset_ns, uint64_t *destroy_ns)
+{
+    struct armvm armvm;
+
+    *create_ns = 0;
+    *reset_ns = 0;
+    *destroy_ns = 0;
+
+    for (uint64_t i = 0; i < config->iterations; ++i) {
+        uint64_t start = _bench_now();
+        if (_bench_create(&armvm, program_file)) {
+            return ARMVM_RET_FAIL;
+        }
+        uint64_t created = _bench_now();
+        int ret = armvm.ci->reset(&armvm);
+        uint64_t reset = _bench_now();
+        _bench_destroy(&armvm);
+        uint64_t destroyed = _bench_now();
+
+        if (ret) {
+            return ARMVM_RET_FAIL;
+        }
+
+        *create_ns += created - start;
+        *reset_ns += reset - created;
+        *destroy_ns += destroyed - reset;
+    }
+
+    if (config->iterations) {
+        *create_ns /= config->iterations;
+        *reset_ns /= config->iterations;
+        *destroy_ns /= config->iterations;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _bench_workload(const struct bench_config *config, const char *name, const char *program_file)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct armvm armvm;
+    uint64_t *latencies = NULL;
+
+    if (access(program_file, R_OK)) {
+        fprintf(stderr, "WARN: Skipping workload '%s', the image does not exist: %s\n", name, program_file);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    uint64_t create_ns, reset_ns, destroy_ns;
+    if (_bench_lifecycle(config, program_file, &create_ns, &reset_ns, &destroy_ns)) {
+        fprintf(stderr, "ERROR: Could not create the vm for workload '%s'.\n", name);
+        return ARMVM_RET_FAIL;
+    }
+
+    // throughput
+    if (_bench_create(&armvm, program_file)) {
+        return ARMVM_RET_FAIL;
+    }
+
+    uint64_t start = _bench_now();
+    for (uint64_t i = 0; i < config->steps; ++i) {
+        if (armvm.ci->step(&armvm)) {
+            fprintf(stderr, "ERROR: Workload '%s' failed after %" PRIu64 " steps.\n", name, i);
+            ret = ARMVM_RET_FAIL;
+            goto err_vm;
+        }
+    }
+    uint64_t elapsed_ns = _bench_now() - start;
+
+    uint64_t cycles;
+    if (armvm.ci->get_cycles(&armvm, &cycles)) {
+        ret = ARMVM_RET_FAIL;
+        goto err_vm;
+    }
+
+    // latency of single steps, continued from the end of the throughput measurement
+    latencies = calloc(config->latency_steps ? config->latency_steps : 1, sizeof(*latencies));
+    if (!latencies) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret = ARMVM_RET_NO_MEM;
+        goto err_vm;
+    }
+
+    for (uint64_t i = 0; i < config->latency_steps; ++i) {
+        uint64_t step_start = _bench_now();
+        if (armvm.ci->step(&armvm)) {
+            fprintf(stderr, "ERROR: Workload '%s' failed after %" PRIu64 " steps.\n", name, config->steps + i);
+            ret = ARMVM_RET_FAIL;
+            goto err_latencies;
+        }
+        latencies[i] = _bench_now() - step_start;
+    }
+    qsort(latencies, config->latency_steps, sizeof(*latencies), _bench_compare);
+
+    const double seconds = elapsed_ns / 1e9;
+    printf("{\"workload\": \"%s\", \"steps\": %" PRIu64 ", \"cycles\": %" PRIu64 ", \"seconds\": %.6f, \"mips\": %.3f",
+           name, config->steps, cycles, seconds, seconds > 0 ? config->steps / seconds / 1e6 : 0.0);
+    if (config->latency_steps) {
+        printf(", \"step_ns\": {\"p50\": %" PRIu64 ", \"p90\": %" PRIu64 ", \"p99\": %" PRIu64 ", \"p999\": %" PRIu64 ", \"max\": %" PRIu64 "}",
+               _bench_percentile(latencies, config->latency_steps, 500),
+               _bench_percentile(latencies, config->latency_steps, 900),
+               _bench_percentile(latencies, config->latency_steps, 990),
+               _bench_percentile(latencies, config->latency_steps, 999),
+               latencies[config->latency_steps - 1]);
+    }
+    printf(", \"create_ns\": %" PRIu64 ", \"reset_ns\": %" PRIu64 ", \"destroy_ns\": %" PRIu64 "}\n",
+           create_ns, reset_ns, destroy_ns);
+    fflush(stdout);
+
+err_latencies:
+    free(latencies);
+err_vm:
+    _bench_destroy(&armvm);
+    return ret;
+}
+
+
+int _bench_parse_amount(const char *arg, uint64_t *amount)
+{
+    char *endpoint;
+
+    errno = 0;
+    *amount = strtoull(arg, &endpoint, 0);
+    if (errno || *endpoint != 0) {
+        return ARMVM_RET_FAIL;
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret_val = 0;
+    struct bench_config config = { DEFAULT_STEPS, DEFAULT_LATENCY_STEPS, DEFAULT_ITERATIONS };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, short_options, long_options, &option_index);
+
+        if (-1 == c) {
+            break;
+        }
+
+        switch (c) {
+            case 's':
+                if (_bench_parse_amount(optarg, &config.steps)) {
+                    fprintf(stderr, "ERROR: Argument to option -s/--steps is invalid.\n");
+                    return 1;
+                }
+                break;
+            case 'l':
+                if (_bench_parse_amount(optarg, &config.latency_steps)) {
+                    fprintf(stderr, "ERROR: Argument to option -l/--latency-steps is invalid.\n");
+                    return 1;
+                }
+                break;
+            case 'i':
+                if (_bench_parse_amount(optarg, &config.iterations)) {
+                    fprintf(stderr, "ERROR: Argument to option -i/--iterations is invalid.\n");
+                    return 1;
+                }
+                break;
+            case 'h':
+                printf("Usage: %s [options] NAME=FILE...\n\n%s", argv[0], usage_message);
+                return 0;
+            default:
+                printf("Usage: %s [options] NAME=FILE...\n\n%s", argv[0], usage_message);
+                return 1;
+        }
+    }
+
+    if (optind >= argc) {
+        fprintf(stderr, "ERROR: No workload given.\n");
+        return 1;
+    }
+
+    for (int i = optind; i < argc; ++i) {
+        char *name = strdup(argv[i]);
+        if (!name) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return 1;
+        }
+
+        char *program_file = strchr(name, '=');
+        if (!program_file) {
+            fprintf(stderr, "ERROR: Invalid workload (expected NAME=FILE): %s\n", argv[i]);
+            free(name);
+            return 1;
+        }
+        *program_file++ = '\0';
+
+        if (_bench_workload(&config, name, program_file)) {
+            ret_val = 1;
+        }
+        free(name);
+    }
+
+    return ret_val;
+}
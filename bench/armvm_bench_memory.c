@@ -0,0 +1,209 @@
+#include <armvm.h>
+#include <libarmvm_memory.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+#include <inttypes.h>
+
+/*
+ * Micro-benchmark of the access paths of the memory model. Every access function
+ * of armvm->mem is timed for every memory area and for a sequential and a random
+ * address pattern. The results are written as one JSON object per line to stdout.
+ */
+
+#define DEVICE_ID "STM32F070CB"
+
+#define DEFAULT_ACCESSES (10000000)
+
+/**
+ * @brief Amount of precomputed addresses per pattern. Has to be a power of two.
+ */
+#define ADDRESSES (4096)
+
+/**
+ * @brief Size of the address range which is accessed in every area.
+ */
+#define SPAN (16 * 1024)
+
+
+struct bench_area {
+    const char *name;
+    uint32_t addr;
+};
+
+
+static const struct bench_area areas[] = {
+    { "remap",  0x00000000 }, // alias of the FLASH
+    { "flash",  0x08000000 },
+    { "ram",    0x20000000 },
+    { "system", 0xe0000000 }, // last area of the list
+    { "miss",   0x40000000 }, // not mapped
+};
+
+
+struct bench_op {
+    const char *name;
+    uint8_t width;    /**< Amount of accessed bytes. */
+    uint8_t aligned;  /**< If 0, the addresses are shifted by one byte. */
+    uint64_t (*run)(struct armvm_memory *mem, const uint32_t *addrs, uint64_t accesses);
+};
+
+
+#define BENCH_READ(fn, type) \
+uint64_t _bench_##fn(struct armvm_memory *mem, const uint32_t *addrs, uint64_t accesses) \
+{ \
+    uint64_t sum = 0; \
+    for (uint64_t i = 0; i < accesses; ++i) { \
+        type value = 0; \
+        mem->fn(mem->data, addrs[i & (ADDRESSES - 1)], &value); \
+        sum += value; \
+    } \
+    return sum; \
+}
+
+#define BENCH_WRITE(fn, type) \
+uint64_t _bench_##fn(struct armvm_memory *mem, const uint32_t *addrs, uint64_t accesses) \
+{ \
+    for (uint64_t i = 0; i < accesses; ++i) { \
+        type value = i; \
+        mem->fn(mem->data, addrs[i & (ADDRESSES - 1)], &value); \
+    } \
+    return accesses; \
+}
+
+BENCH_READ(read_byte, uint8_t)
+BENCH_READ(read_halfword, uint16_t)
+BENCH_READ(read_word, uint32_t)
+BENCH_READ(read_halfword_unaligned, uint16_t)
+BENCH_READ(read_word_unaligned, uint32_t)
+BENCH_WRITE(write_byte, uint8_t)
+BENCH_WRITE(write_halfword, uint16_t)
+BENCH_WRITE(write_word, uint32_t)
+BENCH_WRITE(write_halfword_unaligned, uint16_t)
+BENCH_WRITE(write_word_unaligned, uint32_t)
+
+
+static const struct bench_op ops[] = {
+    { "read_byte",                1, 1, _bench_read_byte },
+    { "read_halfword",            2, 1, _bench_read_halfword },
+    { "read_word",                4, 1, _bench_read_word },
+    { "read_halfword_unaligned",  2, 0, _bench_read_halfword_unaligned },
+    { "read_word_unaligned",      4, 0, _bench_read_word_unaligned },
+    { "write_byte",               1, 1, _bench_write_byte },
+    { "write_halfword",           2, 1, _bench_write_halfword },
+    { "write_word",               4, 1, _bench_write_word },
+    { "write_halfword_unaligned", 2, 0, _bench_write_halfword_unaligned },
+    { "write_word_unaligned",     4, 0, _bench_write_word_unaligned },
+};
+
+
+uint64_t _bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+/**
+ * @brief Fills addrs with ADDRESSES addresses in [base, base + SPAN), which are aligned to width
+ * (plus one byte if the op is unaligned). The random pattern uses a fixed xorshift32 seed.
+ */
+void _bench_addresses(uint32_t *addrs, uint32_t base, const struct bench_op *op, int random)
+{
+    const uint32_t slots = (SPAN - 4) / op->width;
+    uint32_t x = 0x12345678;
+
+    for (size_t i = 0; i < ADDRESSES; ++i) {
+        uint32_t slot = i % slots;
+        if (random) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            slot = x % slots;
+        }
+        addrs[i] = base + slot * op->width + (op->aligned ? 0 : 1);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret_val = 0;
+    uint64_t accesses = DEFAULT_ACCESSES;
+    struct armvm armvm;
+    uint32_t addrs[ADDRESSES];
+
+    const struct option long_options[] = {
+        {"accesses", required_argument, 0, 'a'},
+        {"help",     no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "a:h", long_options, &option_index);
+
+        if (-1 == c) {
+            break;
+        }
+
+        if ('a' == c) {
+            char *endpoint;
+            errno = 0;
+            accesses = strtoull(optarg, &endpoint, 0);
+            if (errno || *endpoint != 0) {
+                fprintf(stderr, "ERROR: Argument to option -a/--accesses is invalid.\n");
+                return 1;
+            }
+        } else {
+            printf("Usage: %s [options]\n\n", argv[0]);
+            printf("Times every access function of the memory model per area and address pattern.\n\n");
+            printf("Options:\n");
+            printf("-a, --accesses=AMOUNT       Accesses per measurement (default: 10000000).\n");
+            printf("-h, --help                  Display this help message and exit.\n");
+            return 'h' == c ? 0 : 1;
+        }
+    }
+
+    memset(&armvm, 0, sizeof(armvm));
+    armvm_opts_init(&armvm.opts);
+    armvm.opts.device_id = strdup(DEVICE_ID);
+    if (!armvm.opts.device_id) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret_val = 1;
+        goto err_opts;
+    }
+
+    if (libarmvm_memory_init(&armvm)) {
+        ret_val = 1;
+        goto err_opts;
+    }
+
+    for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); ++i) {
+        for (size_t j = 0; j < sizeof(areas) / sizeof(areas[0]); ++j) {
+            for (int random = 0; random < 2; ++random) {
+                _bench_addresses(addrs, areas[j].addr, &ops[i], random);
+
+                uint64_t start = _bench_now();
+                volatile uint64_t sink = ops[i].run(armvm.mem, addrs, accesses);
+                uint64_t elapsed_ns = _bench_now() - start;
+                (void)sink;
+
+                printf("{\"op\": \"%s\", \"width\": %u, \"aligned\": %s, \"area\": \"%s\", \"pattern\": \"%s\", "
+                       "\"accesses\": %" PRIu64 ", \"ns_per_access\": %.3f}\n",
+                       ops[i].name, ops[i].width, ops[i].aligned ? "true" : "false", areas[j].name,
+                       random ? "random" : "sequential", accesses,
+                       accesses ? (double)elapsed_ns / accesses : 0.0);
+            }
+        }
+    }
+
+    libarmvm_memory_cleanup(&armvm);
+err_opts:
+    armvm_opts_cleanup(&armvm.opts);
+    return ret_val;
+}
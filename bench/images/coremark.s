@@ -0,0 +1,59 @@
+@ CoreMark-like integer workload: fills a buffer, runs a multiply-accumulate
+@ over it and folds the result with a bitwise CRC16. The checksum of every
+@ iteration seeds the next one. Runs forever.
+
+    .syntax unified
+    .cpu cortex-m0
+    .thumb
+
+    .text
+vectors:
+    .word 0x20004000                @ initial SP
+    .word reset + 1                 @ reset vector (thumb)
+
+reset:
+    movs    r0, #1
+    lsls    r0, r0, #29             @ r0 = 0x20000000 (RAM)
+    movs    r5, #0xa0
+    lsls    r5, r5, #8
+    adds    r5, #0x01               @ r5 = 0xa001 (CRC16 polynomial)
+    movs    r6, #0                  @ r6 = checksum
+
+outer:
+    movs    r1, #0                  @ buf[i] = i * 7 + checksum
+    movs    r2, r0
+fill:
+    movs    r3, #7
+    muls    r3, r1, r3
+    adds    r3, r3, r6
+    str     r3, [r2, #0]
+    adds    r2, #4
+    adds    r1, #1
+    cmp     r1, #16
+    bne     fill
+
+    movs    r1, #0                  @ acc += buf[i] * buf[i + 1]
+    movs    r2, r0
+    movs    r4, #0
+mac:
+    ldr     r3, [r2, #0]
+    ldr     r7, [r2, #4]
+    muls    r3, r7, r3
+    adds    r4, r4, r3
+    adds    r2, #4
+    adds    r1, #1
+    cmp     r1, #15
+    bne     mac
+
+    movs    r1, #16                 @ CRC16 over the low 16 bits of acc
+crc:
+    lsrs    r4, r4, #1
+    bcc     crc_next
+    eors    r4, r5
+crc_next:
+    subs    r1, #1
+    bne     crc
+
+    eors    r6, r4
+    uxth    r6, r6
+    b       outer
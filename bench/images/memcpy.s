@@ -0,0 +1,61 @@
+@ memcpy/memset workload: copies 1 KiB from FLASH to RAM with unrolled word
+@ accesses, fills 1 KiB with bytes and copies 512 bytes within the RAM with
+@ halfword accesses. Runs forever.
+
+    .syntax unified
+    .cpu cortex-m0
+    .thumb
+
+    .text
+vectors:
+    .word 0x20004000                @ initial SP
+    .word reset + 1                 @ reset vector (thumb)
+
+reset:
+    movs    r0, #1
+    lsls    r0, r0, #29             @ r0 = 0x20000000 (RAM)
+    movs    r1, #1
+    lsls    r1, r1, #27             @ r1 = 0x08000000 (FLASH)
+    movs    r6, #1
+    lsls    r6, r6, #10             @ r6 = 1024
+
+outer:
+    movs    r2, #64                 @ memcpy: 64 * 16 bytes
+    movs    r3, r0
+    movs    r4, r1
+copy:
+    ldr     r5, [r4, #0]
+    str     r5, [r3, #0]
+    ldr     r5, [r4, #4]
+    str     r5, [r3, #4]
+    ldr     r5, [r4, #8]
+    str     r5, [r3, #8]
+    ldr     r5, [r4, #12]
+    str     r5, [r3, #12]
+    adds    r4, #16
+    adds    r3, #16
+    subs    r2, #1
+    bne     copy
+
+    movs    r2, r6                  @ memset: 1024 bytes
+    movs    r3, r0
+    movs    r5, #0x5a
+fill:
+    strb    r5, [r3, #0]
+    adds    r3, #1
+    subs    r2, #1
+    bne     fill
+
+    movs    r2, #1                  @ halfword copy: 256 halfwords
+    lsls    r2, r2, #8
+    movs    r3, r0
+    adds    r4, r0, r6
+halfword:
+    ldrh    r5, [r3, #0]
+    strh    r5, [r4, #0]
+    adds    r3, #2
+    adds    r4, #2
+    subs    r2, #1
+    bne     halfword
+
+    b       outer
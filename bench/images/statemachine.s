@@ -0,0 +1,72 @@
+@ Branch-heavy workload: a four state machine which is driven by the top two
+@ bits of a xorshift32 generator. Every transition from state 3 on symbol 3
+@ is counted in r6. Runs forever.
+
+    .syntax unified
+    .cpu cortex-m0
+    .thumb
+
+    .text
+vectors:
+    .word 0x20004000                @ initial SP
+    .word reset + 1                 @ reset vector (thumb)
+
+reset:
+    movs    r0, #1                  @ r0 = xorshift32 state
+    movs    r1, #0                  @ r1 = state of the machine
+    movs    r6, #0                  @ r6 = accepted sequences
+
+next:
+    lsls    r2, r0, #13
+    eors    r0, r2
+    lsrs    r2, r0, #17
+    eors    r0, r2
+    lsls    r2, r0, #5
+    eors    r0, r2
+    lsrs    r2, r0, #30             @ r2 = symbol (0 - 3)
+
+    cmp     r1, #0
+    beq     state0
+    cmp     r1, #1
+    beq     state1
+    cmp     r1, #2
+    beq     state2
+
+state3:
+    cmp     r2, #3
+    bne     goto2
+    adds    r6, #1
+    movs    r1, #0
+    b       next
+
+state0:
+    cmp     r2, #1
+    beq     goto1
+    cmp     r2, #2
+    beq     goto2
+    b       next
+
+state1:
+    cmp     r2, #0
+    beq     goto0
+    cmp     r2, #3
+    beq     goto3
+    b       next
+
+state2:
+    cmp     r2, #2
+    bcc     goto1
+    b       goto0
+
+goto0:
+    movs    r1, #0
+    b       next
+goto1:
+    movs    r1, #1
+    b       next
+goto2:
+    movs    r1, #2
+    b       next
+goto3:
+    movs    r1, #3
+    b       next
@@ -14,6 +14,9 @@
 #define ARMVM_RET_ADDR_NOT_ALIGN (-6)
 #define ARMVM_RET_INVALID_REG    (-7)
 #define ARMVM_RET_UNPREDICTABLE  (-8)
+#define ARMVM_RET_DIVERGED       (-9)
+#define ARMVM_RET_EXIT           (-10) /**< The program stopped the vm (see armvm.exit_code). */
+#define ARMVM_RET_STACK_OVERFLOW (-11) /**< A stack pointer was set below its guard (see armvm_opts.stack_guard_main). */
 
 /**
  * @brief Returns the libarmvm version string.
@@ -42,6 +45,18 @@ int armvm_opts_init(struct armvm_opts *opts);
 int armvm_opts_cleanup(struct armvm_opts *opts);
 
 
+/**
+ * @brief Adds an instrumentation hook to the options.
+ * The hook is copied. Hooks of a kind cost no execution time as long as no hook of this
+ * kind is registered.
+ *
+ * @param opts Pointer to the options of the virtual machine.
+ * @param hook The hook which shall be added.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int armvm_opts_add_hook(struct armvm_opts *opts, const struct armvm_hook *hook);
+
+
 /**
  * @brief Starts the arm virtual machine.
  *
@@ -50,7 +65,9 @@ int armvm_opts_cleanup(struct armvm_opts *opts);
  *
  * @param armvm Pointer to a memory location which holds the state of the virtual machine.
  * @param opts Pointer to the options of the virtual machine.
- * @return ARMVM_RET_SUCCESS on success.
+ * @return ARMVM_RET_SUCCESS on success. This includes a program which stopped the vm through
+ *         the semihosting, its exit code is armvm->exit_code afterwards. If a hook stopped the
+ *         vm, its return value is returned.
  */
 int armvm_start(struct armvm *armvm, const struct armvm_opts *opts);
 
@@ -3,6 +3,7 @@
 #define __ARMVM_TYPES_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 struct armvm;
 
@@ -18,6 +19,92 @@ enum armvm_ISA_e {
 };
 
 
+/**
+ * @brief Kinds of instrumentation hooks.
+ */
+enum armvm_hook_type {
+    ARMVM_HOOK_INSTRUCTION = 0, /**< Before an instruction in [begin, end) is executed. */
+    ARMVM_HOOK_BASIC_BLOCK,     /**< Before an instruction in [begin, end) is executed, which was reached by a branch, an exception or the reset. */
+    ARMVM_HOOK_MEMORY_READ,     /**< After a successful read of an address in [begin, end). Instruction fetches are reads too. */
+    ARMVM_HOOK_MEMORY_WRITE,    /**< After a successful write to an address in [begin, end). */
+    ARMVM_HOOK_EXCEPTION_ENTRY, /**< After an exception was taken. */
+    ARMVM_HOOK_EXCEPTION_EXIT,  /**< After the return from an exception. */
+    ARMVM_HOOK_STOP,            /**< After the virtual machine stopped executing instructions. */
+    // This have to be the last entry of the enum
+    ARMVM_HOOK_TYPES            /**< This is used for internal purposes. */
+};
+
+
+/**
+ * @brief Describes the event, which caused the call of a hook.
+ */
+struct armvm_hook_event {
+    enum armvm_hook_type type;
+    uint32_t addr;   /**< Address of the instruction or the memory access. Exception number for exception hooks. */
+    uint32_t value;  /**< Read or written value for memory hooks. */
+    uint8_t size;    /**< Amount of accessed bytes (1, 2 or 4) for memory hooks. */
+    int ret;         /**< Return value of the execution for the stop hook. */
+};
+
+
+/**
+ * @brief An instrumentation hook (see armvm_opts_add_hook()).
+ */
+struct armvm_hook {
+    enum armvm_hook_type type;
+
+    /**
+     * @brief First address of the range. Is only used for instruction, basic block and memory hooks.
+     */
+    uint32_t begin;
+
+    /**
+     * @brief First address after the range. 0 means that the range ends at the end of the address space.
+     */
+    uint32_t end;
+
+    /**
+     * @brief Is called for every event in the range.
+     *
+     * @param armvm Pointer to the virtual machine. The interfaces may be used to inspect the state.
+     * @param event The event which caused the call.
+     * @param data The data pointer of the hook.
+     * @return ARMVM_RET_SUCCESS to continue the execution. Every other value stops the
+     *         virtual machine and is returned by armvm_start(). The return value of the stop
+     *         hook is ignored.
+     */
+    int (*callback)(struct armvm *armvm, const struct armvm_hook_event *event, void *data);
+
+    void *data; /**< Is passed to callback. */
+};
+
+
+#define ARMVM_TRACE_REGISTERS (0x1) /**< The trace contains the changes of the registers. */
+#define ARMVM_TRACE_MEMORY    (0x2) /**< The trace contains all memory writes. */
+
+
+/**
+ * @brief Output formats of the code coverage.
+ */
+enum armvm_coverage_format {
+    ARMVM_COVERAGE_DRCOV = 0, /**< Executed basic blocks in the drcov format (version 2). */
+    ARMVM_COVERAGE_LCOV,      /**< Line and branch coverage in the lcov tracefile format. Needs the line table of the ELF file (symbol_file). */
+};
+
+
+/**
+ * @brief Amount of USARTs of the device, whose data can be exchanged with the host (USART1 and USART2).
+ */
+#define ARMVM_USARTS (2)
+
+
+/**
+ * @brief Amount of channels of the ADC, whose samples can be read from files of the host
+ * (16 external channels, the temperature sensor, VREFINT and VBAT).
+ */
+#define ARMVM_ADC_CHANNELS (19)
+
+
 /**
  * @brief This structure contains all options for the virtual machine.
  */
@@ -27,6 +114,28 @@ struct armvm_opts {
     enum armvm_ISA_e isa;          /**< Instruction Set Architecture, which shall be loaded */
     uint64_t program_address;      /**< Address to which the program will be loaded. */
     uint64_t steps;                /**< The amount of steps, which will be executed. If set to 0, the vm will run indefinitely. */
+    uint64_t core_clock;           /**< Frequency of the core clock in Hz after reset. Is used to convert cycles into simulated time. */
+    uint64_t lockstep;             /**< If not 0, a reference instance of the vm is executed in lockstep and both are compared every lockstep steps. */
+    char *symbol_file;             /**< ELF file of the program. If set, its symbols are used in reports. */
+    char *profile_file;            /**< If set, executions per instruction address are counted and a hot-spot report is written to this file ("-" for stdout). */
+    char *trace_file;              /**< If set, a compact binary execution trace is written to this file (see arm-vm-trace). */
+    uint32_t trace_flags;          /**< Additional content of the trace (ARMVM_TRACE_*). */
+    char *callgraph_file;          /**< If set, calls and returns are tracked and the inclusive/exclusive counts per function are written to this file ("-" for stdout). */
+    char *heatmap_file;            /**< If set, reads and writes are counted per memory area, access width and bucket and a heatmap is written to this file ("-" for stdout). */
+    uint32_t heatmap_bucket_size;  /**< Size of one bucket of the heatmap in bytes (power of two). 0 selects the default of 64 bytes. */
+    char *stack_file;              /**< If set, the lowest values of MSP and PSP are tracked and written to this file ("-" for stdout). */
+    uint32_t stack_guard_main;     /**< If not 0, the vm stops with ARMVM_RET_STACK_OVERFLOW when the MSP is set below this address. */
+    uint32_t stack_guard_process;  /**< If not 0, the vm stops with ARMVM_RET_STACK_OVERFLOW when the PSP is set below this address. */
+    struct armvm_hook *hooks;      /**< Vector of instrumentation hooks (see armvm_opts_add_hook()). */
+    size_t hooks_size;             /**< Size of the hooks vector. */
+    char *folded_file;             /**< If set, the cycles per call path are written to this file in the folded stack format of flame graph tools ("-" for stdout). */
+    char *coverage_file;           /**< If set, the executed instructions and the outcomes of conditional branches are recorded and written to this file ("-" for stdout). */
+    enum armvm_coverage_format coverage_format; /**< Format of the coverage file. */
+    char *usart_output[ARMVM_USARTS]; /**< If set, the bytes transmitted by USARTn+1 are written to this file or pipe ("-" for stdout). */
+    char *usart_input[ARMVM_USARTS];  /**< If set, USARTn+1 receives the bytes read from this file or pipe ("-" for stdin). */
+    char *gpio_vcd_file;           /**< If set, the changes of the GPIO pins are written to this file as value change dump (VCD). */
+    char *gpio_stimulus_file;      /**< If set, the GPIO input pins are driven by the changes in this file (see struct libarmvm_gpio). */
+    char *adc_input[ARMVM_ADC_CHANNELS]; /**< If set, the conversions of channel n take their samples from this file (raw int16 or CSV, see struct libarmvm_adc). */
 };
 
 
@@ -48,9 +157,11 @@ struct armvm_ci {
 
     /**
      * @brief Executes one step.
-     * One step normally means on tact of the virtual machine. Since the frequency of
-     * the system clock can be changed, the amount of passed simulation time is not
-     * fixed.
+     * One step means the execution of one instruction, the entry into an exception or one
+     * cycle of a core which sleeps in WFI or WFE. Every instruction takes as many
+     * cycles as on the modeled core (see get_cycles()). Since the frequency of the
+     * system clock can be changed, the amount of passed simulation time per cycle is
+     * not fixed (see get_time()).
      *
      * reset() have to be called once before the first call to this function. If this
      * is not done, the behavior of this function is undefined.
@@ -59,6 +170,44 @@ struct armvm_ci {
      * @return Returns ARMVM_RET_SUCCESS on success.
      */
     int (*step)(struct armvm *armvm);
+
+    /**
+     * @brief Executes up to steps steps.
+     * Behaves like calling step() steps times, but detects idle loops: short loops, which
+     * only read the memory and reach their first instruction again with unchanged registers.
+     * Such a loop cannot leave on its own, therefore its remaining iterations are skipped up to
+     * the end of the steps or the next scheduled event. The skipped steps and their cycles are
+     * accounted as if they were executed. A loop which reads a register of a peripheral, that
+     * changes with the cycles (e.g. the counter of a timer), is no idle loop.
+     *
+     * Idle loops are not skipped if the execution is instrumented per step (e.g. profiling,
+     * tracing or the heatmap).
+     *
+     * @param armvm Pointer to the data of the virtual machine.
+     * @param steps Maximal amount of steps.
+     * @param executed Pointer to the destination of the amount of successfully executed steps.
+     * @return Returns ARMVM_RET_SUCCESS on success.
+     */
+    int (*run)(struct armvm *armvm, uint64_t steps, uint64_t *executed);
+
+    /**
+     * @brief Returns the amount of core cycles since the last reset.
+     *
+     * @param armvm Pointer to the data of the virtual machine.
+     * @param cycles Pointer to the destination.
+     * @return Returns ARMVM_RET_SUCCESS on success.
+     */
+    int (*get_cycles)(struct armvm *armvm, uint64_t *cycles);
+
+    /**
+     * @brief Returns the simulated time since the last reset.
+     * The time is derived from the cycles and the frequency of the core clock.
+     *
+     * @param armvm Pointer to the data of the virtual machine.
+     * @param ns Pointer to the destination. The time is given in nanoseconds.
+     * @return Returns ARMVM_RET_SUCCESS on success.
+     */
+    int (*get_time)(struct armvm *armvm, uint64_t *ns);
 };
 
 
@@ -261,6 +410,7 @@ struct armvm {
     struct armvm_registers *regs;     /**< Interface to the registers */
     struct armvm_peripherals *periph; /**< Interface to the peripherals of the controller */
     struct armvm_ci *ci;              /**< Control interface for the virtual machine */
+    int exit_code;                    /**< Exit code, if the program stopped the vm through semihosting (SYS_EXIT). 0 otherwise. */
 };
 
 #endif
@@ -1,10 +1,13 @@
 #include <isa/armv6_m.h>
 #include <assert.h>
 #include <libarmvm_ci.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_nvic.h>
+#include <libarmvm_semihosting.h>
 #include <stdio.h>
+#include <string.h>
 
-// TODO: Make a cmake flag for this
-#define PRINT_ASM_ON
+// PRINT_ASM_ON is set by the cmake option ARMVM_PRINT_ASM
 #ifdef PRINT_ASM_ON
 
 #define PRINT_PC(armvm)\
@@ -30,6 +33,9 @@
 #endif
 
 
+#define ADD_CYCLES(armvm, n) (((struct libarmvm_ci *)(armvm)->ci->data)->cycles += (n))
+
+
 #define UNSET_APSR_ALL(apsr) (apsr = apsr & ~(0b1111 << 28));
 
 #define APSR_N (0x1 << 31)
@@ -90,6 +96,9 @@ int armv6m_TakeReset(struct armvm *armvm)
 
     uint32_t vectortable = 0; // TODO: set to VTOR
     armv6m->CurrentMode = MODE_THREAD;
+    armv6m->EventRegister = 0;
+    armv6m->PRIMASK = 0;
+    memset(armv6m->ExceptionActive, 0, sizeof(armv6m->ExceptionActive));
 
     // Set register LR to unknown
 
@@ -162,6 +171,8 @@ int armv6m_load_instruction(struct armvm *armvm, uint32_t addr, struct armv6m_in
         goto err;
     }
 
+    instruction->addr = addr;
+
     uint16_t firstBits = ins >> 11;
     instruction->is32Bit =    0b11101 == firstBits
                            || 0b11110 == firstBits
@@ -207,20 +218,26 @@ err:
 
 int _execute_32bit_instruction(struct armvm *armvm, const struct armv6m_instruction *instruction) {
     int ret = ARMVM_RET_FAIL;
+    uint32_t cycles = ARMV6M_CYCLES_DEFAULT;
 
     if (   (instruction->i._32bit >> (16 + 11)) == 0b11110
         && (instruction->i._32bit >> 14) & 0b11 == 0b11
         && (instruction->i._32bit >> 12) & 0b1 == 0b1) {
 
         ret = armv6m_ins_BL_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_BL;
     }
 
+    if (ARMVM_RET_SUCCESS == ret) {
+        ADD_CYCLES(armvm, cycles);
+    }
     return ret;
 }
 
 
 int _execute_16bit_instruction(struct armvm *armvm, const struct armv6m_instruction *instruction) {
     int ret = ARMVM_RET_FAIL;
+    uint32_t cycles = ARMV6M_CYCLES_DEFAULT;
 
     if (instruction->i._16bit >> 6 == 0b0000000000) {
         ret = armv6m_ins_MOV_register_T2(armvm, instruction);
@@ -279,33 +296,43 @@ int _execute_16bit_instruction(struct armvm *armvm, const struct armv6m_instruct
 
     } else if (instruction->i._16bit >> 11 == 0b01001) {
         ret = armv6m_ins_LDR_literal_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 9 == 0b0101111) {
         ret = armv6m_ins_LDRSH_register_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b01100) {
         ret = armv6m_ins_STR_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b01101) {
         ret = armv6m_ins_LDR_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b01110) {
         ret = armv6m_ins_STRB_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b01111) {
         ret = armv6m_ins_LDRB_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b10000) {
         ret = armv6m_ins_STRH_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b10001) {
         ret = armv6m_ins_LDRH_immediate_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b10010) {
         ret = armv6m_ins_STR_immediate_T2(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b10011) {
         ret = armv6m_ins_LDR_immediate_T2(armvm, instruction);
+        cycles = ARMV6M_CYCLES_LOAD_STORE;
 
     } else if (instruction->i._16bit >> 11 == 0b10101) {
         ret = armv6m_ins_ADD_SP_immediate_T1(armvm, instruction);
@@ -327,9 +354,31 @@ int _execute_16bit_instruction(struct armvm *armvm, const struct armv6m_instruct
 
     } else if (instruction->i._16bit >> 9 == 0b1011010) {
         ret = armv6m_ins_PUSH_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_MULTIPLE;
 
     } else if (instruction->i._16bit >> 9 == 0b1011110) {
         ret = armv6m_ins_POP_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_MULTIPLE;
+
+    } else if ((instruction->i._16bit & 0xffef) == 0xb662) {
+        ret = armv6m_ins_CPS_T1(armvm, instruction);
+
+    } else if (instruction->i._16bit == 0xbf20) {
+        ret = armv6m_ins_WFE_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_WAIT;
+
+    } else if (instruction->i._16bit == 0xbf30) {
+        ret = armv6m_ins_WFI_T1(armvm, instruction);
+        cycles = ARMV6M_CYCLES_WAIT;
+
+    } else if (instruction->i._16bit == 0xbf40) {
+        ret = armv6m_ins_SEV_T1(armvm, instruction);
+
+    } else if (instruction->i._16bit >> 8 == 0b11011111) {
+        ret = armv6m_ins_SVC_T1(armvm, instruction);
+
+    } else if (instruction->i._16bit >> 8 == 0b10111110) {
+        ret = armv6m_ins_BKPT_T1(armvm, instruction);
 
     } else if (instruction->i._16bit >> 12 == 0b1101) {
         if (((instruction->i._16bit >> 9) & 0b111) != 0b111) {
@@ -340,6 +389,10 @@ int _execute_16bit_instruction(struct armvm *armvm, const struct armv6m_instruct
         ret = armv6m_ins_B_T2(armvm, instruction);
 
     }
+
+    if (ARMVM_RET_SUCCESS == ret) {
+        ADD_CYCLES(armvm, cycles);
+    }
     return ret;
 }
 
@@ -353,7 +406,8 @@ int armv6m_execute_instruction(struct armvm *armvm, const struct armv6m_instruct
         ret = _execute_32bit_instruction(armvm, instruction);
     }
 
-    if (ARMVM_RET_SUCCESS != ret) {
+    // ARMVM_RET_EXIT is no error, the program stopped the vm through the semihosting
+    if (ARMVM_RET_SUCCESS != ret && ARMVM_RET_EXIT != ret) {
         uint32_t pc;
         if (armvm->regs->read_gpr(armvm->regs->data, ARMV6M_REG_PC, &pc)) {
             fprintf(stderr, "ERROR: Could not read gpr.\n");
@@ -385,6 +439,42 @@ int armv6m_execute_instruction(struct armvm *armvm, const struct armv6m_instruct
 }
 
 
+int armv6m_is_register_only(const struct armv6m_instruction *instruction)
+{
+    if (instruction->is32Bit) {
+        // BL, the other 32bit instructions are MSR, MRS, the barriers and UDF.W
+        return 0b11110 == (instruction->i._32bit >> 27) && 0xd000 == (instruction->i._32bit & 0xd000);
+    }
+
+    const uint16_t ins = instruction->i._16bit;
+    switch (ins >> 12) {
+        case 0b0101:
+            // STR, STRH and STRB (register) have opB = 0b0xx except LDRSB (0b011)
+            return (ins & 0x0e00) >= 0x0600;
+        case 0b0110: // STR/LDR (immediate)
+        case 0b0111: // STRB/LDRB (immediate)
+        case 0b1000: // STRH/LDRH (immediate)
+        case 0b1001: // STR/LDR (SP relative)
+        case 0b1100: // STM/LDM
+            return (ins >> 11) & 0x1;
+        case 0b1011:
+            // PUSH, CPS, BKPT and the hints except NOP and YIELD
+            if (0xb400 == (ins & 0xfe00) || 0xb660 == (ins & 0xffe0) || 0xbe00 == (ins & 0xff00)) {
+                return 0;
+            }
+            if (0xbf00 == (ins & 0xff00)) {
+                return 0xbf00 == ins || 0xbf10 == ins;
+            }
+            return 1;
+        case 0b1101:
+            // UDF and SVC
+            return 0b111 != ((ins >> 9) & 0b111);
+        default:
+            return 1;
+    }
+}
+
+
 int armv6m_update_pc(struct armvm *armvm, const struct armv6m_instruction *instruction)
 {
     assert(armvm);
@@ -451,8 +541,7 @@ int armv6m_BXWritePC(struct armvm *armvm, uint32_t address)
     struct armv6m *armv6m = ci->data;
 
     if (armv6m->CurrentMode == MODE_HANDLER && (address >> 28) == 0b1111) {
-        printf("TODO: ExceptionReturn()\n");
-        return ARMVM_RET_FAIL;
+        return armv6m_ExceptionReturn(armvm, address);
     }
 
     ret = armv6m_set_EPSR_T(armvm, address & 0x1);
@@ -482,6 +571,10 @@ int armv6m_ExceptionEntry(struct armvm *armvm, uint32_t exceptionType)
         goto err;
     }
     ret = armv6m_ExceptionTaken(armvm, exceptionType);
+    if (ARMVM_RET_SUCCESS != ret) {
+        goto err;
+    }
+    ret = libarmvm_hooks_exception(armvm, ARMVM_HOOK_EXCEPTION_ENTRY, exceptionType);
 err:
     return ret;
 }
@@ -489,14 +582,281 @@ err:
 
 int armv6m_PushStack(struct armvm *armvm, uint32_t exceptionType)
 {
-    printf("%s(): Not Yet Implemented.\n", __func__);
+    assert(armvm);
+    assert(armvm->ci);
+    assert(armvm->ci->data);
+    assert(armvm->regs);
+    assert(armvm->regs->data);
+
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m *armv6m = ci->data;
+    const struct armvm_registers *regs = armvm->regs;
+
+    uint32_t control;
+    uint32_t psr;
+    if (regs->read_control(regs->data, &control) || regs->read_psr(regs->data, &psr)) {
+        fprintf(stderr, "ERROR: Could not read CONTROL or PSR register.\n");
+        goto err;
+    }
+
+    // the Thread mode may use the process stack, the Handler mode always uses the main stack
+    const int process = (control & ARMV6M_CONTROL_SPSEL) && MODE_THREAD == armv6m->CurrentMode;
+    uint32_t sp;
+    if (process ? regs->read_sp_process(regs->data, &sp) : regs->read_sp_main(regs->data, &sp)) {
+        fprintf(stderr, "ERROR: Could not read stack pointer.\n");
+        goto err;
+    }
+
+    // the frame is aligned to 8 bytes, bit 9 of the stacked xPSR records the alignment
+    const uint32_t frameptralign = (sp >> 2) & 0x1;
+    const uint32_t frameptr = (sp - 0x20) & ~((uint32_t)0x4);
+    if (process ? regs->write_sp_process(regs->data, &frameptr) : regs->write_sp_main(regs->data, &frameptr)) {
+        fprintf(stderr, "ERROR: Could not write stack pointer.\n");
+        goto err;
+    }
+
+    // R0-R3, R12, LR, return address, xPSR
+    uint32_t frame[8];
+    static const uint8_t stacked[] = { 0, 1, 2, 3, 12, ARMV6M_REG_LR, ARMV6M_REG_PC };
+    for (size_t i = 0; i < sizeof(stacked); ++i) {
+        if (regs->read_gpr(regs->data, stacked[i], &frame[i])) {
+            fprintf(stderr, "ERROR: Could not read gpr.\n");
+            goto err;
+        }
+    }
+    // the exception is taken between two instructions, so the PC holds the return address
+    frame[6] -= 4;
+    frame[7] = (psr & ~((uint32_t)0x1 << 9)) | (frameptralign << 9);
+
+    if (libarmvm_memory_write_words(armvm, frameptr, frame, 8)) {
+        fprintf(stderr, "ERROR: Could not write the exception frame to 0x%08x.\n", frameptr);
+        goto err;
+    }
+
+    uint32_t lr;
+    if (MODE_HANDLER == armv6m->CurrentMode) {
+        lr = 0xfffffff1;
+    } else if (!(control & ARMV6M_CONTROL_SPSEL)) {
+        lr = 0xfffffff9;
+    } else {
+        lr = 0xfffffffd;
+    }
+    if (regs->write_gpr(regs->data, ARMV6M_REG_LR, &lr)) {
+        fprintf(stderr, "ERROR: Could not write gpr.\n");
+        goto err;
+    }
+
+    return ARMVM_RET_SUCCESS;
+err:
     return ARMVM_RET_FAIL;
 }
 
 
 int armv6m_ExceptionTaken(struct armvm *armvm, uint32_t exceptionType)
 {
-    printf("%s(): Not Yet Implemented.\n", __func__);
+    assert(armvm);
+    assert(armvm->ci);
+    assert(armvm->ci->data);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m *armv6m = ci->data;
+    const struct armvm_registers *regs = armvm->regs;
+
+    if (exceptionType >= ARMV6M_EXCEPTIONS) {
+        fprintf(stderr, "ERROR: Invalid exception number %u.\n", exceptionType);
+        goto err;
+    }
+
+    // the ARMv6-M has no VTOR, the vector table is always at address 0
+    uint32_t vectortable = 0;
+    uint32_t handler;
+    if (armvm->mem->read_word(armvm->mem->data, vectortable + 4 * exceptionType, &handler)) {
+        fprintf(stderr, "ERROR: Could not read vector table.\n");
+        goto err;
+    }
+
+    if (armv6m_BranchTo(armvm, handler & 0xfffffffe)) {
+        goto err;
+    }
+    armv6m->CurrentMode = MODE_HANDLER;
+
+    uint32_t psr;
+    if (regs->read_psr(regs->data, &psr)) {
+        fprintf(stderr, "ERROR: Could not read PSR register.\n");
+        goto err;
+    }
+    psr = (psr & ~((uint32_t)0x3f | ((uint32_t)0x1 << 24))) | (exceptionType & 0x3f) | ((handler & 0x1) << 24);
+    if (regs->write_psr(regs->data, &psr)) {
+        fprintf(stderr, "ERROR: Could not write PSR register.\n");
+        goto err;
+    }
+
+    armv6m->ExceptionActive[exceptionType] = 1;
+    armv6m->EventRegister = 1;
+    libarmvm_nvic_activate(armvm, exceptionType);
+
+    // the Handler mode uses the main stack, CONTROL.nPRIV is unchanged
+    uint32_t control;
+    if (regs->read_control(regs->data, &control)) {
+        fprintf(stderr, "ERROR: Could not read CONTROL register.\n");
+        goto err;
+    }
+    control &= ~ARMV6M_CONTROL_SPSEL;
+    if (regs->write_control(regs->data, &control)) {
+        fprintf(stderr, "ERROR: Could not write CONTROL register.\n");
+        goto err;
+    }
+
+    ADD_CYCLES(armvm, ARMV6M_CYCLES_EXCEPTION - ARMV6M_CYCLES_PIPELINE_REFILL);
+
+    return ARMVM_RET_SUCCESS;
+err:
+    return ARMVM_RET_FAIL;
+}
+
+
+int armv6m_ExceptionReturn(struct armvm *armvm, uint32_t excReturn)
+{
+    int ret = ARMVM_RET_UNPREDICTABLE;
+
+    assert(armvm);
+    assert(armvm->ci);
+    assert(armvm->ci->data);
+
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m *armv6m = ci->data;
+    const struct armvm_registers *regs = armvm->regs;
+
+    uint32_t psr;
+    uint32_t control;
+    if (regs->read_psr(regs->data, &psr) || regs->read_control(regs->data, &control)) {
+        fprintf(stderr, "ERROR: Could not read PSR or CONTROL register.\n");
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    const uint32_t returning = psr & 0x3f;
+    size_t nested = 0;
+    for (size_t i = 0; i < ARMV6M_EXCEPTIONS; ++i) {
+        nested += armv6m->ExceptionActive[i];
+    }
+
+    if (0x0ffffff0 != (excReturn & 0x0ffffff0) || returning >= ARMV6M_EXCEPTIONS || !armv6m->ExceptionActive[returning]) {
+        fprintf(stderr, "ERROR: Invalid exception return 0x%08x from exception %u.\n", excReturn, returning);
+        goto err;
+    }
+
+    enum armv6m_execution_mode mode;
+    switch (excReturn & 0xf) {
+        case 0x1: // return to Handler mode
+            if (1 == nested) {
+                goto err_unpredictable;
+            }
+            mode = MODE_HANDLER;
+            control &= ~ARMV6M_CONTROL_SPSEL;
+            break;
+        case 0x9: // return to Thread mode with the main stack
+            if (1 != nested) {
+                goto err_unpredictable;
+            }
+            mode = MODE_THREAD;
+            control &= ~ARMV6M_CONTROL_SPSEL;
+            break;
+        case 0xd: // return to Thread mode with the process stack
+            if (1 != nested) {
+                goto err_unpredictable;
+            }
+            mode = MODE_THREAD;
+            control |= ARMV6M_CONTROL_SPSEL;
+            break;
+        default:
+            goto err_unpredictable;
+    }
+
+    armv6m->ExceptionActive[returning] = 0;
+    armv6m->CurrentMode = mode;
+    libarmvm_nvic_deactivate(armvm, returning);
+    if (regs->write_control(regs->data, &control)) {
+        fprintf(stderr, "ERROR: Could not write CONTROL register.\n");
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    uint32_t frameptr;
+    if ((control & ARMV6M_CONTROL_SPSEL) ? regs->read_sp_process(regs->data, &frameptr) : regs->read_sp_main(regs->data, &frameptr)) {
+        fprintf(stderr, "ERROR: Could not read stack pointer.\n");
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    ret = armv6m_PopStack(armvm, frameptr, excReturn);
+    if (ret) {
+        goto err;
+    }
+
+    if (regs->read_psr(regs->data, &psr)) {
+        fprintf(stderr, "ERROR: Could not read PSR register.\n");
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+    if ((MODE_HANDLER == mode) != (0 != (psr & 0x3f))) {
+        fprintf(stderr, "ERROR: The IPSR of the exception frame (%u) does not match the EXC_RETURN 0x%08x.\n", psr & 0x3f, excReturn);
+        ret = ARMVM_RET_UNPREDICTABLE;
+        goto err;
+    }
+
+    armv6m->EventRegister = 1;
+    ADD_CYCLES(armvm, ARMV6M_CYCLES_EXCEPTION - ARMV6M_CYCLES_PIPELINE_REFILL);
+
+    return libarmvm_hooks_exception(armvm, ARMVM_HOOK_EXCEPTION_EXIT, returning);
+
+err_unpredictable:
+    fprintf(stderr, "ERROR: EXC_RETURN 0x%08x does not match the %zu active exceptions.\n", excReturn, nested);
+err:
+    return ret;
+}
+
+
+int armv6m_PopStack(struct armvm *armvm, uint32_t frameptr, uint32_t excReturn)
+{
+    const struct armvm_registers *regs = armvm->regs;
+
+    uint32_t frame[8];
+    if (libarmvm_memory_read_words(armvm, frameptr, frame, 8)) {
+        fprintf(stderr, "ERROR: Could not read the exception frame from 0x%08x.\n", frameptr);
+        goto err;
+    }
+
+    static const uint8_t stacked[] = { 0, 1, 2, 3, 12, ARMV6M_REG_LR };
+    for (size_t i = 0; i < sizeof(stacked); ++i) {
+        if (regs->write_gpr(regs->data, stacked[i], &frame[i])) {
+            fprintf(stderr, "ERROR: Could not write gpr.\n");
+            goto err;
+        }
+    }
+
+    if (armv6m_BranchTo(armvm, frame[6] & 0xfffffffe)) {
+        goto err;
+    }
+
+    // bit 9 of the stacked xPSR restores the alignment of the stack pointer
+    const uint32_t sp = (frameptr + 0x20) | (((frame[7] >> 9) & 0x1) << 2);
+    if (0xd == (excReturn & 0xf) ? regs->write_sp_process(regs->data, &sp) : regs->write_sp_main(regs->data, &sp)) {
+        fprintf(stderr, "ERROR: Could not write stack pointer.\n");
+        goto err;
+    }
+
+    // APSR, IPSR and EPSR.T
+    const uint32_t psr = frame[7] & (0xf0000000 | ((uint32_t)0x1 << 24) | 0x3f);
+    if (regs->write_psr(regs->data, &psr)) {
+        fprintf(stderr, "ERROR: Could not write PSR register.\n");
+        goto err;
+    }
+
+    return ARMVM_RET_SUCCESS;
+err:
     return ARMVM_RET_FAIL;
 }
 
@@ -611,6 +971,7 @@ int armv6m_BranchTo(struct armvm *armvm, uint32_t address)
         fprintf(stderr, "ERROR: Could not write GPR register.\n");
         goto err;
     }
+    ADD_CYCLES(armvm, ARMV6M_CYCLES_PIPELINE_REFILL);
 
     return ARMVM_RET_SUCCESS;
 err:
@@ -775,6 +1136,7 @@ int armv6m_ins_PUSH_T1(struct armvm *armvm, const struct armv6m_instruction *ins
 
     uint8_t setBit = armv6m_BitCount(registers);
     uint32_t address = sp - 4 * setBit;
+    ADD_CYCLES(armvm, setBit);
 
     if (armvm->regs->write_gpr(armvm->regs->data, ARMV6M_REG_SP, &address)) {
         fprintf(stderr, "ERROR: Could not write SP register.\n");
@@ -1295,7 +1657,7 @@ int armv6m_ins_MOV_register_T1(struct armvm *armvm, const struct armv6m_instruct
     if (ARMV6M_REG_PC == Rd) {
         armv6m_ALUWritePC(armvm, m);
     } else {
-        if (armvm->regs->read_gpr(armvm->regs->data, Rd, &m)) {
+        if (armvm->regs->write_gpr(armvm->regs->data, Rd, &m)) {
             fprintf(stderr, "ERROR: Could not write gpr.\n");
             goto err;
         }
@@ -1709,7 +2071,7 @@ int armv6m_ins_MOV_register_T2(struct armvm *armvm, const struct armv6m_instruct
     if (ARMV6M_REG_PC == Rd) {
         armv6m_ALUWritePC(armvm, m);
     } else {
-        if (armvm->regs->read_gpr(armvm->regs->data, Rd, &m)) {
+        if (armvm->regs->write_gpr(armvm->regs->data, Rd, &m)) {
             fprintf(stderr, "ERROR: Could not write gpr.\n");
             goto err;
         }
@@ -1722,10 +2084,14 @@ int armv6m_ins_MOV_register_T2(struct armvm *armvm, const struct armv6m_instruct
 
         if (m & (0x1 << 31)) {
             SET_APSR_N(apsr);
+        } else {
+            UNSET_APSR_N(apsr);
         }
 
         if (0 == m) {
             SET_APSR_Z(apsr);
+        } else {
+            UNSET_APSR_Z(apsr);
         }
 
 
@@ -1972,7 +2338,7 @@ int armv6m_ins_ADD_register_T1(struct armvm *armvm, const struct armv6m_instruct
     if (ARMV6M_REG_PC == Rd) {
         armv6m_ALUWritePC(armvm, res);
     } else {
-        if (armvm->regs->read_gpr(armvm->regs->data, Rd, &res)) {
+        if (armvm->regs->write_gpr(armvm->regs->data, Rd, &res)) {
             fprintf(stderr, "ERROR: Could not write gpr.\n");
             goto err;
         }
@@ -2156,7 +2522,12 @@ int armv6m_ins_MUL_T1(struct armvm *armvm, const struct armv6m_instruction *inst
         goto err;
     }
 
-    int32_t result = dm * n;
+    uint32_t result = (uint32_t)dm * (uint32_t)n;
+
+    if (armvm->regs->write_gpr(armvm->regs->data, Rdm, &result)) {
+        fprintf(stderr, "ERROR: Could not write gpr.\n");
+        goto err;
+    }
 
     uint32_t apsr = 0;
     if (armv6m_get_APSR(armvm, &apsr)) {
@@ -2166,10 +2537,14 @@ int armv6m_ins_MUL_T1(struct armvm *armvm, const struct armv6m_instruction *inst
 
     if (result & (0x1 << 31)) {
         SET_APSR_N(apsr);
+    } else {
+        UNSET_APSR_N(apsr);
     }
 
     if (0 == result) {
         SET_APSR_Z(apsr);
+    } else {
+        UNSET_APSR_Z(apsr);
     }
 
     if (armv6m_set_APSR(armvm, apsr)) {
@@ -2218,7 +2593,7 @@ int armv6m_ins_SUB_register_T1(struct armvm *armvm, const struct armv6m_instruct
     if (ARMV6M_REG_PC == Rd) {
         armv6m_ALUWritePC(armvm, res);
     } else {
-        if (armvm->regs->read_gpr(armvm->regs->data, Rd, &res)) {
+        if (armvm->regs->write_gpr(armvm->regs->data, Rd, &res)) {
             fprintf(stderr, "ERROR: Could not write gpr.\n");
             goto err;
         }
@@ -2295,8 +2670,8 @@ int armv6m_ins_POP_T1(struct armvm *armvm, const struct armv6m_instruction *inst
                 goto err;
             }
 
-            if (armvm->regs->read_gpr(armvm->regs->data, i, &value)) {
-                fprintf(stderr, "ERROR: Could not read gpr register.\n");
+            if (armvm->regs->write_gpr(armvm->regs->data, i, &value)) {
+                fprintf(stderr, "ERROR: Could not write gpr register.\n");
                 ret = ARMVM_RET_FAIL;
                 goto err;
             }
@@ -2304,6 +2679,17 @@ int armv6m_ins_POP_T1(struct armvm *armvm, const struct armv6m_instruction *inst
         }
     }
 
+    // the SP is written before the PC, since an exception return unstacks from the new SP
+    uint8_t setBit = armv6m_BitCount(registers);
+    sp = sp + 4 * setBit;
+    ADD_CYCLES(armvm, setBit);
+
+    if (armvm->regs->write_gpr(armvm->regs->data, ARMV6M_REG_SP, &sp)) {
+        fprintf(stderr, "ERROR: Could not write SP register.\n");
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
     if ((0x1 << 15) & registers) {
         if (!first) {
             PRINT_ASM(", ");
@@ -2330,16 +2716,6 @@ int armv6m_ins_POP_T1(struct armvm *armvm, const struct armv6m_instruction *inst
     }
     PRINT_ASM("\n");
 
-
-    uint8_t setBit = armv6m_BitCount(registers);
-    sp = sp + 4 * setBit;
-
-    if (armvm->regs->write_gpr(armvm->regs->data, ARMV6M_REG_SP, &sp)) {
-        fprintf(stderr, "ERROR: Could not write SP register.\n");
-        ret = ARMVM_RET_FAIL;
-        goto err;
-    }
-
 err:
     return ret;
 }
@@ -2665,6 +3041,149 @@ err:
 }
 
 
+int armv6m_ins_WFE_T1(struct armvm *armvm, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m *armv6m = ci->data;
+
+    PRINT_PC(armvm);
+    PRINT_ASM("WFE\n");
+
+    // the core only sleeps if no event was signaled since the last WFE
+    if (armv6m->EventRegister) {
+        armv6m->EventRegister = 0;
+    } else {
+        ci->pending |= LIBARMVM_CI_PENDING_SLEEP;
+    }
+
+    if (armv6m_update_pc(armvm, instruction)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+err:
+    return ret;
+}
+
+
+int armv6m_ins_WFI_T1(struct armvm *armvm, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    PRINT_PC(armvm);
+    PRINT_ASM("WFI\n");
+
+    // the core does not sleep, if an interrupt is pending already
+    ci->pending |= LIBARMVM_CI_PENDING_SLEEP;
+    libarmvm_nvic_update(armvm);
+
+    if (armv6m_update_pc(armvm, instruction)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+err:
+    return ret;
+}
+
+
+int armv6m_ins_SEV_T1(struct armvm *armvm, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m *armv6m = ci->data;
+
+    PRINT_PC(armvm);
+    PRINT_ASM("SEV\n");
+
+    // single core: the event is only visible to the own WFE
+    armv6m->EventRegister = 1;
+
+    if (armv6m_update_pc(armvm, instruction)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+err:
+    return ret;
+}
+
+
+int armv6m_ins_CPS_T1(struct armvm *armvm, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m *armv6m = ci->data;
+    uint8_t im = (instruction->i._16bit >> 4) & 0x1;
+
+    PRINT_PC(armvm);
+    PRINT_ASM("CPS%s i\n", im ? "ID" : "IE");
+
+    if (armv6m_update_pc(armvm, instruction)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    // a pending interrupt is taken after CPSIE
+    armv6m->PRIMASK = im;
+    libarmvm_nvic_update(armvm);
+
+err:
+    return ret;
+}
+
+
+int armv6m_ins_SVC_T1(struct armvm *armvm, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    PRINT_PC(armvm);
+    PRINT_ASM("SVC #%u\n", instruction->i._16bit & 0xff);
+
+    if (armv6m_update_pc(armvm, instruction)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    // the exception is taken after the instruction, the return address is the next instruction
+    if (libarmvm_nvic_set_pending_synchronous(armvm, ARMV6M_EXCEPTION_SVCALL)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+err:
+    return ret;
+}
+
+
+int armv6m_ins_BKPT_T1(struct armvm *armvm, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    const uint8_t imm8 = instruction->i._16bit & 0xff;
+
+    PRINT_PC(armvm);
+    PRINT_ASM("BKPT #0x%x\n", imm8);
+
+    // there is no debugger, only the semihosting is supported
+    if (LIBARMVM_SEMIHOSTING_BKPT != imm8) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    if (armv6m_update_pc(armvm, instruction)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    ret = libarmvm_semihosting_call(armvm);
+
+err:
+    return ret;
+}
+
+
 /*
 {
     int ret = ARMVM_RET_FAIL;
@@ -2,6 +2,7 @@
 #define __ARMV6_M_H__
 
 #include <armvm.h>
+#include <stddef.h>
 
 /*
  * Register definitions
@@ -10,6 +11,34 @@
 #define ARMV6M_REG_LR (0b1110)
 #define ARMV6M_REG_PC (0b1111)
 
+#define ARMV6M_CONTROL_SPSEL (0x1 << 1)
+
+/*
+ * Cycle counts of the Cortex-M0 (see Cortex-M0 Technical Reference Manual, Table 3-1).
+ * Every instruction is charged with its base cost. Instructions which write the PC are
+ * charged additionally with ARMV6M_CYCLES_PIPELINE_REFILL (e.g. B taken: 1 + 2, BL: 2 + 2,
+ * POP with PC: 1 + N + 2). PUSH and POP are charged additionally with one cycle per register.
+ */
+#define ARMV6M_CYCLES_DEFAULT          (1) /**< Data processing, compare, extend, MUL (single cycle multiplier) and not taken branches. */
+#define ARMV6M_CYCLES_LOAD_STORE       (2) /**< LDR, LDRB, LDRH, LDRSH, STR, STRB and STRH */
+#define ARMV6M_CYCLES_MULTIPLE         (1) /**< PUSH and POP without the transferred registers */
+#define ARMV6M_CYCLES_BL               (2) /**< BL without the pipeline refill */
+#define ARMV6M_CYCLES_PIPELINE_REFILL  (2) /**< Additional cycles for every write to the PC */
+#define ARMV6M_CYCLES_WAIT             (2) /**< WFI and WFE until the core sleeps */
+#define ARMV6M_CYCLES_EXCEPTION        (16) /**< Latency of the exception entry (stacking, vector fetch) and of the exception return (unstacking) including the pipeline refill */
+
+/*
+ * Exception numbers. The external interrupt n has the number ARMV6M_EXCEPTION_IRQ0 + n.
+ */
+#define ARMV6M_EXCEPTION_RESET     (1)
+#define ARMV6M_EXCEPTION_NMI       (2)
+#define ARMV6M_EXCEPTION_HARDFAULT (3)
+#define ARMV6M_EXCEPTION_SVCALL    (11)
+#define ARMV6M_EXCEPTION_PENDSV    (14)
+#define ARMV6M_EXCEPTION_SYSTICK   (15)
+#define ARMV6M_EXCEPTION_IRQ0      (16)
+#define ARMV6M_EXCEPTIONS          (48) /**< Amount of exception numbers (16 system exceptions and 32 interrupts) */
+
 /**
  * @brief Execution modes of the ARMv6-M Architecture.
  */
@@ -46,6 +75,7 @@ enum armv6m_condition_codes {
  * @brief Representation of one instruction.
  */
 struct armv6m_instruction {
+    uint32_t addr; /**< Address from which the instruction was loaded. */
     uint8_t is32Bit;
     union {
         uint32_t _32bit;
@@ -59,6 +89,9 @@ struct armv6m_instruction {
  */
 struct armv6m {
     enum armv6m_execution_mode CurrentMode;  /**< Execution mode of the virtual machine */
+    uint8_t EventRegister;  /**< Is set by SEV and cleared by WFE. */
+    uint8_t PRIMASK;  /**< If set, only NMI and HardFault preempt the execution. Is changed by CPS. */
+    uint8_t ExceptionActive[ARMV6M_EXCEPTIONS];  /**< Set for every exception which is active (taken and not returned). */
 };
 
 
@@ -110,6 +143,18 @@ int armv6m_load_next_instruction(struct armvm *armvm, struct armv6m_instruction
 int armv6m_execute_instruction(struct armvm *armvm, const struct armv6m_instruction *instruction);
 
 
+/**
+ * @brief Checks if an instruction only changes the core registers.
+ * Such an instruction does not write to the memory, does not raise an exception, does not
+ * change the special registers (e.g. PRIMASK) and is no hint (e.g. WFI). Branches, BL and
+ * loads are accepted.
+ *
+ * @param instruction Pointer to the instruction.
+ * @return 1 if the instruction only changes the core registers, 0 otherwise.
+ */
+int armv6m_is_register_only(const struct armv6m_instruction *instruction);
+
+
 /**
  * @brief Calculates and updates the new Program Counter based on the instruction length.
  *
@@ -147,7 +192,8 @@ int armv6m_LoadWritePC(struct armvm *armvm, uint32_t address);
 
 
 /**
- * @brief Interworking branch.
+ * @brief Takes an exception: stacks the context and branches to the handler.
+ * Has to be called between two instructions.
  * See ExceptionEntry() in ARMv6-M Architecture Reference Manual
  *
  * @return ARMVM_RET_SUCCESS on success.
@@ -156,7 +202,7 @@ int armv6m_ExceptionEntry(struct armvm *armvm, uint32_t exceptionType);
 
 
 /**
- * @brief Interworking branch.
+ * @brief Stacks R0-R3, R12, LR, the return address and the xPSR and sets LR to EXC_RETURN.
  * See PushStack() in ARMv6-M Architecture Reference Manual
  *
  * @return ARMVM_RET_SUCCESS on success.
@@ -165,7 +211,7 @@ int armv6m_PushStack(struct armvm *armvm, uint32_t exceptionType);
 
 
 /**
- * @brief Interworking branch.
+ * @brief Branches to the handler of the exception and enters the Handler mode.
  * See ExceptionTaken() in ARMv6-M Architecture Reference Manual
  *
  * @return ARMVM_RET_SUCCESS on success.
@@ -173,6 +219,28 @@ int armv6m_PushStack(struct armvm *armvm, uint32_t exceptionType);
 int armv6m_ExceptionTaken(struct armvm *armvm, uint32_t exceptionType);
 
 
+/**
+ * @brief Returns from the active exception. Is called if an EXC_RETURN value is written to the
+ * PC in Handler mode (BX and POP). Has to be called after all other effects of the instruction.
+ * See ExceptionReturn() in ARMv6-M Architecture Reference Manual
+ *
+ * @param excReturn The EXC_RETURN value.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int armv6m_ExceptionReturn(struct armvm *armvm, uint32_t excReturn);
+
+
+/**
+ * @brief Restores R0-R3, R12, LR, the PC and the xPSR from the exception frame.
+ * See PopStack() in ARMv6-M Architecture Reference Manual
+ *
+ * @param frameptr Address of the exception frame.
+ * @param excReturn The EXC_RETURN value.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int armv6m_PopStack(struct armvm *armvm, uint32_t frameptr, uint32_t excReturn);
+
+
 /**
  * @brief Sets the Application Program Status register.
  *
@@ -280,6 +348,19 @@ const char *armv6m_reg_idx_to_string(uint8_t reg_idx);
  */
 const char *armv6m_cond_to_string(enum armv6m_condition_codes cond);
 
+
+/**
+ * @brief Writes the disassembly of an instruction into buf.
+ * The disassembler covers the whole Armv6-M instruction set and does not depend on the
+ * state of a virtual machine. instruction->addr is used to resolve PC relative addresses.
+ *
+ * @param buf Destination of the zero terminated disassembly.
+ * @param size Size of buf in bytes.
+ * @return ARMVM_RET_SUCCESS on success.
+ *         ARMVM_RET_FAIL if the instruction is undefined. buf contains the raw encoding in this case.
+ */
+int armv6m_disassemble(const struct armv6m_instruction *instruction, char *buf, size_t size);
+
 // 16 Bit instructions
 int armv6m_ins_PUSH_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
 int armv6m_ins_POP_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
@@ -319,6 +400,12 @@ int armv6m_ins_UXTB_T1(struct armvm *armvm, const struct armv6m_instruction *ins
 int armv6m_ins_UXTH_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
 int armv6m_ins_ASR_immediate_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
 int armv6m_ins_EOR_register_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
+int armv6m_ins_WFE_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
+int armv6m_ins_WFI_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
+int armv6m_ins_SEV_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
+int armv6m_ins_CPS_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
+int armv6m_ins_SVC_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
+int armv6m_ins_BKPT_T1(struct armvm *armvm, const struct armv6m_instruction *instruction);
 
 
 // 32 Bit instructions
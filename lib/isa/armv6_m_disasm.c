@@ -0,0 +1,319 @@
+#include <isa/armv6_m.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+/**
+ * @brief Output buffer of the disassembler.
+ */
+struct _disasm_buffer {
+    char *buf;
+    size_t size;
+    size_t len;
+};
+
+
+void _disasm_print(struct _disasm_buffer *out, const char *fmt, ...)
+{
+    va_list args;
+
+    if (out->len >= out->size) {
+        return;
+    }
+
+    va_start(args, fmt);
+    int len = vsnprintf(out->buf + out->len, out->size - out->len, fmt, args);
+    va_end(args);
+
+    if (0 < len) {
+        out->len += len;
+    }
+}
+
+
+#define REG(idx) armv6m_reg_idx_to_string(idx)
+
+
+void _disasm_register_list(struct _disasm_buffer *out, uint16_t registers)
+{
+    uint8_t first = 1;
+
+    _disasm_print(out, "{");
+    for (size_t i = 0; i < 16; ++i) {
+        if ((0x1 << i) & registers) {
+            _disasm_print(out, "%s%s", first ? "" : ", ", REG(i));
+            first = 0;
+        }
+    }
+    _disasm_print(out, "}");
+}
+
+
+const char *_disasm_sysm_to_string(uint8_t sysm)
+{
+    switch (sysm) {
+        case 0:  return "APSR";
+        case 1:  return "IAPSR";
+        case 2:  return "EAPSR";
+        case 3:  return "XPSR";
+        case 5:  return "IPSR";
+        case 6:  return "EPSR";
+        case 7:  return "IEPSR";
+        case 8:  return "MSP";
+        case 9:  return "PSP";
+        case 16: return "PRIMASK";
+        case 20: return "CONTROL";
+        default: return "<unknown special register>";
+    }
+}
+
+
+int _disasm_32bit(struct _disasm_buffer *out, const struct armv6m_instruction *instruction)
+{
+    uint16_t hw1 = instruction->i._32bit >> 16;
+    uint16_t hw2 = instruction->i._32bit & 0xffff;
+
+    if ((hw1 >> 11) == 0b11110 && (hw2 >> 14) == 0b11 && ((hw2 >> 12) & 0b1)) {
+        uint32_t S = (hw1 >> 10) & 0b1;
+        uint32_t J1 = (hw2 >> 13) & 0b1;
+        uint32_t J2 = (hw2 >> 11) & 0b1;
+        uint32_t I1 = ~(J1 ^ S) & 1;
+        uint32_t I2 = ~(J2 ^ S) & 1;
+        uint32_t imm32 = (S << 24) | (I1 << 23) | (I2 << 22) | ((hw1 & 0x3ff) << 12) | ((hw2 & 0x7ff) << 1);
+        if (S) {
+            imm32 |= 0b1111111 << 25;
+        }
+        _disasm_print(out, "BL 0x%x", instruction->addr + 4 + imm32);
+
+    } else if ((hw1 & 0xfff0) == 0xf380 && (hw2 & 0xff00) == 0x8800) {
+        _disasm_print(out, "MSR %s, %s", _disasm_sysm_to_string(hw2 & 0xff), REG(hw1 & 0xf));
+
+    } else if (hw1 == 0xf3ef && (hw2 & 0xf000) == 0x8000) {
+        _disasm_print(out, "MRS %s, %s", REG((hw2 >> 8) & 0xf), _disasm_sysm_to_string(hw2 & 0xff));
+
+    } else if (hw1 == 0xf3bf && (hw2 & 0xfff0) == 0x8f40) {
+        _disasm_print(out, "DSB #%u", hw2 & 0xf);
+
+    } else if (hw1 == 0xf3bf && (hw2 & 0xfff0) == 0x8f50) {
+        _disasm_print(out, "DMB #%u", hw2 & 0xf);
+
+    } else if (hw1 == 0xf3bf && (hw2 & 0xfff0) == 0x8f60) {
+        _disasm_print(out, "ISB #%u", hw2 & 0xf);
+
+    } else if ((hw1 & 0xfff0) == 0xf7f0 && (hw2 & 0xf000) == 0xa000) {
+        _disasm_print(out, "UDF.W #%u", ((hw1 & 0xf) << 12) | (hw2 & 0xfff));
+
+    } else {
+        _disasm_print(out, ".word 0x%08x", instruction->i._32bit);
+        return ARMVM_RET_FAIL;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _disasm_16bit(struct _disasm_buffer *out, const struct armv6m_instruction *instruction)
+{
+    static const char *data_processing[] = {
+        "ANDS", "EORS", "LSLS", "LSRS", "ASRS", "ADCS", "SBCS", "RORS",
+        "TST",  "RSBS", "CMP",  "CMN",  "ORRS", "MULS", "BICS", "MVNS"
+    };
+    static const char *load_store_register[] = {
+        "STR", "STRH", "STRB", "LDRSB", "LDR", "LDRH", "LDRB", "LDRSH"
+    };
+    static const char *extend[] = { "SXTH", "SXTB", "UXTH", "UXTB" };
+    static const char *reverse[] = { "REV", "REV16", "<undefined>", "REVSH" };
+    static const char *hints[] = { "NOP", "YIELD", "WFE", "WFI", "SEV" };
+
+    uint16_t ins = instruction->i._16bit;
+    uint8_t r0 = ins & 0b111;
+    uint8_t r3 = (ins >> 3) & 0b111;
+    uint8_t r6 = (ins >> 6) & 0b111;
+    uint8_t r8 = (ins >> 8) & 0b111;
+    uint8_t imm5 = (ins >> 6) & 0b11111;
+    uint8_t imm8 = ins & 0xff;
+
+    if (ins >> 11 == 0b00000) {
+        if (imm5) {
+            _disasm_print(out, "LSLS %s, %s, #%u", REG(r0), REG(r3), imm5);
+        } else {
+            _disasm_print(out, "MOVS %s, %s", REG(r0), REG(r3));
+        }
+
+    } else if (ins >> 11 == 0b00001) {
+        _disasm_print(out, "LSRS %s, %s, #%u", REG(r0), REG(r3), imm5 ? imm5 : 32);
+
+    } else if (ins >> 11 == 0b00010) {
+        _disasm_print(out, "ASRS %s, %s, #%u", REG(r0), REG(r3), imm5 ? imm5 : 32);
+
+    } else if (ins >> 9 == 0b0001100) {
+        _disasm_print(out, "ADDS %s, %s, %s", REG(r0), REG(r3), REG(r6));
+
+    } else if (ins >> 9 == 0b0001101) {
+        _disasm_print(out, "SUBS %s, %s, %s", REG(r0), REG(r3), REG(r6));
+
+    } else if (ins >> 9 == 0b0001110) {
+        _disasm_print(out, "ADDS %s, %s, #%u", REG(r0), REG(r3), r6);
+
+    } else if (ins >> 9 == 0b0001111) {
+        _disasm_print(out, "SUBS %s, %s, #%u", REG(r0), REG(r3), r6);
+
+    } else if (ins >> 11 == 0b00100) {
+        _disasm_print(out, "MOVS %s, #%u", REG(r8), imm8);
+
+    } else if (ins >> 11 == 0b00101) {
+        _disasm_print(out, "CMP %s, #%u", REG(r8), imm8);
+
+    } else if (ins >> 11 == 0b00110) {
+        _disasm_print(out, "ADDS %s, #%u", REG(r8), imm8);
+
+    } else if (ins >> 11 == 0b00111) {
+        _disasm_print(out, "SUBS %s, #%u", REG(r8), imm8);
+
+    } else if (ins >> 10 == 0b010000) {
+        uint8_t opcode = (ins >> 6) & 0xf;
+        if (0b1001 == opcode) {
+            _disasm_print(out, "RSBS %s, %s, #0", REG(r0), REG(r3));
+        } else if (0b1101 == opcode) {
+            _disasm_print(out, "MULS %s, %s, %s", REG(r0), REG(r3), REG(r0));
+        } else {
+            _disasm_print(out, "%s %s, %s", data_processing[opcode], REG(r0), REG(r3));
+        }
+
+    } else if (ins >> 8 == 0b01000100) {
+        uint8_t Rdn = r0 | ((ins >> 4) & 0b1000);
+        _disasm_print(out, "ADD %s, %s", REG(Rdn), REG((ins >> 3) & 0xf));
+
+    } else if (ins >> 8 == 0b01000101) {
+        uint8_t Rn = r0 | ((ins >> 4) & 0b1000);
+        _disasm_print(out, "CMP %s, %s", REG(Rn), REG((ins >> 3) & 0xf));
+
+    } else if (ins >> 8 == 0b01000110) {
+        uint8_t Rd = r0 | ((ins >> 4) & 0b1000);
+        uint8_t Rm = (ins >> 3) & 0xf;
+        if (8 == Rd && 8 == Rm) {
+            _disasm_print(out, "NOP               ; ");
+        }
+        _disasm_print(out, "MOV %s, %s", REG(Rd), REG(Rm));
+
+    } else if (ins >> 7 == 0b010001110) {
+        _disasm_print(out, "BX %s", REG((ins >> 3) & 0xf));
+
+    } else if (ins >> 7 == 0b010001111) {
+        _disasm_print(out, "BLX %s", REG((ins >> 3) & 0xf));
+
+    } else if (ins >> 11 == 0b01001) {
+        uint32_t address = armv6m_Align(instruction->addr + 4, 4) + (imm8 << 2);
+        _disasm_print(out, "LDR %s, [PC, #%u] ; load from 0x%x", REG(r8), imm8 << 2, address);
+
+    } else if (ins >> 12 == 0b0101) {
+        _disasm_print(out, "%s %s, [%s, %s]", load_store_register[(ins >> 9) & 0b111], REG(r0), REG(r3), REG(r6));
+
+    } else if (ins >> 11 == 0b01100) {
+        _disasm_print(out, "STR %s, [%s, #%u]", REG(r0), REG(r3), imm5 << 2);
+
+    } else if (ins >> 11 == 0b01101) {
+        _disasm_print(out, "LDR %s, [%s, #%u]", REG(r0), REG(r3), imm5 << 2);
+
+    } else if (ins >> 11 == 0b01110) {
+        _disasm_print(out, "STRB %s, [%s, #%u]", REG(r0), REG(r3), imm5);
+
+    } else if (ins >> 11 == 0b01111) {
+        _disasm_print(out, "LDRB %s, [%s, #%u]", REG(r0), REG(r3), imm5);
+
+    } else if (ins >> 11 == 0b10000) {
+        _disasm_print(out, "STRH %s, [%s, #%u]", REG(r0), REG(r3), imm5 << 1);
+
+    } else if (ins >> 11 == 0b10001) {
+        _disasm_print(out, "LDRH %s, [%s, #%u]", REG(r0), REG(r3), imm5 << 1);
+
+    } else if (ins >> 11 == 0b10010) {
+        _disasm_print(out, "STR %s, [SP, #%u]", REG(r8), imm8 << 2);
+
+    } else if (ins >> 11 == 0b10011) {
+        _disasm_print(out, "LDR %s, [SP, #%u]", REG(r8), imm8 << 2);
+
+    } else if (ins >> 11 == 0b10100) {
+        _disasm_print(out, "ADR %s, 0x%x", REG(r8), armv6m_Align(instruction->addr + 4, 4) + (imm8 << 2));
+
+    } else if (ins >> 11 == 0b10101) {
+        _disasm_print(out, "ADD %s, SP, #%u", REG(r8), imm8 << 2);
+
+    } else if (ins >> 7 == 0b101100000) {
+        _disasm_print(out, "ADD SP, #%u", (ins & 0x7f) << 2);
+
+    } else if (ins >> 7 == 0b101100001) {
+        _disasm_print(out, "SUB SP, #%u", (ins & 0x7f) << 2);
+
+    } else if (ins >> 8 == 0b10110010) {
+        _disasm_print(out, "%s %s, %s", extend[(ins >> 6) & 0b11], REG(r0), REG(r3));
+
+    } else if (ins >> 9 == 0b1011010) {
+        _disasm_print(out, "PUSH ");
+        _disasm_register_list(out, imm8 | ((ins & 0x100) << 6));
+
+    } else if ((ins & 0xffef) == 0xb662) {
+        _disasm_print(out, "CPS%s i", (ins & 0x10) ? "ID" : "IE");
+
+    } else if (ins >> 8 == 0b10111010 && ((ins >> 6) & 0b11) != 0b10) {
+        _disasm_print(out, "%s %s, %s", reverse[(ins >> 6) & 0b11], REG(r0), REG(r3));
+
+    } else if (ins >> 9 == 0b1011110) {
+        _disasm_print(out, "POP ");
+        _disasm_register_list(out, imm8 | ((ins & 0x100) << 7));
+
+    } else if (ins >> 8 == 0b10111110) {
+        _disasm_print(out, "BKPT #0x%x", imm8);
+
+    } else if (ins >> 8 == 0b10111111 && !(ins & 0xf) && (ins >> 4 & 0xf) <= 4) {
+        _disasm_print(out, "%s", hints[(ins >> 4) & 0xf]);
+
+    } else if (ins >> 11 == 0b11000) {
+        _disasm_print(out, "STM %s!, ", REG(r8));
+        _disasm_register_list(out, imm8);
+
+    } else if (ins >> 11 == 0b11001) {
+        _disasm_print(out, "LDM %s%s, ", REG(r8), (imm8 & (0x1 << r8)) ? "" : "!");
+        _disasm_register_list(out, imm8);
+
+    } else if (ins >> 8 == 0b11011110) {
+        _disasm_print(out, "UDF #%u", imm8);
+
+    } else if (ins >> 8 == 0b11011111) {
+        _disasm_print(out, "SVC #%u", imm8);
+
+    } else if (ins >> 12 == 0b1101) {
+        int32_t imm32 = ((int8_t)imm8) << 1;
+        _disasm_print(out, "B%s 0x%x", armv6m_cond_to_string((ins >> 8) & 0xf), instruction->addr + 4 + imm32);
+
+    } else if (ins >> 11 == 0b11100) {
+        uint32_t imm32 = (ins & 0x7ff) << 1;
+        if (imm32 & (1 << 11)) {
+            imm32 |= 0xfffff000;
+        }
+        _disasm_print(out, "B 0x%x", instruction->addr + 4 + imm32);
+
+    } else {
+        _disasm_print(out, ".hword 0x%04x", ins);
+        return ARMVM_RET_FAIL;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+#undef REG
+
+
+int armv6m_disassemble(const struct armv6m_instruction *instruction, char *buf, size_t size)
+{
+    struct _disasm_buffer out = { buf, size, 0 };
+
+    if (!size) {
+        return ARMVM_RET_INVALID_PARAM;
+    }
+    buf[0] = 0;
+
+    if (instruction->is32Bit) {
+        return _disasm_32bit(&out, instruction);
+    }
+    return _disasm_16bit(&out, instruction);
+}
@@ -1,5 +1,6 @@
 #include <string.h>
 #include <stdio.h>
+#include <inttypes.h>
 #include <armvm.h>
 #include <lib_version.h>
 #include <stdlib.h>
@@ -8,6 +9,14 @@
 #include <libarmvm_registers.h>
 #include <libarmvm_peripherals.h>
 #include <libarmvm_ci.h>
+#include <libarmvm_lockstep.h>
+#include <libarmvm_symbols.h>
+#include <libarmvm_heatmap.h>
+
+/**
+ * Amount of steps per call to run(), if the vm runs indefinitely.
+ */
+#define LIBARMVM_RUN_CHUNK (1 << 20)
 
 const char *armvm_version()
 {
@@ -21,6 +30,7 @@ int armvm_opts_init(struct armvm_opts *opts)
     opts->isa = ARMV6_M;
     opts->program_address = 0x08000000;
     opts->steps = 0;
+    opts->core_clock = 8000000;
     
     return ARMVM_RET_SUCCESS;
 }
@@ -38,6 +48,93 @@ int armvm_opts_cleanup(struct armvm_opts *opts)
         opts->device_id = NULL;
     }
 
+    if (opts->symbol_file) {
+        free(opts->symbol_file);
+        opts->symbol_file = NULL;
+    }
+
+    if (opts->profile_file) {
+        free(opts->profile_file);
+        opts->profile_file = NULL;
+    }
+
+    if (opts->trace_file) {
+        free(opts->trace_file);
+        opts->trace_file = NULL;
+    }
+
+    if (opts->callgraph_file) {
+        free(opts->callgraph_file);
+        opts->callgraph_file = NULL;
+    }
+
+    if (opts->folded_file) {
+        free(opts->folded_file);
+        opts->folded_file = NULL;
+    }
+
+    if (opts->coverage_file) {
+        free(opts->coverage_file);
+        opts->coverage_file = NULL;
+    }
+
+    if (opts->heatmap_file) {
+        free(opts->heatmap_file);
+        opts->heatmap_file = NULL;
+    }
+
+    if (opts->stack_file) {
+        free(opts->stack_file);
+        opts->stack_file = NULL;
+    }
+
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        free(opts->usart_output[i]);
+        opts->usart_output[i] = NULL;
+        free(opts->usart_input[i]);
+        opts->usart_input[i] = NULL;
+    }
+
+    if (opts->gpio_vcd_file) {
+        free(opts->gpio_vcd_file);
+        opts->gpio_vcd_file = NULL;
+    }
+
+    if (opts->gpio_stimulus_file) {
+        free(opts->gpio_stimulus_file);
+        opts->gpio_stimulus_file = NULL;
+    }
+
+    for (size_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        free(opts->adc_input[i]);
+        opts->adc_input[i] = NULL;
+    }
+
+    if (opts->hooks) {
+        free(opts->hooks);
+        opts->hooks = NULL;
+        opts->hooks_size = 0;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int armvm_opts_add_hook(struct armvm_opts *opts, const struct armvm_hook *hook)
+{
+    if (!opts || !hook || hook->type >= ARMVM_HOOK_TYPES || !hook->callback) {
+        return ARMVM_RET_INVALID_PARAM;
+    }
+
+    struct armvm_hook *hooks = realloc(opts->hooks, (opts->hooks_size + 1) * sizeof(*hooks));
+    if (!hooks) {
+        return ARMVM_RET_NO_MEM;
+    }
+
+    hooks[opts->hooks_size] = *hook;
+    opts->hooks = hooks;
+    opts->hooks_size++;
+
     return ARMVM_RET_SUCCESS;
 }
 
@@ -67,70 +164,313 @@ int armvm_start(struct armvm *armvm, const struct armvm_opts *opts)
         goto err_opts;
     }
 
+    ret = _libarmvm_init(armvm);
+    if (ret) {
+        goto err_opts;
+    }
+
+    if (armvm->opts.lockstep) {
+        ret = libarmvm_lockstep_run(armvm);
+    } else {
+        ret = _libarmvm_run(armvm);
+    }
+
+    libarmvm_hooks_stop(armvm, ret);
+
+    // the program stopped the vm on its own
+    if (ARMVM_RET_EXIT == ret) {
+        ret = ARMVM_RET_SUCCESS;
+    }
+
+    if (_libarmvm_report(armvm)) {
+        ret = ARMVM_RET_FAIL;
+    }
+
+    if (_libarmvm_cleanup(armvm)) {
+        ret = ARMVM_RET_FAIL;
+    }
+
+err_opts:
+    if(armvm_opts_cleanup(&armvm->opts)) {
+        ret = ARMVM_RET_FAIL;
+    }
+err:
+    return ret;
+}
+
+
+int _libarmvm_init(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
     if (libarmvm_memory_init(armvm)) {
         ret = ARMVM_RET_FAIL;
-        goto err_opts;
+        goto err;
+    }
+
+    // the peripherals split the memory areas, therefore they are set up before the program is loaded
+    if (libarmvm_peripherals_init(armvm)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
     }
 
     if (libarmvm_memory_load_program(armvm, armvm->opts.program_address, armvm->opts.program_file)) {
         fprintf(stderr, "ERROR: Could not load program: %s\n", armvm->opts.program_file);
         ret = ARMVM_RET_FAIL;
-        goto err_memory;
+        goto err;
+    }
+
+    // the heatmap is enabled after loading the program, so it does not count the loading
+    if (armvm->opts.heatmap_file && libarmvm_memory_heatmap_enable(armvm, armvm->opts.heatmap_bucket_size)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
     }
 
     if (libarmvm_registers_init(armvm)) {
         ret = ARMVM_RET_FAIL;
-        goto err_memory;
+        goto err;
+    }
+
+    if (armvm->opts.stack_file || armvm->opts.stack_guard_main || armvm->opts.stack_guard_process) {
+        if (libarmvm_registers_stack_enable(armvm, armvm->opts.stack_guard_main, armvm->opts.stack_guard_process)) {
+            ret = ARMVM_RET_FAIL;
+            goto err;
+        }
     }
 
     if (libarmvm_ci_init(armvm)) {
         ret = ARMVM_RET_FAIL;
-        goto err_registers;
+        goto err;
+    }
+
+    if (libarmvm_peripherals_connect(armvm)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
     }
 
     if(armvm->ci->reset(armvm)) {
         ret = ARMVM_RET_FAIL;
-        goto err_ci;
+        goto err;
     }
 
+    return ret;
+err:
+    _libarmvm_cleanup(armvm);
+    return ret;
+}
+
+
+int _libarmvm_run(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    uint64_t executed;
+
     if (armvm->opts.steps) {
-        for (uint64_t i = 0; i < armvm->opts.steps; ++i) {
-            if (armvm->ci->step(armvm)) {
-                ret = ARMVM_RET_FAIL;
-                goto err_ci;
-            }
+        ret = armvm->ci->run(armvm, armvm->opts.steps, &executed);
+        if (ARMVM_RET_EXIT == ret) {
+            goto exit;
+        }
+        if (ret) {
+            goto err;
         }
         printf("Successful executed %d steps.\n", armvm->opts.steps);
+        _libarmvm_print_time(armvm);
 
     } else {
+        // an idle loop is skipped to the end of every chunk, if no event is scheduled before
         while (1) {
-            if (armvm->ci->step(armvm)) {
+            ret = armvm->ci->run(armvm, LIBARMVM_RUN_CHUNK, &executed);
+            if (ARMVM_RET_EXIT == ret) {
+                goto exit;
+            }
+            if (ret) {
+                goto err;
+            }
+            if (libarmvm_ci_sleeps_forever(armvm)) {
+                fprintf(stderr, "WARN: The core sleeps and nothing can wake it up anymore, the vm is stopped.\n");
+                _libarmvm_print_time(armvm);
+                goto err;
+            }
+        }
+    }
+
+err:
+    return ret;
+
+exit:
+    printf("Program exited with code %d.\n", armvm->exit_code);
+    _libarmvm_print_time(armvm);
+    return ret;
+}
+
+
+FILE *_libarmvm_report_open(const char *file)
+{
+    if (0 == strcmp("-", file)) {
+        return stdout;
+    }
+
+    FILE *out = fopen(file, "w");
+    if (!out) {
+        fprintf(stderr, "ERROR: Could not open report file: %s\n", file);
+    }
+    return out;
+}
+
+
+void _libarmvm_report_close(FILE *out)
+{
+    if (stdout == out) {
+        fflush(out);
+    } else {
+        fclose(out);
+    }
+}
+
+
+int _libarmvm_report(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct libarmvm_memory *mem = armvm->mem->data;
+    struct libarmvm_symbols symbols;
+    struct libarmvm_symbols *symbols_ptr = NULL;
+
+    if (armvm->opts.symbol_file) {
+        if (libarmvm_symbols_load(&symbols, armvm->opts.symbol_file)) {
+            fprintf(stderr, "WARN: Reports are written without symbols.\n");
+        } else {
+            symbols_ptr = &symbols;
+        }
+    }
+
+    if (ci->profile) {
+        FILE *out = _libarmvm_report_open(armvm->opts.profile_file);
+        if (!out) {
+            ret = ARMVM_RET_FAIL;
+        } else {
+            if (libarmvm_profile_report(ci->profile, symbols_ptr, out)) {
+                ret = ARMVM_RET_FAIL;
+            }
+            _libarmvm_report_close(out);
+        }
+    }
+
+    if (ci->callgraph && armvm->opts.callgraph_file) {
+        FILE *out = _libarmvm_report_open(armvm->opts.callgraph_file);
+        if (!out) {
+            ret = ARMVM_RET_FAIL;
+        } else {
+            if (libarmvm_callgraph_report(ci->callgraph, symbols_ptr, out)) {
+                ret = ARMVM_RET_FAIL;
+            }
+            _libarmvm_report_close(out);
+        }
+    }
+
+    if (ci->callgraph && armvm->opts.folded_file) {
+        FILE *out = _libarmvm_report_open(armvm->opts.folded_file);
+        if (!out) {
+            ret = ARMVM_RET_FAIL;
+        } else {
+            if (libarmvm_callgraph_folded(ci->callgraph, symbols_ptr, out)) {
+                ret = ARMVM_RET_FAIL;
+            }
+            _libarmvm_report_close(out);
+        }
+    }
+
+    if (ci->coverage) {
+        FILE *out = _libarmvm_report_open(armvm->opts.coverage_file);
+        if (!out) {
+            ret = ARMVM_RET_FAIL;
+        } else {
+            if (ARMVM_COVERAGE_LCOV == armvm->opts.coverage_format) {
+                if (!symbols_ptr) {
+                    fprintf(stderr, "ERROR: The lcov coverage needs the ELF file of the program (-e/--elf).\n");
+                    ret = ARMVM_RET_FAIL;
+                } else if (libarmvm_coverage_lcov(ci->coverage, symbols_ptr, out)) {
+                    ret = ARMVM_RET_FAIL;
+                }
+            } else {
+                const char *module = armvm->opts.symbol_file ? armvm->opts.symbol_file : armvm->opts.program_file;
+                if (libarmvm_coverage_drcov(ci->coverage, module, out)) {
+                    ret = ARMVM_RET_FAIL;
+                }
+            }
+            _libarmvm_report_close(out);
+        }
+    }
+
+    if (mem->heatmap) {
+        FILE *out = _libarmvm_report_open(armvm->opts.heatmap_file);
+        if (!out) {
+            ret = ARMVM_RET_FAIL;
+        } else {
+            if (libarmvm_heatmap_report(mem->heatmap, out)) {
+                ret = ARMVM_RET_FAIL;
+            }
+            _libarmvm_report_close(out);
+        }
+    }
+
+    if (armvm->opts.stack_file) {
+        FILE *out = _libarmvm_report_open(armvm->opts.stack_file);
+        if (!out) {
+            ret = ARMVM_RET_FAIL;
+        } else {
+            if (libarmvm_registers_stack_report(armvm, out)) {
                 ret = ARMVM_RET_FAIL;
-                goto err_ci;
             }
+            _libarmvm_report_close(out);
         }
     }
 
-    printf("TODO: Set up peripherals.\n");
+    if (symbols_ptr) {
+        libarmvm_symbols_cleanup(symbols_ptr);
+    }
+
+    return ret;
+}
+
+
+void _libarmvm_print_time(struct armvm *armvm)
+{
+    uint64_t cycles;
+    uint64_t ns;
+
+    if (armvm->ci->get_cycles(armvm, &cycles) || armvm->ci->get_time(armvm, &ns)) {
+        return;
+    }
+
+    printf("Simulated %" PRIu64 " cycles (%" PRIu64 ".%09" PRIu64 " s).\n", cycles, ns / 1000000000, ns % 1000000000);
+}
+
+
+int _libarmvm_cleanup(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    // the host threads of the peripherals notify the control interface
+    libarmvm_peripherals_disconnect(armvm);
 
-err_ci:
     if (libarmvm_ci_cleanup(armvm)) {
         ret = ARMVM_RET_FAIL;
     }
-err_registers:
+
     if (libarmvm_registers_cleanup(armvm)) {
         ret = ARMVM_RET_FAIL;
     }
-err_memory:
-    if (libarmvm_memory_cleanup(armvm)) {
+
+    if (libarmvm_peripherals_cleanup(armvm)) {
         ret = ARMVM_RET_FAIL;
     }
 
-err_opts:
-    if(armvm_opts_cleanup(&armvm->opts)) {
+    if (libarmvm_memory_cleanup(armvm)) {
         ret = ARMVM_RET_FAIL;
     }
-err:
+
     return ret;
 }
 
@@ -157,6 +497,11 @@ int _libarmvm_opts_check(const struct armvm_opts *opts)
     }
 #undef DEVICE_ID
 
+    if (!opts->core_clock) {
+        fprintf(stderr, "ERROR: The core clock (armvm_opts.core_clock) must not be 0.\n");
+        ret = ARMVM_RET_INVALID_OPTS;
+    }
+
     // TODO: Currently, we only support the Armv6-M ISA
     if (ARMV6_M != opts->isa) {
         fprintf(stderr, "ERROR: Unsupported isa (armvm_opts.isa): %s\n", armvm_utils_isa_to_string(opts->isa));
@@ -196,9 +541,133 @@ int _libarmvm_opts_copy(struct armvm_opts *dest, const struct armvm_opts *src)
         dest->device_id = NULL;
     }
 
+    if (src->symbol_file) {
+        dest->symbol_file = strdup(src->symbol_file);
+        if (!dest->symbol_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->profile_file) {
+        dest->profile_file = strdup(src->profile_file);
+        if (!dest->profile_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->trace_file) {
+        dest->trace_file = strdup(src->trace_file);
+        if (!dest->trace_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->callgraph_file) {
+        dest->callgraph_file = strdup(src->callgraph_file);
+        if (!dest->callgraph_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->folded_file) {
+        dest->folded_file = strdup(src->folded_file);
+        if (!dest->folded_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->coverage_file) {
+        dest->coverage_file = strdup(src->coverage_file);
+        if (!dest->coverage_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->heatmap_file) {
+        dest->heatmap_file = strdup(src->heatmap_file);
+        if (!dest->heatmap_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->stack_file) {
+        dest->stack_file = strdup(src->stack_file);
+        if (!dest->stack_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        if (src->usart_output[i]) {
+            dest->usart_output[i] = strdup(src->usart_output[i]);
+            if (!dest->usart_output[i]) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+        }
+        if (src->usart_input[i]) {
+            dest->usart_input[i] = strdup(src->usart_input[i]);
+            if (!dest->usart_input[i]) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+        }
+    }
+
+    if (src->gpio_vcd_file) {
+        dest->gpio_vcd_file = strdup(src->gpio_vcd_file);
+        if (!dest->gpio_vcd_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    if (src->gpio_stimulus_file) {
+        dest->gpio_stimulus_file = strdup(src->gpio_stimulus_file);
+        if (!dest->gpio_stimulus_file) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    for (size_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        if (src->adc_input[i]) {
+            dest->adc_input[i] = strdup(src->adc_input[i]);
+            if (!dest->adc_input[i]) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+        }
+    }
+
+    if (src->hooks_size) {
+        dest->hooks = malloc(src->hooks_size * sizeof(*dest->hooks));
+        if (!dest->hooks) {
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+        memcpy(dest->hooks, src->hooks, src->hooks_size * sizeof(*dest->hooks));
+        dest->hooks_size = src->hooks_size;
+    }
+
     dest->isa = src->isa;
     dest->program_address = src->program_address;
     dest->steps = src->steps;
+    dest->core_clock = src->core_clock;
+    dest->lockstep = src->lockstep;
+    dest->trace_flags = src->trace_flags;
+    dest->coverage_format = src->coverage_format;
+    dest->heatmap_bucket_size = src->heatmap_bucket_size;
+    dest->stack_guard_main = src->stack_guard_main;
+    dest->stack_guard_process = src->stack_guard_process;
 
 err:
     if (ret != ARMVM_RET_SUCCESS) {
@@ -17,4 +17,46 @@ int _libarmvm_opts_check(const struct armvm_opts *opts);
  */
 int _libarmvm_opts_copy(struct armvm_opts *dest, const struct armvm_opts *src);
 
+
+/**
+ * @brief Initializes memory, registers and control interface of armvm and resets the virtual machine.
+ * armvm->opts have to be set and checked before. On failure, everything which was already
+ * initialized is cleaned up again.
+ *
+ * @returns ARMVM_RET_SUCCESS on success.
+ */
+int _libarmvm_init(struct armvm *armvm);
+
+
+/**
+ * @brief Executes armvm->opts.steps steps or runs indefinitely, if armvm->opts.steps is 0.
+ *
+ * @returns ARMVM_RET_SUCCESS on success.
+ */
+int _libarmvm_run(struct armvm *armvm);
+
+
+/**
+ * @brief Prints the simulated cycles and the simulated time to stdout.
+ */
+void _libarmvm_print_time(struct armvm *armvm);
+
+
+/**
+ * @brief Writes all enabled reports (e.g. the hot-spot report of the profiler).
+ * Is called once, when the virtual machine stops.
+ *
+ * @returns ARMVM_RET_SUCCESS on success.
+ */
+int _libarmvm_report(struct armvm *armvm);
+
+
+/**
+ * @brief Cleans up everything which was initialized by _libarmvm_init().
+ * The options in armvm->opts are not touched.
+ *
+ * @returns ARMVM_RET_SUCCESS on success.
+ */
+int _libarmvm_cleanup(struct armvm *armvm);
+
 #endif
@@ -0,0 +1,515 @@
+#include <libarmvm_adc.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_rcc.h>
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Offsets of the registers.
+ */
+#define ADC_ISR    (0x00)
+#define ADC_IER    (0x04)
+#define ADC_CR     (0x08)
+#define ADC_CFGR1  (0x0c)
+#define ADC_CFGR2  (0x10)
+#define ADC_SMPR   (0x14)
+#define ADC_TR     (0x20)
+#define ADC_CHSELR (0x28)
+#define ADC_DR     (0x40)
+#define ADC_CCR    (0x308)
+
+#define ADC_ISR_ADRDY (0x1 << 0)
+#define ADC_ISR_EOSMP (0x1 << 1)
+#define ADC_ISR_EOC   (0x1 << 2)
+#define ADC_ISR_EOSEQ (0x1 << 3)
+#define ADC_ISR_OVR   (0x1 << 4)
+#define ADC_ISR_AWD   (0x1 << 7)
+#define ADC_ISR_FLAGS (ADC_ISR_ADRDY | ADC_ISR_EOSMP | ADC_ISR_EOC | ADC_ISR_EOSEQ | ADC_ISR_OVR | ADC_ISR_AWD)
+
+#define ADC_CR_ADEN    (0x1 << 0)
+#define ADC_CR_ADDIS   (0x1 << 1)
+#define ADC_CR_ADSTART (0x1 << 2)
+#define ADC_CR_ADSTP   (0x1 << 4)
+#define ADC_CR_ADCAL   (0x1U << 31)
+
+#define ADC_CFGR1_DMAEN   (0x1 << 0)
+#define ADC_CFGR1_SCANDIR (0x1 << 2)
+#define ADC_CFGR1_RES     (0x3 << 3)
+#define ADC_CFGR1_ALIGN   (0x1 << 5)
+#define ADC_CFGR1_OVRMOD  (0x1 << 12)
+#define ADC_CFGR1_CONT    (0x1 << 13)
+
+#define ADC_CFGR2_CKMODE_SHIFT (30)
+
+#define ADC_CHSELR_MASK (0x7ffff)
+
+/**
+ * @brief Sampling times of SMPR in halves of a cycle of the ADC clock.
+ */
+static const uint32_t _adc_sampling[8] = { 3, 15, 27, 57, 83, 111, 143, 479 };
+
+
+static inline uint64_t _adc_cycles(const struct libarmvm_adc *adc)
+{
+    return ((const struct libarmvm_ci *)adc->armvm->ci->data)->cycles;
+}
+
+
+/**
+ * Returns the cycles of the core clock of one conversion. The conversion of 12 bits takes 12.5 cycles
+ * of the ADC clock after the sampling time, every 2 bits less take 2 cycles less.
+ */
+uint64_t _adc_conversion_cycles(const struct libarmvm_adc *adc)
+{
+    const uint32_t res = (adc->cfgr1 & ADC_CFGR1_RES) >> 3;
+    const uint64_t half_cycles = _adc_sampling[adc->smpr & 0x7] + 25 - 4 * res;
+
+    switch (adc->cfgr2 >> ADC_CFGR2_CKMODE_SHIFT) {
+        case 1:
+            // PCLK / 2
+            return (half_cycles * adc->pclk_ratio) >> LIBARMVM_RCC_RATIO_SHIFT;
+        case 2:
+            // PCLK / 4
+            return (2 * half_cycles * adc->pclk_ratio) >> LIBARMVM_RCC_RATIO_SHIFT;
+        default:
+            {
+                const uint64_t cycles = (half_cycles * adc->clock_ratio + 2 * LIBARMVM_RCC_RATIO_ONE - 1) >> (LIBARMVM_RCC_RATIO_SHIFT + 1);
+                return cycles ? cycles : 1;
+            }
+    }
+}
+
+
+/**
+ * Converts the next sample of a channel into the data format of CFGR1.
+ */
+uint32_t _adc_convert(struct libarmvm_adc *adc, uint32_t channel)
+{
+    struct libarmvm_adc_input *input = &adc->input[channel];
+
+    if (!input->samples) {
+        return 0;
+    }
+
+    const uint16_t sample = (uint16_t)input->samples[input->pos] ^ 0x8000;
+    if (++input->pos == input->size) {
+        input->pos = 0;
+    }
+
+    const uint32_t bits = 12 - 2 * ((adc->cfgr1 & ADC_CFGR1_RES) >> 3);
+    const uint32_t value = sample >> (16 - bits);
+    if (adc->cfgr1 & ADC_CFGR1_ALIGN) {
+        // 6 bits are aligned to the left of the low byte
+        return value << (6 == bits ? 2 : 16 - bits);
+    }
+    return value;
+}
+
+
+void _adc_irq(struct libarmvm_adc *adc)
+{
+    if (adc->isr & adc->ier) {
+        libarmvm_nvic_set_pending(adc->armvm, ARMV6M_EXCEPTION_IRQ0 + LIBARMVM_ADC_IRQ);
+    }
+}
+
+
+void _adc_stop(struct libarmvm_adc *adc)
+{
+    libarmvm_peripherals_cancel(adc->armvm, &adc->event);
+    adc->cr &= ~ADC_CR_ADSTART;
+    adc->block = 0;
+}
+
+
+/**
+ * Starts the sequence of the channels of CHSELR.
+ */
+int _adc_start(struct libarmvm_adc *adc)
+{
+    adc->seq_size = 0;
+    for (uint32_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        const uint32_t channel = (adc->cfgr1 & ADC_CFGR1_SCANDIR) ? ARMVM_ADC_CHANNELS - 1 - i : i;
+        if (adc->chselr & (1 << channel)) {
+            adc->seq[adc->seq_size++] = channel;
+        }
+    }
+
+    if (!adc->seq_size) {
+        adc->cr &= ~ADC_CR_ADSTART;
+        return ARMVM_RET_SUCCESS;
+    }
+
+    adc->seq_pos = 0;
+    adc->block = 0;
+    adc->cycles_per_conversion = _adc_conversion_cycles(adc);
+
+    return libarmvm_peripherals_schedule(adc->armvm, &adc->event, _adc_cycles(adc) + adc->cycles_per_conversion);
+}
+
+
+/**
+ * Transfers the conversion, which ends now, and the following ones as one block with the DMA.
+ * The amount of conversions of the block is stored in count, eoseq is set if the sequence ends in the block.
+ */
+int _adc_dma_block(struct libarmvm_adc *adc, uint32_t capacity, uint32_t *count, uint32_t *eoseq)
+{
+    uint32_t values[LIBARMVM_ADC_DMA_BLOCK];
+    uint32_t size = capacity < LIBARMVM_ADC_DMA_BLOCK ? capacity : LIBARMVM_ADC_DMA_BLOCK;
+
+    // the block ends with the sequence, if the sequence stops or raises an interrupt
+    if ((!(adc->cfgr1 & ADC_CFGR1_CONT) || (adc->ier & ADC_ISR_EOSEQ)) && size > adc->seq_size - adc->seq_pos) {
+        size = adc->seq_size - adc->seq_pos;
+    }
+
+    *eoseq = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+        values[i] = _adc_convert(adc, adc->seq[adc->seq_pos]);
+        if (++adc->seq_pos == adc->seq_size) {
+            adc->seq_pos = 0;
+            *eoseq = 1;
+        }
+    }
+    adc->dr = values[size - 1];
+    *count = size;
+
+    return libarmvm_dma_push(adc->armvm, LIBARMVM_DMA_ADC, values, size, adc->cycles_per_conversion);
+}
+
+
+/**
+ * Ends a conversion or a block of conversions, which was transferred by the DMA.
+ */
+int _adc_event(struct armvm *armvm, void *data)
+{
+    struct libarmvm_adc *adc = data;
+    const uint64_t cycles = adc->event.cycles;
+    uint32_t eoseq = 0;
+
+    if (adc->block) {
+        adc->block = 0;
+        eoseq = adc->block_eoseq;
+    } else {
+        const uint32_t capacity = (adc->cfgr1 & ADC_CFGR1_DMAEN)
+                                  ? libarmvm_dma_capacity(armvm, LIBARMVM_DMA_ADC, LIBARMVM_DMA_TO_MEMORY) : 0;
+        if (capacity) {
+            uint32_t count;
+            int ret = _adc_dma_block(adc, capacity, &count, &eoseq);
+            if (ret) {
+                return ret;
+            }
+            if (count > 1) {
+                adc->block = 1;
+                adc->block_eoseq = eoseq;
+                return libarmvm_peripherals_schedule(armvm, &adc->event, cycles + (count - 1) * adc->cycles_per_conversion);
+            }
+        } else {
+            // an overrun keeps the unread data, unless OVRMOD is set
+            const uint32_t value = _adc_convert(adc, adc->seq[adc->seq_pos]);
+            if (!(adc->isr & ADC_ISR_EOC) || (adc->cfgr1 & ADC_CFGR1_OVRMOD)) {
+                adc->dr = value;
+            }
+            if (adc->isr & ADC_ISR_EOC) {
+                adc->isr |= ADC_ISR_OVR;
+            }
+            adc->isr |= ADC_ISR_EOSMP | ADC_ISR_EOC;
+            if (++adc->seq_pos == adc->seq_size) {
+                adc->seq_pos = 0;
+                eoseq = 1;
+            }
+        }
+    }
+
+    if (eoseq) {
+        adc->isr |= ADC_ISR_EOSEQ;
+        if (!(adc->cfgr1 & ADC_CFGR1_CONT)) {
+            adc->cr &= ~ADC_CR_ADSTART;
+        }
+    }
+    _adc_irq(adc);
+
+    if (adc->cr & ADC_CR_ADSTART) {
+        return libarmvm_peripherals_schedule(armvm, &adc->event, cycles + adc->cycles_per_conversion);
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _adc_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    struct libarmvm_adc *adc = data;
+    uint32_t word = 0;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case ADC_ISR:
+            word = adc->isr;
+            break;
+        case ADC_IER:
+            word = adc->ier;
+            break;
+        case ADC_CR:
+            word = adc->cr;
+            break;
+        case ADC_CFGR1:
+            word = adc->cfgr1;
+            break;
+        case ADC_CFGR2:
+            word = adc->cfgr2;
+            break;
+        case ADC_SMPR:
+            word = adc->smpr;
+            break;
+        case ADC_TR:
+            word = adc->tr;
+            break;
+        case ADC_CHSELR:
+            word = adc->chselr;
+            break;
+        case ADC_DR:
+            word = adc->dr;
+            adc->isr &= ~ADC_ISR_EOC;
+            break;
+        case ADC_CCR:
+            word = adc->ccr;
+            break;
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _adc_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_adc *adc = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+
+    value <<= shift;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case ADC_ISR:
+            adc->isr &= ~(value & mask & ADC_ISR_FLAGS);
+            break;
+        case ADC_IER:
+            adc->ier = (adc->ier & ~(mask & ADC_ISR_FLAGS)) | (value & mask & ADC_ISR_FLAGS);
+            _adc_irq(adc);
+            break;
+        case ADC_CR:
+            // the calibration (ADCAL) ends at once
+            value &= mask;
+            if (value & ADC_CR_ADDIS) {
+                _adc_stop(adc);
+                adc->cr &= ~ADC_CR_ADEN;
+                adc->isr &= ~ADC_ISR_ADRDY;
+            } else if (value & ADC_CR_ADEN) {
+                adc->cr |= ADC_CR_ADEN;
+                adc->isr |= ADC_ISR_ADRDY;
+                _adc_irq(adc);
+            }
+            if (value & ADC_CR_ADSTP) {
+                _adc_stop(adc);
+            } else if ((value & ADC_CR_ADSTART) && (adc->cr & ADC_CR_ADEN) && !(adc->cr & ADC_CR_ADSTART)) {
+                adc->cr |= ADC_CR_ADSTART;
+                return _adc_start(adc);
+            }
+            break;
+        case ADC_CFGR1:
+            adc->cfgr1 = (adc->cfgr1 & ~mask) | (value & mask);
+            break;
+        case ADC_CFGR2:
+            adc->cfgr2 = (adc->cfgr2 & ~mask) | (value & mask);
+            break;
+        case ADC_SMPR:
+            adc->smpr = ((adc->smpr & ~mask) | (value & mask)) & 0x7;
+            break;
+        case ADC_TR:
+            adc->tr = ((adc->tr & ~mask) | (value & mask)) & 0x0fff0fff;
+            break;
+        case ADC_CHSELR:
+            adc->chselr = ((adc->chselr & ~mask) | (value & mask)) & ADC_CHSELR_MASK;
+            break;
+        case ADC_CCR:
+            adc->ccr = ((adc->ccr & ~mask) | (value & mask)) & 0x01c00000;
+            break;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _adc_map(struct libarmvm_adc_input *input, int fd, const char *file)
+{
+    struct stat st;
+
+    if (fstat(fd, &st)) {
+        fprintf(stderr, "ERROR: Could not read sample file: %s\n", file);
+        return ARMVM_RET_FAIL;
+    }
+    if (st.st_size < (off_t)sizeof(int16_t)) {
+        fprintf(stderr, "ERROR: The sample file has no samples: %s\n", file);
+        return ARMVM_RET_FAIL;
+    }
+
+    void *samples = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == samples) {
+        fprintf(stderr, "ERROR: Could not map sample file: %s\n", file);
+        return ARMVM_RET_FAIL;
+    }
+    madvise(samples, st.st_size, MADV_SEQUENTIAL);
+
+    input->samples = samples;
+    input->size = st.st_size / sizeof(int16_t);
+    input->pos = 0;
+    input->map_size = st.st_size;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * Converts a CSV file into a temporary raw file, which is removed when it is closed.
+ */
+FILE *_adc_convert_csv(const char *file)
+{
+    FILE *csv = fopen(file, "r");
+    if (!csv) {
+        fprintf(stderr, "ERROR: Could not open sample file: %s\n", file);
+        return NULL;
+    }
+
+    FILE *raw = tmpfile();
+    if (!raw) {
+        fprintf(stderr, "ERROR: Could not create a temporary file for the samples of: %s\n", file);
+        goto err;
+    }
+
+    while (1) {
+        int c;
+        do {
+            c = getc(csv);
+        } while (isspace(c) || ',' == c);
+        if (EOF == c) {
+            break;
+        }
+        ungetc(c, csv);
+
+        long value;
+        if (1 != fscanf(csv, "%ld", &value) || value < INT16_MIN || value > INT16_MAX) {
+            fprintf(stderr, "ERROR: Invalid sample in the CSV file: %s\n", file);
+            goto err;
+        }
+        const int16_t sample = value;
+        if (1 != fwrite(&sample, sizeof(sample), 1, raw)) {
+            fprintf(stderr, "ERROR: Could not write the samples of: %s\n", file);
+            goto err;
+        }
+    }
+
+    if (ferror(csv) || fflush(raw)) {
+        fprintf(stderr, "ERROR: Could not convert the samples of: %s\n", file);
+        goto err;
+    }
+
+    fclose(csv);
+    return raw;
+err:
+    if (raw) {
+        fclose(raw);
+    }
+    fclose(csv);
+    return NULL;
+}
+
+
+int libarmvm_adc_init(struct armvm *armvm, struct libarmvm_adc *adc)
+{
+    assert(armvm);
+
+    memset(adc, 0, sizeof(*adc));
+    adc->armvm = armvm;
+    adc->clock_ratio = ((uint64_t)armvm->opts.core_clock << LIBARMVM_RCC_RATIO_SHIFT) / LIBARMVM_ADC_CLOCK;
+    adc->pclk_ratio = LIBARMVM_RCC_RATIO_ONE;
+    libarmvm_peripherals_event_init(&adc->event, _adc_event, adc);
+    libarmvm_adc_reset(adc);
+
+    const struct libarmvm_memory_peripheral periph = { _adc_read, _adc_write, adc };
+    return libarmvm_memory_add_peripheral(armvm, LIBARMVM_ADC_BASE_ADDR, LIBARMVM_ADC_SIZE, &periph);
+}
+
+
+int libarmvm_adc_connect(struct libarmvm_adc *adc, char * const *files)
+{
+    for (uint32_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        const char *file = files[i];
+        if (!file) {
+            continue;
+        }
+
+        const size_t len = strlen(file);
+        FILE *f;
+        if (len > 4 && !strcasecmp(file + len - 4, ".csv")) {
+            f = _adc_convert_csv(file);
+        } else {
+            f = fopen(file, "rb");
+            if (!f) {
+                fprintf(stderr, "ERROR: Could not open sample file: %s\n", file);
+            }
+        }
+        if (!f) {
+            return ARMVM_RET_FAIL;
+        }
+
+        // the mapping stays valid after the file is closed
+        int ret = _adc_map(&adc->input[i], fileno(f), file);
+        fclose(f);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_adc_reset(struct libarmvm_adc *adc)
+{
+    adc->isr = 0;
+    adc->ier = 0;
+    adc->cr = 0;
+    adc->cfgr1 = 0;
+    adc->cfgr2 = 0;
+    adc->smpr = 0;
+    adc->tr = 0x0fff0000;
+    adc->chselr = 0;
+    adc->dr = 0;
+    adc->ccr = 0;
+
+    adc->seq_size = 0;
+    adc->seq_pos = 0;
+    adc->block = 0;
+
+    for (uint32_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        adc->input[i].pos = 0;
+    }
+}
+
+
+void libarmvm_adc_disconnect(struct libarmvm_adc *adc)
+{
+    for (uint32_t i = 0; i < ARMVM_ADC_CHANNELS; ++i) {
+        struct libarmvm_adc_input *input = &adc->input[i];
+        if (input->samples) {
+            munmap((void *)input->samples, input->map_size);
+        }
+        memset(input, 0, sizeof(*input));
+    }
+}
@@ -0,0 +1,107 @@
+/** @file */
+#ifndef __LIBARMVM_ADC_H__
+#define __LIBARMVM_ADC_H__
+
+#include <armvm.h>
+#include <libarmvm_event.h>
+
+/**
+ * @brief First address and interrupt of the ADC of the STM32F070.
+ */
+#define LIBARMVM_ADC_BASE_ADDR (0x40012400)
+#define LIBARMVM_ADC_SIZE      (0x400)
+#define LIBARMVM_ADC_IRQ       (12)
+
+/**
+ * @brief Frequency of the asynchronous clock of the ADC (HSI14) in Hz.
+ */
+#define LIBARMVM_ADC_CLOCK (14000000)
+
+/**
+ * @brief Maximal amount of conversions, which are transferred by the DMA as one block.
+ */
+#define LIBARMVM_ADC_DMA_BLOCK (256)
+
+
+/**
+ * @brief Samples of one channel. They are mapped from a file of the host.
+ */
+struct libarmvm_adc_input {
+    const int16_t *samples;  /**< NULL if the channel has no samples. */
+    size_t size;             /**< Amount of samples. */
+    size_t pos;              /**< Index of the sample of the next conversion. */
+    size_t map_size;         /**< Size of the mapping in bytes. */
+};
+
+
+/**
+ * @brief ADC with the register layout of the STM32F0.
+ * Every conversion takes the next sample of its channel, the samples repeat after the end of the file.
+ * A sample is a signed 16 bit value, whose range is mapped to the range of the ADC (-32768 is 0).
+ * A sample file is either raw (little endian int16) or, if its name ends with ".csv", a list of decimal
+ * values separated by commas or white space, which is converted once into a temporary raw file.
+ *
+ * The end of a conversion is an event of the scheduler. If the DMA serves the ADC, the following
+ * conversions are transferred as one block of up to LIBARMVM_ADC_DMA_BLOCK conversions, which ends
+ * at the end of the sequence, if the sequence stops there or raises an interrupt.
+ *
+ * External triggers, the discontinuous, wait and auto-off modes and the analog watchdog are not modeled.
+ */
+struct libarmvm_adc {
+    struct armvm *armvm;
+    struct libarmvm_peripherals_event event;  /**< End of the next conversion or DMA block. */
+
+    uint32_t isr;
+    uint32_t ier;
+    uint32_t cr;
+    uint32_t cfgr1;
+    uint32_t cfgr2;
+    uint32_t smpr;
+    uint32_t tr;
+    uint32_t chselr;
+    uint32_t dr;
+    uint32_t ccr;
+
+    uint8_t seq[ARMVM_ADC_CHANNELS];  /**< Channels of the running sequence in the order of their conversion. */
+    uint32_t seq_size;
+    uint32_t seq_pos;                 /**< Position of the next conversion in the sequence. */
+    uint64_t cycles_per_conversion;
+    uint64_t clock_ratio;             /**< Core cycles per cycle of the asynchronous clock (see LIBARMVM_RCC_RATIO_SHIFT). */
+    uint64_t pclk_ratio;              /**< Core cycles per cycle of PCLK. */
+    uint8_t block;                    /**< Set if the event ends a block, which was transferred by the DMA. */
+    uint8_t block_eoseq;              /**< Set if the sequence ended in this block. */
+
+    struct libarmvm_adc_input input[ARMVM_ADC_CHANNELS];
+};
+
+
+/**
+ * @brief Initializes the ADC and maps its registers to LIBARMVM_ADC_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_adc_init(struct armvm *armvm, struct libarmvm_adc *adc);
+
+
+/**
+ * @brief Maps the sample files of the channels.
+ *
+ * @param files File per channel. NULL if the channel has no samples, its conversions are 0.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_adc_connect(struct libarmvm_adc *adc, char * const *files);
+
+
+/**
+ * @brief Resets the registers of the ADC and starts the samples of all channels from their beginning.
+ * Has to be called after the scheduled events were removed.
+ */
+void libarmvm_adc_reset(struct libarmvm_adc *adc);
+
+
+/**
+ * @brief Unmaps the sample files.
+ */
+void libarmvm_adc_disconnect(struct libarmvm_adc *adc);
+
+#endif
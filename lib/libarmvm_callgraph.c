@@ -0,0 +1,322 @@
+#include <libarmvm_callgraph.h>
+#include <inttypes.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define CALLGRAPH_INITIAL_NODES (256)
+
+/**
+ * @brief Accumulated counts of one function, used for the report.
+ */
+struct _callgraph_function {
+    uint32_t function;
+    uint64_t calls;
+    uint64_t incl_instructions;
+    uint64_t excl_instructions;
+    uint64_t incl_cycles;
+    uint64_t excl_cycles;
+};
+
+
+int _callgraph_add_node(struct libarmvm_callgraph *callgraph, size_t parent, uint32_t function, size_t *idx)
+{
+    if (callgraph->nodes_size == callgraph->nodes_capacity) {
+        size_t capacity = 2 * callgraph->nodes_capacity;
+        struct libarmvm_callgraph_node *nodes = realloc(callgraph->nodes, capacity * sizeof(*nodes));
+        if (!nodes) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return ARMVM_RET_NO_MEM;
+        }
+        callgraph->nodes = nodes;
+        callgraph->nodes_capacity = capacity;
+    }
+
+    *idx = callgraph->nodes_size++;
+    struct libarmvm_callgraph_node *node = &callgraph->nodes[*idx];
+    memset(node, 0, sizeof(*node));
+    node->function = function;
+    node->parent = parent;
+
+    if (*idx != parent) {
+        node->next_sibling = callgraph->nodes[parent].first_child;
+        callgraph->nodes[parent].first_child = *idx;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _callgraph_call(struct libarmvm_callgraph *callgraph, uint32_t function, uint32_t return_addr)
+{
+    if (LIBARMVM_CALLGRAPH_MAX_DEPTH == callgraph->depth) {
+        callgraph->overflows++;
+        return ARMVM_RET_SUCCESS;
+    }
+
+    size_t child = callgraph->nodes[callgraph->current].first_child;
+    while (child && callgraph->nodes[child].function != function) {
+        child = callgraph->nodes[child].next_sibling;
+    }
+
+    if (!child) {
+        int ret = _callgraph_add_node(callgraph, callgraph->current, function, &child);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    callgraph->stack[callgraph->depth].node = callgraph->current;
+    callgraph->stack[callgraph->depth].return_addr = return_addr;
+    callgraph->depth++;
+
+    callgraph->current = child;
+    callgraph->nodes[child].calls++;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _callgraph_return(struct libarmvm_callgraph *callgraph, uint32_t pc)
+{
+    // BX and POP are also used for other purposes than returns. Therefore, only a jump to
+    // the return address of a frame is treated as return. Frames above it are dropped.
+    for (size_t i = callgraph->depth; i > 0; --i) {
+        if (callgraph->stack[i - 1].return_addr == pc) {
+            callgraph->depth = i - 1;
+            callgraph->current = callgraph->stack[i - 1].node;
+            return;
+        }
+    }
+}
+
+
+int libarmvm_callgraph_init(struct libarmvm_callgraph *callgraph)
+{
+    size_t root;
+
+    memset(callgraph, 0, sizeof(*callgraph));
+
+    callgraph->nodes = calloc(CALLGRAPH_INITIAL_NODES, sizeof(*callgraph->nodes));
+    if (!callgraph->nodes) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+    callgraph->nodes_capacity = CALLGRAPH_INITIAL_NODES;
+
+    return _callgraph_add_node(callgraph, 0, 0, &root);
+}
+
+
+int libarmvm_callgraph_cleanup(struct libarmvm_callgraph *callgraph)
+{
+    if (callgraph->nodes) {
+        free(callgraph->nodes);
+        callgraph->nodes = NULL;
+    }
+    callgraph->nodes_size = 0;
+    callgraph->nodes_capacity = 0;
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_callgraph_step(struct libarmvm_callgraph *callgraph, const struct armv6m_instruction *instruction, uint32_t pc, uint64_t cycles)
+{
+    struct libarmvm_callgraph_node *node = &callgraph->nodes[callgraph->current];
+
+    if (!node->calls && !callgraph->current) {
+        // the root node is named after the first executed instruction (the reset handler)
+        node->function = instruction->addr;
+        node->calls = 1;
+    }
+
+    node->instructions++;
+    node->cycles += cycles;
+
+    if (instruction->is32Bit) {
+        uint16_t hw1 = instruction->i._32bit >> 16;
+        uint16_t hw2 = instruction->i._32bit & 0xffff;
+        if ((hw1 >> 11) == 0b11110 && (hw2 & 0xd000) == 0xd000) {
+            // BL
+            return _callgraph_call(callgraph, pc, instruction->addr + 4);
+        }
+        return ARMVM_RET_SUCCESS;
+    }
+
+    uint16_t ins = instruction->i._16bit;
+    if ((ins & 0xff87) == 0x4780) {
+        // BLX <Rm>
+        return _callgraph_call(callgraph, pc, instruction->addr + 2);
+    }
+    if ((ins & 0xff87) == 0x4700 || (ins & 0xff00) == 0xbd00) {
+        // BX <Rm> or POP {..., PC}
+        _callgraph_return(callgraph, pc);
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _callgraph_print_name(const struct libarmvm_symbols *symbols, uint32_t addr, FILE *out)
+{
+    const struct libarmvm_symbol *sym = NULL;
+    if (symbols) {
+        sym = libarmvm_symbols_lookup(symbols, addr);
+    }
+
+    if (!sym) {
+        fprintf(out, "0x%08x", addr);
+    } else if (sym->addr == addr) {
+        fprintf(out, "%s", sym->name);
+    } else {
+        fprintf(out, "%s+0x%x", sym->name, addr - sym->addr);
+    }
+}
+
+
+int _callgraph_function_address_compare(const void *a, const void *b)
+{
+    const struct _callgraph_function *func_a = a;
+    const struct _callgraph_function *func_b = b;
+
+    return (func_a->function > func_b->function) - (func_a->function < func_b->function);
+}
+
+
+int _callgraph_function_compare(const void *a, const void *b)
+{
+    const struct _callgraph_function *func_a = a;
+    const struct _callgraph_function *func_b = b;
+
+    if (func_a->incl_cycles != func_b->incl_cycles) {
+        return func_a->incl_cycles > func_b->incl_cycles ? -1 : 1;
+    }
+    return (func_a->function > func_b->function) - (func_a->function < func_b->function);
+}
+
+
+/**
+ * Returns 1 if an ancestor of the node calls the same function (recursion). Such nodes are
+ * already contained in the inclusive counts of the ancestor.
+ */
+int _callgraph_is_recursive(const struct libarmvm_callgraph *callgraph, size_t idx)
+{
+    uint32_t function = callgraph->nodes[idx].function;
+
+    while (idx) {
+        idx = callgraph->nodes[idx].parent;
+        if (callgraph->nodes[idx].function == function) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+int libarmvm_callgraph_report(const struct libarmvm_callgraph *callgraph, const struct libarmvm_symbols *symbols, FILE *out)
+{
+    const size_t size = callgraph->nodes_size;
+    uint64_t *incl_instructions = calloc(size, sizeof(*incl_instructions));
+    uint64_t *incl_cycles = calloc(size, sizeof(*incl_cycles));
+    struct _callgraph_function *functions = calloc(size, sizeof(*functions));
+    size_t functions_size = 0;
+
+    if (!incl_instructions || !incl_cycles || !functions) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        free(incl_instructions);
+        free(incl_cycles);
+        free(functions);
+        return ARMVM_RET_NO_MEM;
+    }
+
+    // children are always created after their parent
+    for (size_t i = size; i > 0; --i) {
+        const struct libarmvm_callgraph_node *node = &callgraph->nodes[i - 1];
+        incl_instructions[i - 1] += node->instructions;
+        incl_cycles[i - 1] += node->cycles;
+        if (i - 1) {
+            incl_instructions[node->parent] += incl_instructions[i - 1];
+            incl_cycles[node->parent] += incl_cycles[i - 1];
+        }
+    }
+
+    // every node gets an entry, the entries of the same function are merged after sorting them by address
+    for (size_t i = 0; i < size; ++i) {
+        const struct libarmvm_callgraph_node *node = &callgraph->nodes[i];
+        functions[i].function = node->function;
+        functions[i].calls = node->calls;
+        functions[i].excl_instructions = node->instructions;
+        functions[i].excl_cycles = node->cycles;
+        if (!_callgraph_is_recursive(callgraph, i)) {
+            functions[i].incl_instructions = incl_instructions[i];
+            functions[i].incl_cycles = incl_cycles[i];
+        }
+    }
+
+    qsort(functions, size, sizeof(*functions), _callgraph_function_address_compare);
+
+    for (size_t i = 0; i < size; ++i) {
+        if (functions_size && functions[functions_size - 1].function == functions[i].function) {
+            struct _callgraph_function *function = &functions[functions_size - 1];
+            function->calls += functions[i].calls;
+            function->excl_instructions += functions[i].excl_instructions;
+            function->excl_cycles += functions[i].excl_cycles;
+            function->incl_instructions += functions[i].incl_instructions;
+            function->incl_cycles += functions[i].incl_cycles;
+        } else {
+            functions[functions_size++] = functions[i];
+        }
+    }
+
+    qsort(functions, functions_size, sizeof(*functions), _callgraph_function_compare);
+
+    const uint64_t total_cycles = incl_cycles[0] ? incl_cycles[0] : 1;
+    fprintf(out, "# libarmvm call graph report\n");
+    fprintf(out, "# executed instructions: %" PRIu64 "\n", incl_instructions[0]);
+    fprintf(out, "# cycles: %" PRIu64 "\n", incl_cycles[0]);
+    fprintf(out, "# calls deeper than %u frames (not tracked): %" PRIu64 "\n", LIBARMVM_CALLGRAPH_MAX_DEPTH, callgraph->overflows);
+    fprintf(out, "\n");
+    fprintf(out, "#%11s %20s %8s %20s %8s %20s %20s  %s\n", "calls", "incl. cycles", "percent", "excl. cycles", "percent",
+                                                            "incl. instructions", "excl. instructions", "function");
+    for (size_t i = 0; i < functions_size; ++i) {
+        fprintf(out, "%12" PRIu64 " %20" PRIu64 " %7.2f%% %20" PRIu64 " %7.2f%% %20" PRIu64 " %20" PRIu64 "  ",
+                functions[i].calls,
+                functions[i].incl_cycles, 100.0 * functions[i].incl_cycles / total_cycles,
+                functions[i].excl_cycles, 100.0 * functions[i].excl_cycles / total_cycles,
+                functions[i].incl_instructions, functions[i].excl_instructions);
+        _callgraph_print_name(symbols, functions[i].function, out);
+        fprintf(out, "\n");
+    }
+
+    free(incl_instructions);
+    free(incl_cycles);
+    free(functions);
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_callgraph_folded(const struct libarmvm_callgraph *callgraph, const struct libarmvm_symbols *symbols, FILE *out)
+{
+    size_t path[LIBARMVM_CALLGRAPH_MAX_DEPTH + 1];
+
+    for (size_t i = 0; i < callgraph->nodes_size; ++i) {
+        if (!callgraph->nodes[i].cycles) {
+            continue;
+        }
+
+        size_t path_size = 0;
+        size_t idx = i;
+        while (idx) {
+            path[path_size++] = idx;
+            idx = callgraph->nodes[idx].parent;
+        }
+        path[path_size++] = 0;
+
+        for (size_t j = path_size; j > 0; --j) {
+            _callgraph_print_name(symbols, callgraph->nodes[path[j - 1]].function, out);
+            fprintf(out, "%s", j > 1 ? ";" : "");
+        }
+        fprintf(out, " %" PRIu64 "\n", callgraph->nodes[i].cycles);
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
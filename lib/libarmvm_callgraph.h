@@ -0,0 +1,104 @@
+/** @file */
+#ifndef __LIBARMVM_CALLGRAPH_H__
+#define __LIBARMVM_CALLGRAPH_H__
+
+#include <armvm.h>
+#include <stdio.h>
+#include <isa/armv6_m.h>
+#include <libarmvm_symbols.h>
+
+/**
+ * @brief Maximal depth of the shadow call stack. Deeper calls are accounted to the deepest frame.
+ */
+#define LIBARMVM_CALLGRAPH_MAX_DEPTH (1024)
+
+/**
+ * @brief One node of the call tree. Every node represents one call path.
+ */
+struct libarmvm_callgraph_node {
+    uint32_t function;     /**< Entry address of the called function. */
+    size_t parent;         /**< Index of the calling node. The root node is its own parent. */
+    size_t first_child;    /**< Index of the first called node. 0 if there is none. */
+    size_t next_sibling;   /**< Index of the next node with the same parent. 0 if there is none. */
+    uint64_t calls;        /**< Amount of calls of this path. */
+    uint64_t instructions; /**< Instructions which were executed in the function itself. */
+    uint64_t cycles;       /**< Cycles which were spent in the function itself. */
+};
+
+
+/**
+ * @brief One frame of the shadow call stack.
+ */
+struct libarmvm_callgraph_frame {
+    size_t node;          /**< Index of the node which is continued after the return. */
+    uint32_t return_addr; /**< Address of the instruction after the call. */
+};
+
+
+/**
+ * @brief Call graph profiler.
+ * Calls are detected at BL and BLX, returns at BX and POP with the PC in the register list.
+ */
+struct libarmvm_callgraph {
+    /**
+     * @brief Vector of the nodes of the call tree. nodes[0] is the root node, which
+     * represents the code executed after reset.
+     */
+    struct libarmvm_callgraph_node *nodes;
+    size_t nodes_size;
+    size_t nodes_capacity;
+
+    struct libarmvm_callgraph_frame stack[LIBARMVM_CALLGRAPH_MAX_DEPTH];
+    size_t depth;         /**< Amount of frames on the shadow call stack. */
+    size_t current;       /**< Index of the node which is currently executed. */
+    uint64_t overflows;   /**< Amount of calls which exceeded LIBARMVM_CALLGRAPH_MAX_DEPTH. */
+};
+
+
+/**
+ * @brief Initializes the call graph profiler.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_callgraph_init(struct libarmvm_callgraph *callgraph);
+
+
+/**
+ * @brief Frees all memory allocated by the call graph profiler.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_callgraph_cleanup(struct libarmvm_callgraph *callgraph);
+
+
+/**
+ * @brief Accounts one executed instruction. Has to be called after the instruction was executed.
+ *
+ * @param pc Address of the next instruction.
+ * @param cycles Amount of cycles the instruction took.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_callgraph_step(struct libarmvm_callgraph *callgraph, const struct armv6m_instruction *instruction, uint32_t pc, uint64_t cycles);
+
+
+/**
+ * @brief Writes the inclusive and exclusive instruction and cycle counts per function.
+ *
+ * @param symbols Function symbols of the program or NULL.
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_callgraph_report(const struct libarmvm_callgraph *callgraph, const struct libarmvm_symbols *symbols, FILE *out);
+
+
+/**
+ * @brief Writes the cycles per call path in the folded stack format ("main;foo;bar 42"),
+ * which is consumed by flame graph tools.
+ *
+ * @param symbols Function symbols of the program or NULL.
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_callgraph_folded(const struct libarmvm_callgraph *callgraph, const struct libarmvm_symbols *symbols, FILE *out);
+
+#endif
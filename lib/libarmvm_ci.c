@@ -1,22 +1,105 @@
 #include <libarmvm_ci.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_peripherals.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <isa/armv6_m.h>
 
+/**
+ * Maximal distance in bytes between the backward branch and the first instruction of an idle loop.
+ */
+#define CI_IDLE_MAX_LOOP (32)
+
+
+/**
+ * State of the idle loop detection. A loop is observed from one arrival at its first
+ * instruction (begin) by a backward branch to the next one.
+ */
+struct _ci_idle {
+    uint32_t begin;        /**< First instruction of the observed loop. 0x1 if no loop is observed. */
+    uint32_t min_addr;     /**< Lowest address which was executed since the arrival at begin. */
+    uint32_t max_addr;     /**< Highest address which was executed since the arrival at begin. */
+    uint64_t step;         /**< Executed steps at the arrival at begin. */
+    uint64_t cycles;       /**< Cycles at the arrival at begin. */
+    uint32_t gpr[LIBARMVM_GPR_SIZE];
+    uint32_t psr;
+    uint32_t control;
+    uint32_t SP_main;
+    uint32_t SP_process;
+    uint64_t volatile_reads; /**< libarmvm_memory.volatile_reads at the arrival at begin. */
+    uint64_t next_event;     /**< libarmvm_ci.next_event at the arrival at begin. */
+};
+
 
 int _reset(struct armvm *armvm)
 {
-    return armv6m_TakeReset(armvm);
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    // an initial stack pointer below its guard stops the vm before the first instruction
+    ci->pending = 0;
+    int ret = armv6m_TakeReset(armvm);
+
+    ci->cycles = 0;
+    ci->core_clock = armvm->opts.core_clock;
+    ci->time_base = 0;
+    ci->time_base_cycles = 0;
+    ci->next_event = UINT64_MAX;
+
+    if (armvm->periph && libarmvm_peripherals_reset(armvm)) {
+        ret = ARMVM_RET_FAIL;
+    }
+
+    return ret;
+}
+
+
+/**
+ * Handles ci->pending instead of executing the next instruction.
+ */
+int _ci_step_pending(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    if (ci->pending & LIBARMVM_CI_PENDING_STACK_OVERFLOW) {
+        ci->pending &= ~LIBARMVM_CI_PENDING_STACK_OVERFLOW;
+        return ARMVM_RET_STACK_OVERFLOW;
+    }
+
+    if (ci->pending & LIBARMVM_CI_PENDING_EXCEPTION) {
+        ci->pending &= ~LIBARMVM_CI_PENDING_EXCEPTION;
+        return armv6m_ExceptionEntry(armvm, ci->exception);
+    }
+
+    if (ci->pending & LIBARMVM_CI_PENDING_SLEEP) {
+        // the sleeping core does nothing for one cycle
+        ci->cycles++;
+    }
+
+    return ARMVM_RET_SUCCESS;
 }
 
 
 int _step(struct armvm *armvm)
 {
     int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
     struct armv6m_instruction instruction;
 
+    // the events which are due may raise an exception, which is taken in this step
+    if (ci->cycles >= ci->next_event) {
+        ret = libarmvm_peripherals_service(armvm);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    if (ci->pending) {
+        return _ci_step_pending(armvm);
+    }
+
     // TODO: Implement Pipeline
     ret = armv6m_load_next_instruction(armvm, &instruction);
     if (ret) {
@@ -33,6 +116,405 @@ err:
 }
 
 
+/**
+ * Is used instead of _step() if profiling, tracing, the call graph, the coverage or hooks which
+ * have to be called per step are enabled. Therefore, _step() has no overhead if all of them are disabled.
+ */
+int _step_instrumented(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armv6m_instruction instruction;
+
+    // the events which are due may raise an exception, which is taken in this step
+    if (ci->cycles >= ci->next_event) {
+        ret = libarmvm_peripherals_service(armvm);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    if (ci->pending) {
+        return _ci_step_pending(armvm);
+    }
+
+    ret = armv6m_load_next_instruction(armvm, &instruction);
+    if (ret) {
+        goto err;
+    }
+
+    if (ci->profile) {
+        libarmvm_profile_count(ci->profile, instruction.addr);
+    }
+
+    if (ci->trace) {
+        libarmvm_trace_instruction(ci->trace, armvm->regs->data, &instruction);
+    }
+
+    if (ci->hooks) {
+        ret = libarmvm_hooks_instruction(armvm, ci->hooks, &instruction);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    const uint64_t cycles = ci->cycles;
+    ret = armv6m_execute_instruction(armvm, &instruction);
+    if (ret) {
+        goto err;
+    }
+
+    if (ci->trace) {
+        libarmvm_trace_registers(ci->trace, armvm->regs->data);
+    }
+
+    if (ci->callgraph) {
+        const struct libarmvm_registers *regs = armvm->regs->data;
+        ret = libarmvm_callgraph_step(ci->callgraph, &instruction, regs->gpr[ARMV6M_REG_PC], ci->cycles - cycles);
+    }
+
+    if (ci->coverage) {
+        const struct libarmvm_registers *regs = armvm->regs->data;
+        libarmvm_coverage_step(ci->coverage, &instruction, regs->gpr[ARMV6M_REG_PC]);
+    }
+
+    if (ci->hooks && ci->hooks->memory_ret) {
+        ret = ci->hooks->memory_ret;
+        ci->hooks->memory_ret = ARMVM_RET_SUCCESS;
+    }
+
+err:
+    return ret;
+}
+
+
+void _ci_idle_observe(struct _ci_idle *idle, const struct libarmvm_registers *regs, const struct libarmvm_memory *mem,
+                      uint64_t step, uint64_t cycles, uint64_t next_event)
+{
+    idle->begin = regs->gpr[ARMV6M_REG_PC];
+    idle->min_addr = UINT32_MAX;
+    idle->max_addr = 0;
+    idle->step = step;
+    idle->cycles = cycles;
+    memcpy(idle->gpr, regs->gpr, sizeof(idle->gpr));
+    idle->psr = regs->psr;
+    idle->control = regs->control;
+    idle->SP_main = regs->SP_main;
+    idle->SP_process = regs->SP_process;
+    idle->volatile_reads = mem->volatile_reads;
+    idle->next_event = next_event;
+}
+
+
+/**
+ * Checks if the observed loop ends with the backward branch at end and has not changed any
+ * register or the memory since the arrival at its first instruction. A loop which read a
+ * peripheral register, that changes with the cycles (e.g. a counter), is not idle: its next
+ * iteration may read another value without any scheduled event. The same applies to an iteration,
+ * during which an event happened: it may have changed a value, after the loop read it.
+ */
+int _ci_idle_detect(struct armvm *armvm, const struct _ci_idle *idle, const struct libarmvm_registers *regs, uint32_t end)
+{
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct libarmvm_memory *mem = armvm->mem->data;
+
+    if (   regs->gpr[ARMV6M_REG_PC] != idle->begin
+        || idle->volatile_reads != mem->volatile_reads
+        || idle->next_event <= ci->cycles
+        || idle->min_addr < idle->begin
+        || idle->max_addr > end
+        || 0 != memcmp(idle->gpr, regs->gpr, sizeof(idle->gpr))
+        || idle->psr != regs->psr
+        || idle->control != regs->control
+        || idle->SP_main != regs->SP_main
+        || idle->SP_process != regs->SP_process) {
+        return 0;
+    }
+
+    // every instruction of the loop body has to be free of side effects
+    struct armv6m_instruction instruction;
+    for (uint32_t addr = idle->begin; addr <= end; addr += instruction.is32Bit ? 4 : 2) {
+        if (armv6m_load_instruction(armvm, addr, &instruction) || !armv6m_is_register_only(&instruction)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * Idle loops can only be skipped if no instrumentation needs to see every step or memory access.
+ * The write log does not prevent it, since an idle loop does not write.
+ */
+int _ci_idle_skippable(struct armvm *armvm)
+{
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct libarmvm_memory *mem = armvm->mem->data;
+
+    if (ci->reference || armvm->ci->step != _step || mem->heatmap) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < mem->observers_size; ++i) {
+        if (mem->observers[i].read) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+
+/**
+ * Skips up to steps steps of the sleeping core (one cycle each), but not beyond the next scheduled
+ * event. If no event is scheduled and a host input is registered, it waits for the host input instead.
+ * The peripherals poll their host inputs after a notification.
+ *
+ * @param skipped Pointer to the destination of the amount of skipped steps.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int _ci_sleep(struct armvm *armvm, uint64_t steps, uint64_t *skipped)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    *skipped = 0;
+    pthread_mutex_lock(&ci->host_lock);
+    while (ci->host_inputs && UINT64_MAX == ci->next_event && !ci->host_notified) {
+        pthread_cond_wait(&ci->host_cond, &ci->host_lock);
+    }
+    const uint8_t notified = ci->host_notified;
+    ci->host_notified = 0;
+    pthread_mutex_unlock(&ci->host_lock);
+
+    if (notified) {
+        return libarmvm_peripherals_poll_host(armvm);
+    }
+
+    uint64_t skip = steps;
+    if (UINT64_MAX != ci->next_event) {
+        const uint64_t cycles = ci->next_event > ci->cycles ? ci->next_event - ci->cycles : 0;
+        if (cycles < skip) {
+            skip = cycles;
+        }
+    }
+    ci->cycles += skip;
+    *skipped = skip;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _ci_run(struct armvm *armvm, uint64_t steps, uint64_t *executed)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct libarmvm_ci *ci = armvm->ci->data;
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    uint64_t step = 0;
+    uint64_t skipped;
+
+    // host inputs, which arrived while the core did not sleep, are noticed once per call
+    ret = libarmvm_peripherals_poll_host(armvm);
+    if (ret) {
+        goto err;
+    }
+
+    if (!_ci_idle_skippable(armvm)) {
+        while (step < steps) {
+            if ((ci->pending & LIBARMVM_CI_PENDING_SLEEP) && !ci->reference) {
+                ret = _ci_sleep(armvm, steps - step, &skipped);
+                if (ret) {
+                    goto err;
+                }
+                step += skipped;
+                if (step == steps) {
+                    break;
+                }
+            }
+
+            ret = armvm->ci->step(armvm);
+            if (ret) {
+                goto err;
+            }
+            step++;
+        }
+        goto err;
+    }
+
+    struct _ci_idle idle;
+    memset(&idle, 0, sizeof(idle));
+    idle.begin = 0x1;
+
+    while (step < steps) {
+        if (ci->pending & LIBARMVM_CI_PENDING_SLEEP) {
+            ret = _ci_sleep(armvm, steps - step, &skipped);
+            if (ret) {
+                goto err;
+            }
+            step += skipped;
+            if (step == steps) {
+                break;
+            }
+        }
+
+        const uint32_t addr = regs->gpr[ARMV6M_REG_PC];
+        ret = _step(armvm);
+        if (ret) {
+            goto err;
+        }
+        step++;
+
+        if (addr < idle.min_addr) {
+            idle.min_addr = addr;
+        }
+        if (addr > idle.max_addr) {
+            idle.max_addr = addr;
+        }
+
+        // only short backward branches can close an idle loop, a sleeping core does not execute anything
+        const uint32_t pc = regs->gpr[ARMV6M_REG_PC];
+        if (pc > addr || addr - pc > CI_IDLE_MAX_LOOP || ci->pending) {
+            continue;
+        }
+
+        if (_ci_idle_detect(armvm, &idle, regs, addr)) {
+            const uint64_t loop_steps = step - idle.step;
+            const uint64_t loop_cycles = ci->cycles - idle.cycles;
+
+            uint64_t loops = (steps - step) / loop_steps;
+            if (UINT64_MAX != ci->next_event) {
+                const uint64_t event_loops = ci->next_event > ci->cycles ? (ci->next_event - ci->cycles) / loop_cycles : 0;
+                if (event_loops < loops) {
+                    loops = event_loops;
+                }
+            }
+
+            step += loops * loop_steps;
+            ci->cycles += loops * loop_cycles;
+        }
+
+        _ci_idle_observe(&idle, regs, armvm->mem->data, step, ci->cycles, ci->next_event);
+    }
+
+err:
+    *executed = step;
+    return ret;
+}
+
+
+int _get_cycles(struct armvm *armvm, uint64_t *cycles)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    *cycles = ci->cycles;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _get_time(struct armvm *armvm, uint64_t *ns)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    *ns = ci->time_base + libarmvm_ci_cycles_to_ns(ci->cycles - ci->time_base_cycles, ci->core_clock);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_ci_wakeup(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    ci->pending &= ~LIBARMVM_CI_PENDING_SLEEP;
+}
+
+
+void libarmvm_ci_raise_exception(struct armvm *armvm, uint32_t exception)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    ci->exception = exception;
+    ci->pending = (ci->pending & ~LIBARMVM_CI_PENDING_SLEEP) | LIBARMVM_CI_PENDING_EXCEPTION;
+}
+
+
+void libarmvm_ci_withdraw_exception(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    ci->pending &= ~LIBARMVM_CI_PENDING_EXCEPTION;
+}
+
+
+void libarmvm_ci_stack_overflow(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    ci->pending |= LIBARMVM_CI_PENDING_STACK_OVERFLOW;
+}
+
+
+int libarmvm_ci_add_host_input(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    pthread_mutex_lock(&ci->host_lock);
+    ci->host_inputs++;
+    pthread_mutex_unlock(&ci->host_lock);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_ci_remove_host_input(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    pthread_mutex_lock(&ci->host_lock);
+    ci->host_inputs--;
+    pthread_cond_signal(&ci->host_cond);
+    pthread_mutex_unlock(&ci->host_lock);
+}
+
+
+void libarmvm_ci_notify_host_input(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    pthread_mutex_lock(&ci->host_lock);
+    ci->host_notified = 1;
+    pthread_cond_signal(&ci->host_cond);
+    pthread_mutex_unlock(&ci->host_lock);
+}
+
+
+int libarmvm_ci_sleeps_forever(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    if (LIBARMVM_CI_PENDING_SLEEP != ci->pending || UINT64_MAX != ci->next_event) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&ci->host_lock);
+    const int forever = !ci->host_inputs && !ci->host_notified;
+    pthread_mutex_unlock(&ci->host_lock);
+
+    return forever;
+}
+
+
+int libarmvm_ci_set_core_clock(struct armvm *armvm, uint64_t core_clock)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    if (!core_clock) {
+        return ARMVM_RET_INVALID_PARAM;
+    }
+
+    _get_time(armvm, &ci->time_base);
+    ci->time_base_cycles = ci->cycles;
+    ci->core_clock = core_clock;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
 int libarmvm_ci_init(struct armvm *armvm)
 {
     int ret = ARMVM_RET_SUCCESS;
@@ -66,6 +548,8 @@ int libarmvm_ci_init(struct armvm *armvm)
     }
     struct libarmvm_ci *ci = armvm->ci->data;
     ci->isa = ARMV6_M;
+    pthread_mutex_init(&ci->host_lock, NULL);
+    pthread_cond_init(&ci->host_cond, NULL);
 
     ci->data = calloc(1, sizeof(struct armv6m));
     if (!ci->data) {
@@ -79,8 +563,93 @@ int libarmvm_ci_init(struct armvm *armvm)
         ret = ARMVM_RET_NO_MEM;
         goto err;
     }
+    if (armvm->opts.profile_file) {
+        ci->profile = calloc(1, sizeof(*ci->profile));
+        if (!ci->profile) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+
+        ret = libarmvm_profile_init(armvm, ci->profile);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    if (armvm->opts.trace_file) {
+        ci->trace = calloc(1, sizeof(*ci->trace));
+        if (!ci->trace) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+
+        ret = libarmvm_trace_init(armvm, ci->trace);
+        if (ret) {
+            free(ci->trace);
+            ci->trace = NULL;
+            goto err;
+        }
+    }
+
+    if (armvm->opts.callgraph_file || armvm->opts.folded_file) {
+        ci->callgraph = calloc(1, sizeof(*ci->callgraph));
+        if (!ci->callgraph) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+
+        ret = libarmvm_callgraph_init(ci->callgraph);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    if (armvm->opts.coverage_file) {
+        ci->coverage = calloc(1, sizeof(*ci->coverage));
+        if (!ci->coverage) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+
+        ret = libarmvm_coverage_init(armvm, ci->coverage);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    if (armvm->opts.hooks_size) {
+        ci->hooks = calloc(1, sizeof(*ci->hooks));
+        if (!ci->hooks) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+
+        ret = libarmvm_hooks_init(armvm, ci->hooks);
+        if (ret) {
+            free(ci->hooks);
+            ci->hooks = NULL;
+            goto err;
+        }
+    }
+
     armvm->ci->reset = _reset;
-    armvm->ci->step = _step;
+    if (   ci->profile
+        || ci->trace
+        || ci->callgraph
+        || ci->coverage
+        || (ci->hooks && libarmvm_hooks_instrument_step(ci->hooks))) {
+        armvm->ci->step = _step_instrumented;
+    } else {
+        armvm->ci->step = _step;
+    }
+    armvm->ci->run = _ci_run;
+    armvm->ci->get_cycles = _get_cycles;
+    armvm->ci->get_time = _get_time;
 
     return ret;
 err:
@@ -91,6 +660,8 @@ err:
 
 int libarmvm_ci_cleanup(struct armvm *armvm)
 {
+    int ret = ARMVM_RET_SUCCESS;
+
     if (armvm->ci) {
         if (armvm->ci->data) {
             struct libarmvm_ci *ci = armvm->ci->data;
@@ -99,11 +670,45 @@ int libarmvm_ci_cleanup(struct armvm *armvm)
                 free(ci->data);
                 ci->data = NULL;
             }
+            if (ci->profile) {
+                libarmvm_profile_cleanup(ci->profile);
+                free(ci->profile);
+                ci->profile = NULL;
+            }
+            if (ci->hooks) {
+                libarmvm_hooks_cleanup(ci->hooks);
+                free(ci->hooks);
+                ci->hooks = NULL;
+            }
+            if (ci->coverage) {
+                libarmvm_coverage_cleanup(ci->coverage);
+                free(ci->coverage);
+                ci->coverage = NULL;
+            }
+            if (ci->semihosting) {
+                libarmvm_semihosting_cleanup(ci->semihosting);
+                free(ci->semihosting);
+                ci->semihosting = NULL;
+            }
+            if (ci->callgraph) {
+                libarmvm_callgraph_cleanup(ci->callgraph);
+                free(ci->callgraph);
+                ci->callgraph = NULL;
+            }
+            if (ci->trace) {
+                if (libarmvm_trace_cleanup(ci->trace)) {
+                    ret = ARMVM_RET_FAIL;
+                }
+                free(ci->trace);
+                ci->trace = NULL;
+            }
+            pthread_cond_destroy(&ci->host_cond);
+            pthread_mutex_destroy(&ci->host_lock);
             free(armvm->ci->data);
             armvm->ci->data = NULL;
         }
         free(armvm->ci);
         armvm->ci = NULL;
     }
-    return ARMVM_RET_SUCCESS;
+    return ret;
 }
@@ -3,10 +3,128 @@
 #define __LIBARMVM_CI_H__
 
 #include <armvm.h>
+#include <libarmvm_profile.h>
+#include <libarmvm_trace.h>
+#include <libarmvm_callgraph.h>
+#include <libarmvm_hooks.h>
+#include <libarmvm_coverage.h>
+#include <libarmvm_semihosting.h>
+#include <pthread.h>
+
+/**
+ * @brief The core sleeps in WFI or WFE until it is woken up (see libarmvm_ci_wakeup()).
+ */
+#define LIBARMVM_CI_PENDING_SLEEP (0x1)
+
+/**
+ * @brief The exception libarmvm_ci.exception is taken before the next instruction (see libarmvm_ci_raise_exception()).
+ */
+#define LIBARMVM_CI_PENDING_EXCEPTION (0x2)
+
+/**
+ * @brief The vm stops with ARMVM_RET_STACK_OVERFLOW before the next instruction (see libarmvm_ci_stack_overflow()).
+ */
+#define LIBARMVM_CI_PENDING_STACK_OVERFLOW (0x4)
 
 struct libarmvm_ci {
     enum armvm_ISA_e isa;
     void *data;
+
+    /**
+     * @brief If set, the control interface executes every step with the plain reference
+     * interpreter and does not take any shortcuts. Is used for the reference instance in
+     * the lockstep mode.
+     */
+    uint8_t reference;
+
+    /**
+     * @brief Amount of core cycles since the last reset.
+     */
+    uint64_t cycles;
+
+    /**
+     * @brief Current frequency of the core clock in Hz.
+     */
+    uint64_t core_clock;
+
+    /**
+     * @brief Simulated time in ns at the last change of core_clock.
+     */
+    uint64_t time_base;
+
+    /**
+     * @brief Value of cycles at the last change of core_clock.
+     */
+    uint64_t time_base_cycles;
+
+    /**
+     * @brief Bitmask of LIBARMVM_CI_PENDING_*, which need to be handled before the next instruction.
+     * It is checked once per step, therefore the execution without any pending work has no
+     * further overhead.
+     */
+    uint32_t pending;
+
+    /**
+     * @brief Number of the exception which is taken, if LIBARMVM_CI_PENDING_EXCEPTION is set.
+     */
+    uint32_t exception;
+
+    /**
+     * @brief Amount of registered inputs which are driven by the host (e.g. a terminal). Is protected by host_lock.
+     * If a sleeping core has no scheduled event, run() waits for one of them instead of
+     * skipping the remaining steps.
+     */
+    size_t host_inputs;
+
+    /**
+     * @brief Is set by libarmvm_ci_notify_host_input() and protected by host_lock.
+     */
+    uint8_t host_notified;
+
+    pthread_mutex_t host_lock;
+    pthread_cond_t host_cond;  /**< Is signaled by libarmvm_ci_notify_host_input(). */
+
+    /**
+     * @brief Value of cycles at which the next scheduled event (e.g. of a timer) happens.
+     * UINT64_MAX if no event is scheduled. Idle loops are fast-forwarded at most up to this value.
+     * Is maintained by the scheduler of the peripherals (see libarmvm_peripherals_schedule()).
+     */
+    uint64_t next_event;
+
+    /**
+     * @brief Execution counters per instruction address. NULL if profiling is disabled.
+     */
+    struct libarmvm_profile *profile;
+
+    /**
+     * @brief Writer of the execution trace. NULL if tracing is disabled.
+     */
+    struct libarmvm_trace *trace;
+
+    /**
+     * @brief Call graph profiler. NULL if the call graph is not tracked.
+     */
+    struct libarmvm_callgraph *callgraph;
+
+    /**
+     * @brief Registered instrumentation hooks. NULL if there are none.
+     */
+    struct libarmvm_hooks *hooks;
+
+    /**
+     * @brief Code coverage. NULL if the coverage is not recorded.
+     */
+    struct libarmvm_coverage *coverage;
+
+    /**
+     * @brief Files of the semihosting. NULL until the program uses the semihosting the first time.
+     */
+    struct libarmvm_semihosting *semihosting;
+
+    /**
+     * @brief Log of the semihosting results, which is shared with the other instance in the lockstep mode. NULL otherwise.
+     */
+    struct libarmvm_semihosting_replay *replay;
 };
 
 
@@ -19,6 +137,95 @@ struct libarmvm_ci {
 int libarmvm_ci_init(struct armvm *armvm);
 
 
+/**
+ * @brief Changes the frequency of the core clock.
+ * The simulated time which passed until now is kept, all following cycles are converted
+ * into simulated time with the new frequency.
+ *
+ * @param core_clock Frequency in Hz.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_ci_set_core_clock(struct armvm *armvm, uint64_t core_clock);
+
+
+/**
+ * @brief Wakes up the core, if it sleeps in WFI or WFE.
+ * Is called by the sources of interrupts and events. Must only be called by the thread
+ * which executes the virtual machine.
+ */
+void libarmvm_ci_wakeup(struct armvm *armvm);
+
+
+/**
+ * @brief Lets the core take an exception before the next instruction. Wakes up the core.
+ * Is called by the interrupt controller (see libarmvm_nvic_update()), which decides which
+ * exception is taken. A previously raised exception, which was not taken yet, is replaced.
+ * Must only be called by the thread which executes the virtual machine.
+ *
+ * @param exception Number of the exception.
+ */
+void libarmvm_ci_raise_exception(struct armvm *armvm, uint32_t exception);
+
+
+/**
+ * @brief Cancels the exception, which was raised by libarmvm_ci_raise_exception() and was not taken yet.
+ * Must only be called by the thread which executes the virtual machine.
+ */
+void libarmvm_ci_withdraw_exception(struct armvm *armvm);
+
+
+/**
+ * @brief Stops the vm with ARMVM_RET_STACK_OVERFLOW before the next instruction.
+ * Is called by the registers, when a stack pointer crosses its guard. The current instruction
+ * is completed. Must only be called by the thread which executes the virtual machine.
+ */
+void libarmvm_ci_stack_overflow(struct armvm *armvm);
+
+
+/**
+ * @brief Registers an input which is driven by the host.
+ * From now on, a sleeping core without a scheduled event waits in run() until
+ * libarmvm_ci_notify_host_input() is called.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_ci_add_host_input(struct armvm *armvm);
+
+
+/**
+ * @brief Unregisters an input which is driven by the host, e.g. because it reached its end.
+ * Can be called from any thread.
+ */
+void libarmvm_ci_remove_host_input(struct armvm *armvm);
+
+
+/**
+ * @brief Signals, that a host input has new data. The peripherals poll their host inputs
+ * (see libarmvm_peripherals_poll_host()) before the next step of a sleeping core or at the
+ * next call of run(). Can be called from any thread.
+ */
+void libarmvm_ci_notify_host_input(struct armvm *armvm);
+
+
+/**
+ * @brief Checks, if the core sleeps in WFI or WFE and nothing can wake it up anymore: no event
+ * is scheduled, no exception is pending and no input is driven by the host.
+ * A run without a limit of steps would skip the idle time forever.
+ *
+ * @return Non-zero, if the core sleeps forever.
+ */
+int libarmvm_ci_sleeps_forever(struct armvm *armvm);
+
+
+/**
+ * @brief Converts cycles into nanoseconds for a clock with the frequency clock in Hz.
+ */
+static inline uint64_t libarmvm_ci_cycles_to_ns(uint64_t cycles, uint64_t clock)
+{
+    return (cycles / clock) * 1000000000 + ((cycles % clock) * 1000000000) / clock;
+}
+
+
 /**
  * @brief Cleans up the control interface.
  *
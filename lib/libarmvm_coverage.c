@@ -0,0 +1,338 @@
+#include <libarmvm_coverage.h>
+#include <libarmvm_memory.h>
+#include <inttypes.h>
+#include <string.h>
+#include <assert.h>
+
+#define COVERAGE_DRCOV_MAX_BLOCK (0xffff)
+
+
+/**
+ * @brief Coverage of one source line or of one conditional branch in a source line.
+ */
+struct _coverage_entry {
+    uint32_t file;
+    uint32_t line;
+    uint32_t addr;      /**< Address of the branch. Is only used for branches. */
+    uint8_t branch;     /**< Set if the entry describes a conditional branch. */
+    uint8_t hit;        /**< Line: one instruction was executed. Branch: the branch was taken. */
+    uint8_t not_taken;  /**< Branch: the branch was not taken. */
+};
+
+
+static inline int _coverage_test(const uint32_t *bitmap, size_t idx)
+{
+    return (bitmap[idx >> 5] >> (idx & 0x1f)) & 0x1;
+}
+
+
+static inline void _coverage_set(uint32_t *bitmap, size_t idx)
+{
+    bitmap[idx >> 5] |= (uint32_t)1 << (idx & 0x1f);
+}
+
+
+int libarmvm_coverage_init(struct armvm *armvm, struct libarmvm_coverage *coverage)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_memory_flash flash;
+
+    memset(coverage, 0, sizeof(*coverage));
+
+    if (libarmvm_memory_get_flash(armvm->mem->data, &flash)) {
+        fprintf(stderr, "ERROR: The memory model has no FLASH region.\n");
+        return ARMVM_RET_FAIL;
+    }
+    coverage->base = flash.base;
+    coverage->size = flash.size;
+    coverage->alias_base = flash.alias_base;
+    coverage->alias_size = flash.alias_size;
+    // an odd address is never reached, therefore the first instruction starts a block
+    coverage->next_addr = 0x1;
+
+    const size_t words = (coverage->size / 2 + 31) / 32;
+    coverage->executed = calloc(words, sizeof(uint32_t));
+    coverage->blocks = calloc(words, sizeof(uint32_t));
+    coverage->taken = calloc(words, sizeof(uint32_t));
+    coverage->not_taken = calloc(words, sizeof(uint32_t));
+    if (!coverage->executed || !coverage->blocks || !coverage->taken || !coverage->not_taken) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        libarmvm_coverage_cleanup(coverage);
+        return ARMVM_RET_NO_MEM;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_coverage_cleanup(struct libarmvm_coverage *coverage)
+{
+    free(coverage->executed);
+    free(coverage->blocks);
+    free(coverage->taken);
+    free(coverage->not_taken);
+    coverage->executed = NULL;
+    coverage->blocks = NULL;
+    coverage->taken = NULL;
+    coverage->not_taken = NULL;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_coverage_step(struct libarmvm_coverage *coverage, const struct armv6m_instruction *instruction, uint32_t pc)
+{
+    const uint32_t addr = instruction->addr;
+    const uint32_t next_addr = coverage->next_addr;
+    coverage->next_addr = addr + (instruction->is32Bit ? 4 : 2);
+
+    uint32_t offset = addr - coverage->base;
+    if (offset >= coverage->size) {
+        offset = addr - coverage->alias_base;
+        if (offset >= coverage->alias_size) {
+            return;
+        }
+    }
+
+    const size_t idx = offset >> 1;
+    _coverage_set(coverage->executed, idx);
+    if (instruction->is32Bit && idx + 1 < coverage->size / 2) {
+        _coverage_set(coverage->executed, idx + 1);
+    }
+
+    if (addr != next_addr) {
+        _coverage_set(coverage->blocks, idx);
+    }
+
+    // B<c> (B_T1): the condition 0b111x encodes UDF and SVC
+    const uint16_t ins = instruction->i._16bit;
+    if (!instruction->is32Bit && (ins >> 12) == 0b1101 && ((ins >> 9) & 0b111) != 0b111) {
+        if (pc == addr + 2) {
+            _coverage_set(coverage->not_taken, idx);
+        } else {
+            _coverage_set(coverage->taken, idx);
+        }
+    }
+}
+
+
+int _coverage_entry_compare(const void *a, const void *b)
+{
+    const struct _coverage_entry *entry_a = a;
+    const struct _coverage_entry *entry_b = b;
+
+    if (entry_a->file != entry_b->file) {
+        return entry_a->file < entry_b->file ? -1 : 1;
+    }
+    if (entry_a->line != entry_b->line) {
+        return entry_a->line < entry_b->line ? -1 : 1;
+    }
+    if (entry_a->branch != entry_b->branch) {
+        return entry_a->branch < entry_b->branch ? -1 : 1;
+    }
+    if (entry_a->addr != entry_b->addr) {
+        return entry_a->addr < entry_b->addr ? -1 : 1;
+    }
+    return 0;
+}
+
+
+int _coverage_add_entry(struct _coverage_entry **entries, size_t *entries_size, size_t *capacity, const struct _coverage_entry *entry)
+{
+    if (*entries_size == *capacity) {
+        size_t new_capacity = *capacity ? 2 * *capacity : 1024;
+        struct _coverage_entry *new_entries = realloc(*entries, new_capacity * sizeof(*new_entries));
+        if (!new_entries) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return ARMVM_RET_NO_MEM;
+        }
+        *entries = new_entries;
+        *capacity = new_capacity;
+    }
+    (*entries)[(*entries_size)++] = *entry;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Creates one entry for every row of the line table, which covers a part of the
+ * FLASH region, and one entry for every executed conditional branch.
+ */
+int _coverage_collect_entries(const struct libarmvm_coverage *coverage, const struct libarmvm_symbols *symbols, struct _coverage_entry **entries, size_t *entries_size)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    size_t capacity = 0;
+
+    *entries = NULL;
+    *entries_size = 0;
+
+    for (size_t i = 0; i + 1 < symbols->lines_size; ++i) {
+        const struct libarmvm_line *row = &symbols->lines[i];
+        if (row->end) {
+            continue;
+        }
+
+        const uint32_t begin = row->addr - coverage->base;
+        uint32_t end = symbols->lines[i + 1].addr - coverage->base;
+        if (begin >= coverage->size || end <= begin) {
+            continue;
+        }
+        if (end > coverage->size) {
+            end = coverage->size;
+        }
+
+        struct _coverage_entry entry = { row->file, row->line, 0, 0, 0, 0 };
+        for (size_t idx = begin >> 1; idx < (end + 1) >> 1; ++idx) {
+            if (!_coverage_test(coverage->executed, idx)) {
+                continue;
+            }
+            entry.hit = 1;
+
+            if (_coverage_test(coverage->taken, idx) || _coverage_test(coverage->not_taken, idx)) {
+                const struct _coverage_entry branch = {
+                    row->file, row->line, coverage->base + 2 * (uint32_t)idx, 1,
+                    _coverage_test(coverage->taken, idx), _coverage_test(coverage->not_taken, idx)
+                };
+                ret = _coverage_add_entry(entries, entries_size, &capacity, &branch);
+                if (ret) {
+                    goto err;
+                }
+            }
+        }
+
+        ret = _coverage_add_entry(entries, entries_size, &capacity, &entry);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    qsort(*entries, *entries_size, sizeof(**entries), _coverage_entry_compare);
+
+    return ret;
+err:
+    free(*entries);
+    *entries = NULL;
+    *entries_size = 0;
+    return ret;
+}
+
+
+int libarmvm_coverage_lcov(const struct libarmvm_coverage *coverage, const struct libarmvm_symbols *symbols, FILE *out)
+{
+    struct _coverage_entry *entries;
+    size_t entries_size;
+
+    if (!symbols->lines_size) {
+        fprintf(stderr, "ERROR: The program has no line table. Compile it with debug information (-g).\n");
+        return ARMVM_RET_FAIL;
+    }
+
+    int ret = _coverage_collect_entries(coverage, symbols, &entries, &entries_size);
+    if (ret) {
+        return ret;
+    }
+
+    fprintf(out, "TN:\n");
+
+    size_t i = 0;
+    while (i < entries_size) {
+        const uint32_t file = entries[i].file;
+        size_t lines_found = 0;
+        size_t lines_hit = 0;
+        size_t branches_found = 0;
+        size_t branches_hit = 0;
+
+        fprintf(out, "SF:%s\n", symbols->files[file]);
+
+        while (i < entries_size && entries[i].file == file) {
+            const uint32_t line = entries[i].line;
+            uint8_t hit = 0;
+            size_t block = 0;
+
+            // the line entries are sorted before the branches of the same line
+            for (; i < entries_size && entries[i].file == file && entries[i].line == line && !entries[i].branch; ++i) {
+                hit |= entries[i].hit;
+            }
+            fprintf(out, "DA:%u,%u\n", line, hit);
+            lines_found++;
+            lines_hit += hit;
+
+            for (; i < entries_size && entries[i].file == file && entries[i].line == line; ++i, ++block) {
+                fprintf(out, "BRDA:%u,%zu,0,%u\n", line, block, entries[i].hit);
+                fprintf(out, "BRDA:%u,%zu,1,%u\n", line, block, entries[i].not_taken);
+                branches_found += 2;
+                branches_hit += entries[i].hit + entries[i].not_taken;
+            }
+        }
+
+        if (branches_found) {
+            fprintf(out, "BRF:%zu\n", branches_found);
+            fprintf(out, "BRH:%zu\n", branches_hit);
+        }
+        fprintf(out, "LF:%zu\n", lines_found);
+        fprintf(out, "LH:%zu\n", lines_hit);
+        fprintf(out, "end_of_record\n");
+    }
+
+    free(entries);
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_coverage_drcov(const struct libarmvm_coverage *coverage, const char *module, FILE *out)
+{
+    const size_t halfwords = coverage->size / 2;
+    size_t blocks_size = 0;
+
+    // a block starts at a block start or after a not executed halfword and ends before the next one
+    for (int write = 0; write < 2; ++write) {
+        if (write) {
+            fprintf(out, "DRCOV VERSION: 2\n");
+            fprintf(out, "DRCOV FLAVOR: drcov\n");
+            fprintf(out, "Module Table: version 2, count 1\n");
+            fprintf(out, "Columns: id, base, end, entry, path\n");
+            fprintf(out, "  0, 0x%08x, 0x%08x, 0x%08x, %s\n", coverage->base, coverage->base + coverage->size, 0, module);
+            fprintf(out, "BB Table: %zu bbs\n", blocks_size);
+        }
+
+        size_t idx = 0;
+        while (idx < halfwords) {
+            if (!_coverage_test(coverage->executed, idx)) {
+                ++idx;
+                continue;
+            }
+
+            size_t start = idx++;
+            while (   idx < halfwords
+                   && idx - start < COVERAGE_DRCOV_MAX_BLOCK / 2
+                   && _coverage_test(coverage->executed, idx)
+                   && !_coverage_test(coverage->blocks, idx)) {
+                ++idx;
+            }
+
+            if (!write) {
+                blocks_size++;
+                continue;
+            }
+
+            // struct { uint32_t start; uint16_t size; uint16_t id; } in little endian
+            const uint32_t offset = 2 * start;
+            const uint16_t size = 2 * (idx - start);
+            const uint8_t record[8] = {
+                offset & 0xff, (offset >> 8) & 0xff, (offset >> 16) & 0xff, offset >> 24,
+                size & 0xff, size >> 8,
+                0, 0
+            };
+            if (1 != fwrite(record, sizeof(record), 1, out)) {
+                fprintf(stderr, "ERROR: Could not write the coverage.\n");
+                return ARMVM_RET_FAIL;
+            }
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/** @file */
+#ifndef __LIBARMVM_COVERAGE_H__
+#define __LIBARMVM_COVERAGE_H__
+
+#include <armvm.h>
+#include <stdio.h>
+#include <isa/armv6_m.h>
+#include <libarmvm_symbols.h>
+
+/**
+ * @brief Code coverage of the FLASH region.
+ * Every bitmap holds one bit per halfword of the FLASH region. Instructions outside of the
+ * FLASH region are not recorded.
+ */
+struct libarmvm_coverage {
+    uint32_t base;        /**< First address of the FLASH region. */
+    uint32_t size;        /**< Size of the FLASH region in bytes. */
+    uint32_t alias_base;  /**< First address of the region which is remapped to the FLASH region. */
+    uint32_t alias_size;  /**< Size of the region which is remapped to the FLASH region. 0 if there is none. */
+
+    uint32_t *executed;   /**< Halfwords which belong to an executed instruction. */
+    uint32_t *blocks;     /**< Executed instructions which were reached by a branch, an exception or the reset. */
+    uint32_t *taken;      /**< Conditional branches (B<c>) which were taken at least once. */
+    uint32_t *not_taken;  /**< Conditional branches (B<c>) which were not taken at least once. */
+
+    uint32_t next_addr;   /**< Address of the next instruction if no branch is taken. */
+};
+
+
+/**
+ * @brief Initializes the coverage for the FLASH region of armvm->mem.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_coverage_init(struct armvm *armvm, struct libarmvm_coverage *coverage);
+
+
+/**
+ * @brief Frees all memory allocated by libarmvm_coverage_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_coverage_cleanup(struct libarmvm_coverage *coverage);
+
+
+/**
+ * @brief Marks one instruction as executed. Has to be called after the instruction was executed.
+ *
+ * @param pc Address of the next instruction.
+ */
+void libarmvm_coverage_step(struct libarmvm_coverage *coverage, const struct armv6m_instruction *instruction, uint32_t pc);
+
+
+/**
+ * @brief Writes the coverage in the lcov tracefile format.
+ * The executed addresses are mapped to source lines with the DWARF line table of symbols.
+ * Branch data is written for every executed conditional branch.
+ *
+ * @param symbols Symbols and line table of the program.
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_coverage_lcov(const struct libarmvm_coverage *coverage, const struct libarmvm_symbols *symbols, FILE *out);
+
+
+/**
+ * @brief Writes the executed basic blocks in the drcov format (version 2).
+ * The FLASH region is the only module of the table.
+ *
+ * @param module Path of the module which is written into the module table.
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_coverage_drcov(const struct libarmvm_coverage *coverage, const char *module, FILE *out);
+
+#endif
@@ -0,0 +1,241 @@
+#include <libarmvm_crc.h>
+#include <libarmvm_memory.h>
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers.
+ */
+#define CRC_DR   (0x00)
+#define CRC_IDR  (0x04)
+#define CRC_CR   (0x08)
+#define CRC_INIT (0x10)
+#define CRC_POL  (0x14)
+
+#define CRC_CR_RESET          (0x1 << 0)
+#define CRC_CR_POLYSIZE_SHIFT (3)
+#define CRC_CR_REV_IN_SHIFT   (5)
+#define CRC_CR_REV_OUT        (0x1 << 7)
+#define CRC_CR_WRITABLE       (0xf8)
+
+
+/**
+ * @brief Returns the amount of bits, by which the CRC is shifted to be aligned to bit 31 (32 - size of the polynomial).
+ */
+static inline uint32_t _crc_shift(uint32_t cr)
+{
+    static const uint32_t shift[] = { 0, 16, 24, 25 };
+    return shift[(cr >> CRC_CR_POLYSIZE_SHIFT) & 0x3];
+}
+
+
+static inline uint32_t _crc_reverse(uint32_t value)
+{
+    value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+    value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+    value = ((value >> 4) & 0x0f0f0f0f) | ((value & 0x0f0f0f0f) << 4);
+    return __builtin_bswap32(value);
+}
+
+
+/**
+ * @brief Builds the tables of the polynomial and its size.
+ */
+void _crc_tables(struct libarmvm_crc *crc)
+{
+    const uint32_t shift = _crc_shift(crc->cr);
+    const uint32_t poly = crc->pol << shift;
+
+    for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t value = b << 24;
+        for (int i = 0; i < 8; ++i) {
+            value = (value & 0x80000000) ? (value << 1) ^ poly : value << 1;
+        }
+        crc->table[0][b] = value;
+    }
+    for (int i = 1; i < 8; ++i) {
+        for (uint32_t b = 0; b < 256; ++b) {
+            const uint32_t value = crc->table[i - 1][b];
+            crc->table[i][b] = (value << 8) ^ crc->table[0][value >> 24];
+        }
+    }
+}
+
+
+/**
+ * @brief Returns the written data of size bytes with the bit order of REV_IN.
+ * The bits are reversed per byte, per halfword or per word, but at most per written value.
+ */
+static inline uint32_t _crc_input(uint32_t cr, uint32_t value, uint8_t size)
+{
+    static const uint8_t granule[] = { 0, 1, 2, 4 };
+    uint8_t bytes = granule[(cr >> CRC_CR_REV_IN_SHIFT) & 0x3];
+
+    if (!bytes) {
+        return value;
+    }
+    if (bytes >= size) {
+        return _crc_reverse(value) >> (32 - 8 * size);
+    }
+    if (1 == bytes) {
+        return __builtin_bswap32(_crc_reverse(value));
+    }
+    // halfwords of a word
+    const uint32_t reversed = _crc_reverse(value);
+    return (reversed >> 16) | (reversed << 16);
+}
+
+
+/**
+ * @brief Returns the aligned CRC after the data of size bytes, one table step per byte.
+ */
+static inline uint32_t _crc_feed(const struct libarmvm_crc *crc, uint32_t value, uint32_t data, uint8_t size)
+{
+    switch (size) {
+        case 1:
+            value ^= data << 24;
+            return (value << 8) ^ crc->table[0][value >> 24];
+        case 2:
+            value ^= data << 16;
+            return (value << 16) ^ crc->table[1][value >> 24] ^ crc->table[0][(value >> 16) & 0xff];
+        default:
+            value ^= data;
+            return   crc->table[3][value >> 24] ^ crc->table[2][(value >> 16) & 0xff]
+                   ^ crc->table[1][(value >> 8) & 0xff] ^ crc->table[0][value & 0xff];
+    }
+}
+
+
+int _crc_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    const struct libarmvm_crc *crc = data;
+    uint32_t word = 0;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case CRC_DR:
+            word = (crc->cr & CRC_CR_REV_OUT) ? _crc_reverse(crc->dr) >> _crc_shift(crc->cr) : crc->dr;
+            break;
+        case CRC_IDR:
+            word = crc->idr;
+            break;
+        case CRC_CR:
+            word = crc->cr;
+            break;
+        case CRC_INIT:
+            word = crc->init;
+            break;
+        case CRC_POL:
+            word = crc->pol;
+            break;
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _crc_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_crc *crc = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+
+    if (CRC_DR == (offset & ~(uint32_t)0x3)) {
+        // the written bytes are the data, regardless of their address in the register
+        const uint32_t crc_shift = _crc_shift(crc->cr);
+        crc->dr = _crc_feed(crc, crc->dr << crc_shift, _crc_input(crc->cr, value, size), size) >> crc_shift;
+        return ARMVM_RET_SUCCESS;
+    }
+
+    value <<= shift;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case CRC_IDR:
+            crc->idr = ((crc->idr & ~mask) | (value & mask)) & 0xff;
+            break;
+        case CRC_CR:
+            {
+                const uint32_t cr = ((crc->cr & ~mask) | (value & mask)) & CRC_CR_WRITABLE;
+                const uint32_t polysize = (cr ^ crc->cr) & (0x3 << CRC_CR_POLYSIZE_SHIFT);
+                crc->cr = cr;
+                if (polysize) {
+                    _crc_tables(crc);
+                    crc->dr &= 0xffffffff >> _crc_shift(cr);
+                }
+                if (value & mask & CRC_CR_RESET) {
+                    crc->dr = crc->init & (0xffffffff >> _crc_shift(cr));
+                }
+            }
+            break;
+        case CRC_INIT:
+            crc->init = (crc->init & ~mask) | (value & mask);
+            break;
+        case CRC_POL:
+            crc->pol = (crc->pol & ~mask) | (value & mask);
+            _crc_tables(crc);
+            break;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Processes consecutive words of the data register 8 bytes per step (slicing-by-8).
+ */
+int _crc_write_fifo(void *data, uint32_t offset, uint8_t size, const uint32_t *values, size_t count)
+{
+    struct libarmvm_crc *crc = data;
+
+    if (CRC_DR != offset || 4 != size) {
+        for (size_t i = 0; i < count; ++i) {
+            _crc_write(crc, offset, size, values[i]);
+        }
+        return ARMVM_RET_SUCCESS;
+    }
+
+    const uint32_t shift = _crc_shift(crc->cr);
+    uint32_t value = crc->dr << shift;
+    size_t i = 0;
+
+    for (; i + 1 < count; i += 2) {
+        const uint32_t first = value ^ _crc_input(crc->cr, values[i], 4);
+        const uint32_t second = _crc_input(crc->cr, values[i + 1], 4);
+        value =   crc->table[7][first >> 24] ^ crc->table[6][(first >> 16) & 0xff]
+                ^ crc->table[5][(first >> 8) & 0xff] ^ crc->table[4][first & 0xff]
+                ^ crc->table[3][second >> 24] ^ crc->table[2][(second >> 16) & 0xff]
+                ^ crc->table[1][(second >> 8) & 0xff] ^ crc->table[0][second & 0xff];
+    }
+    if (i < count) {
+        value = _crc_feed(crc, value, _crc_input(crc->cr, values[i], 4), 4);
+    }
+
+    crc->dr = value >> shift;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_crc_init(struct armvm *armvm, struct libarmvm_crc *crc)
+{
+    assert(armvm);
+
+    memset(crc, 0, sizeof(*crc));
+    crc->armvm = armvm;
+    libarmvm_crc_reset(crc);
+
+    const struct libarmvm_memory_peripheral periph = { _crc_read, _crc_write, crc, _crc_write_fifo };
+    return libarmvm_memory_add_peripheral(armvm, LIBARMVM_CRC_BASE_ADDR, LIBARMVM_CRC_SIZE, &periph);
+}
+
+
+void libarmvm_crc_reset(struct libarmvm_crc *crc)
+{
+    crc->dr = 0xffffffff;
+    crc->idr = 0;
+    crc->cr = 0;
+    crc->init = 0xffffffff;
+    crc->pol = LIBARMVM_CRC_POLYNOMIAL;
+    _crc_tables(crc);
+}
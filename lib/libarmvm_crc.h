@@ -0,0 +1,56 @@
+/** @file */
+#ifndef __LIBARMVM_CRC_H__
+#define __LIBARMVM_CRC_H__
+
+#include <armvm.h>
+
+/**
+ * @brief First address of the CRC calculation unit of the STM32F0.
+ */
+#define LIBARMVM_CRC_BASE_ADDR (0x40023000)
+#define LIBARMVM_CRC_SIZE      (0x400)
+
+/**
+ * @brief Polynomial of the CRC after the reset (CRC-32 of Ethernet).
+ */
+#define LIBARMVM_CRC_POLYNOMIAL (0x04c11db7)
+
+
+/**
+ * @brief CRC calculation unit with the register layout of the STM32F0 (programmable polynomial of 7, 8, 16
+ * or 32 bits, reversal of the input and output data).
+ * The CRC is computed with slicing-by-8 tables of the polynomial, which are built, when the polynomial or its
+ * size is written. A write of the data register processes its 1, 2 or 4 bytes with one table step per byte,
+ * consecutive words of the DMA are processed 8 bytes per step (see libarmvm_memory_write_fifo()).
+ * A CRC with less than 32 bits is computed aligned to the most significant bit of the tables.
+ */
+struct libarmvm_crc {
+    struct armvm *armvm;
+
+    uint32_t dr;    /**< Current CRC in the low bits of the polynomial size. */
+    uint32_t idr;
+    uint32_t cr;
+    uint32_t init;
+    uint32_t pol;
+
+    /**
+     * @brief The CRC of a byte b followed by i zero bytes is table[i][b] (aligned to bit 31).
+     */
+    uint32_t table[8][256];
+};
+
+
+/**
+ * @brief Initializes the CRC calculation unit and maps its registers to LIBARMVM_CRC_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_crc_init(struct armvm *armvm, struct libarmvm_crc *crc);
+
+
+/**
+ * @brief Resets the registers and the tables to LIBARMVM_CRC_POLYNOMIAL.
+ */
+void libarmvm_crc_reset(struct libarmvm_crc *crc);
+
+#endif
@@ -0,0 +1,670 @@
+#include <libarmvm_dma.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers to LIBARMVM_DMA_BASE_ADDR. The registers of the channel n start at DMA_CCR + n * DMA_CHANNEL_SIZE.
+ */
+#define DMA_ISR   (0x00)
+#define DMA_IFCR  (0x04)
+#define DMA_CCR   (0x08)
+#define DMA_CNDTR (0x0c)
+#define DMA_CPAR  (0x10)
+#define DMA_CMAR  (0x14)
+
+#define DMA_CHANNEL_SIZE (0x14)
+
+#define DMA_CCR_EN      (0x1 << 0)
+#define DMA_CCR_TCIE    (0x1 << 1)
+#define DMA_CCR_HTIE    (0x1 << 2)
+#define DMA_CCR_TEIE    (0x1 << 3)
+#define DMA_CCR_DIR     (0x1 << 4)
+#define DMA_CCR_CIRC    (0x1 << 5)
+#define DMA_CCR_PINC    (0x1 << 6)
+#define DMA_CCR_MINC    (0x1 << 7)
+#define DMA_CCR_PSIZE_SHIFT (8)
+#define DMA_CCR_MSIZE_SHIFT (10)
+#define DMA_CCR_MEM2MEM (0x1 << 14)
+#define DMA_CCR_MASK    (0x7fff)
+
+/*
+ * Flags of a channel in ISR, shifted by 4 * channel. TCIF, HTIF and TEIF have the same positions as their enable bits in CCR.
+ */
+#define DMA_ISR_GIF  (0x1 << 0)
+#define DMA_ISR_TCIF (0x1 << 1)
+#define DMA_ISR_HTIF (0x1 << 2)
+#define DMA_ISR_TEIF (0x1 << 3)
+#define DMA_ISR_IRQ_FLAGS (DMA_ISR_TCIF | DMA_ISR_HTIF | DMA_ISR_TEIF)
+
+/**
+ * @brief Amount of elements, which are copied through the buffer on the stack at once.
+ */
+#define DMA_CHUNK (1024)
+
+
+static inline uint64_t _dma_cycles(const struct libarmvm_dma *dma)
+{
+    return ((const struct libarmvm_ci *)dma->armvm->ci->data)->cycles;
+}
+
+
+static inline struct libarmvm_dma_channel *_dma_channel(struct armvm *armvm, uint32_t channel)
+{
+    assert(channel < LIBARMVM_DMA_CHANNELS);
+    return &((struct libarmvm_peripherals *)armvm->periph->data)->dma.channel[channel];
+}
+
+
+/**
+ * @brief Returns the size of an element in bytes (PSIZE or MSIZE). The reserved size is a word.
+ */
+static inline uint32_t _dma_size(uint32_t ccr, unsigned shift)
+{
+    static const uint32_t sizes[] = { 1, 2, 4, 4 };
+    return sizes[(ccr >> shift) & 0x3];
+}
+
+
+static inline uint32_t _dma_mask(uint32_t size)
+{
+    return 4 == size ? 0xffffffff : ((uint32_t)1 << (8 * size)) - 1;
+}
+
+
+/**
+ * @brief Reads count elements of size bytes, which start with the element idx at addr.
+ * Consecutive elements are read as one block, the elements of a fixed address (e.g. a register) one by one.
+ */
+int _dma_read_elements(struct armvm *armvm, uint32_t addr, uint32_t size, int inc, uint32_t idx, uint32_t *values, uint32_t count)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    if (!inc) {
+        for (uint32_t i = 0; i < count && !ret; ++i) {
+            uint8_t byte;
+            uint16_t halfword;
+            switch (size) {
+                case 1:
+                    ret = armvm->mem->read_byte(armvm->mem->data, addr, &byte);
+                    values[i] = byte;
+                    break;
+                case 2:
+                    ret = armvm->mem->read_halfword(armvm->mem->data, addr, &halfword);
+                    values[i] = halfword;
+                    break;
+                default:
+                    ret = armvm->mem->read_word(armvm->mem->data, addr, &values[i]);
+                    break;
+            }
+        }
+        return ret;
+    }
+
+    uint8_t bytes[DMA_CHUNK * 4];
+    addr += idx * size;
+    for (uint32_t done = 0; done < count; ) {
+        const uint32_t n = count - done < DMA_CHUNK ? count - done : DMA_CHUNK;
+        ret = libarmvm_memory_read_bytes(armvm, addr, bytes, n * size);
+        if (ret) {
+            return ret;
+        }
+        for (uint32_t i = 0; i < n; ++i) {
+            uint32_t value = 0;
+            for (uint32_t j = 0; j < size; ++j) {
+                value |= (uint32_t)bytes[i * size + j] << (8 * j);
+            }
+            values[done + i] = value;
+        }
+        addr += n * size;
+        done += n;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Writes count elements of size bytes, which start with the element idx at addr.
+ * Like _dma_read_elements(), consecutive elements are written as one block. The elements of a fixed
+ * address are passed to the peripheral at once (see libarmvm_memory_write_fifo()).
+ */
+int _dma_write_elements(struct armvm *armvm, uint32_t addr, uint32_t size, int inc, uint32_t idx, const uint32_t *values, uint32_t count)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    if (!inc) {
+        return libarmvm_memory_write_fifo(armvm, addr, size, values, count);
+    }
+
+    uint8_t bytes[DMA_CHUNK * 4];
+    addr += idx * size;
+    for (uint32_t done = 0; done < count; ) {
+        const uint32_t n = count - done < DMA_CHUNK ? count - done : DMA_CHUNK;
+        for (uint32_t i = 0; i < n; ++i) {
+            for (uint32_t j = 0; j < size; ++j) {
+                bytes[i * size + j] = values[done + i] >> (8 * j);
+            }
+        }
+        ret = libarmvm_memory_write_bytes(armvm, addr, bytes, n * size);
+        if (ret) {
+            return ret;
+        }
+        addr += n * size;
+        done += n;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Returns the amount of elements of the block, which are transferred at cycles.
+ */
+uint32_t _dma_completed(const struct libarmvm_dma_channel *ch, uint64_t cycles)
+{
+    if (!ch->count || cycles < ch->start) {
+        return 0;
+    }
+    if (!ch->cycles_per_element) {
+        return ch->count;
+    }
+
+    const uint64_t done = (cycles - ch->start) / ch->cycles_per_element;
+    return done < ch->count ? done + 1 : ch->count;
+}
+
+
+/**
+ * @brief Returns the amount of elements after which the half transfer flag is set.
+ */
+static inline uint32_t _dma_half(const struct libarmvm_dma_channel *ch)
+{
+    return (ch->reload + 1) / 2;
+}
+
+
+/**
+ * @brief Sets the flags of the elements of the block, which were transferred until cycles.
+ * The elements are numbered from the start of the buffer on, so the transfer is complete at every
+ * multiple of reload and half complete at every multiple plus the half.
+ */
+void _dma_advance(struct libarmvm_dma_channel *ch, uint64_t cycles)
+{
+    const uint32_t done = _dma_completed(ch, cycles);
+
+    if (done <= ch->seen) {
+        return;
+    }
+
+    const uint64_t reload = ch->reload;
+    const uint64_t half = _dma_half(ch);
+    const uint64_t from = (uint64_t)ch->first + ch->seen;
+    const uint64_t to = (uint64_t)ch->first + done;
+    uint32_t flags = 0;
+
+    if (to / reload > from / reload) {
+        flags |= DMA_ISR_TCIF;
+    }
+    if ((to + reload - half) / reload > (from + reload - half) / reload) {
+        flags |= DMA_ISR_HTIF;
+    }
+    if (flags) {
+        ch->dma->isr |= (flags | DMA_ISR_GIF) << (4 * ch->idx);
+    }
+    ch->seen = done;
+}
+
+
+/**
+ * @brief Returns the current value of CNDTR. The channel has to be advanced to the current cycle.
+ */
+uint32_t _dma_cndtr(const struct libarmvm_dma_channel *ch)
+{
+    if (!(ch->ccr & DMA_CCR_EN) || !ch->reload) {
+        return ch->cndtr;
+    }
+
+    const uint64_t pos = (uint64_t)ch->first + ch->seen;
+    if (ch->ccr & DMA_CCR_CIRC) {
+        return ch->reload - pos % ch->reload;
+    }
+    return ch->reload - pos;
+}
+
+
+/**
+ * @brief Pends the interrupt, if one of the enabled flags of the channel is set.
+ */
+void _dma_update_irq(struct libarmvm_dma_channel *ch)
+{
+    if ((ch->dma->isr >> (4 * ch->idx)) & ch->ccr & DMA_ISR_IRQ_FLAGS) {
+        libarmvm_nvic_set_pending(ch->dma->armvm, ARMV6M_EXCEPTION_IRQ0 + ch->irq);
+    }
+}
+
+
+/**
+ * @brief Schedules the next element of the block, which completes the transfer or half of it, if its flag
+ * is clear or its interrupt is enabled. A flag is set, even if its interrupt is disabled. Therefore, ISR only
+ * changes at the events and a loop, which polls it, is not skipped beyond the change (see _dma_time_invariant()).
+ */
+int _dma_schedule(struct libarmvm_dma_channel *ch)
+{
+    struct armvm *armvm = ch->dma->armvm;
+    const uint64_t reload = ch->reload;
+    const uint64_t pos = (uint64_t)ch->first + ch->seen;
+    const uint32_t watched = ch->ccr | ~(ch->dma->isr >> (4 * ch->idx));
+    uint64_t next = UINT64_MAX;
+
+    if ((ch->ccr & DMA_CCR_EN) && ch->seen < ch->count) {
+        if (watched & DMA_ISR_TCIF) {
+            next = (pos / reload + 1) * reload;
+        }
+        if (watched & DMA_ISR_HTIF) {
+            const uint64_t ticks = (_dma_half(ch) + reload - pos % reload) % reload;
+            const uint64_t half = pos + (ticks ? ticks : reload);
+            next = half < next ? half : next;
+        }
+    }
+
+    if (UINT64_MAX == next || next - ch->first > ch->count) {
+        libarmvm_peripherals_cancel(armvm, &ch->event);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    return libarmvm_peripherals_schedule(armvm, &ch->event, ch->start + (next - ch->first - 1) * ch->cycles_per_element);
+}
+
+
+int _dma_event(struct armvm *armvm, void *data)
+{
+    struct libarmvm_dma_channel *ch = data;
+
+    _dma_advance(ch, _dma_cycles(ch->dma));
+    _dma_update_irq(ch);
+
+    return _dma_schedule(ch);
+}
+
+
+/**
+ * @brief Adds count elements to the time line of the channel. They continue the current block,
+ * if it is still transferring with the same rate. Otherwise, they start a new block at start.
+ */
+void _dma_block(struct libarmvm_dma_channel *ch, uint64_t start, uint64_t cycles_per_element, uint32_t count)
+{
+    _dma_advance(ch, _dma_cycles(ch->dma));
+
+    if (   ch->seen < ch->count
+        && ch->cycles_per_element == cycles_per_element
+        && start <= ch->start + ch->count * cycles_per_element) {
+        ch->count += count;
+        return;
+    }
+
+    // the elements of the previous block, which are still due, are completed at once
+    _dma_advance(ch, UINT64_MAX);
+
+    ch->first += ch->count;
+    if (ch->ccr & DMA_CCR_CIRC) {
+        ch->first %= ch->reload;
+    }
+    ch->start = start;
+    ch->cycles_per_element = cycles_per_element;
+    ch->count = count;
+    ch->seen = 0;
+}
+
+
+/**
+ * @brief Stops the channel after a bus error.
+ */
+void _dma_error(struct libarmvm_dma_channel *ch)
+{
+    _dma_advance(ch, _dma_cycles(ch->dma));
+    ch->cndtr = _dma_cndtr(ch);
+    ch->ccr &= ~DMA_CCR_EN;
+    ch->count = 0;
+    ch->dma->isr |= (DMA_ISR_TEIF | DMA_ISR_GIF) << (4 * ch->idx);
+    _dma_update_irq(ch);
+}
+
+
+/**
+ * @brief Copies all elements of a memory-to-memory transfer at once.
+ * The elements are completed one per LIBARMVM_DMA_CYCLES from now on.
+ */
+int _dma_mem2mem(struct libarmvm_dma_channel *ch)
+{
+    struct armvm *armvm = ch->dma->armvm;
+    const uint32_t psize = _dma_size(ch->ccr, DMA_CCR_PSIZE_SHIFT);
+    const uint32_t msize = _dma_size(ch->ccr, DMA_CCR_MSIZE_SHIFT);
+    const int pinc = !!(ch->ccr & DMA_CCR_PINC);
+    const int minc = !!(ch->ccr & DMA_CCR_MINC);
+    uint32_t values[DMA_CHUNK];
+    int ret = ARMVM_RET_SUCCESS;
+
+    // DIR selects the source like in the other modes
+    for (uint32_t done = 0; done < ch->reload && !ret; ) {
+        const uint32_t n = ch->reload - done < DMA_CHUNK ? ch->reload - done : DMA_CHUNK;
+        if (ch->ccr & DMA_CCR_DIR) {
+            ret = _dma_read_elements(armvm, ch->cmar, msize, minc, done, values, n);
+            for (uint32_t i = 0; i < n; ++i) {
+                values[i] &= _dma_mask(msize);
+            }
+            ret = ret ? ret : _dma_write_elements(armvm, ch->cpar, psize, pinc, done, values, n);
+        } else {
+            ret = _dma_read_elements(armvm, ch->cpar, psize, pinc, done, values, n);
+            for (uint32_t i = 0; i < n; ++i) {
+                values[i] &= _dma_mask(psize);
+            }
+            ret = ret ? ret : _dma_write_elements(armvm, ch->cmar, msize, minc, done, values, n);
+        }
+        done += n;
+    }
+
+    if (ret) {
+        _dma_error(ch);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    ch->next = ch->reload;
+    _dma_block(ch, _dma_cycles(ch->dma) + LIBARMVM_DMA_CYCLES, LIBARMVM_DMA_CYCLES, ch->reload);
+    return _dma_schedule(ch);
+}
+
+
+/**
+ * @brief Starts the channel with the programmed CNDTR.
+ */
+int _dma_enable(struct libarmvm_dma_channel *ch)
+{
+    ch->reload = ch->cndtr;
+    ch->next = 0;
+    ch->first = 0;
+    ch->count = 0;
+    ch->seen = 0;
+
+    if (!ch->reload) {
+        return ARMVM_RET_SUCCESS;
+    }
+    if (ch->ccr & DMA_CCR_MEM2MEM) {
+        return _dma_mem2mem(ch);
+    }
+    if (ch->request) {
+        return ch->request(ch->request_data);
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Transfers the elements of a peripheral between the memory and values.
+ * The buffer of the circular mode is copied in pieces, which end at its end.
+ */
+int _dma_transfer(struct libarmvm_dma_channel *ch, uint32_t *values, uint32_t count, uint64_t cycles_per_element, uint32_t dir)
+{
+    struct armvm *armvm = ch->dma->armvm;
+    const uint32_t pmask = _dma_mask(_dma_size(ch->ccr, DMA_CCR_PSIZE_SHIFT));
+    const uint32_t msize = _dma_size(ch->ccr, DMA_CCR_MSIZE_SHIFT);
+    const int minc = !!(ch->ccr & DMA_CCR_MINC);
+
+    const uint32_t capacity = libarmvm_dma_capacity(armvm, ch->idx, dir);
+    if (count > capacity) {
+        count = capacity;
+    }
+
+    for (uint32_t done = 0; done < count; ) {
+        const uint32_t n = count - done < ch->reload - ch->next ? count - done : ch->reload - ch->next;
+        int ret;
+
+        if (LIBARMVM_DMA_TO_MEMORY == dir) {
+            ret = _dma_write_elements(armvm, ch->cmar, msize, minc, ch->next, values + done, n);
+        } else {
+            ret = _dma_read_elements(armvm, ch->cmar, msize, minc, ch->next, values + done, n);
+            for (uint32_t i = 0; i < n; ++i) {
+                values[done + i] &= pmask;
+            }
+        }
+        if (ret) {
+            // the elements, which were not read, are 0
+            if (LIBARMVM_DMA_FROM_MEMORY == dir) {
+                memset(values + done, 0, (count - done) * sizeof(*values));
+            }
+            _dma_error(ch);
+            return ARMVM_RET_SUCCESS;
+        }
+
+        done += n;
+        ch->next += n;
+        if ((ch->ccr & DMA_CCR_CIRC) && ch->next == ch->reload) {
+            ch->next = 0;
+        }
+    }
+
+    if (!count) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    _dma_block(ch, _dma_cycles(ch->dma), cycles_per_element, count);
+    return _dma_schedule(ch);
+}
+
+
+int _dma_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    struct libarmvm_dma *dma = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+    const uint64_t cycles = _dma_cycles(dma);
+    uint32_t word = 0;
+
+    if (DMA_ISR == reg) {
+        for (size_t i = 0; i < LIBARMVM_DMA_CHANNELS; ++i) {
+            _dma_advance(&dma->channel[i], cycles);
+        }
+        word = dma->isr;
+    } else if (reg >= DMA_CCR && reg < DMA_CCR + LIBARMVM_DMA_CHANNELS * DMA_CHANNEL_SIZE) {
+        struct libarmvm_dma_channel *ch = &dma->channel[(reg - DMA_CCR) / DMA_CHANNEL_SIZE];
+        switch ((reg - DMA_CCR) % DMA_CHANNEL_SIZE + DMA_CCR) {
+            case DMA_CCR:
+                word = ch->ccr;
+                break;
+            case DMA_CNDTR:
+                _dma_advance(ch, cycles);
+                word = _dma_cndtr(ch);
+                break;
+            case DMA_CPAR:
+                word = ch->cpar;
+                break;
+            case DMA_CMAR:
+                word = ch->cmar;
+                break;
+        }
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Only CNDTR of a channel, which still transfers elements, changes with the cycles.
+ * The flags only change by writes or at the events (see _dma_schedule()).
+ */
+int _dma_time_invariant(void *data, uint32_t offset)
+{
+    const struct libarmvm_dma *dma = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+
+    if (reg < DMA_CCR || reg >= DMA_CCR + LIBARMVM_DMA_CHANNELS * DMA_CHANNEL_SIZE) {
+        return 1;
+    }
+
+    const struct libarmvm_dma_channel *ch = &dma->channel[(reg - DMA_CCR) / DMA_CHANNEL_SIZE];
+    return (reg - DMA_CCR) % DMA_CHANNEL_SIZE + DMA_CCR != DMA_CNDTR || ch->seen >= ch->count;
+}
+
+
+int _dma_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_dma *dma = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+    const uint64_t cycles = _dma_cycles(dma);
+    int ret = ARMVM_RET_SUCCESS;
+
+    value <<= shift;
+
+    if (DMA_IFCR == reg) {
+        // CGIF clears all flags of the channel
+        value &= mask;
+        for (size_t i = 0; i < LIBARMVM_DMA_CHANNELS; ++i) {
+            _dma_advance(&dma->channel[i], cycles);
+            if (value & (DMA_ISR_GIF << (4 * i))) {
+                value |= 0xf << (4 * i);
+            }
+        }
+        dma->isr &= ~value;
+
+        // a cleared flag is watched again
+        for (size_t i = 0; i < LIBARMVM_DMA_CHANNELS && !ret; ++i) {
+            ret = _dma_schedule(&dma->channel[i]);
+        }
+        return ret;
+    }
+
+    if (reg < DMA_CCR || reg >= DMA_CCR + LIBARMVM_DMA_CHANNELS * DMA_CHANNEL_SIZE) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    struct libarmvm_dma_channel *ch = &dma->channel[(reg - DMA_CCR) / DMA_CHANNEL_SIZE];
+    _dma_advance(ch, cycles);
+
+    switch ((reg - DMA_CCR) % DMA_CHANNEL_SIZE + DMA_CCR) {
+        case DMA_CCR:
+            {
+                // a disabled channel keeps the current CNDTR
+                const uint32_t ccr = ((ch->ccr & ~mask) | (value & mask)) & DMA_CCR_MASK;
+                const int enable = !(ch->ccr & DMA_CCR_EN) && (ccr & DMA_CCR_EN);
+                if ((ch->ccr & DMA_CCR_EN) && !(ccr & DMA_CCR_EN)) {
+                    ch->cndtr = _dma_cndtr(ch);
+                    ch->count = 0;
+                }
+                ch->ccr = ccr;
+                if (enable) {
+                    ret = _dma_enable(ch);
+                }
+            }
+            break;
+        case DMA_CNDTR:
+            // is only writable while the channel is disabled
+            if (!(ch->ccr & DMA_CCR_EN)) {
+                ch->cndtr = ((ch->cndtr & ~mask) | (value & mask)) & 0xffff;
+            }
+            break;
+        case DMA_CPAR:
+            ch->cpar = (ch->cpar & ~mask) | (value & mask);
+            break;
+        case DMA_CMAR:
+            ch->cmar = (ch->cmar & ~mask) | (value & mask);
+            break;
+    }
+
+    if (ret) {
+        return ret;
+    }
+
+    _dma_update_irq(ch);
+
+    return _dma_schedule(ch);
+}
+
+
+int libarmvm_dma_init(struct armvm *armvm, struct libarmvm_dma *dma)
+{
+    static const uint32_t irqs[LIBARMVM_DMA_CHANNELS] = {
+        LIBARMVM_DMA_CH1_IRQ, LIBARMVM_DMA_CH2_3_IRQ, LIBARMVM_DMA_CH2_3_IRQ, LIBARMVM_DMA_CH4_5_IRQ, LIBARMVM_DMA_CH4_5_IRQ
+    };
+
+    assert(armvm);
+
+    memset(dma, 0, sizeof(*dma));
+    dma->armvm = armvm;
+    for (uint32_t i = 0; i < LIBARMVM_DMA_CHANNELS; ++i) {
+        dma->channel[i].dma = dma;
+        dma->channel[i].idx = i;
+        dma->channel[i].irq = irqs[i];
+        libarmvm_peripherals_event_init(&dma->channel[i].event, _dma_event, &dma->channel[i]);
+    }
+
+    const struct libarmvm_memory_peripheral periph = { _dma_read, _dma_write, dma, NULL, _dma_time_invariant };
+    return libarmvm_memory_add_peripheral(armvm, LIBARMVM_DMA_BASE_ADDR, LIBARMVM_DMA_SIZE, &periph);
+}
+
+
+void libarmvm_dma_reset(struct libarmvm_dma *dma)
+{
+    dma->isr = 0;
+    for (size_t i = 0; i < LIBARMVM_DMA_CHANNELS; ++i) {
+        struct libarmvm_dma_channel *ch = &dma->channel[i];
+        ch->ccr = 0;
+        ch->cndtr = 0;
+        ch->cpar = 0;
+        ch->cmar = 0;
+        ch->reload = 0;
+        ch->next = 0;
+        ch->start = 0;
+        ch->cycles_per_element = 0;
+        ch->first = 0;
+        ch->count = 0;
+        ch->seen = 0;
+    }
+}
+
+
+void libarmvm_dma_connect(struct armvm *armvm, uint32_t channel, int (*request)(void *data), void *data)
+{
+    struct libarmvm_dma_channel *ch = _dma_channel(armvm, channel);
+
+    ch->request = request;
+    ch->request_data = data;
+}
+
+
+uint32_t libarmvm_dma_capacity(struct armvm *armvm, uint32_t channel, uint32_t dir)
+{
+    const struct libarmvm_dma_channel *ch = _dma_channel(armvm, channel);
+
+    if (!(ch->ccr & DMA_CCR_EN) || (ch->ccr & DMA_CCR_MEM2MEM) || !ch->reload) {
+        return 0;
+    }
+    if (((ch->ccr & DMA_CCR_DIR) ? LIBARMVM_DMA_FROM_MEMORY : LIBARMVM_DMA_TO_MEMORY) != dir) {
+        return 0;
+    }
+    if (ch->ccr & DMA_CCR_CIRC) {
+        return UINT32_MAX;
+    }
+    return ch->reload - ch->next;
+}
+
+
+int libarmvm_dma_push(struct armvm *armvm, uint32_t channel, const uint32_t *values, uint32_t count, uint64_t cycles_per_element)
+{
+    struct libarmvm_dma_channel *ch = _dma_channel(armvm, channel);
+
+    // the values are not modified in this direction
+    return _dma_transfer(ch, (uint32_t *)values, count, cycles_per_element, LIBARMVM_DMA_TO_MEMORY);
+}
+
+
+int libarmvm_dma_pull(struct armvm *armvm, uint32_t channel, uint32_t *values, uint32_t count, uint64_t cycles_per_element)
+{
+    struct libarmvm_dma_channel *ch = _dma_channel(armvm, channel);
+
+    return _dma_transfer(ch, values, count, cycles_per_element, LIBARMVM_DMA_FROM_MEMORY);
+}
@@ -0,0 +1,142 @@
+/** @file */
+#ifndef __LIBARMVM_DMA_H__
+#define __LIBARMVM_DMA_H__
+
+#include <armvm.h>
+#include <libarmvm_event.h>
+
+/**
+ * @brief First address and interrupts of DMA1 of the STM32F070.
+ * Channel 1 has its own interrupt, channels 2 and 3 and channels 4 and 5 share one.
+ */
+#define LIBARMVM_DMA_BASE_ADDR (0x40020000)
+#define LIBARMVM_DMA_SIZE      (0x400)
+#define LIBARMVM_DMA_CH1_IRQ   (9)
+#define LIBARMVM_DMA_CH2_3_IRQ (10)
+#define LIBARMVM_DMA_CH4_5_IRQ (11)
+
+#define LIBARMVM_DMA_CHANNELS (5)
+
+/**
+ * @brief Cycles of one element of a memory-to-memory transfer (a read and a write on the bus).
+ */
+#define LIBARMVM_DMA_CYCLES (2)
+
+/*
+ * Channels (counted from 0) of the requests of the peripherals.
+ */
+#define LIBARMVM_DMA_ADC       (0)
+#define LIBARMVM_DMA_USART1_TX (1)
+#define LIBARMVM_DMA_USART1_RX (2)
+#define LIBARMVM_DMA_USART2_TX (3)
+#define LIBARMVM_DMA_USART2_RX (4)
+
+/*
+ * Directions of a transfer between a peripheral and the memory.
+ */
+#define LIBARMVM_DMA_TO_MEMORY   (0)
+#define LIBARMVM_DMA_FROM_MEMORY (1)
+
+
+struct libarmvm_dma;
+
+
+/**
+ * @brief Channel of the DMA controller.
+ * The elements of a block are copied at once through the block accessors of the memory. The block
+ * is completed one element per cycles_per_element from its start. CNDTR, the flags and the interrupts
+ * follow this time line, which is derived from the cycle counter, when a register is accessed.
+ */
+struct libarmvm_dma_channel {
+    struct libarmvm_dma *dma;
+    uint32_t idx;  /**< Number of the channel (counted from 0). */
+    uint32_t irq;  /**< Number of the interrupt (IRQn). */
+
+    struct libarmvm_peripherals_event event;  /**< Next half or complete transfer, whose flag is clear or whose interrupt is enabled. */
+
+    uint32_t ccr;
+    uint32_t cndtr;  /**< CNDTR while the channel is disabled. */
+    uint32_t cpar;
+    uint32_t cmar;
+
+    uint32_t reload;  /**< CNDTR when the channel was enabled. The circular mode starts again with it. */
+    uint32_t next;    /**< Index of the next element, which is copied. */
+
+    uint64_t start;               /**< Value of the cycle counter at which the first element of the block is transferred. */
+    uint64_t cycles_per_element;
+    uint32_t first;               /**< Index of the first element of the block. */
+    uint32_t count;               /**< Amount of elements of the block. */
+    uint32_t seen;                /**< Amount of elements of the block, whose flags were set. */
+
+    /**
+     * @brief Is called when the channel is enabled, so the connected peripheral can serve a pending request.
+     * NULL if no peripheral is connected.
+     */
+    int (*request)(void *data);
+    void *request_data;
+};
+
+
+/**
+ * @brief DMA1 with the register layout of the STM32F0.
+ * The priorities of the channels are not modeled, each channel transfers its blocks independently.
+ */
+struct libarmvm_dma {
+    struct armvm *armvm;
+    uint32_t isr;  /**< Flags of all channels. */
+    struct libarmvm_dma_channel channel[LIBARMVM_DMA_CHANNELS];
+};
+
+
+/**
+ * @brief Initializes the DMA controller and maps its registers to LIBARMVM_DMA_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_dma_init(struct armvm *armvm, struct libarmvm_dma *dma);
+
+
+/**
+ * @brief Resets the registers of the DMA controller. All channels are disabled.
+ * Has to be called after the scheduled events were removed.
+ */
+void libarmvm_dma_reset(struct libarmvm_dma *dma);
+
+
+/**
+ * @brief Connects a peripheral to the request of a channel.
+ *
+ * @param request Is called with data when the channel is enabled.
+ */
+void libarmvm_dma_connect(struct armvm *armvm, uint32_t channel, int (*request)(void *data), void *data);
+
+
+/**
+ * @brief Returns the amount of elements, which a channel accepts now in the direction dir (LIBARMVM_DMA_TO_MEMORY
+ * or LIBARMVM_DMA_FROM_MEMORY). 0 if the channel is disabled, transfers in the other direction or is complete.
+ * UINT32_MAX in the circular mode.
+ */
+uint32_t libarmvm_dma_capacity(struct armvm *armvm, uint32_t channel, uint32_t dir);
+
+
+/**
+ * @brief Transfers count elements of a peripheral to the memory as one block.
+ * The first element is transferred now, the others one per cycles_per_element.
+ * The amount of elements must not exceed libarmvm_dma_capacity().
+ *
+ * @param values Elements with the width of PSIZE.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_dma_push(struct armvm *armvm, uint32_t channel, const uint32_t *values, uint32_t count, uint64_t cycles_per_element);
+
+
+/**
+ * @brief Transfers count elements of the memory to a peripheral as one block.
+ * Like libarmvm_dma_push(), the first element is transferred now and the others one per cycles_per_element.
+ *
+ * @param values Receives the elements with the width of PSIZE.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_dma_pull(struct armvm *armvm, uint32_t channel, uint32_t *values, uint32_t count, uint64_t cycles_per_element);
+
+#endif
@@ -0,0 +1,33 @@
+/** @file */
+#ifndef __LIBARMVM_EVENT_H__
+#define __LIBARMVM_EVENT_H__
+
+#include <armvm.h>
+#include <stdlib.h>
+
+/**
+ * @brief An event of a peripheral, which happens at a given core cycle (e.g. a timer overflow).
+ * It is embedded into the state of the peripheral and scheduled with libarmvm_peripherals_schedule().
+ */
+struct libarmvm_peripherals_event {
+    /**
+     * @brief Is called before the first step, which starts at or after cycles.
+     * The event is not scheduled anymore, but the handler may schedule it again.
+     *
+     * @param armvm The virtual machine.
+     * @param data The data pointer of the event.
+     * @return ARMVM_RET_SUCCESS on success.
+     */
+    int (*handler)(struct armvm *armvm, void *data);
+
+    void *data;  /**< Is passed to handler(). */
+
+    uint64_t cycles;  /**< Value of the cycle counter at which the event happens. */
+
+    /**
+     * @brief Position in the heap of the scheduler plus one. 0 if the event is not scheduled.
+     */
+    size_t heap_idx;
+};
+
+#endif
@@ -0,0 +1,551 @@
+#include <libarmvm_gpio.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_peripherals.h>
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers of a port.
+ */
+#define GPIO_MODER   (0x00)
+#define GPIO_OTYPER  (0x04)
+#define GPIO_OSPEEDR (0x08)
+#define GPIO_PUPDR   (0x0c)
+#define GPIO_IDR     (0x10)
+#define GPIO_ODR     (0x14)
+#define GPIO_BSRR    (0x18)
+#define GPIO_LCKR    (0x1c)
+#define GPIO_AFRL    (0x20)
+#define GPIO_AFRH    (0x24)
+#define GPIO_BRR     (0x28)
+
+/*
+ * Values of the 2 bit fields of MODER and PUPDR.
+ */
+#define GPIO_MODE_OUTPUT (0x1)
+#define GPIO_PULL_UP     (0x1)
+
+/*
+ * Reset values of GPIOA, whose pins PA13 and PA14 are used by the SWD.
+ */
+#define GPIO_MODER_A   (0x28000000)
+#define GPIO_OSPEEDR_A (0x0c000000)
+#define GPIO_PUPDR_A   (0x24000000)
+
+#define GPIO_STIMULUS_CAPACITY (64)
+
+
+static inline uint64_t _gpio_cycles(const struct libarmvm_gpio *gpio)
+{
+    return ((const struct libarmvm_ci *)gpio->armvm->ci->data)->cycles;
+}
+
+
+void _gpio_flush(struct libarmvm_gpio *gpio)
+{
+    if (gpio->buf_size && !gpio->error) {
+        if (gpio->buf_size != fwrite(gpio->buf, 1, gpio->buf_size, gpio->vcd)) {
+            fprintf(stderr, "ERROR: Could not write VCD file.\n");
+            gpio->error = 1;
+        }
+    }
+    gpio->buf_size = 0;
+}
+
+
+void _gpio_put(struct libarmvm_gpio *gpio, const char *str, size_t len)
+{
+    assert(len <= LIBARMVM_GPIO_BUFFER_SIZE);
+
+    if (gpio->buf_size + len > LIBARMVM_GPIO_BUFFER_SIZE) {
+        _gpio_flush(gpio);
+    }
+    memcpy(gpio->buf + gpio->buf_size, str, len);
+    gpio->buf_size += len;
+}
+
+
+/**
+ * Writes the value of a pin with its identifier in the VCD file (port letter and hexadecimal pin number).
+ */
+static inline void _gpio_put_pin(struct libarmvm_gpio *gpio, uint32_t port, uint32_t pin, uint32_t value)
+{
+    const char line[4] = { value ? '1' : '0', 'a' + port, "0123456789abcdef"[pin], '\n' };
+    _gpio_put(gpio, line, sizeof(line));
+}
+
+
+/**
+ * Returns the pins of a port, whose 2 bit field of reg has the value field.
+ */
+uint16_t _gpio_pins(uint32_t reg, uint32_t field)
+{
+    uint16_t pins = 0;
+
+    for (uint32_t pin = 0; pin < LIBARMVM_GPIO_PINS; ++pin) {
+        if (field == ((reg >> (2 * pin)) & 0x3)) {
+            pins |= 1 << pin;
+        }
+    }
+
+    return pins;
+}
+
+
+/**
+ * Computes the state of the pins of a port. An output in the open-drain mode only drives the low level.
+ * The pins, which are not driven by the port, have the value of the stimulus or of their pull-up.
+ */
+uint16_t _gpio_level(const struct libarmvm_gpio_port *port)
+{
+    const uint16_t output = _gpio_pins(port->moder, GPIO_MODE_OUTPUT);
+    const uint16_t pull_up = _gpio_pins(port->pupdr, GPIO_PULL_UP);
+    const uint16_t push_pull = output & ~port->otyper;
+    const uint16_t low = output & port->otyper & ~port->odr;
+    const uint16_t external = (port->driven & port->input) | (~port->driven & pull_up);
+
+    return (push_pull & port->odr) | (~push_pull & ~low & external);
+}
+
+
+/**
+ * Updates the state of the pins of a port at the value cycles of the cycle counter.
+ * Only the changed pins are written to the VCD file.
+ */
+void _gpio_update(struct libarmvm_gpio_port *port, uint64_t cycles)
+{
+    struct libarmvm_gpio *gpio = port->gpio;
+    const uint16_t level = _gpio_level(port);
+    const uint16_t changed = level ^ port->level;
+
+    if (!changed) {
+        return;
+    }
+    port->level = level;
+
+    if (!gpio->vcd) {
+        return;
+    }
+
+    const uint64_t time = gpio->time_base + cycles;
+    if (time > gpio->time) {
+        char line[32];
+        const int len = snprintf(line, sizeof(line), "#%llu\n", (unsigned long long)time);
+        _gpio_put(gpio, line, len);
+        gpio->time = time;
+    }
+
+    for (uint32_t pin = 0; pin < LIBARMVM_GPIO_PINS; ++pin) {
+        if (changed & (1 << pin)) {
+            _gpio_put_pin(gpio, port->idx, pin, level & (1 << pin));
+        }
+    }
+}
+
+
+void _gpio_reset_port(struct libarmvm_gpio_port *port)
+{
+    const int a = 0 == port->idx;
+
+    port->moder = a ? GPIO_MODER_A : 0;
+    port->otyper = 0;
+    port->ospeedr = a ? GPIO_OSPEEDR_A : 0;
+    port->pupdr = a ? GPIO_PUPDR_A : 0;
+    port->odr = 0;
+    port->lckr = 0;
+    port->afr[0] = 0;
+    port->afr[1] = 0;
+    port->input = 0;
+    port->driven = 0;
+}
+
+
+/**
+ * Schedules the next change of the stimulus.
+ */
+int _gpio_schedule(struct libarmvm_gpio *gpio)
+{
+    if (gpio->stimulus_next >= gpio->stimulus_size) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    return libarmvm_peripherals_schedule(gpio->armvm, &gpio->event, gpio->stimulus[gpio->stimulus_next].cycles);
+}
+
+
+void _gpio_update_ports(struct libarmvm_gpio *gpio, uint32_t ports, uint64_t cycles)
+{
+    for (uint32_t i = 0; i < LIBARMVM_GPIO_PORTS; ++i) {
+        if (ports & (1 << i)) {
+            _gpio_update(&gpio->port[i], cycles);
+        }
+    }
+}
+
+
+/**
+ * Applies all changes of the stimulus until the current cycle.
+ */
+int _gpio_event(struct armvm *armvm, void *data)
+{
+    struct libarmvm_gpio *gpio = data;
+    const uint64_t cycles = _gpio_cycles(gpio);
+    uint32_t ports = 0;
+
+    // the changes are written with their own cycles, the event may be served some cycles later
+    while (gpio->stimulus_next < gpio->stimulus_size && gpio->stimulus[gpio->stimulus_next].cycles <= cycles) {
+        const struct libarmvm_gpio_stimulus *change = &gpio->stimulus[gpio->stimulus_next++];
+        struct libarmvm_gpio_port *port = &gpio->port[change->port];
+        const uint16_t bit = 1 << change->pin;
+
+        if (ports && change->cycles != gpio->stimulus[gpio->stimulus_next - 2].cycles) {
+            _gpio_update_ports(gpio, ports, gpio->stimulus[gpio->stimulus_next - 2].cycles);
+            ports = 0;
+        }
+
+        if (LIBARMVM_GPIO_RELEASE == change->value) {
+            port->driven &= ~bit;
+        } else {
+            port->driven |= bit;
+            port->input = change->value ? port->input | bit : port->input & ~bit;
+        }
+        ports |= 1 << change->port;
+    }
+    _gpio_update_ports(gpio, ports, gpio->stimulus[gpio->stimulus_next - 1].cycles);
+
+    return _gpio_schedule(gpio);
+}
+
+
+int _gpio_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    const struct libarmvm_gpio_port *port = data;
+    uint32_t word = 0;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case GPIO_MODER:
+            word = port->moder;
+            break;
+        case GPIO_OTYPER:
+            word = port->otyper;
+            break;
+        case GPIO_OSPEEDR:
+            word = port->ospeedr;
+            break;
+        case GPIO_PUPDR:
+            word = port->pupdr;
+            break;
+        case GPIO_IDR:
+            word = port->level;
+            break;
+        case GPIO_ODR:
+            word = port->odr;
+            break;
+        case GPIO_LCKR:
+            word = port->lckr;
+            break;
+        case GPIO_AFRL:
+            word = port->afr[0];
+            break;
+        case GPIO_AFRH:
+            word = port->afr[1];
+            break;
+        // BSRR and BRR are write-only
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _gpio_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_gpio_port *port = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+
+    value <<= shift;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case GPIO_MODER:
+            port->moder = (port->moder & ~mask) | (value & mask);
+            break;
+        case GPIO_OTYPER:
+            port->otyper = (port->otyper & ~(mask & 0xffff)) | (value & mask & 0xffff);
+            break;
+        case GPIO_OSPEEDR:
+            port->ospeedr = (port->ospeedr & ~mask) | (value & mask);
+            return ARMVM_RET_SUCCESS;
+        case GPIO_PUPDR:
+            port->pupdr = (port->pupdr & ~mask) | (value & mask);
+            break;
+        case GPIO_ODR:
+            port->odr = (port->odr & ~(mask & 0xffff)) | (value & mask & 0xffff);
+            break;
+        case GPIO_BSRR:
+            // the set bits win over the reset bits
+            port->odr = (port->odr & ~((value & mask) >> 16)) | (value & mask & 0xffff);
+            break;
+        case GPIO_LCKR:
+            port->lckr = (port->lckr & ~(mask & 0x1ffff)) | (value & mask & 0x1ffff);
+            return ARMVM_RET_SUCCESS;
+        case GPIO_AFRL:
+            port->afr[0] = (port->afr[0] & ~mask) | (value & mask);
+            return ARMVM_RET_SUCCESS;
+        case GPIO_AFRH:
+            port->afr[1] = (port->afr[1] & ~mask) | (value & mask);
+            return ARMVM_RET_SUCCESS;
+        case GPIO_BRR:
+            port->odr &= ~(value & mask & 0xffff);
+            break;
+        default:
+            return ARMVM_RET_SUCCESS;
+    }
+
+    _gpio_update(port, _gpio_cycles(port->gpio));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * Parses one line of the stimulus file. Returns 0 for empty lines and comments, 1 for a change and -1 on error.
+ */
+int _gpio_parse_stimulus(const char *line, struct libarmvm_gpio_stimulus *change)
+{
+    while (isspace((unsigned char)*line)) {
+        line++;
+    }
+    if (!*line || '#' == *line) {
+        return 0;
+    }
+
+    char *end;
+    errno = 0;
+    const unsigned long long cycles = strtoull(line, &end, 0);
+    if (errno || end == line || !isspace((unsigned char)*end)) {
+        return -1;
+    }
+
+    char port;
+    unsigned pin;
+    char value;
+    char rest;
+    if (3 != sscanf(end, " P%c%u %c %c", &port, &pin, &value, &rest)) {
+        return -1;
+    }
+
+    port = toupper((unsigned char)port);
+    if (port < 'A' || port >= 'A' + LIBARMVM_GPIO_PORTS || pin >= LIBARMVM_GPIO_PINS) {
+        return -1;
+    }
+
+    change->cycles = cycles;
+    change->port = port - 'A';
+    change->pin = pin;
+    switch (value) {
+        case '0':
+            change->value = 0;
+            break;
+        case '1':
+            change->value = 1;
+            break;
+        case 'z':
+        case 'Z':
+            change->value = LIBARMVM_GPIO_RELEASE;
+            break;
+        default:
+            return -1;
+    }
+
+    return 1;
+}
+
+
+int _gpio_load_stimulus(struct libarmvm_gpio *gpio, const char *file)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    size_t capacity = 0;
+    char line[256];
+    unsigned number = 0;
+
+    FILE *f = fopen(file, "r");
+    if (!f) {
+        fprintf(stderr, "ERROR: Could not open stimulus file: %s\n", file);
+        return ARMVM_RET_FAIL;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        struct libarmvm_gpio_stimulus change;
+
+        number++;
+        const int parsed = _gpio_parse_stimulus(line, &change);
+        if (!parsed) {
+            continue;
+        }
+        if (0 > parsed) {
+            fprintf(stderr, "ERROR: Invalid line %u of the stimulus file: %s\n", number, file);
+            ret = ARMVM_RET_FAIL;
+            goto err;
+        }
+        if (gpio->stimulus_size && change.cycles < gpio->stimulus[gpio->stimulus_size - 1].cycles) {
+            fprintf(stderr, "ERROR: The cycles decrease in line %u of the stimulus file: %s\n", number, file);
+            ret = ARMVM_RET_FAIL;
+            goto err;
+        }
+
+        if (gpio->stimulus_size == capacity) {
+            capacity = capacity ? 2 * capacity : GPIO_STIMULUS_CAPACITY;
+            struct libarmvm_gpio_stimulus *stimulus = realloc(gpio->stimulus, capacity * sizeof(*stimulus));
+            if (!stimulus) {
+                fprintf(stderr, "ERROR: Not enough memory.\n");
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            gpio->stimulus = stimulus;
+        }
+        gpio->stimulus[gpio->stimulus_size++] = change;
+    }
+
+    if (ferror(f)) {
+        fprintf(stderr, "ERROR: Could not read stimulus file: %s\n", file);
+        ret = ARMVM_RET_FAIL;
+    }
+
+err:
+    fclose(f);
+    return ret;
+}
+
+
+int _gpio_open_vcd(struct libarmvm_gpio *gpio, const char *file)
+{
+    char line[64];
+
+    gpio->buf = malloc(LIBARMVM_GPIO_BUFFER_SIZE);
+    if (!gpio->buf) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+
+    gpio->vcd = fopen(file, "w");
+    if (!gpio->vcd) {
+        fprintf(stderr, "ERROR: Could not open VCD file: %s\n", file);
+        return ARMVM_RET_FAIL;
+    }
+
+    const char header[] = "$comment libarmvm GPIO, one time unit is one cycle of the core clock $end\n"
+                          "$scope module gpio $end\n";
+    _gpio_put(gpio, header, sizeof(header) - 1);
+    for (uint32_t i = 0; i < LIBARMVM_GPIO_PORTS; ++i) {
+        for (uint32_t pin = 0; pin < LIBARMVM_GPIO_PINS; ++pin) {
+            const int len = snprintf(line, sizeof(line), "$var wire 1 %c%x P%c%u $end\n", 'a' + i, pin, 'A' + i, pin);
+            _gpio_put(gpio, line, len);
+        }
+    }
+
+    const char dumpvars[] = "$upscope $end\n"
+                            "$enddefinitions $end\n"
+                            "#0\n"
+                            "$dumpvars\n";
+    _gpio_put(gpio, dumpvars, sizeof(dumpvars) - 1);
+    for (uint32_t i = 0; i < LIBARMVM_GPIO_PORTS; ++i) {
+        for (uint32_t pin = 0; pin < LIBARMVM_GPIO_PINS; ++pin) {
+            _gpio_put_pin(gpio, i, pin, gpio->port[i].level & (1 << pin));
+        }
+    }
+    _gpio_put(gpio, "$end\n", 5);
+    gpio->time = 0;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_gpio_init(struct armvm *armvm, struct libarmvm_gpio *gpio)
+{
+    assert(armvm);
+
+    memset(gpio, 0, sizeof(*gpio));
+    gpio->armvm = armvm;
+    libarmvm_peripherals_event_init(&gpio->event, _gpio_event, gpio);
+
+    for (uint32_t i = 0; i < LIBARMVM_GPIO_PORTS; ++i) {
+        struct libarmvm_gpio_port *port = &gpio->port[i];
+
+        port->gpio = gpio;
+        port->idx = i;
+        _gpio_reset_port(port);
+        port->level = _gpio_level(port);
+
+        const struct libarmvm_memory_peripheral periph = { _gpio_read, _gpio_write, port };
+        int ret = libarmvm_memory_add_peripheral(armvm, LIBARMVM_GPIO_BASE_ADDR + i * LIBARMVM_GPIO_SIZE, LIBARMVM_GPIO_SIZE, &periph);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_gpio_connect(struct libarmvm_gpio *gpio, const char *vcd, const char *stimulus)
+{
+    int ret;
+
+    if (vcd) {
+        ret = _gpio_open_vcd(gpio, vcd);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    if (stimulus) {
+        ret = _gpio_load_stimulus(gpio, stimulus);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_gpio_reset(struct libarmvm_gpio *gpio)
+{
+    // the cycle counter starts again, the VCD file continues after its last change
+    gpio->time_base = gpio->time;
+
+    for (uint32_t i = 0; i < LIBARMVM_GPIO_PORTS; ++i) {
+        _gpio_reset_port(&gpio->port[i]);
+        _gpio_update(&gpio->port[i], 0);
+    }
+
+    gpio->stimulus_next = 0;
+    return _gpio_schedule(gpio);
+}
+
+
+void libarmvm_gpio_disconnect(struct libarmvm_gpio *gpio)
+{
+    if (gpio->vcd) {
+        _gpio_flush(gpio);
+        if (fclose(gpio->vcd)) {
+            fprintf(stderr, "ERROR: Could not write VCD file.\n");
+        }
+        gpio->vcd = NULL;
+    }
+    free(gpio->buf);
+    gpio->buf = NULL;
+    gpio->buf_size = 0;
+
+    free(gpio->stimulus);
+    gpio->stimulus = NULL;
+    gpio->stimulus_size = 0;
+    gpio->stimulus_next = 0;
+}
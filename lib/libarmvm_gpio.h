@@ -0,0 +1,121 @@
+/** @file */
+#ifndef __LIBARMVM_GPIO_H__
+#define __LIBARMVM_GPIO_H__
+
+#include <armvm.h>
+#include <stdio.h>
+#include <libarmvm_event.h>
+
+/**
+ * @brief First address of GPIOA. The ports GPIOA to GPIOF follow each other every LIBARMVM_GPIO_SIZE bytes.
+ */
+#define LIBARMVM_GPIO_BASE_ADDR (0x48000000)
+#define LIBARMVM_GPIO_SIZE      (0x400)
+
+#define LIBARMVM_GPIO_PORTS (6)
+#define LIBARMVM_GPIO_PINS  (16)
+
+/**
+ * @brief Size of the output buffer. The VCD file is only written if the buffer is full.
+ */
+#define LIBARMVM_GPIO_BUFFER_SIZE (64 * 1024)
+
+
+struct libarmvm_gpio;
+
+
+/**
+ * @brief Port of the GPIO with the register layout of the STM32F0.
+ */
+struct libarmvm_gpio_port {
+    struct libarmvm_gpio *gpio;
+    uint32_t idx;  /**< Number of the port (0 for GPIOA). */
+
+    uint32_t moder;
+    uint32_t otyper;
+    uint32_t ospeedr;
+    uint32_t pupdr;
+    uint32_t odr;
+    uint32_t lckr;
+    uint32_t afr[2];
+
+    uint16_t input;   /**< Values of the pins, which are driven by the stimulus. */
+    uint16_t driven;  /**< Pins, which are driven by the stimulus. The others follow their pull-up or pull-down. */
+    uint16_t level;   /**< Current state of the pins. Is read as IDR. */
+};
+
+
+/**
+ * @brief Change of an input pin, which is given by the stimulus file.
+ */
+struct libarmvm_gpio_stimulus {
+    uint64_t cycles;  /**< Value of the cycle counter (since the reset), at which the pin changes. */
+    uint8_t port;
+    uint8_t pin;
+    uint8_t value;    /**< 0 or 1 drives the pin, LIBARMVM_GPIO_RELEASE releases it. */
+};
+
+#define LIBARMVM_GPIO_RELEASE (2)
+
+
+/**
+ * @brief The ports GPIOA to GPIOF.
+ * The state of the pins is only computed when a register, which affects it, is written or the stimulus changes
+ * an input. Only the pins, whose state changed, are written to the VCD file. The time of the VCD file is the
+ * cycle counter, it continues after a reset.
+ *
+ * The stimulus file has one change per line: "CYCLES PIN VALUE", for example "1000 PA0 1". VALUE is 0, 1 or z,
+ * which releases the pin. CYCLES count from the reset and must not decrease. Empty lines and lines starting
+ * with '#' are ignored.
+ */
+struct libarmvm_gpio {
+    struct armvm *armvm;
+    struct libarmvm_gpio_port port[LIBARMVM_GPIO_PORTS];
+
+    struct libarmvm_peripherals_event event;  /**< Next change of the stimulus. */
+    struct libarmvm_gpio_stimulus *stimulus;
+    size_t stimulus_size;
+    size_t stimulus_next;                     /**< Index of the next change of the stimulus. */
+
+    FILE *vcd;               /**< NULL if no VCD file is written. */
+    char *buf;               /**< Output buffer of LIBARMVM_GPIO_BUFFER_SIZE bytes. */
+    size_t buf_size;         /**< Amount of used bytes in buf. */
+    uint64_t time;           /**< Last time, which was written to the VCD file. */
+    uint64_t time_base;      /**< Time of the VCD file at the last reset. */
+    uint8_t error;           /**< Set if writing the VCD file failed. */
+};
+
+
+/**
+ * @brief Initializes the ports and maps their registers to LIBARMVM_GPIO_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_gpio_init(struct armvm *armvm, struct libarmvm_gpio *gpio);
+
+
+/**
+ * @brief Opens the VCD file, writes its header and loads the stimulus file.
+ *
+ * @param vcd File to which the changes of the pins are written. NULL if no VCD file shall be written.
+ * @param stimulus File which drives the input pins. NULL if the pins are not driven.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_gpio_connect(struct libarmvm_gpio *gpio, const char *vcd, const char *stimulus);
+
+
+/**
+ * @brief Resets the registers of the ports, releases all pins and starts the stimulus from its beginning.
+ * Has to be called after the scheduled events were removed.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_gpio_reset(struct libarmvm_gpio *gpio);
+
+
+/**
+ * @brief Writes the rest of the buffer, closes the VCD file and frees the stimulus.
+ */
+void libarmvm_gpio_disconnect(struct libarmvm_gpio *gpio);
+
+#endif
@@ -0,0 +1,213 @@
+#include <libarmvm_heatmap.h>
+#include <libarmvm_memory.h>
+#include <inttypes.h>
+#include <string.h>
+#include <assert.h>
+
+#define HEATMAP_BAR_WIDTH (40)
+
+
+const char *_heatmap_area_name(enum libarmvm_memory_area_type type)
+{
+    switch (type) {
+        case RAM:   return "RAM";
+        case ROM:   return "ROM";
+        case FLASH: return "FLASH";
+        case PERIPHERAL: return "PERIPHERAL";
+        default:    return "<unknown>";
+    }
+}
+
+
+static inline void _heatmap_count(struct libarmvm_heatmap *heatmap, uint32_t addr, uint8_t size, uint8_t counter)
+{
+    for (size_t i = 0; i < heatmap->aliases_size; ++i) {
+        uint32_t offset = addr - heatmap->aliases[i].addr;
+        if (offset < heatmap->aliases[i].size) {
+            addr = heatmap->aliases[i].remap_addr + offset;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < heatmap->regions_size; ++i) {
+        uint32_t offset = addr - heatmap->regions[i].addr;
+        if (offset < heatmap->regions[i].size) {
+            heatmap->regions[i].buckets[offset >> heatmap->bucket_shift][counter + (size >> 1)]++;
+            return;
+        }
+    }
+}
+
+
+void _heatmap_read_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    _heatmap_count(data, addr, size, LIBARMVM_HEATMAP_READ_8);
+}
+
+
+void _heatmap_write_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    _heatmap_count(data, addr, size, LIBARMVM_HEATMAP_WRITE_8);
+}
+
+
+int libarmvm_heatmap_init(struct armvm *armvm, struct libarmvm_heatmap *heatmap, uint32_t bucket_size)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_memory *mem = armvm->mem->data;
+
+    memset(heatmap, 0, sizeof(*heatmap));
+
+    if (bucket_size < 4 || (bucket_size & (bucket_size - 1))) {
+        fprintf(stderr, "ERROR: The bucket size of the heatmap has to be a power of two and at least 4: %u\n", bucket_size);
+        return ARMVM_RET_INVALID_OPTS;
+    }
+    while ((1u << heatmap->bucket_shift) < bucket_size) {
+        heatmap->bucket_shift++;
+    }
+
+    heatmap->regions = calloc(mem->areas_size, sizeof(*heatmap->regions));
+    heatmap->aliases = calloc(mem->areas_size, sizeof(*heatmap->aliases));
+    if (!heatmap->regions || !heatmap->aliases) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret = ARMVM_RET_NO_MEM;
+        goto err;
+    }
+
+    for (size_t i = 0; i < mem->areas_size; ++i) {
+        const struct libarmvm_memory_area *area = &mem->areas[i];
+
+        if (REMAP == area->type) {
+            struct libarmvm_heatmap_alias *alias = &heatmap->aliases[heatmap->aliases_size++];
+            alias->addr = area->addr;
+            alias->size = area->size;
+            alias->remap_addr = area->u.remap_addr;
+            continue;
+        }
+
+        struct libarmvm_heatmap_region *region = &heatmap->regions[heatmap->regions_size++];
+        region->addr = area->addr;
+        region->size = area->size;
+        region->name = _heatmap_area_name(area->type);
+        region->buckets = calloc(((area->size - 1) >> heatmap->bucket_shift) + 1, sizeof(*region->buckets));
+        if (!region->buckets) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+    }
+
+    const struct libarmvm_memory_observer observer = { _heatmap_read_observe, _heatmap_write_observe, heatmap };
+    ret = libarmvm_memory_add_observer(armvm, &observer);
+    if (ret) {
+        goto err;
+    }
+
+    return ret;
+err:
+    libarmvm_heatmap_cleanup(heatmap);
+    return ret;
+}
+
+
+int libarmvm_heatmap_cleanup(struct libarmvm_heatmap *heatmap)
+{
+    if (heatmap->regions) {
+        for (size_t i = 0; i < heatmap->regions_size; ++i) {
+            free(heatmap->regions[i].buckets);
+        }
+        free(heatmap->regions);
+        heatmap->regions = NULL;
+        heatmap->regions_size = 0;
+    }
+
+    if (heatmap->aliases) {
+        free(heatmap->aliases);
+        heatmap->aliases = NULL;
+        heatmap->aliases_size = 0;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+uint64_t _heatmap_bucket_total(const uint64_t *counters)
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < LIBARMVM_HEATMAP_COUNTERS; ++i) {
+        total += counters[i];
+    }
+    return total;
+}
+
+
+void _heatmap_report_region(const struct libarmvm_heatmap *heatmap, const struct libarmvm_heatmap_region *region, FILE *out)
+{
+    const size_t buckets_size = ((region->size - 1) >> heatmap->bucket_shift) + 1;
+    uint64_t totals[LIBARMVM_HEATMAP_COUNTERS] = {0};
+    uint64_t max = 0;
+
+    for (size_t i = 0; i < buckets_size; ++i) {
+        for (size_t j = 0; j < LIBARMVM_HEATMAP_COUNTERS; ++j) {
+            totals[j] += region->buckets[i][j];
+        }
+        uint64_t total = _heatmap_bucket_total(region->buckets[i]);
+        if (total > max) {
+            max = total;
+        }
+    }
+
+    fprintf(out, "# %s 0x%08x - 0x%08x\n", region->name, region->addr, region->addr + region->size - 1);
+    fprintf(out, "#   reads : %" PRIu64 " (8bit), %" PRIu64 " (16bit), %" PRIu64 " (32bit)\n",
+            totals[LIBARMVM_HEATMAP_READ_8], totals[LIBARMVM_HEATMAP_READ_16], totals[LIBARMVM_HEATMAP_READ_32]);
+    fprintf(out, "#   writes: %" PRIu64 " (8bit), %" PRIu64 " (16bit), %" PRIu64 " (32bit)\n",
+            totals[LIBARMVM_HEATMAP_WRITE_8], totals[LIBARMVM_HEATMAP_WRITE_16], totals[LIBARMVM_HEATMAP_WRITE_32]);
+
+    if (!max) {
+        fprintf(out, "\n");
+        return;
+    }
+
+    fprintf(out, "#%-9s %12s %12s %12s %12s %12s %12s  %s\n", "bucket", "rd8", "rd16", "rd32", "wr8", "wr16", "wr32", "heat");
+    for (size_t i = 0; i < buckets_size; ++i) {
+        const uint64_t *counters = region->buckets[i];
+        uint64_t total = _heatmap_bucket_total(counters);
+        if (!total) {
+            continue;
+        }
+
+        fprintf(out, "0x%08x", region->addr + (uint32_t)(i << heatmap->bucket_shift));
+        for (size_t j = 0; j < LIBARMVM_HEATMAP_COUNTERS; ++j) {
+            fprintf(out, " %12" PRIu64, counters[j]);
+        }
+        fprintf(out, "  ");
+
+        // at least one character for every accessed bucket
+        size_t width = 1 + (total * (HEATMAP_BAR_WIDTH - 1)) / max;
+        for (size_t j = 0; j < width; ++j) {
+            fputc('#', out);
+        }
+        fputc('\n', out);
+    }
+    fprintf(out, "\n");
+}
+
+
+int libarmvm_heatmap_report(const struct libarmvm_heatmap *heatmap, FILE *out)
+{
+    fprintf(out, "# libarmvm memory heatmap\n");
+    fprintf(out, "# bucket size: %u bytes\n", 1u << heatmap->bucket_shift);
+    fprintf(out, "# Reads include instruction fetches. Accesses to remapped areas are accounted to their target.\n");
+    fprintf(out, "\n");
+
+    for (size_t i = 0; i < heatmap->regions_size; ++i) {
+        _heatmap_report_region(heatmap, &heatmap->regions[i], out);
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
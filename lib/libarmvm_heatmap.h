@@ -0,0 +1,88 @@
+/** @file */
+#ifndef __LIBARMVM_HEATMAP_H__
+#define __LIBARMVM_HEATMAP_H__
+
+#include <armvm.h>
+#include <stdio.h>
+
+/**
+ * @brief Default size of one bucket of the heatmap in bytes (one cache line).
+ */
+#define LIBARMVM_HEATMAP_DEFAULT_BUCKET_SIZE (64)
+
+/**
+ * @brief Index of a counter in one bucket: reads and writes for every access width.
+ */
+enum libarmvm_heatmap_counter {
+    LIBARMVM_HEATMAP_READ_8 = 0,
+    LIBARMVM_HEATMAP_READ_16,
+    LIBARMVM_HEATMAP_READ_32,
+    LIBARMVM_HEATMAP_WRITE_8,
+    LIBARMVM_HEATMAP_WRITE_16,
+    LIBARMVM_HEATMAP_WRITE_32,
+    // This have to be the last entry of the enum
+    LIBARMVM_HEATMAP_COUNTERS
+};
+
+
+/**
+ * @brief Access counters of one memory area, which is not remapped.
+ */
+struct libarmvm_heatmap_region {
+    uint32_t addr;
+    uint32_t size;
+    const char *name;
+    uint64_t (*buckets)[LIBARMVM_HEATMAP_COUNTERS]; /**< One set of counters per bucket. */
+};
+
+
+/**
+ * @brief Remapped area: accesses to [addr, addr + size) are redirected to remap_addr.
+ */
+struct libarmvm_heatmap_alias {
+    uint32_t addr;
+    uint32_t size;
+    uint32_t remap_addr;
+};
+
+
+/**
+ * @brief Counters for all memory accesses through armvm->mem.
+ * Accesses through remapped areas are accounted to the area, to which they are redirected.
+ */
+struct libarmvm_heatmap {
+    uint32_t bucket_shift; /**< log2 of the bucket size. */
+    struct libarmvm_heatmap_region *regions;
+    size_t regions_size;
+
+    struct libarmvm_heatmap_alias *aliases;
+    size_t aliases_size;
+};
+
+
+/**
+ * @brief Creates the counters for all memory areas and registers the heatmap as memory observer.
+ *
+ * @param bucket_size Size of one bucket in bytes. Has to be a power of two.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_heatmap_init(struct armvm *armvm, struct libarmvm_heatmap *heatmap, uint32_t bucket_size);
+
+
+/**
+ * @brief Frees all memory allocated by libarmvm_heatmap_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_heatmap_cleanup(struct libarmvm_heatmap *heatmap);
+
+
+/**
+ * @brief Writes the access statistics per area and the heatmap of all accessed buckets.
+ *
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_heatmap_report(const struct libarmvm_heatmap *heatmap, FILE *out);
+
+#endif
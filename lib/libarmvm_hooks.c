@@ -0,0 +1,202 @@
+#include <libarmvm_hooks.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+static inline int _hooks_in_range(const struct armvm_hook *hook, uint32_t addr)
+{
+    return addr >= hook->begin && (!hook->end || addr < hook->end);
+}
+
+
+void _hooks_memory_observe(struct libarmvm_hooks *hooks, enum armvm_hook_type type, uint32_t addr, uint8_t size, uint32_t value)
+{
+    struct armvm_hook_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.addr = addr;
+    event.size = size;
+    event.value = value;
+
+    int ret = libarmvm_hooks_call(hooks->armvm, hooks, &event);
+    if (ret && !hooks->memory_ret) {
+        hooks->memory_ret = ret;
+    }
+}
+
+
+void _hooks_read_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    _hooks_memory_observe(data, ARMVM_HOOK_MEMORY_READ, addr, size, value);
+}
+
+
+void _hooks_write_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    _hooks_memory_observe(data, ARMVM_HOOK_MEMORY_WRITE, addr, size, value);
+}
+
+
+int libarmvm_hooks_init(struct armvm *armvm, struct libarmvm_hooks *hooks)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    assert(armvm);
+
+    memset(hooks, 0, sizeof(*hooks));
+    hooks->armvm = armvm;
+
+    for (size_t i = 0; i < armvm->opts.hooks_size; ++i) {
+        const struct armvm_hook *hook = &armvm->opts.hooks[i];
+        if (hook->type >= ARMVM_HOOK_TYPES || !hook->callback) {
+            fprintf(stderr, "ERROR: Invalid hook (armvm_opts.hooks[%zu]).\n", i);
+            ret = ARMVM_RET_INVALID_OPTS;
+            goto err;
+        }
+
+        struct armvm_hook *vector = realloc(hooks->hooks[hook->type], (hooks->hooks_size[hook->type] + 1) * sizeof(*vector));
+        if (!vector) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            ret = ARMVM_RET_NO_MEM;
+            goto err;
+        }
+        vector[hooks->hooks_size[hook->type]++] = *hook;
+        hooks->hooks[hook->type] = vector;
+    }
+
+    if (hooks->hooks_size[ARMVM_HOOK_MEMORY_READ] || hooks->hooks_size[ARMVM_HOOK_MEMORY_WRITE]) {
+        struct libarmvm_memory_observer observer = { NULL, NULL, hooks };
+        if (hooks->hooks_size[ARMVM_HOOK_MEMORY_READ]) {
+            observer.read = _hooks_read_observe;
+        }
+        if (hooks->hooks_size[ARMVM_HOOK_MEMORY_WRITE]) {
+            observer.write = _hooks_write_observe;
+        }
+
+        ret = libarmvm_memory_add_observer(armvm, &observer);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    return ret;
+err:
+    libarmvm_hooks_cleanup(hooks);
+    return ret;
+}
+
+
+int libarmvm_hooks_cleanup(struct libarmvm_hooks *hooks)
+{
+    for (size_t i = 0; i < ARMVM_HOOK_TYPES; ++i) {
+        free(hooks->hooks[i]);
+        hooks->hooks[i] = NULL;
+        hooks->hooks_size[i] = 0;
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_hooks_call(struct armvm *armvm, struct libarmvm_hooks *hooks, const struct armvm_hook_event *event)
+{
+    const struct armvm_hook *vector = hooks->hooks[event->type];
+
+    for (size_t i = 0; i < hooks->hooks_size[event->type]; ++i) {
+        if (!_hooks_in_range(&vector[i], event->addr)) {
+            continue;
+        }
+
+        int ret = vector[i].callback(armvm, event, vector[i].data);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_hooks_instruction(struct armvm *armvm, struct libarmvm_hooks *hooks, const struct armv6m_instruction *instruction)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct armvm_hook_event event;
+
+    memset(&event, 0, sizeof(event));
+    event.addr = instruction->addr;
+
+    if (hooks->hooks_size[ARMVM_HOOK_BASIC_BLOCK] && (!hooks->started || instruction->addr != hooks->next_addr)) {
+        event.type = ARMVM_HOOK_BASIC_BLOCK;
+        ret = libarmvm_hooks_call(armvm, hooks, &event);
+        if (ret) {
+            goto err;
+        }
+    }
+    hooks->started = 1;
+    hooks->next_addr = instruction->addr + (instruction->is32Bit ? 4 : 2);
+
+    if (hooks->hooks_size[ARMVM_HOOK_INSTRUCTION]) {
+        event.type = ARMVM_HOOK_INSTRUCTION;
+        ret = libarmvm_hooks_call(armvm, hooks, &event);
+    }
+
+err:
+    return ret;
+}
+
+
+/**
+ * Calls all hooks of event->type without checking the range.
+ */
+int _hooks_call_all(struct armvm *armvm, struct libarmvm_hooks *hooks, const struct armvm_hook_event *event)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    const struct armvm_hook *vector = hooks->hooks[event->type];
+
+    for (size_t i = 0; i < hooks->hooks_size[event->type]; ++i) {
+        int hook_ret = vector[i].callback(armvm, event, vector[i].data);
+        if (hook_ret && !ret) {
+            ret = hook_ret;
+        }
+    }
+
+    return ret;
+}
+
+
+int libarmvm_hooks_exception(struct armvm *armvm, enum armvm_hook_type type, uint32_t exception_number)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armvm_hook_event event;
+
+    if (!ci->hooks || !ci->hooks->hooks_size[type]) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.addr = exception_number;
+
+    return _hooks_call_all(armvm, ci->hooks, &event);
+}
+
+
+void libarmvm_hooks_stop(struct armvm *armvm, int ret)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    struct armvm_hook_event event;
+
+    if (!ci->hooks || !ci->hooks->hooks_size[ARMVM_HOOK_STOP]) {
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.type = ARMVM_HOOK_STOP;
+    event.ret = ret;
+
+    _hooks_call_all(armvm, ci->hooks, &event);
+}
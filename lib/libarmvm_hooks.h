@@ -0,0 +1,85 @@
+/** @file */
+#ifndef __LIBARMVM_HOOKS_H__
+#define __LIBARMVM_HOOKS_H__
+
+#include <armvm.h>
+#include <isa/armv6_m.h>
+
+/**
+ * @brief The registered hooks, sorted by their kind.
+ */
+struct libarmvm_hooks {
+    struct armvm_hook *hooks[ARMVM_HOOK_TYPES]; /**< One vector of hooks per kind. */
+    size_t hooks_size[ARMVM_HOOK_TYPES];        /**< Sizes of the vectors. */
+
+    struct armvm *armvm;     /**< Is passed to the memory hooks. */
+    uint32_t next_addr;      /**< Address of the next instruction if no branch is taken. */
+    uint8_t started;         /**< Set after the first instruction was executed. */
+    int memory_ret;          /**< First return value of a memory hook which was not ARMVM_RET_SUCCESS. */
+};
+
+
+/**
+ * @brief Sorts the hooks of armvm->opts by their kind.
+ * If there are memory hooks, they are registered as memory observer. Therefore, armvm->mem has
+ * to be initialized.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_hooks_init(struct armvm *armvm, struct libarmvm_hooks *hooks);
+
+
+/**
+ * @brief Frees all memory allocated by libarmvm_hooks_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_hooks_cleanup(struct libarmvm_hooks *hooks);
+
+
+/**
+ * @brief Returns 1 if the execution of every step has to be instrumented for the hooks.
+ */
+static inline int libarmvm_hooks_instrument_step(const struct libarmvm_hooks *hooks)
+{
+    return    hooks->hooks_size[ARMVM_HOOK_INSTRUCTION]
+           || hooks->hooks_size[ARMVM_HOOK_BASIC_BLOCK]
+           || hooks->hooks_size[ARMVM_HOOK_MEMORY_READ]
+           || hooks->hooks_size[ARMVM_HOOK_MEMORY_WRITE];
+}
+
+
+/**
+ * @brief Calls all hooks of event->type whose range contains event->addr.
+ *
+ * @return ARMVM_RET_SUCCESS or the first other return value of a hook.
+ */
+int libarmvm_hooks_call(struct armvm *armvm, struct libarmvm_hooks *hooks, const struct armvm_hook_event *event);
+
+
+/**
+ * @brief Calls the basic block and instruction hooks. Has to be called before the instruction is executed.
+ *
+ * @return ARMVM_RET_SUCCESS or the first other return value of a hook.
+ */
+int libarmvm_hooks_instruction(struct armvm *armvm, struct libarmvm_hooks *hooks, const struct armv6m_instruction *instruction);
+
+
+/**
+ * @brief Calls the exception entry or exit hooks, if hooks are registered.
+ *
+ * @param type ARMVM_HOOK_EXCEPTION_ENTRY or ARMVM_HOOK_EXCEPTION_EXIT.
+ * @param exception_number Number of the exception.
+ * @return ARMVM_RET_SUCCESS or the first other return value of a hook.
+ */
+int libarmvm_hooks_exception(struct armvm *armvm, enum armvm_hook_type type, uint32_t exception_number);
+
+
+/**
+ * @brief Calls the stop hooks, if hooks are registered.
+ *
+ * @param ret Return value of the execution.
+ */
+void libarmvm_hooks_stop(struct armvm *armvm, int ret);
+
+#endif
@@ -0,0 +1,329 @@
+#include <libarmvm_lockstep.h>
+#include <libarmvm.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_ci.h>
+#include <isa/armv6_m.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <assert.h>
+
+/*
+ * A PUSH/POP writes up to nine words, therefore the write log needs up to nine entries per step.
+ * If the write log is too small, the whole memory is compared instead.
+ */
+#define LOCKSTEP_WRITES_PER_STEP     (9)
+#define LOCKSTEP_MAX_LOG_CAPACITY    (1024 * 1024)
+#define LOCKSTEP_MAX_REPORTED_BYTES  (16)
+
+
+int _lockstep_compare_registers(const struct libarmvm_registers *regs, const struct libarmvm_registers *ref)
+{
+    int diverged = 0;
+
+#define COMPARE(name, a, b) \
+    if ((a) != (b)) { \
+        fprintf(stderr, "  %-10s: 0x%08x (reference: 0x%08x)\n", name, a, b); \
+        diverged = 1; \
+    }
+
+    for (uint8_t i = 0; i < LIBARMVM_GPR_SIZE; ++i) {
+        COMPARE(armv6m_reg_idx_to_string(i), regs->gpr[i], ref->gpr[i]);
+    }
+    COMPARE("PSR", regs->psr, ref->psr);
+    COMPARE("CONTROL", regs->control, ref->control);
+    COMPARE("SP_main", regs->SP_main, ref->SP_main);
+    COMPARE("SP_process", regs->SP_process, ref->SP_process);
+#undef COMPARE
+
+    return diverged;
+}
+
+
+/**
+ * @brief Reads a byte directly from the memory areas. Unlike armvm->mem->read_byte(), the read is
+ * not seen by the observers of the memory (e.g. the heatmap or the read hooks).
+ *
+ * @return ARMVM_RET_SUCCESS on success. ARMVM_RET_INVALID_ADDR if addr is not plain memory.
+ */
+int _lockstep_read_byte(const struct libarmvm_memory *mem, uint32_t addr, uint8_t *value)
+{
+    const struct libarmvm_memory_area *area = libarmvm_memory_get_area(mem, addr);
+    while (area && REMAP == area->type) {
+        addr = addr - area->addr + area->u.remap_addr;
+        area = libarmvm_memory_get_area(mem, addr);
+    }
+    if (!area || PERIPHERAL == area->type) {
+        return ARMVM_RET_INVALID_ADDR;
+    }
+
+    *value = area->u.data[addr - area->addr];
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _lockstep_compare_log(struct armvm *armvm, struct armvm *ref, const struct libarmvm_memory *log_mem, size_t *reported)
+{
+    int diverged = 0;
+
+    for (size_t i = 0; i < log_mem->write_log_size; ++i) {
+        // reading the registers of a peripheral may change its state
+        const struct libarmvm_memory_area *area = libarmvm_memory_get_area(log_mem, log_mem->write_log[i].addr);
+        if (area && PERIPHERAL == area->type) {
+            continue;
+        }
+
+        for (uint32_t j = 0; j < log_mem->write_log[i].size; ++j) {
+            uint32_t addr = log_mem->write_log[i].addr + j;
+            uint8_t value;
+            uint8_t ref_value;
+
+            if (   _lockstep_read_byte(armvm->mem->data, addr, &value)
+                || _lockstep_read_byte(ref->mem->data, addr, &ref_value)) {
+                fprintf(stderr, "ERROR: Could not read written memory at 0x%08x.\n", addr);
+                return 1;
+            }
+
+            if (value != ref_value) {
+                if (*reported < LOCKSTEP_MAX_REPORTED_BYTES) {
+                    fprintf(stderr, "  0x%08x: 0x%02x (reference: 0x%02x)\n", addr, value, ref_value);
+                }
+                (*reported)++;
+                diverged = 1;
+            }
+        }
+    }
+
+    return diverged;
+}
+
+
+int _lockstep_compare_areas(const struct libarmvm_memory *mem, const struct libarmvm_memory *ref, size_t *reported)
+{
+    int diverged = 0;
+
+    assert(mem->areas_size == ref->areas_size);
+    for (size_t i = 0; i < mem->areas_size; ++i) {
+        // the state of the peripherals is not compared
+        if (REMAP == mem->areas[i].type || PERIPHERAL == mem->areas[i].type) {
+            continue;
+        }
+
+        if (!memcmp(mem->areas[i].u.data, ref->areas[i].u.data, mem->areas[i].size)) {
+            continue;
+        }
+
+        for (uint32_t offset = 0; offset < mem->areas[i].size; ++offset) {
+            if (mem->areas[i].u.data[offset] != ref->areas[i].u.data[offset]) {
+                if (*reported < LOCKSTEP_MAX_REPORTED_BYTES) {
+                    fprintf(stderr, "  0x%08x: 0x%02x (reference: 0x%02x)\n", mem->areas[i].addr + offset,
+                                                                              mem->areas[i].u.data[offset],
+                                                                              ref->areas[i].u.data[offset]);
+                }
+                (*reported)++;
+                diverged = 1;
+            }
+        }
+    }
+
+    return diverged;
+}
+
+
+int _lockstep_compare(struct armvm *armvm, struct armvm *ref, uint64_t first_step, uint64_t last_step)
+{
+    struct libarmvm_memory *mem = armvm->mem->data;
+    struct libarmvm_memory *ref_mem = ref->mem->data;
+    size_t reported = 0;
+    int diverged = 0;
+
+    if (_lockstep_compare_registers(armvm->regs->data, ref->regs->data)) {
+        diverged = 1;
+    }
+
+    if (mem->write_log_overflow || ref_mem->write_log_overflow) {
+        if (_lockstep_compare_areas(mem, ref_mem, &reported)) {
+            diverged = 1;
+        }
+    } else {
+        if (_lockstep_compare_log(armvm, ref, mem, &reported)) {
+            diverged = 1;
+        }
+        if (_lockstep_compare_log(armvm, ref, ref_mem, &reported)) {
+            diverged = 1;
+        }
+    }
+
+    if (reported > LOCKSTEP_MAX_REPORTED_BYTES) {
+        fprintf(stderr, "  ... %zu more differing bytes\n", reported - LOCKSTEP_MAX_REPORTED_BYTES);
+    }
+
+    if (diverged) {
+        fprintf(stderr, "ERROR: Lockstep divergence between step %" PRIu64 " and step %" PRIu64 " (see differences above).\n", first_step, last_step);
+    }
+
+    libarmvm_memory_write_log_clear(mem);
+    libarmvm_memory_write_log_clear(ref_mem);
+
+    return diverged;
+}
+
+
+int libarmvm_lockstep_run(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct armvm ref;
+    struct libarmvm_semihosting_replay replay;
+
+    assert(armvm);
+    assert(armvm->opts.lockstep);
+
+    memset(&ref, 0, sizeof(ref));
+    memset(&replay, 0, sizeof(replay));
+    if (_libarmvm_opts_copy(&ref.opts, &armvm->opts)) {
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    // the reference instance does not collect any profiling data, is not traced and does not exchange data with the host
+    free(ref.opts.profile_file);
+    ref.opts.profile_file = NULL;
+    free(ref.opts.trace_file);
+    ref.opts.trace_file = NULL;
+    free(ref.opts.callgraph_file);
+    ref.opts.callgraph_file = NULL;
+    free(ref.opts.folded_file);
+    ref.opts.folded_file = NULL;
+    free(ref.opts.coverage_file);
+    ref.opts.coverage_file = NULL;
+    free(ref.opts.heatmap_file);
+    ref.opts.heatmap_file = NULL;
+    free(ref.opts.stack_file);
+    ref.opts.stack_file = NULL;
+    ref.opts.stack_guard_main = 0;
+    ref.opts.stack_guard_process = 0;
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        if (ref.opts.usart_input[i]) {
+            fprintf(stderr, "WARN: The reference instance does not receive the input of USART%zu, both instances may diverge.\n", i + 1);
+        }
+        free(ref.opts.usart_output[i]);
+        ref.opts.usart_output[i] = NULL;
+        free(ref.opts.usart_input[i]);
+        ref.opts.usart_input[i] = NULL;
+    }
+    free(ref.opts.gpio_vcd_file);
+    ref.opts.gpio_vcd_file = NULL;
+    free(ref.opts.hooks);
+    ref.opts.hooks = NULL;
+    ref.opts.hooks_size = 0;
+
+    ret = _libarmvm_init(&ref);
+    if (ret) {
+        fprintf(stderr, "ERROR: Could not initialize the lockstep reference instance.\n");
+        goto err_opts;
+    }
+    ((struct libarmvm_ci *)ref.ci->data)->reference = 1;
+
+    // the reference instance replays the results of the host files, which the vm got
+    ((struct libarmvm_ci *)armvm->ci->data)->replay = &replay;
+    ((struct libarmvm_ci *)ref.ci->data)->replay = &replay;
+
+    size_t capacity = LOCKSTEP_MAX_LOG_CAPACITY;
+    if (armvm->opts.lockstep < LOCKSTEP_MAX_LOG_CAPACITY / LOCKSTEP_WRITES_PER_STEP) {
+        capacity = armvm->opts.lockstep * LOCKSTEP_WRITES_PER_STEP;
+    }
+
+    ret = libarmvm_memory_write_log_enable(armvm, capacity);
+    if (ret) {
+        goto err_ref;
+    }
+
+    ret = libarmvm_memory_write_log_enable(&ref, capacity);
+    if (ret) {
+        goto err_ref;
+    }
+
+    uint64_t step = 0;
+    uint64_t compared = 0;
+    while (!armvm->opts.steps || step < armvm->opts.steps) {
+        // both instances run until the next comparison, the vm may skip idle loops
+        uint64_t chunk = armvm->opts.lockstep - step % armvm->opts.lockstep;
+        if (armvm->opts.steps && chunk > armvm->opts.steps - step) {
+            chunk = armvm->opts.steps - step;
+        }
+
+        uint64_t executed;
+        uint64_t ref_executed;
+        int step_ret = armvm->ci->run(armvm, chunk, &executed);
+        // the guard of the stack stops the vm before the next instruction, the reference instance has no guard
+        const int failed = step_ret && ARMVM_RET_STACK_OVERFLOW != step_ret;
+        int ref_ret = ref.ci->run(&ref, failed ? executed + 1 : executed, &ref_executed);
+        if (ref_ret) {
+            if (ref_executed < executed) {
+                // the reference instance failed before the vm
+                step_ret = ARMVM_RET_SUCCESS;
+            }
+            step += ref_executed + 1;
+        } else {
+            step += executed + (failed ? 1 : 0);
+        }
+
+        if (ARMVM_RET_STACK_OVERFLOW == step_ret && !ref_ret) {
+            ret = _lockstep_compare(armvm, &ref, compared + 1, step) ? ARMVM_RET_DIVERGED : ARMVM_RET_STACK_OVERFLOW;
+            goto err_ref;
+        }
+
+        if (step_ret || ref_ret) {
+            if (ARMVM_RET_EXIT == step_ret && ARMVM_RET_EXIT == ref_ret) {
+                // both instances stopped at the same step, their final states are compared
+                if (_lockstep_compare(armvm, &ref, compared + 1, step) || armvm->exit_code != ref.exit_code) {
+                    ret = ARMVM_RET_DIVERGED;
+                    goto err_ref;
+                }
+                printf("Program exited with code %d after %" PRIu64 " steps in lockstep.\n", armvm->exit_code, step);
+                _libarmvm_print_time(armvm);
+                ret = ARMVM_RET_EXIT;
+                goto err_ref;
+            }
+            if (!step_ret != !ref_ret) {
+                fprintf(stderr, "ERROR: Lockstep divergence at step %" PRIu64 ": %s failed.\n", step,
+                                step_ret ? "the vm" : "the reference instance");
+                _lockstep_compare(armvm, &ref, compared + 1, step);
+                ret = ARMVM_RET_DIVERGED;
+            } else {
+                ret = ARMVM_RET_FAIL;
+            }
+            goto err_ref;
+        }
+
+        if (0 == step % armvm->opts.lockstep || step == armvm->opts.steps) {
+            if (_lockstep_compare(armvm, &ref, compared + 1, step)) {
+                ret = ARMVM_RET_DIVERGED;
+                goto err_ref;
+            }
+            compared = step;
+        }
+
+        if (!armvm->opts.steps && libarmvm_ci_sleeps_forever(armvm)) {
+            fprintf(stderr, "WARN: The core sleeps and nothing can wake it up anymore, the vm is stopped.\n");
+            break;
+        }
+    }
+    printf("Successful executed %" PRIu64 " steps in lockstep.\n", step);
+    _libarmvm_print_time(armvm);
+
+err_ref:
+    ((struct libarmvm_ci *)armvm->ci->data)->replay = NULL;
+    free(replay.data);
+    if (_libarmvm_cleanup(&ref)) {
+        ret = ARMVM_RET_FAIL;
+    }
+err_opts:
+    if (armvm_opts_cleanup(&ref.opts)) {
+        ret = ARMVM_RET_FAIL;
+    }
+err:
+    return ret;
+}
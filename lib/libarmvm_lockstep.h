@@ -0,0 +1,24 @@
+/** @file */
+#ifndef __LIBARMVM_LOCKSTEP_H__
+#define __LIBARMVM_LOCKSTEP_H__
+
+#include <armvm.h>
+
+/**
+ * @brief Runs armvm in lockstep with a reference instance of the virtual machine.
+ * The reference instance is created from armvm->opts and executes every step with the
+ * reference interpreter. Every armvm->opts.lockstep steps, the register file, the PSR,
+ * the CONTROL register, both stack pointers and all memory written since the last
+ * comparison are compared. On the first divergence a diff report is printed to stderr
+ * and the execution stops.
+ *
+ * armvm has to be initialized with _libarmvm_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ *         ARMVM_RET_DIVERGED if armvm and the reference instance diverged.
+ *         ARMVM_RET_EXIT if the program stopped both instances at the same step (see armvm->exit_code).
+ *         ARMVM_RET_STACK_OVERFLOW if a stack pointer of armvm crossed its guard.
+ */
+int libarmvm_lockstep_run(struct armvm *armvm);
+
+#endif
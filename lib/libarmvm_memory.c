@@ -1,4 +1,5 @@
 #include <libarmvm_memory.h>
+#include <libarmvm_heatmap.h>
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -38,6 +39,21 @@ struct libarmvm_memory_area *_get_memory_area(struct libarmvm_memory *mem, const
 }
 
 
+/**
+ * @brief Reads a register of a peripheral and counts the read, if the register is not time-invariant.
+ */
+static inline int _read_peripheral(struct libarmvm_memory *mem, const struct libarmvm_memory_area *area,
+                                   uint32_t offset, uint8_t size, uint32_t *value)
+{
+    const struct libarmvm_memory_peripheral *periph = &area->u.periph;
+
+    if (!periph->time_invariant || !periph->time_invariant(periph->data, offset)) {
+        mem->volatile_reads++;
+    }
+    return periph->read(periph->data, offset, size, value);
+}
+
+
 int _read_byte(void *data, uint32_t src_addr, uint8_t *dest)
 {
     struct libarmvm_memory_area *area = _get_memory_area(data, src_addr, 1);
@@ -51,6 +67,13 @@ int _read_byte(void *data, uint32_t src_addr, uint8_t *dest)
         return _read_byte(data, offset + area->u.remap_addr, dest);
     }
 
+    if (PERIPHERAL == area->type) {
+        uint32_t value = 0;
+        int ret = _read_peripheral(data, area, offset, 1, &value);
+        *dest = value;
+        return ret;
+    }
+
     uint8_t *mem = area->u.data + offset;
     *dest = *mem;
 
@@ -71,6 +94,13 @@ int _read_halfword_unaligned(void *data, uint32_t src_addr, uint16_t *dest)
         return _read_halfword_unaligned(data, offset + area->u.remap_addr, dest);
     }
 
+    if (PERIPHERAL == area->type) {
+        uint32_t value = 0;
+        int ret = _read_peripheral(data, area, offset, 2, &value);
+        *dest = value;
+        return ret;
+    }
+
     uint16_t *mem = (uint16_t *)(area->u.data + offset);
     *dest = *mem;
 
@@ -102,6 +132,13 @@ int _read_word_unaligned(void *data, uint32_t src_addr, uint32_t *dest)
         return _read_word_unaligned(data, offset + area->u.remap_addr, dest);
     }
 
+    if (PERIPHERAL == area->type) {
+        uint32_t value = 0;
+        int ret = _read_peripheral(data, area, offset, 4, &value);
+        *dest = value;
+        return ret;
+    }
+
     uint32_t *mem = (uint32_t *)(area->u.data + offset);
     *dest = *mem;
 
@@ -133,6 +170,10 @@ int _write_byte(void *data, uint32_t dest_addr, const uint8_t *src)
         return _write_byte(data, offset + area->u.remap_addr, src);
     }
 
+    if (PERIPHERAL == area->type) {
+        return area->u.periph.write(area->u.periph.data, offset, 1, *src);
+    }
+
     uint8_t *mem = area->u.data + offset;
     *mem = *src;
 
@@ -153,6 +194,10 @@ int _write_halfword_unaligned(void *data, uint32_t dest_addr, const uint16_t *sr
         return _write_halfword_unaligned(data, offset + area->u.remap_addr, src);
     }
 
+    if (PERIPHERAL == area->type) {
+        return area->u.periph.write(area->u.periph.data, offset, 2, *src);
+    }
+
     uint16_t *mem = (uint16_t *)(area->u.data + offset);
     *mem = *src;
 
@@ -184,6 +229,10 @@ int _write_word_unaligned(void *data, uint32_t dest_addr, const uint32_t *src)
         return _write_word_unaligned(data, offset + area->u.remap_addr, src);
     }
 
+    if (PERIPHERAL == area->type) {
+        return area->u.periph.write(area->u.periph.data, offset, 4, *src);
+    }
+
     uint32_t *mem = (uint32_t *)(area->u.data + offset);
     *mem = *src;
 
@@ -202,6 +251,77 @@ int _write_word(void *data, uint32_t dest_addr, const uint32_t *src)
 }
 
 
+void _notify_read(struct libarmvm_memory *mem, uint32_t addr, uint8_t size, uint32_t value)
+{
+    for (size_t i = 0; i < mem->observers_size; ++i) {
+        if (mem->observers[i].read) {
+            mem->observers[i].read(mem->observers[i].data, addr, size, value);
+        }
+    }
+}
+
+
+void _notify_write(struct libarmvm_memory *mem, uint32_t addr, uint8_t size, uint32_t value)
+{
+    for (size_t i = 0; i < mem->observers_size; ++i) {
+        if (mem->observers[i].write) {
+            mem->observers[i].write(mem->observers[i].data, addr, size, value);
+        }
+    }
+}
+
+
+#define OBSERVED_READ(name, type, size) \
+int name##_observed(void *data, uint32_t src_addr, type *dest) \
+{ \
+    int ret = name(data, src_addr, dest); \
+    if (ARMVM_RET_SUCCESS == ret) { \
+        _notify_read(data, src_addr, size, *dest); \
+    } \
+    return ret; \
+}
+
+#define OBSERVED_WRITE(name, type, size) \
+int name##_observed(void *data, uint32_t dest_addr, const type *src) \
+{ \
+    int ret = name(data, dest_addr, src); \
+    if (ARMVM_RET_SUCCESS == ret) { \
+        _notify_write(data, dest_addr, size, *src); \
+    } \
+    return ret; \
+}
+
+OBSERVED_READ(_read_byte, uint8_t, 1)
+OBSERVED_READ(_read_halfword, uint16_t, 2)
+OBSERVED_READ(_read_word, uint32_t, 4)
+OBSERVED_READ(_read_halfword_unaligned, uint16_t, 2)
+OBSERVED_READ(_read_word_unaligned, uint32_t, 4)
+
+OBSERVED_WRITE(_write_byte, uint8_t, 1)
+OBSERVED_WRITE(_write_halfword, uint16_t, 2)
+OBSERVED_WRITE(_write_word, uint32_t, 4)
+OBSERVED_WRITE(_write_halfword_unaligned, uint16_t, 2)
+OBSERVED_WRITE(_write_word_unaligned, uint32_t, 4)
+
+#undef OBSERVED_READ
+#undef OBSERVED_WRITE
+
+
+void _write_log_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    struct libarmvm_memory *mem = data;
+
+    if (mem->write_log_size >= mem->write_log_capacity) {
+        mem->write_log_overflow = 1;
+        return;
+    }
+
+    mem->write_log[mem->write_log_size].addr = addr;
+    mem->write_log[mem->write_log_size].size = size;
+    mem->write_log_size++;
+}
+
+
 int libarmvm_memory_init(struct armvm *armvm)
 {
     int ret = ARMVM_RET_SUCCESS;
@@ -304,7 +424,7 @@ int libarmvm_memory_cleanup(struct armvm *armvm)
             struct libarmvm_memory *mem = armvm->mem->data;
             if (mem->areas) {
                 for (size_t i = 0; mem->areas_size > i; ++i) {
-                    if (REMAP == mem->areas[i].type) {
+                    if (REMAP == mem->areas[i].type || PERIPHERAL == mem->areas[i].type) {
                         continue;
                     }
                     free(mem->areas[i].u.data);
@@ -314,6 +434,22 @@ int libarmvm_memory_cleanup(struct armvm *armvm)
                 mem->areas = NULL;
                 mem->areas_size = 0;
             }
+            if (mem->heatmap) {
+                libarmvm_heatmap_cleanup(mem->heatmap);
+                free(mem->heatmap);
+                mem->heatmap = NULL;
+            }
+            if (mem->observers) {
+                free(mem->observers);
+                mem->observers = NULL;
+                mem->observers_size = 0;
+            }
+            if (mem->write_log) {
+                free(mem->write_log);
+                mem->write_log = NULL;
+                mem->write_log_size = 0;
+                mem->write_log_capacity = 0;
+            }
             free(armvm->mem->data);
             armvm->mem->data = NULL;
         }
@@ -372,3 +508,385 @@ err:
     return ret;
 }
 
+
+int libarmvm_memory_get_flash(const struct libarmvm_memory *mem, struct libarmvm_memory_flash *flash)
+{
+    memset(flash, 0, sizeof(*flash));
+
+    for (size_t i = 0; i < mem->areas_size; ++i) {
+        if (FLASH == mem->areas[i].type) {
+            flash->base = mem->areas[i].addr;
+            flash->size = mem->areas[i].size;
+            break;
+        }
+    }
+
+    if (!flash->size) {
+        return ARMVM_RET_FAIL;
+    }
+
+    for (size_t i = 0; i < mem->areas_size; ++i) {
+        if (REMAP == mem->areas[i].type && flash->base == mem->areas[i].u.remap_addr) {
+            flash->alias_base = mem->areas[i].addr;
+            flash->alias_size = mem->areas[i].size < flash->size ? mem->areas[i].size : flash->size;
+            break;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+const struct libarmvm_memory_area *libarmvm_memory_get_area(const struct libarmvm_memory *mem, uint32_t addr)
+{
+    return _get_memory_area((struct libarmvm_memory *)mem, addr, 1);
+}
+
+
+int libarmvm_memory_add_peripheral(struct armvm *armvm, uint32_t addr, uint32_t size, const struct libarmvm_memory_peripheral *periph)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+    assert(periph->read);
+    assert(periph->write);
+
+    struct libarmvm_memory *mem = armvm->mem->data;
+
+    if (mem->heatmap) {
+        fprintf(stderr, "ERROR: Peripherals have to be added before the heatmap is enabled.\n");
+        return ARMVM_RET_FAIL;
+    }
+
+    if (!size || addr + (size - 1) < addr) {
+        fprintf(stderr, "ERROR: Invalid peripheral area: 0x%08x, size %u\n", addr, size);
+        return ARMVM_RET_INVALID_PARAM;
+    }
+
+    // first area which ends at or after addr
+    size_t idx = 0;
+    while (idx < mem->areas_size && mem->areas[idx].addr + (mem->areas[idx].size - 1) < addr) {
+        idx++;
+    }
+
+    struct libarmvm_memory_area *area = idx < mem->areas_size ? &mem->areas[idx] : NULL;
+    const int split = area && area->addr <= addr + (size - 1);
+    uint32_t before = 0;
+    uint32_t after = 0;
+    uint8_t *tail = NULL;
+
+    if (split) {
+        if (RAM != area->type || addr < area->addr || size > area->size - (addr - area->addr)) {
+            fprintf(stderr, "ERROR: The peripheral area 0x%08x (size %u) overlaps the memory area 0x%08x.\n", addr, size, area->addr);
+            return ARMVM_RET_FAIL;
+        }
+        before = addr - area->addr;
+        after = area->size - before - size;
+
+        // the part after the peripheral gets its own copy, so every area owns its data
+        if (after) {
+            tail = malloc(after);
+            if (!tail) {
+                fprintf(stderr, "ERROR: Not enough memory.\n");
+                return ARMVM_RET_NO_MEM;
+            }
+            memcpy(tail, area->u.data + before + size, after);
+        }
+    }
+
+    // the areas [idx, areas_size) are moved behind the new areas, a split area is replaced
+    const size_t removed = split && !before;
+    const size_t src = idx + (split ? 1 : 0);
+    const size_t dest = idx + (split && before ? 1 : 0) + 1 + (after ? 1 : 0);
+    const size_t areas_size = mem->areas_size - removed + 1 + (after ? 1 : 0);
+
+    struct libarmvm_memory_area *areas = realloc(mem->areas, areas_size * sizeof(*areas));
+    if (!areas) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        free(tail);
+        return ARMVM_RET_NO_MEM;
+    }
+    mem->areas = areas;
+    area = &areas[idx];
+
+    if (split) {
+        if (before) {
+            area->size = before;
+        } else {
+            free(area->u.data);
+        }
+    }
+    memmove(&areas[dest], &areas[src], (mem->areas_size - src) * sizeof(*areas));
+
+    struct libarmvm_memory_area *periph_area = &areas[dest - 1 - (after ? 1 : 0)];
+    periph_area->type = PERIPHERAL;
+    periph_area->addr = addr;
+    periph_area->size = size;
+    periph_area->u.periph = *periph;
+
+    if (after) {
+        areas[dest - 1].type = RAM;
+        areas[dest - 1].addr = addr + size;
+        areas[dest - 1].size = after;
+        areas[dest - 1].u.data = tail;
+    }
+    mem->areas_size = areas_size;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_memory_add_observer(struct armvm *armvm, const struct libarmvm_memory_observer *observer)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_memory *mem = armvm->mem->data;
+
+    struct libarmvm_memory_observer *observers = realloc(mem->observers, (mem->observers_size + 1) * sizeof(*observers));
+    if (!observers) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+    observers[mem->observers_size] = *observer;
+    mem->observers = observers;
+    mem->observers_size++;
+
+    if (observer->read) {
+        armvm->mem->read_byte     = _read_byte_observed;
+        armvm->mem->read_halfword = _read_halfword_observed;
+        armvm->mem->read_word     = _read_word_observed;
+        armvm->mem->read_halfword_unaligned = _read_halfword_unaligned_observed;
+        armvm->mem->read_word_unaligned     = _read_word_unaligned_observed;
+    }
+
+    if (observer->write) {
+        armvm->mem->write_byte     = _write_byte_observed;
+        armvm->mem->write_halfword = _write_halfword_observed;
+        armvm->mem->write_word     = _write_word_observed;
+        armvm->mem->write_halfword_unaligned = _write_halfword_unaligned_observed;
+        armvm->mem->write_word_unaligned     = _write_word_unaligned_observed;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * Returns the data of the memory area, which contains [addr, addr + size) and is neither remapped
+ * nor a peripheral. NULL if there is none.
+ */
+uint8_t *_memory_block(struct libarmvm_memory *mem, uint32_t addr, uint32_t size)
+{
+    struct libarmvm_memory_area *area = _get_memory_area(mem, addr, size);
+    if (!area || REMAP == area->type || PERIPHERAL == area->type) {
+        return NULL;
+    }
+    return area->u.data + (addr - area->addr);
+}
+
+
+int libarmvm_memory_write_words(struct armvm *armvm, uint32_t addr, const uint32_t *words, size_t size)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    if (addr % 4) {
+        return ARMVM_RET_ADDR_NOT_ALIGN;
+    }
+
+    uint8_t *block = _write_word == armvm->mem->write_word ? _memory_block(armvm->mem->data, addr, 4 * size) : NULL;
+    if (block) {
+        memcpy(block, words, 4 * size);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        int ret = armvm->mem->write_word(armvm->mem->data, addr + 4 * i, &words[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_memory_write_fifo(struct armvm *armvm, uint32_t addr, uint8_t size, const uint32_t *values, size_t count)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+    assert(1 == size || 2 == size || 4 == size);
+
+    if (addr % size) {
+        return ARMVM_RET_ADDR_NOT_ALIGN;
+    }
+
+    const struct libarmvm_memory_area *area = _write_word == armvm->mem->write_word ? _get_memory_area(armvm->mem->data, addr, size) : NULL;
+    if (area && PERIPHERAL == area->type && area->u.periph.write_fifo) {
+        return area->u.periph.write_fifo(area->u.periph.data, addr - area->addr, size, values, count);
+    }
+
+    int ret = ARMVM_RET_SUCCESS;
+    for (size_t i = 0; i < count && !ret; ++i) {
+        const uint8_t byte = values[i];
+        const uint16_t halfword = values[i];
+        switch (size) {
+            case 1:
+                ret = armvm->mem->write_byte(armvm->mem->data, addr, &byte);
+                break;
+            case 2:
+                ret = armvm->mem->write_halfword(armvm->mem->data, addr, &halfword);
+                break;
+            default:
+                ret = armvm->mem->write_word(armvm->mem->data, addr, &values[i]);
+                break;
+        }
+    }
+    return ret;
+}
+
+
+int libarmvm_memory_read_words(struct armvm *armvm, uint32_t addr, uint32_t *words, size_t size)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    if (addr % 4) {
+        return ARMVM_RET_ADDR_NOT_ALIGN;
+    }
+
+    const uint8_t *block = _read_word == armvm->mem->read_word ? _memory_block(armvm->mem->data, addr, 4 * size) : NULL;
+    if (block) {
+        memcpy(words, block, 4 * size);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        int ret = armvm->mem->read_word(armvm->mem->data, addr + 4 * i, &words[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_memory_write_bytes(struct armvm *armvm, uint32_t addr, const uint8_t *bytes, size_t size)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    if (!size) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    uint8_t *block = _write_byte == armvm->mem->write_byte ? _memory_block(armvm->mem->data, addr, size) : NULL;
+    if (block) {
+        memcpy(block, bytes, size);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        int ret = armvm->mem->write_byte(armvm->mem->data, addr + i, &bytes[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_memory_read_bytes(struct armvm *armvm, uint32_t addr, uint8_t *bytes, size_t size)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    if (!size) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    const uint8_t *block = _read_byte == armvm->mem->read_byte ? _memory_block(armvm->mem->data, addr, size) : NULL;
+    if (block) {
+        memcpy(bytes, block, size);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        int ret = armvm->mem->read_byte(armvm->mem->data, addr + i, &bytes[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_memory_heatmap_enable(struct armvm *armvm, uint32_t bucket_size)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_memory *mem = armvm->mem->data;
+
+    if (mem->heatmap) {
+        fprintf(stderr, "ERROR: Heatmap already enabled.\n");
+        return ARMVM_RET_FAIL;
+    }
+
+    mem->heatmap = calloc(1, sizeof(*mem->heatmap));
+    if (!mem->heatmap) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+
+    if (!bucket_size) {
+        bucket_size = LIBARMVM_HEATMAP_DEFAULT_BUCKET_SIZE;
+    }
+
+    int ret = libarmvm_heatmap_init(armvm, mem->heatmap, bucket_size);
+    if (ret) {
+        free(mem->heatmap);
+        mem->heatmap = NULL;
+    }
+    return ret;
+}
+
+
+int libarmvm_memory_write_log_enable(struct armvm *armvm, size_t capacity)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_memory *mem = armvm->mem->data;
+
+    if (mem->write_log) {
+        fprintf(stderr, "ERROR: Write log already enabled.\n");
+        return ARMVM_RET_FAIL;
+    }
+
+    mem->write_log = calloc(capacity, sizeof(*mem->write_log));
+    if (!mem->write_log) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+    mem->write_log_capacity = capacity;
+    libarmvm_memory_write_log_clear(mem);
+
+    const struct libarmvm_memory_observer observer = { NULL, _write_log_observe, mem };
+    return libarmvm_memory_add_observer(armvm, &observer);
+}
+
+
+void libarmvm_memory_write_log_clear(struct libarmvm_memory *mem)
+{
+    mem->write_log_size = 0;
+    mem->write_log_overflow = 0;
+}
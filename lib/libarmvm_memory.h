@@ -5,6 +5,8 @@
 #include <armvm.h>
 #include <stdlib.h>
 
+struct libarmvm_heatmap;
+
 /**
  * @brief Defines the different types of memory areas.
  */
@@ -12,7 +14,64 @@ enum libarmvm_memory_area_type {
     RAM,   /**< Random Access Memory (volatile) */
     ROM,   /**< Read Only Memory (non-volatile) */
     FLASH, /**< Random Access Memory (non-volatile) */
-    REMAP  /**< This part of the memory is mapped to a different memory address. All accesses to this memory will be redirected. */
+    REMAP, /**< This part of the memory is mapped to a different memory address. All accesses to this memory will be redirected. */
+    PERIPHERAL /**< Registers of a peripheral. All accesses are handled by the callbacks of the peripheral. */
+};
+
+
+/**
+ * @brief Callbacks of a memory mapped peripheral.
+ * @see libarmvm_memory_add_peripheral
+ */
+struct libarmvm_memory_peripheral {
+    /**
+     * @brief Is called for every read of the area of the peripheral.
+     *
+     * @param data The data pointer of the peripheral.
+     * @param offset Offset of the read address to the first address of the area.
+     * @param size Amount of read bytes (1, 2 or 4).
+     * @param value Pointer to the destination of the read value.
+     * @return ARMVM_RET_SUCCESS on success.
+     */
+    int (*read)(void *data, uint32_t offset, uint8_t size, uint32_t *value);
+
+    /**
+     * @brief Is called for every write to the area of the peripheral.
+     *
+     * @param data The data pointer of the peripheral.
+     * @param offset Offset of the written address to the first address of the area.
+     * @param size Amount of written bytes (1, 2 or 4).
+     * @param value The written value.
+     * @return ARMVM_RET_SUCCESS on success.
+     */
+    int (*write)(void *data, uint32_t offset, uint8_t size, uint32_t value);
+
+    void *data; /**< Is passed to read(), write() and write_fifo(). */
+
+    /**
+     * @brief Is called for consecutive writes to one address (e.g. a data register, which is served by the DMA),
+     * instead of calling write() for every value. May be NULL.
+     *
+     * @param data The data pointer of the peripheral.
+     * @param offset Offset of the written address to the first address of the area.
+     * @param size Amount of bytes of every value (1, 2 or 4).
+     * @param values The written values in the order of the writes.
+     * @param count Amount of values.
+     * @return ARMVM_RET_SUCCESS on success.
+     */
+    int (*write_fifo)(void *data, uint32_t offset, uint8_t size, const uint32_t *values, size_t count);
+
+    /**
+     * @brief Checks if a register is time-invariant: its value only changes by writes or at the
+     * events of the peripheral (see libarmvm_peripherals_schedule()), but not with every cycle.
+     * An idle loop, which polls such a register, may be skipped up to the next event. May be NULL,
+     * then no register is time-invariant.
+     *
+     * @param data The data pointer of the peripheral.
+     * @param offset Offset of the read address to the first address of the area.
+     * @return Non-zero, if the register is time-invariant.
+     */
+    int (*time_invariant)(void *data, uint32_t offset);
 };
 
 
@@ -32,13 +91,69 @@ struct libarmvm_memory_area {
 
         /**
          * @brief Pointer to the memory location, which holds the data of the memory area.
-         * Is only used, if type is not REMAP.
+         * Is only used, if type is RAM, ROM or FLASH.
          */
         uint8_t *data;
+
+        /**
+         * @brief Callbacks which handle all accesses to this area.
+         * Is only used, if type is PERIPHERAL.
+         */
+        struct libarmvm_memory_peripheral periph;
     } u;
 };
 
 
+/**
+ * @brief Observer of the memory accesses through the memory interface.
+ * @see libarmvm_memory_add_observer
+ */
+struct libarmvm_memory_observer {
+    /**
+     * @brief Is called after every successful read. May be NULL.
+     *
+     * @param data The data pointer of the observer.
+     * @param addr Address which was read.
+     * @param size Amount of read bytes (1, 2 or 4).
+     * @param value The read value.
+     */
+    void (*read)(void *data, uint32_t addr, uint8_t size, uint32_t value);
+
+    /**
+     * @brief Is called after every successful write. May be NULL.
+     *
+     * @param data The data pointer of the observer.
+     * @param addr Address which was written.
+     * @param size Amount of written bytes (1, 2 or 4).
+     * @param value The written value.
+     */
+    void (*write)(void *data, uint32_t addr, uint8_t size, uint32_t value);
+
+    void *data; /**< Is passed to read() and write(). */
+};
+
+
+/**
+ * @brief Location of the FLASH area and of the area which is remapped to it.
+ * @see libarmvm_memory_get_flash
+ */
+struct libarmvm_memory_flash {
+    uint32_t base;        /**< First address of the FLASH area. */
+    uint32_t size;        /**< Size of the FLASH area in bytes. */
+    uint32_t alias_base;  /**< First address of the area which is remapped to the FLASH area. */
+    uint32_t alias_size;  /**< Size of the remapped area (at most size). 0 if there is none. */
+};
+
+
+/**
+ * @brief One entry of the write log.
+ */
+struct libarmvm_memory_write {
+    uint32_t addr; /**< Address which was written to. */
+    uint32_t size; /**< Amount of written bytes. */
+};
+
+
 /**
  * @brief Holds all information related to the virtual machine memory.
  */
@@ -54,6 +169,49 @@ struct libarmvm_memory {
      * @brief Size of the areas vector.
      */
     size_t areas_size;
+
+    /**
+     * @brief Vector of all registered observers.
+     */
+    struct libarmvm_memory_observer *observers;
+
+    /**
+     * @brief Size of the observers vector.
+     */
+    size_t observers_size;
+
+    /**
+     * @brief Holds all writes since the last call of libarmvm_memory_write_log_clear().
+     * Is NULL, if the write log is not enabled.
+     */
+    struct libarmvm_memory_write *write_log;
+
+    /**
+     * @brief Amount of valid entries in write_log.
+     */
+    size_t write_log_size;
+
+    /**
+     * @brief Maximal amount of entries in write_log.
+     */
+    size_t write_log_capacity;
+
+    /**
+     * @brief Is set, if more than write_log_capacity writes happened since the last clear.
+     * In this case the write log is incomplete.
+     */
+    uint8_t write_log_overflow;
+
+    /**
+     * @brief Access counters per area and bucket. NULL if the heatmap is disabled.
+     */
+    struct libarmvm_heatmap *heatmap;
+
+    /**
+     * @brief Amount of reads of peripheral registers, which are not time-invariant (see
+     * libarmvm_memory_peripheral.time_invariant). An idle loop, which increments it, is not skipped.
+     */
+    uint64_t volatile_reads;
 };
 
 
@@ -83,4 +241,120 @@ int libarmvm_memory_cleanup(struct armvm *armvm);
  */
 int libarmvm_memory_load_program(struct armvm *armvm, uint32_t dest_addr, const char *program);
 
+
+/**
+ * @brief Locates the FLASH area and the area which is remapped to it.
+ *
+ * @param flash Pointer to the destination.
+ * @return ARMVM_RET_SUCCESS on success.
+ *         ARMVM_RET_FAIL if there is no FLASH area.
+ */
+int libarmvm_memory_get_flash(const struct libarmvm_memory *mem, struct libarmvm_memory_flash *flash);
+
+
+/**
+ * @brief Returns the memory area which contains the address addr. NULL if there is none.
+ */
+const struct libarmvm_memory_area *libarmvm_memory_get_area(const struct libarmvm_memory *mem, uint32_t addr);
+
+
+/**
+ * @brief Maps the registers of a peripheral to [addr, addr + size).
+ * The range must either be unmapped or lie within one RAM area, which is split around it.
+ * Peripherals have to be added before the heatmap is enabled.
+ *
+ * @param periph The callbacks are copied.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_add_peripheral(struct armvm *armvm, uint32_t addr, uint32_t size, const struct libarmvm_memory_peripheral *periph);
+
+
+/**
+ * @brief Registers an observer for all accesses through armvm->mem.
+ * Only if at least one observer for reads (or writes) is registered, the read (or write)
+ * functions of armvm->mem are replaced with functions which notify the observers.
+ * Without observers, the memory accesses have no additional overhead.
+ *
+ * @param observer The observer is copied.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_add_observer(struct armvm *armvm, const struct libarmvm_memory_observer *observer);
+
+
+/**
+ * @brief Writes size consecutive words to the word aligned address addr.
+ * If the words are in one memory area, which is no peripheral, and no write observer is registered, they are copied
+ * at once. Otherwise, every word is written through armvm->mem->write_word().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_write_words(struct armvm *armvm, uint32_t addr, const uint32_t *words, size_t size);
+
+
+/**
+ * @brief Writes count values of size bytes one after the other to the address addr, which is aligned to size.
+ * If the address is in a peripheral with write_fifo() and no write observer is registered, the values are passed
+ * at once. Otherwise, every value is written through armvm->mem.
+ *
+ * @param size Amount of bytes of every value (1, 2 or 4).
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_write_fifo(struct armvm *armvm, uint32_t addr, uint8_t size, const uint32_t *values, size_t count);
+
+
+/**
+ * @brief Reads size consecutive words from the word aligned address addr.
+ * If the words are in one memory area, which is no peripheral, and no read observer is registered, they are copied
+ * at once. Otherwise, every word is read through armvm->mem->read_word().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_read_words(struct armvm *armvm, uint32_t addr, uint32_t *words, size_t size);
+
+
+/**
+ * @brief Writes size consecutive bytes to the address addr.
+ * Like libarmvm_memory_write_words(), the bytes are copied at once if possible.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_write_bytes(struct armvm *armvm, uint32_t addr, const uint8_t *bytes, size_t size);
+
+
+/**
+ * @brief Reads size consecutive bytes from the address addr.
+ * Like libarmvm_memory_read_words(), the bytes are copied at once if possible.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_read_bytes(struct armvm *armvm, uint32_t addr, uint8_t *bytes, size_t size);
+
+
+/**
+ * @brief Enables the heatmap (see libarmvm_heatmap.h).
+ * All following accesses through armvm->mem are counted in libarmvm_memory.heatmap.
+ *
+ * @param bucket_size Size of one bucket in bytes (power of two). 0 selects the default.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_heatmap_enable(struct armvm *armvm, uint32_t bucket_size);
+
+
+/**
+ * @brief Enables the write log.
+ * After this call, all successful writes through armvm->mem are recorded in
+ * libarmvm_memory.write_log. The write log is an observer of the memory
+ * (see libarmvm_memory_add_observer()).
+ *
+ * @param capacity Maximal amount of writes recorded between two calls of libarmvm_memory_write_log_clear().
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_memory_write_log_enable(struct armvm *armvm, size_t capacity);
+
+
+/**
+ * @brief Removes all entries from the write log.
+ */
+void libarmvm_memory_write_log_clear(struct libarmvm_memory *mem);
+
 #endif
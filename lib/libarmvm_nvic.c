@@ -0,0 +1,381 @@
+#include <libarmvm_nvic.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_registers.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers to LIBARMVM_NVIC_BASE_ADDR.
+ */
+#define NVIC_ISER     (0x000)
+#define NVIC_ICER     (0x080)
+#define NVIC_ISPR     (0x100)
+#define NVIC_ICPR     (0x180)
+#define NVIC_IPR      (0x300)
+#define NVIC_IPR_SIZE (0x20)
+
+/*
+ * Offsets of the registers to LIBARMVM_SCB_BASE_ADDR.
+ */
+#define SCB_CPUID (0x00)
+#define SCB_ICSR  (0x04)
+#define SCB_AIRCR (0x0c)
+#define SCB_SHPR2 (0x1c)
+#define SCB_SHPR3 (0x20)
+
+#define SCB_CPUID_VALUE      (0x410cc200)  /**< Cortex-M0 r0p0 */
+#define SCB_AIRCR_VECTKEY    (0xfa050000)  /**< Read value of the key field of AIRCR. */
+
+#define SCB_ICSR_NMIPENDSET  ((uint32_t)0x1 << 31)
+#define SCB_ICSR_PENDSVSET   (0x1 << 28)
+#define SCB_ICSR_PENDSVCLR   (0x1 << 27)
+#define SCB_ICSR_PENDSTSET   (0x1 << 26)
+#define SCB_ICSR_PENDSTCLR   (0x1 << 25)
+#define SCB_ICSR_ISRPENDING  (0x1 << 22)
+
+#define NVIC_LEVEL_NMI          (0)
+#define NVIC_LEVEL_HARDFAULT    (1)
+#define NVIC_LEVEL_CONFIGURABLE (2)  /**< Level of the configurable priority 0x00. */
+
+#define NVIC_BIT(exception) ((uint64_t)1 << (exception))
+
+/**
+ * @brief Exceptions with a configurable priority.
+ */
+#define NVIC_CONFIGURABLE (  NVIC_BIT(ARMV6M_EXCEPTION_SVCALL) | NVIC_BIT(ARMV6M_EXCEPTION_PENDSV) \
+                           | NVIC_BIT(ARMV6M_EXCEPTION_SYSTICK) | ((uint64_t)0xffffffff << ARMV6M_EXCEPTION_IRQ0))
+
+/**
+ * @brief Exceptions which are always enabled.
+ */
+#define NVIC_SYSTEM (  NVIC_BIT(ARMV6M_EXCEPTION_NMI) | NVIC_BIT(ARMV6M_EXCEPTION_HARDFAULT) | NVIC_BIT(ARMV6M_EXCEPTION_SVCALL) \
+                     | NVIC_BIT(ARMV6M_EXCEPTION_PENDSV) | NVIC_BIT(ARMV6M_EXCEPTION_SYSTICK))
+
+
+static inline struct libarmvm_nvic *_nvic(struct armvm *armvm)
+{
+    return &((struct libarmvm_peripherals *)armvm->periph->data)->nvic;
+}
+
+
+/**
+ * @brief Returns the highest priority level of the exceptions. LIBARMVM_NVIC_LEVELS if there is none.
+ */
+static inline unsigned _nvic_level(const struct libarmvm_nvic *nvic, uint64_t exceptions)
+{
+    unsigned level = 0;
+    while (level < LIBARMVM_NVIC_LEVELS && !(exceptions & nvic->levels[level])) {
+        level++;
+    }
+    return level;
+}
+
+
+/**
+ * @brief Returns the level of the execution priority. Only exceptions of a higher level
+ * (a lower value) preempt the execution.
+ */
+static inline unsigned _nvic_execution_level(const struct libarmvm_nvic *nvic, const struct armv6m *armv6m)
+{
+    // PRIMASK raises the execution priority to 0, only NMI and HardFault preempt it
+    const unsigned level = _nvic_level(nvic, nvic->active);
+    if (armv6m->PRIMASK && level > NVIC_LEVEL_CONFIGURABLE) {
+        return NVIC_LEVEL_CONFIGURABLE;
+    }
+    return level;
+}
+
+
+void _nvic_set_priority(struct libarmvm_nvic *nvic, uint32_t exception, uint8_t priority)
+{
+    const uint64_t bit = NVIC_BIT(exception);
+
+    priority &= 0xc0;
+    nvic->priority[exception] = priority;
+    for (unsigned level = NVIC_LEVEL_CONFIGURABLE; level < LIBARMVM_NVIC_LEVELS; ++level) {
+        nvic->levels[level] &= ~bit;
+    }
+    nvic->levels[NVIC_LEVEL_CONFIGURABLE + (priority >> 6)] |= bit;
+}
+
+
+int _nvic_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    const struct libarmvm_nvic *nvic = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+    uint32_t word = 0;
+
+    if (NVIC_ISER == reg || NVIC_ICER == reg) {
+        word = nvic->enabled >> ARMV6M_EXCEPTION_IRQ0;
+    } else if (NVIC_ISPR == reg || NVIC_ICPR == reg) {
+        word = nvic->pending >> ARMV6M_EXCEPTION_IRQ0;
+    } else if (reg >= NVIC_IPR && reg < NVIC_IPR + NVIC_IPR_SIZE) {
+        const uint8_t *priority = &nvic->priority[ARMV6M_EXCEPTION_IRQ0 + (reg - NVIC_IPR)];
+        word = priority[0] | (priority[1] << 8) | (priority[2] << 16) | ((uint32_t)priority[3] << 24);
+    }
+
+    // all other registers are read as zero
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _nvic_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_nvic *nvic = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint64_t word = (uint64_t)(value << shift) << ARMV6M_EXCEPTION_IRQ0;
+
+    if (NVIC_ISER == reg) {
+        nvic->enabled |= word;
+    } else if (NVIC_ICER == reg) {
+        nvic->enabled &= ~word;
+    } else if (NVIC_ISPR == reg) {
+        nvic->pending |= word;
+    } else if (NVIC_ICPR == reg) {
+        nvic->pending &= ~word;
+    } else if (reg >= NVIC_IPR && reg < NVIC_IPR + NVIC_IPR_SIZE) {
+        const uint32_t exception = ARMV6M_EXCEPTION_IRQ0 + (offset - NVIC_IPR);
+        for (uint8_t i = 0; i < size && (offset & 0x3) + i < 4; ++i) {
+            _nvic_set_priority(nvic, exception + i, value >> (8 * i));
+        }
+    } else {
+        // all other registers ignore writes
+        return ARMVM_RET_SUCCESS;
+    }
+
+    libarmvm_nvic_update(nvic->armvm);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _scb_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    const struct libarmvm_nvic *nvic = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+    uint32_t word = nvic->scb[reg / 4];
+
+    if (SCB_CPUID == reg) {
+        word = SCB_CPUID_VALUE;
+    } else if (SCB_ICSR == reg) {
+        const uint64_t ready = nvic->pending & nvic->enabled;
+        uint32_t psr = 0;
+        nvic->armvm->regs->read_psr(nvic->armvm->regs->data, &psr);
+
+        word = psr & 0x3f;  // VECTACTIVE
+        if (ready) {
+            word |= __builtin_ctzll(ready & nvic->levels[_nvic_level(nvic, ready)]) << 12;  // VECTPENDING
+        }
+        if (nvic->pending >> ARMV6M_EXCEPTION_IRQ0) {
+            word |= SCB_ICSR_ISRPENDING;
+        }
+        if (nvic->pending & NVIC_BIT(ARMV6M_EXCEPTION_NMI)) {
+            word |= SCB_ICSR_NMIPENDSET;
+        }
+        if (nvic->pending & NVIC_BIT(ARMV6M_EXCEPTION_PENDSV)) {
+            word |= SCB_ICSR_PENDSVSET;
+        }
+        if (nvic->pending & NVIC_BIT(ARMV6M_EXCEPTION_SYSTICK)) {
+            word |= SCB_ICSR_PENDSTSET;
+        }
+    } else if (SCB_AIRCR == reg) {
+        word = SCB_AIRCR_VECTKEY | (word & 0xffff);
+    } else if (SCB_SHPR2 == reg) {
+        word = (uint32_t)nvic->priority[ARMV6M_EXCEPTION_SVCALL] << 24;
+    } else if (SCB_SHPR3 == reg) {
+        word = ((uint32_t)nvic->priority[ARMV6M_EXCEPTION_PENDSV] << 16) | ((uint32_t)nvic->priority[ARMV6M_EXCEPTION_SYSTICK] << 24);
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _scb_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_nvic *nvic = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+    const uint32_t word = (value << shift) & mask;
+
+    if (SCB_CPUID == reg) {
+        return ARMVM_RET_SUCCESS;
+    } else if (SCB_ICSR == reg) {
+        if (word & SCB_ICSR_NMIPENDSET) {
+            nvic->pending |= NVIC_BIT(ARMV6M_EXCEPTION_NMI);
+        }
+        if (word & SCB_ICSR_PENDSVSET) {
+            nvic->pending |= NVIC_BIT(ARMV6M_EXCEPTION_PENDSV);
+        } else if (word & SCB_ICSR_PENDSVCLR) {
+            nvic->pending &= ~NVIC_BIT(ARMV6M_EXCEPTION_PENDSV);
+        }
+        if (word & SCB_ICSR_PENDSTSET) {
+            nvic->pending |= NVIC_BIT(ARMV6M_EXCEPTION_SYSTICK);
+        } else if (word & SCB_ICSR_PENDSTCLR) {
+            nvic->pending &= ~NVIC_BIT(ARMV6M_EXCEPTION_SYSTICK);
+        }
+    } else if (SCB_SHPR2 == reg) {
+        if (mask & 0xff000000) {
+            _nvic_set_priority(nvic, ARMV6M_EXCEPTION_SVCALL, word >> 24);
+        }
+    } else if (SCB_SHPR3 == reg) {
+        if (mask & 0x00ff0000) {
+            _nvic_set_priority(nvic, ARMV6M_EXCEPTION_PENDSV, word >> 16);
+        }
+        if (mask & 0xff000000) {
+            _nvic_set_priority(nvic, ARMV6M_EXCEPTION_SYSTICK, word >> 24);
+        }
+    } else {
+        nvic->scb[reg / 4] = (nvic->scb[reg / 4] & ~mask) | word;
+        return ARMVM_RET_SUCCESS;
+    }
+
+    libarmvm_nvic_update(nvic->armvm);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_nvic_init(struct armvm *armvm, struct libarmvm_nvic *nvic)
+{
+    assert(armvm);
+
+    memset(nvic, 0, sizeof(*nvic));
+    nvic->armvm = armvm;
+    libarmvm_nvic_reset(nvic);
+
+    const struct libarmvm_memory_peripheral periph = { _nvic_read, _nvic_write, nvic };
+    int ret = libarmvm_memory_add_peripheral(armvm, LIBARMVM_NVIC_BASE_ADDR, LIBARMVM_NVIC_SIZE, &periph);
+    if (ret) {
+        return ret;
+    }
+
+    const struct libarmvm_memory_peripheral scb = { _scb_read, _scb_write, nvic };
+    return libarmvm_memory_add_peripheral(armvm, LIBARMVM_SCB_BASE_ADDR, LIBARMVM_SCB_SIZE, &scb);
+}
+
+
+void libarmvm_nvic_reset(struct libarmvm_nvic *nvic)
+{
+    nvic->enabled = NVIC_SYSTEM;
+    nvic->pending = 0;
+    nvic->active = 0;
+
+    memset(nvic->levels, 0, sizeof(nvic->levels));
+    memset(nvic->priority, 0, sizeof(nvic->priority));
+    memset(nvic->scb, 0, sizeof(nvic->scb));
+    nvic->levels[NVIC_LEVEL_NMI] = NVIC_BIT(ARMV6M_EXCEPTION_NMI);
+    nvic->levels[NVIC_LEVEL_HARDFAULT] = NVIC_BIT(ARMV6M_EXCEPTION_HARDFAULT);
+    nvic->levels[NVIC_LEVEL_CONFIGURABLE] = NVIC_CONFIGURABLE;
+}
+
+
+void libarmvm_nvic_set_pending(struct armvm *armvm, uint32_t exception)
+{
+    assert(exception < ARMV6M_EXCEPTIONS);
+
+    struct libarmvm_nvic *nvic = _nvic(armvm);
+    const uint64_t pending = nvic->pending | NVIC_BIT(exception);
+
+    if (pending != nvic->pending) {
+        nvic->pending = pending;
+        libarmvm_nvic_update(armvm);
+    }
+}
+
+
+int libarmvm_nvic_set_pending_synchronous(struct armvm *armvm, uint32_t exception)
+{
+    assert(exception < ARMV6M_EXCEPTIONS);
+
+    struct libarmvm_nvic *nvic = _nvic(armvm);
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct armv6m *armv6m = ci->data;
+
+    // the exception is escalated to a HardFault, if it cannot preempt the execution
+    const unsigned execution_level = _nvic_execution_level(nvic, armv6m);
+    if (_nvic_level(nvic, NVIC_BIT(exception)) >= execution_level) {
+        if (NVIC_LEVEL_HARDFAULT >= execution_level) {
+            fprintf(stderr, "ERROR: Exception %u cannot be escalated to a HardFault, the core locks up.\n", exception);
+            return ARMVM_RET_FAIL;
+        }
+        exception = ARMV6M_EXCEPTION_HARDFAULT;
+    }
+
+    libarmvm_nvic_set_pending(armvm, exception);
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_nvic_clear_pending(struct armvm *armvm, uint32_t exception)
+{
+    assert(exception < ARMV6M_EXCEPTIONS);
+
+    struct libarmvm_nvic *nvic = _nvic(armvm);
+    const uint64_t pending = nvic->pending & ~NVIC_BIT(exception);
+
+    if (pending != nvic->pending) {
+        nvic->pending = pending;
+        libarmvm_nvic_update(armvm);
+    }
+}
+
+
+void libarmvm_nvic_activate(struct armvm *armvm, uint32_t exception)
+{
+    assert(exception < ARMV6M_EXCEPTIONS);
+
+    struct libarmvm_nvic *nvic = _nvic(armvm);
+
+    nvic->pending &= ~NVIC_BIT(exception);
+    nvic->active |= NVIC_BIT(exception);
+    libarmvm_nvic_update(armvm);
+}
+
+
+void libarmvm_nvic_deactivate(struct armvm *armvm, uint32_t exception)
+{
+    assert(exception < ARMV6M_EXCEPTIONS);
+
+    struct libarmvm_nvic *nvic = _nvic(armvm);
+
+    nvic->active &= ~NVIC_BIT(exception);
+    libarmvm_nvic_update(armvm);
+}
+
+
+void libarmvm_nvic_update(struct armvm *armvm)
+{
+    struct libarmvm_nvic *nvic = _nvic(armvm);
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct armv6m *armv6m = ci->data;
+
+    const uint64_t ready = nvic->pending & nvic->enabled;
+    if (!ready) {
+        libarmvm_ci_withdraw_exception(armvm);
+        return;
+    }
+
+    const unsigned level = _nvic_level(nvic, ready);
+    const unsigned active_level = _nvic_level(nvic, nvic->active);
+    const unsigned execution_level = _nvic_execution_level(nvic, armv6m);
+
+    if (level < execution_level) {
+        // the exception with the lowest number wins within the same priority
+        libarmvm_ci_raise_exception(armvm, __builtin_ctzll(ready & nvic->levels[level]));
+        return;
+    }
+
+    libarmvm_ci_withdraw_exception(armvm);
+    if (level < active_level) {
+        libarmvm_ci_wakeup(armvm);
+    }
+}
@@ -0,0 +1,143 @@
+/** @file */
+#ifndef __LIBARMVM_NVIC_H__
+#define __LIBARMVM_NVIC_H__
+
+#include <armvm.h>
+#include <isa/armv6_m.h>
+
+/**
+ * @brief First address of the NVIC registers in the System Control Space.
+ */
+#define LIBARMVM_NVIC_BASE_ADDR (0xE000E100)
+
+/**
+ * @brief Size of the NVIC registers (ISER at 0xE000E100 up to the IPRs at 0xE000E400-0xE000E41F).
+ */
+#define LIBARMVM_NVIC_SIZE (0x400)
+
+/**
+ * @brief First address of the System Control Block. ICSR, SHPR2 and SHPR3 are handled by the NVIC,
+ * the other registers of the block keep the written values.
+ */
+#define LIBARMVM_SCB_BASE_ADDR (0xE000ED00)
+#define LIBARMVM_SCB_SIZE      (0x40)
+
+/**
+ * @brief Amount of priority levels: NMI, HardFault and the four configurable priorities
+ * of the ARMv6-M (0x00, 0x40, 0x80 and 0xc0), ordered from the highest to the lowest priority.
+ */
+#define LIBARMVM_NVIC_LEVELS (6)
+
+
+/**
+ * @brief Nested Vectored Interrupt Controller.
+ * All exceptions except the reset are bits of 64 bit bitmaps, indexed by their exception number
+ * (IRQn is ARMV6M_EXCEPTION_IRQ0 + n). The exceptions of every priority level are kept in a
+ * bitmap of their own, which is updated if a priority is written. Therefore, the pending exception
+ * with the highest priority is found with one AND per level and without scanning the exceptions.
+ */
+struct libarmvm_nvic {
+    struct armvm *armvm;
+
+    /**
+     * @brief Enabled exceptions. The system exceptions are always enabled, the interrupts
+     * are enabled by ISER.
+     */
+    uint64_t enabled;
+
+    /**
+     * @brief Pending exceptions.
+     */
+    uint64_t pending;
+
+    /**
+     * @brief Active exceptions (taken and not returned).
+     */
+    uint64_t active;
+
+    /**
+     * @brief Exceptions per priority level, ordered from the highest to the lowest priority.
+     */
+    uint64_t levels[LIBARMVM_NVIC_LEVELS];
+
+    /**
+     * @brief Priority of every exception as written to the IPRs. Only the bits 7:6 are implemented.
+     */
+    uint8_t priority[ARMV6M_EXCEPTIONS];
+
+    /**
+     * @brief Values of the registers of the System Control Block, which are not modeled.
+     */
+    uint32_t scb[LIBARMVM_SCB_SIZE / 4];
+};
+
+
+/**
+ * @brief Initializes the NVIC and maps its registers to LIBARMVM_NVIC_BASE_ADDR and LIBARMVM_SCB_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_nvic_init(struct armvm *armvm, struct libarmvm_nvic *nvic);
+
+
+/**
+ * @brief Resets the NVIC: No interrupt is enabled, no exception is pending or active and all priorities are 0.
+ */
+void libarmvm_nvic_reset(struct libarmvm_nvic *nvic);
+
+
+/**
+ * @brief Sets an exception to pending. Is called by the peripherals for their interrupts
+ * (ARMV6M_EXCEPTION_IRQ0 + n) and by the core for the system exceptions (e.g. SVCall).
+ * If the exception has a higher priority than the execution priority and is enabled, it is
+ * taken before the next instruction.
+ *
+ * @param exception Number of the exception.
+ */
+void libarmvm_nvic_set_pending(struct armvm *armvm, uint32_t exception);
+
+
+/**
+ * @brief Sets an exception, which is caused by an instruction (e.g. SVCall), to pending.
+ * If the execution priority is too high to take the exception, it is escalated to a HardFault.
+ *
+ * @param exception Number of the exception.
+ * @return ARMVM_RET_SUCCESS on success. ARMVM_RET_FAIL, if not even the HardFault can be taken
+ *         (the core would lock up).
+ */
+int libarmvm_nvic_set_pending_synchronous(struct armvm *armvm, uint32_t exception);
+
+
+/**
+ * @brief Removes the pending state of an exception.
+ *
+ * @param exception Number of the exception.
+ */
+void libarmvm_nvic_clear_pending(struct armvm *armvm, uint32_t exception);
+
+
+/**
+ * @brief Marks an exception as active and removes its pending state. Is called when the exception is taken.
+ *
+ * @param exception Number of the exception.
+ */
+void libarmvm_nvic_activate(struct armvm *armvm, uint32_t exception);
+
+
+/**
+ * @brief Marks an exception as inactive. Is called when the exception returns.
+ * A pending exception is taken afterwards, if its priority is high enough (tail-chaining).
+ *
+ * @param exception Number of the exception.
+ */
+void libarmvm_nvic_deactivate(struct armvm *armvm, uint32_t exception);
+
+
+/**
+ * @brief Decides which pending exception is taken before the next instruction.
+ * Is called after every change of the state of the NVIC and after PRIMASK changed. A sleeping
+ * core is woken up by a pending exception, which would preempt the execution if PRIMASK was clear.
+ */
+void libarmvm_nvic_update(struct armvm *armvm);
+
+#endif
@@ -1 +1,392 @@
 #include <libarmvm_peripherals.h>
+#include <libarmvm_ci.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PERIPHERALS_EVENTS_CAPACITY (16)
+
+/**
+ * @brief Addresses, interrupts and features of the timers.
+ */
+static const struct {
+    uint32_t addr;
+    uint32_t irq;
+    uint32_t cc_irq;
+    uint32_t channels;
+    uint32_t features;
+} _peripherals_tims[LIBARMVM_TIMS] = {
+    { LIBARMVM_TIM1_BASE_ADDR, LIBARMVM_TIM1_IRQ, LIBARMVM_TIM1_CC_IRQ, 4, LIBARMVM_TIM_FEATURE_RCR | LIBARMVM_TIM_FEATURE_DIR },
+    { LIBARMVM_TIM3_BASE_ADDR, LIBARMVM_TIM3_IRQ, LIBARMVM_TIM3_IRQ, 4, LIBARMVM_TIM_FEATURE_DIR },
+    { LIBARMVM_TIM14_BASE_ADDR, LIBARMVM_TIM14_IRQ, LIBARMVM_TIM14_IRQ, 1, 0 },
+    { LIBARMVM_TIM15_BASE_ADDR, LIBARMVM_TIM15_IRQ, LIBARMVM_TIM15_IRQ, 2, LIBARMVM_TIM_FEATURE_RCR },
+    { LIBARMVM_TIM16_BASE_ADDR, LIBARMVM_TIM16_IRQ, LIBARMVM_TIM16_IRQ, 1, LIBARMVM_TIM_FEATURE_RCR },
+    { LIBARMVM_TIM17_BASE_ADDR, LIBARMVM_TIM17_IRQ, LIBARMVM_TIM17_IRQ, 1, LIBARMVM_TIM_FEATURE_RCR },
+};
+
+
+static inline void _peripherals_heap_set(struct libarmvm_peripherals *periph, size_t idx, struct libarmvm_peripherals_event *event)
+{
+    periph->events[idx] = event;
+    event->heap_idx = idx + 1;
+}
+
+
+void _peripherals_sift_up(struct libarmvm_peripherals *periph, size_t idx)
+{
+    struct libarmvm_peripherals_event *event = periph->events[idx];
+
+    while (idx) {
+        const size_t parent = (idx - 1) / 2;
+        if (periph->events[parent]->cycles <= event->cycles) {
+            break;
+        }
+        _peripherals_heap_set(periph, idx, periph->events[parent]);
+        idx = parent;
+    }
+    _peripherals_heap_set(periph, idx, event);
+}
+
+
+void _peripherals_sift_down(struct libarmvm_peripherals *periph, size_t idx)
+{
+    struct libarmvm_peripherals_event *event = periph->events[idx];
+
+    while (1) {
+        size_t child = 2 * idx + 1;
+        if (child >= periph->events_size) {
+            break;
+        }
+        if (child + 1 < periph->events_size && periph->events[child + 1]->cycles < periph->events[child]->cycles) {
+            child++;
+        }
+        if (event->cycles <= periph->events[child]->cycles) {
+            break;
+        }
+        _peripherals_heap_set(periph, idx, periph->events[child]);
+        idx = child;
+    }
+    _peripherals_heap_set(periph, idx, event);
+}
+
+
+/**
+ * Publishes the cycles of the first event as libarmvm_ci.next_event.
+ */
+void _peripherals_update_next_event(struct armvm *armvm)
+{
+    const struct libarmvm_peripherals *periph = armvm->periph->data;
+    struct libarmvm_ci *ci = armvm->ci->data;
+
+    ci->next_event = periph->events_size ? periph->events[0]->cycles : UINT64_MAX;
+}
+
+
+int libarmvm_peripherals_init(struct armvm *armvm)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    assert(armvm);
+    assert(armvm->mem);
+
+    if (armvm->periph) {
+        fprintf(stderr, "ERROR: Peripherals already initialized.\n");
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    armvm->periph = calloc(1, sizeof(*armvm->periph));
+    if (!armvm->periph) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret = ARMVM_RET_NO_MEM;
+        goto err;
+    }
+
+    armvm->periph->data = calloc(1, sizeof(struct libarmvm_peripherals));
+    if (!armvm->periph->data) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret = ARMVM_RET_NO_MEM;
+        goto err;
+    }
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    periph->events = calloc(PERIPHERALS_EVENTS_CAPACITY, sizeof(*periph->events));
+    if (!periph->events) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret = ARMVM_RET_NO_MEM;
+        goto err;
+    }
+    periph->events_capacity = PERIPHERALS_EVENTS_CAPACITY;
+
+    ret = libarmvm_nvic_init(armvm, &periph->nvic);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_systick_init(armvm, &periph->systick);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_rcc_init(armvm, &periph->rcc);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_dma_init(armvm, &periph->dma);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_gpio_init(armvm, &periph->gpio);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_adc_init(armvm, &periph->adc);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_crc_init(armvm, &periph->crc);
+    if (ret) {
+        goto err;
+    }
+
+    for (size_t i = 0; i < LIBARMVM_TIMS; ++i) {
+        ret = libarmvm_tim_init(armvm, &periph->tim[i], _peripherals_tims[i].addr, _peripherals_tims[i].irq,
+                                _peripherals_tims[i].cc_irq, _peripherals_tims[i].channels, _peripherals_tims[i].features);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    ret = libarmvm_usart_init(armvm, &periph->usart[0], LIBARMVM_USART1_BASE_ADDR, LIBARMVM_USART1_IRQ,
+                              LIBARMVM_DMA_USART1_TX, LIBARMVM_DMA_USART1_RX);
+    if (ret) {
+        goto err;
+    }
+
+    ret = libarmvm_usart_init(armvm, &periph->usart[1], LIBARMVM_USART2_BASE_ADDR, LIBARMVM_USART2_IRQ,
+                              LIBARMVM_DMA_USART2_TX, LIBARMVM_DMA_USART2_RX);
+    if (ret) {
+        goto err;
+    }
+
+    return ret;
+err:
+    libarmvm_peripherals_cleanup(armvm);
+    return ret;
+}
+
+
+int libarmvm_peripherals_connect(struct armvm *armvm)
+{
+    assert(armvm);
+    assert(armvm->periph);
+    assert(armvm->ci);
+
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    int ret = libarmvm_gpio_connect(&periph->gpio, armvm->opts.gpio_vcd_file, armvm->opts.gpio_stimulus_file);
+    if (ret) {
+        libarmvm_peripherals_disconnect(armvm);
+        return ret;
+    }
+
+    ret = libarmvm_adc_connect(&periph->adc, armvm->opts.adc_input);
+    if (ret) {
+        libarmvm_peripherals_disconnect(armvm);
+        return ret;
+    }
+
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        ret = libarmvm_usart_connect(&periph->usart[i], armvm->opts.usart_output[i], armvm->opts.usart_input[i]);
+        if (ret) {
+            libarmvm_peripherals_disconnect(armvm);
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_peripherals_disconnect(struct armvm *armvm)
+{
+    if (!armvm->periph || !armvm->periph->data) {
+        return;
+    }
+
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    libarmvm_gpio_disconnect(&periph->gpio);
+    libarmvm_adc_disconnect(&periph->adc);
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        libarmvm_usart_disconnect(&periph->usart[i]);
+    }
+}
+
+
+int libarmvm_peripherals_poll_host(struct armvm *armvm)
+{
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        int ret = libarmvm_usart_poll(&periph->usart[i]);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_peripherals_reset(struct armvm *armvm)
+{
+    assert(armvm);
+    assert(armvm->periph);
+    assert(armvm->periph->data);
+
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    for (size_t i = 0; i < periph->events_size; ++i) {
+        periph->events[i]->heap_idx = 0;
+    }
+    periph->events_size = 0;
+
+    libarmvm_nvic_reset(&periph->nvic);
+    libarmvm_systick_reset(&periph->systick);
+    libarmvm_dma_reset(&periph->dma);
+    int ret = libarmvm_gpio_reset(&periph->gpio);
+    libarmvm_adc_reset(&periph->adc);
+    libarmvm_crc_reset(&periph->crc);
+    for (size_t i = 0; i < LIBARMVM_TIMS; ++i) {
+        libarmvm_tim_reset(&periph->tim[i]);
+    }
+    for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+        libarmvm_usart_reset(&periph->usart[i]);
+    }
+
+    // the clocks of the peripherals are set after their resets
+    const int rcc_ret = libarmvm_rcc_reset(&periph->rcc);
+    ret = ret ? ret : rcc_ret;
+
+    _peripherals_update_next_event(armvm);
+
+    return ret;
+}
+
+
+void libarmvm_peripherals_event_init(struct libarmvm_peripherals_event *event, int (*handler)(struct armvm *, void *), void *data)
+{
+    event->handler = handler;
+    event->data = data;
+    event->cycles = UINT64_MAX;
+    event->heap_idx = 0;
+}
+
+
+int libarmvm_peripherals_schedule(struct armvm *armvm, struct libarmvm_peripherals_event *event, uint64_t cycles)
+{
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    if (event->heap_idx) {
+        const size_t idx = event->heap_idx - 1;
+        const uint64_t old_cycles = event->cycles;
+
+        event->cycles = cycles;
+        if (cycles < old_cycles) {
+            _peripherals_sift_up(periph, idx);
+        } else {
+            _peripherals_sift_down(periph, idx);
+        }
+        _peripherals_update_next_event(armvm);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    if (periph->events_size == periph->events_capacity) {
+        const size_t capacity = 2 * periph->events_capacity;
+        struct libarmvm_peripherals_event **events = realloc(periph->events, capacity * sizeof(*events));
+        if (!events) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return ARMVM_RET_NO_MEM;
+        }
+        periph->events = events;
+        periph->events_capacity = capacity;
+    }
+
+    event->cycles = cycles;
+    periph->events[periph->events_size++] = event;
+    _peripherals_sift_up(periph, periph->events_size - 1);
+    _peripherals_update_next_event(armvm);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_peripherals_cancel(struct armvm *armvm, struct libarmvm_peripherals_event *event)
+{
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    if (!event->heap_idx) {
+        return;
+    }
+
+    const size_t idx = event->heap_idx - 1;
+    event->heap_idx = 0;
+
+    // the last event takes the place of the removed one
+    struct libarmvm_peripherals_event *last = periph->events[--periph->events_size];
+    if (idx < periph->events_size) {
+        _peripherals_heap_set(periph, idx, last);
+        _peripherals_sift_up(periph, idx);
+        _peripherals_sift_down(periph, last->heap_idx - 1);
+    }
+    _peripherals_update_next_event(armvm);
+}
+
+
+int libarmvm_peripherals_service(struct armvm *armvm)
+{
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+    const struct libarmvm_ci *ci = armvm->ci->data;
+
+    while (periph->events_size && periph->events[0]->cycles <= ci->cycles) {
+        struct libarmvm_peripherals_event *event = periph->events[0];
+
+        libarmvm_peripherals_cancel(armvm, event);
+        int ret = event->handler(armvm, event->data);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_peripherals_cleanup(struct armvm *armvm)
+{
+    if (armvm->periph) {
+        if (armvm->periph->data) {
+            struct libarmvm_peripherals *periph = armvm->periph->data;
+            libarmvm_gpio_disconnect(&periph->gpio);
+            libarmvm_adc_disconnect(&periph->adc);
+            for (size_t i = 0; i < ARMVM_USARTS; ++i) {
+                libarmvm_usart_disconnect(&periph->usart[i]);
+            }
+            free(periph->events);
+            periph->events = NULL;
+            periph->events_size = 0;
+            periph->events_capacity = 0;
+        }
+        free(armvm->periph->data);
+        armvm->periph->data = NULL;
+        free(armvm->periph);
+        armvm->periph = NULL;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
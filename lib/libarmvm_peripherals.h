@@ -2,4 +2,134 @@
 #ifndef __LIBARMVM_PERIPHERALS_H__
 #define __LIBARMVM_PERIPHERALS_H__
 
+#include <armvm.h>
+#include <libarmvm_event.h>
+#include <libarmvm_nvic.h>
+#include <libarmvm_adc.h>
+#include <libarmvm_crc.h>
+#include <libarmvm_dma.h>
+#include <libarmvm_gpio.h>
+#include <libarmvm_rcc.h>
+#include <libarmvm_systick.h>
+#include <libarmvm_tim.h>
+#include <libarmvm_usart.h>
+
+/**
+ * @brief Holds the state of all peripherals of the microcontroller.
+ * Is the data of armvm->periph.
+ */
+struct libarmvm_peripherals {
+    /**
+     * @brief Interrupt controller, to which all interrupts of the peripherals are routed.
+     */
+    struct libarmvm_nvic nvic;
+
+    struct libarmvm_systick systick;  /**< System timer of the core. */
+
+    struct libarmvm_rcc rcc;  /**< Reset and clock control, which sets the clocks of the other peripherals. */
+
+    struct libarmvm_dma dma;  /**< DMA1, which serves the requests of the other peripherals. */
+
+    struct libarmvm_gpio gpio;  /**< GPIOA to GPIOF. */
+
+    struct libarmvm_adc adc;  /**< ADC, whose conversions take their samples from files of the host. */
+
+    struct libarmvm_crc crc;  /**< CRC calculation unit. */
+
+    struct libarmvm_tim tim[LIBARMVM_TIMS];  /**< TIM1, TIM3, TIM14, TIM15, TIM16 and TIM17. */
+
+    struct libarmvm_usart usart[ARMVM_USARTS];  /**< USART1 and USART2. */
+
+    /**
+     * @brief Scheduled events as a binary min-heap ordered by their cycles.
+     * The first event is the next one and its cycles are libarmvm_ci.next_event.
+     */
+    struct libarmvm_peripherals_event **events;
+
+    size_t events_size;      /**< Amount of scheduled events. */
+    size_t events_capacity;  /**< Size of the events vector. */
+};
+
+
+/**
+ * @brief Initialize the peripherals of the virtual machine and maps their registers into the memory.
+ * The peripherals will be chosen based on the armvm->opts.device_id.
+ * Has to be called after libarmvm_memory_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_init(struct armvm *armvm);
+
+
+/**
+ * @brief Connects the peripherals to the files of the host, which are given by armvm->opts, and starts their host threads.
+ * Has to be called after libarmvm_ci_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_connect(struct armvm *armvm);
+
+
+/**
+ * @brief Stops the host threads of the peripherals. Has to be called before libarmvm_ci_cleanup().
+ */
+void libarmvm_peripherals_disconnect(struct armvm *armvm);
+
+
+/**
+ * @brief Lets the peripherals take the data, which their host threads provided (see libarmvm_ci_notify_host_input()).
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_poll_host(struct armvm *armvm);
+
+
+/**
+ * @brief Resets all peripherals and removes all scheduled events. Is called by the reset of the control interface.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_reset(struct armvm *armvm);
+
+
+/**
+ * @brief Initializes an event, which is not scheduled.
+ *
+ * @param handler Is called when the event happens.
+ * @param data Is passed to handler().
+ */
+void libarmvm_peripherals_event_init(struct libarmvm_peripherals_event *event, int (*handler)(struct armvm *, void *), void *data);
+
+
+/**
+ * @brief Schedules an event at the value cycles of the cycle counter. An event which is scheduled
+ * already is moved. An event in the past happens before the next step.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_schedule(struct armvm *armvm, struct libarmvm_peripherals_event *event, uint64_t cycles);
+
+
+/**
+ * @brief Removes an event from the schedule. Nothing happens if it is not scheduled.
+ */
+void libarmvm_peripherals_cancel(struct armvm *armvm, struct libarmvm_peripherals_event *event);
+
+
+/**
+ * @brief Calls the handlers of all events, which happen at or before the current cycle, in the order of their cycles.
+ * Is called by the control interface before a step, if the cycle counter reached libarmvm_ci.next_event.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_service(struct armvm *armvm);
+
+
+/**
+ * @brief Cleans up the peripherals.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_peripherals_cleanup(struct armvm *armvm);
+
 #endif
@@ -0,0 +1,194 @@
+#include <libarmvm_profile.h>
+#include <libarmvm_memory.h>
+#include <inttypes.h>
+#include <string.h>
+#include <assert.h>
+
+#define PROFILE_TOP_ADDRESSES (20)
+
+/**
+ * @brief Execution count of a function or an address, used for sorting the report.
+ */
+struct _profile_entry {
+    uint64_t count;
+    size_t idx;
+};
+
+
+int _profile_entry_compare(const void *a, const void *b)
+{
+    const struct _profile_entry *entry_a = a;
+    const struct _profile_entry *entry_b = b;
+
+    if (entry_a->count > entry_b->count) {
+        return -1;
+    }
+    return entry_a->count < entry_b->count;
+}
+
+
+int libarmvm_profile_init(struct armvm *armvm, struct libarmvm_profile *profile)
+{
+    assert(armvm);
+    assert(armvm->mem);
+    assert(armvm->mem->data);
+
+    struct libarmvm_memory_flash flash;
+
+    memset(profile, 0, sizeof(*profile));
+
+    if (libarmvm_memory_get_flash(armvm->mem->data, &flash)) {
+        fprintf(stderr, "ERROR: The memory model has no FLASH region.\n");
+        return ARMVM_RET_FAIL;
+    }
+    profile->base = flash.base;
+    profile->size = flash.size;
+    profile->alias_base = flash.alias_base;
+    profile->alias_size = flash.alias_size;
+
+    profile->counts = calloc(profile->size / 2, sizeof(*profile->counts));
+    if (!profile->counts) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_profile_cleanup(struct libarmvm_profile *profile)
+{
+    if (profile->counts) {
+        free(profile->counts);
+        profile->counts = NULL;
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _profile_print_location(const struct libarmvm_symbols *symbols, uint32_t addr, FILE *out)
+{
+    const struct libarmvm_symbol *sym = NULL;
+    if (symbols) {
+        sym = libarmvm_symbols_lookup(symbols, addr);
+    }
+
+    if (sym) {
+        fprintf(out, "0x%08x  %s+0x%x\n", addr, sym->name, addr - sym->addr);
+    } else {
+        fprintf(out, "0x%08x\n", addr);
+    }
+}
+
+
+int _profile_report_functions(const struct libarmvm_profile *profile, const struct libarmvm_symbols *symbols, uint64_t total, FILE *out)
+{
+    // the last entry accumulates all instructions which do not belong to a known function
+    const size_t unknown = symbols->symbols_size;
+    struct _profile_entry *entries = calloc(symbols->symbols_size + 1, sizeof(*entries));
+    if (!entries) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+
+    for (size_t i = 0; i <= symbols->symbols_size; ++i) {
+        entries[i].idx = i;
+    }
+    entries[unknown].count = profile->outside;
+
+    for (size_t i = 0; i < profile->size / 2; ++i) {
+        if (!profile->counts[i]) {
+            continue;
+        }
+
+        const struct libarmvm_symbol *sym = libarmvm_symbols_lookup(symbols, profile->base + 2 * i);
+        if (sym) {
+            entries[sym - symbols->symbols].count += profile->counts[i];
+        } else {
+            entries[unknown].count += profile->counts[i];
+        }
+    }
+
+    qsort(entries, symbols->symbols_size + 1, sizeof(*entries), _profile_entry_compare);
+
+    fprintf(out, "# Hot spots by function\n");
+    fprintf(out, "#%19s %8s  %s\n", "count", "percent", "function");
+    for (size_t i = 0; i <= symbols->symbols_size && entries[i].count; ++i) {
+        fprintf(out, "%20" PRIu64 " %7.2f%%  ", entries[i].count, 100.0 * entries[i].count / total);
+        if (unknown == entries[i].idx) {
+            fprintf(out, "<unknown>\n");
+        } else {
+            const struct libarmvm_symbol *sym = &symbols->symbols[entries[i].idx];
+            fprintf(out, "%s (0x%08x)\n", sym->name, sym->addr);
+        }
+    }
+    fprintf(out, "\n");
+
+    free(entries);
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _profile_report_addresses(const struct libarmvm_profile *profile, const struct libarmvm_symbols *symbols, uint64_t total, FILE *out)
+{
+    size_t entries_size = 0;
+    struct _profile_entry *entries = calloc(profile->size / 2, sizeof(*entries));
+    if (!entries) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+
+    for (size_t i = 0; i < profile->size / 2; ++i) {
+        if (profile->counts[i]) {
+            entries[entries_size].count = profile->counts[i];
+            entries[entries_size].idx = i;
+            entries_size++;
+        }
+    }
+
+    qsort(entries, entries_size, sizeof(*entries), _profile_entry_compare);
+
+    fprintf(out, "# Hot spots by address (top %u)\n", PROFILE_TOP_ADDRESSES);
+    fprintf(out, "#%19s %8s  %-10s  %s\n", "count", "percent", "address", "location");
+    for (size_t i = 0; i < entries_size && i < PROFILE_TOP_ADDRESSES; ++i) {
+        fprintf(out, "%20" PRIu64 " %7.2f%%  ", entries[i].count, 100.0 * entries[i].count / total);
+        _profile_print_location(symbols, profile->base + 2 * entries[i].idx, out);
+    }
+
+    free(entries);
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_profile_report(const struct libarmvm_profile *profile, const struct libarmvm_symbols *symbols, FILE *out)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    uint64_t total = profile->outside;
+
+    for (size_t i = 0; i < profile->size / 2; ++i) {
+        total += profile->counts[i];
+    }
+
+    fprintf(out, "# libarmvm hot-spot report\n");
+    fprintf(out, "# executed instructions: %" PRIu64 "\n", total);
+    fprintf(out, "# executed outside of FLASH (0x%08x - 0x%08x): %" PRIu64 "\n", profile->base,
+                                                                          profile->base + profile->size - 1,
+                                                                          profile->outside);
+    fprintf(out, "\n");
+
+    if (!total) {
+        return ret;
+    }
+
+    if (symbols) {
+        ret = _profile_report_functions(profile, symbols, total, out);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    ret = _profile_report_addresses(profile, symbols, total, out);
+
+err:
+    return ret;
+}
@@ -0,0 +1,69 @@
+/** @file */
+#ifndef __LIBARMVM_PROFILE_H__
+#define __LIBARMVM_PROFILE_H__
+
+#include <armvm.h>
+#include <stdio.h>
+#include <libarmvm_symbols.h>
+
+/**
+ * @brief Execution counters for every instruction address of the FLASH region.
+ */
+struct libarmvm_profile {
+    uint32_t base;        /**< First address of the FLASH region. */
+    uint32_t size;        /**< Size of the FLASH region in bytes. */
+    uint32_t alias_base;  /**< First address of the region which is remapped to the FLASH region. */
+    uint32_t alias_size;  /**< Size of the region which is remapped to the FLASH region. 0 if there is none. */
+    uint64_t *counts;     /**< One counter per halfword of the FLASH region. */
+    uint64_t outside;     /**< Amount of executed instructions outside of the FLASH region. */
+};
+
+
+/**
+ * @brief Initializes the profile for the FLASH region of armvm->mem.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_profile_init(struct armvm *armvm, struct libarmvm_profile *profile);
+
+
+/**
+ * @brief Frees all memory allocated by libarmvm_profile_init().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_profile_cleanup(struct libarmvm_profile *profile);
+
+
+/**
+ * @brief Counts one execution of the instruction at addr.
+ */
+static inline void libarmvm_profile_count(struct libarmvm_profile *profile, uint32_t addr)
+{
+    uint32_t offset = addr - profile->base;
+    if (offset < profile->size) {
+        profile->counts[offset >> 1]++;
+        return;
+    }
+
+    offset = addr - profile->alias_base;
+    if (offset < profile->alias_size) {
+        profile->counts[offset >> 1]++;
+        return;
+    }
+
+    profile->outside++;
+}
+
+
+/**
+ * @brief Writes a hot-spot report.
+ * If symbols is not NULL, the executed instructions are also accumulated per function.
+ *
+ * @param symbols Function symbols of the program or NULL.
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_profile_report(const struct libarmvm_profile *profile, const struct libarmvm_symbols *symbols, FILE *out);
+
+#endif
@@ -0,0 +1,364 @@
+#include <libarmvm_rcc.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers.
+ */
+#define RCC_CR       (0x00)
+#define RCC_CFGR     (0x04)
+#define RCC_CIR      (0x08)
+#define RCC_APB2RSTR (0x0c)
+#define RCC_APB1RSTR (0x10)
+#define RCC_AHBENR   (0x14)
+#define RCC_APB2ENR  (0x18)
+#define RCC_APB1ENR  (0x1c)
+#define RCC_BDCR     (0x20)
+#define RCC_CSR      (0x24)
+#define RCC_AHBRSTR  (0x28)
+#define RCC_CFGR2    (0x2c)
+#define RCC_CFGR3    (0x30)
+#define RCC_CR2      (0x34)
+
+#define RCC_CR_HSION    (0x1 << 0)
+#define RCC_CR_HSIRDY   (0x1 << 1)
+#define RCC_CR_HSEON    (0x1 << 16)
+#define RCC_CR_HSERDY   (0x1 << 17)
+#define RCC_CR_PLLON    (0x1 << 24)
+#define RCC_CR_PLLRDY   (0x1 << 25)
+#define RCC_CR_WRITABLE (0x010d00f9)
+
+#define RCC_CFGR_SW          (0x3)
+#define RCC_CFGR_SWS_SHIFT   (2)
+#define RCC_CFGR_HPRE_SHIFT  (4)
+#define RCC_CFGR_PPRE_SHIFT  (8)
+#define RCC_CFGR_PLLSRC_HSE  (0x1 << 16)
+#define RCC_CFGR_PLLMUL_SHIFT (18)
+#define RCC_CFGR_WRITABLE    (0xff3f47f3)
+
+/*
+ * Sources of SYSCLK (SW and SWS).
+ */
+#define RCC_SYSCLK_HSI (0)
+#define RCC_SYSCLK_HSE (1)
+#define RCC_SYSCLK_PLL (2)
+
+#define RCC_BDCR_LSEON  (0x1 << 0)
+#define RCC_BDCR_LSERDY (0x1 << 1)
+
+#define RCC_CSR_LSION  (0x1 << 0)
+#define RCC_CSR_LSIRDY (0x1 << 1)
+#define RCC_CSR_RMVF   (0x1 << 24)
+#define RCC_CSR_FLAGS  (0xfe000000)
+#define RCC_CSR_RESET  (0x0c000000)
+
+#define RCC_CR2_HSI14ON  (0x1 << 0)
+#define RCC_CR2_HSI14RDY (0x1 << 1)
+
+/*
+ * Clock of USART1 (USART1SW of CFGR3).
+ */
+#define RCC_USART_PCLK   (0)
+#define RCC_USART_SYSCLK (1)
+#define RCC_USART_LSE    (2)
+#define RCC_USART_HSI    (3)
+
+
+/**
+ * Returns whether a source of SYSCLK is switched on.
+ */
+int _rcc_ready(const struct libarmvm_rcc *rcc, uint32_t source)
+{
+    switch (source) {
+        case RCC_SYSCLK_HSI:
+            return !!(rcc->cr & RCC_CR_HSION);
+        case RCC_SYSCLK_HSE:
+            return !!(rcc->cr & RCC_CR_HSEON);
+        case RCC_SYSCLK_PLL:
+            return !!(rcc->cr & RCC_CR_PLLON);
+    }
+    return 0;
+}
+
+
+uint64_t _rcc_sysclk(const struct libarmvm_rcc *rcc)
+{
+    switch ((rcc->cfgr >> RCC_CFGR_SWS_SHIFT) & 0x3) {
+        case RCC_SYSCLK_HSE:
+            return LIBARMVM_RCC_HSE;
+        case RCC_SYSCLK_PLL:
+            {
+                uint64_t mul = ((rcc->cfgr >> RCC_CFGR_PLLMUL_SHIFT) & 0xf) + 2;
+                if (mul > 16) {
+                    mul = 16;
+                }
+                if (rcc->cfgr & RCC_CFGR_PLLSRC_HSE) {
+                    return LIBARMVM_RCC_HSE / ((rcc->cfgr2 & 0xf) + 1) * mul;
+                }
+                return LIBARMVM_RCC_HSI / 2 * mul;
+            }
+    }
+    return LIBARMVM_RCC_HSI;
+}
+
+
+/**
+ * Lets the timers, the USARTs and the ADC count with their clocks at the current frequencies.
+ */
+int _rcc_apply(struct libarmvm_rcc *rcc)
+{
+    struct armvm *armvm = rcc->armvm;
+    struct libarmvm_peripherals *periph = armvm->periph->data;
+    const struct libarmvm_ci *ci = armvm->ci->data;
+
+    if (ci->core_clock != rcc->hclk) {
+        int ret = libarmvm_ci_set_core_clock(armvm, rcc->hclk);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    // the timers are clocked by 2 * PCLK, if PCLK is divided
+    const uint64_t pclk_ratio = (rcc->hclk << LIBARMVM_RCC_RATIO_SHIFT) / rcc->pclk;
+    const uint32_t tim_cycles = rcc->hclk == rcc->pclk ? 1 : rcc->hclk / (2 * rcc->pclk);
+    for (size_t i = 0; i < LIBARMVM_TIMS; ++i) {
+        int ret = libarmvm_tim_set_clock(&periph->tim[i], tim_cycles);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    periph->usart[0].clock_ratio = (rcc->hclk << LIBARMVM_RCC_RATIO_SHIFT) / rcc->usart_clock;
+    periph->usart[1].clock_ratio = pclk_ratio;
+
+    periph->adc.clock_ratio = (rcc->hclk << LIBARMVM_RCC_RATIO_SHIFT) / LIBARMVM_ADC_CLOCK;
+    periph->adc.pclk_ratio = pclk_ratio;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * Computes the frequencies of the clocks after a write of the clock configuration. The peripherals
+ * only get new ratios, if a frequency changed.
+ */
+int _rcc_update(struct libarmvm_rcc *rcc)
+{
+    static const uint32_t hpre[8] = { 2, 4, 8, 16, 64, 128, 256, 512 };
+
+    // the selected source is used as soon as it is ready
+    const uint32_t sw = rcc->cfgr & RCC_CFGR_SW;
+    if (_rcc_ready(rcc, sw)) {
+        rcc->cfgr = (rcc->cfgr & ~(0x3 << RCC_CFGR_SWS_SHIFT)) | (sw << RCC_CFGR_SWS_SHIFT);
+    }
+
+    const uint64_t sysclk = _rcc_sysclk(rcc);
+    const uint32_t hpre_bits = (rcc->cfgr >> RCC_CFGR_HPRE_SHIFT) & 0xf;
+    const uint64_t hclk = (hpre_bits & 0x8) ? sysclk / hpre[hpre_bits & 0x7] : sysclk;
+    const uint32_t ppre_bits = (rcc->cfgr >> RCC_CFGR_PPRE_SHIFT) & 0x7;
+    const uint64_t pclk = (ppre_bits & 0x4) ? hclk >> ((ppre_bits & 0x3) + 1) : hclk;
+
+    uint64_t usart_clock = pclk;
+    switch (rcc->cfgr3 & 0x3) {
+        case RCC_USART_SYSCLK:
+            usart_clock = sysclk;
+            break;
+        case RCC_USART_LSE:
+            usart_clock = LIBARMVM_RCC_LSE;
+            break;
+        case RCC_USART_HSI:
+            usart_clock = LIBARMVM_RCC_HSI;
+            break;
+    }
+
+    if (rcc->sysclk == sysclk && rcc->hclk == hclk && rcc->pclk == pclk && rcc->usart_clock == usart_clock) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    rcc->sysclk = sysclk;
+    rcc->hclk = hclk;
+    rcc->pclk = pclk;
+    rcc->usart_clock = usart_clock;
+
+    return _rcc_apply(rcc);
+}
+
+
+int _rcc_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    const struct libarmvm_rcc *rcc = data;
+    uint32_t word = 0;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case RCC_CR:
+            word = rcc->cr;
+            break;
+        case RCC_CFGR:
+            word = rcc->cfgr;
+            break;
+        case RCC_CIR:
+            word = rcc->cir;
+            break;
+        case RCC_APB2RSTR:
+            word = rcc->apb2rstr;
+            break;
+        case RCC_APB1RSTR:
+            word = rcc->apb1rstr;
+            break;
+        case RCC_AHBENR:
+            word = rcc->ahbenr;
+            break;
+        case RCC_APB2ENR:
+            word = rcc->apb2enr;
+            break;
+        case RCC_APB1ENR:
+            word = rcc->apb1enr;
+            break;
+        case RCC_BDCR:
+            word = rcc->bdcr;
+            break;
+        case RCC_CSR:
+            word = rcc->csr;
+            break;
+        case RCC_AHBRSTR:
+            word = rcc->ahbrstr;
+            break;
+        case RCC_CFGR2:
+            word = rcc->cfgr2;
+            break;
+        case RCC_CFGR3:
+            word = rcc->cfgr3;
+            break;
+        case RCC_CR2:
+            word = rcc->cr2;
+            break;
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _rcc_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_rcc *rcc = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+
+    value <<= shift;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case RCC_CR:
+            {
+                rcc->cr = (rcc->cr & ~(mask & RCC_CR_WRITABLE)) | (value & mask & RCC_CR_WRITABLE);
+
+                // the source of SYSCLK and of the PLL, which is used, can not be switched off
+                const uint32_t sws = (rcc->cfgr >> RCC_CFGR_SWS_SHIFT) & 0x3;
+                if (RCC_SYSCLK_HSI == sws) {
+                    rcc->cr |= RCC_CR_HSION;
+                } else if (RCC_SYSCLK_HSE == sws) {
+                    rcc->cr |= RCC_CR_HSEON;
+                } else if (RCC_SYSCLK_PLL == sws) {
+                    rcc->cr |= RCC_CR_PLLON | ((rcc->cfgr & RCC_CFGR_PLLSRC_HSE) ? RCC_CR_HSEON : RCC_CR_HSION);
+                }
+
+                rcc->cr &= ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY);
+                rcc->cr |= (rcc->cr & RCC_CR_HSION) ? RCC_CR_HSIRDY : 0;
+                rcc->cr |= (rcc->cr & RCC_CR_HSEON) ? RCC_CR_HSERDY : 0;
+                rcc->cr |= (rcc->cr & RCC_CR_PLLON) ? RCC_CR_PLLRDY : 0;
+            }
+            return _rcc_update(rcc);
+        case RCC_CFGR:
+            rcc->cfgr = (rcc->cfgr & ~(mask & RCC_CFGR_WRITABLE)) | (value & mask & RCC_CFGR_WRITABLE);
+            return _rcc_update(rcc);
+        case RCC_CIR:
+            // the interrupts of the oscillators are not modeled
+            rcc->cir = ((rcc->cir & ~mask) | (value & mask)) & 0x00003f00;
+            break;
+        case RCC_APB2RSTR:
+            rcc->apb2rstr = (rcc->apb2rstr & ~mask) | (value & mask);
+            break;
+        case RCC_APB1RSTR:
+            rcc->apb1rstr = (rcc->apb1rstr & ~mask) | (value & mask);
+            break;
+        case RCC_AHBENR:
+            rcc->ahbenr = (rcc->ahbenr & ~mask) | (value & mask);
+            break;
+        case RCC_APB2ENR:
+            rcc->apb2enr = (rcc->apb2enr & ~mask) | (value & mask);
+            break;
+        case RCC_APB1ENR:
+            rcc->apb1enr = (rcc->apb1enr & ~mask) | (value & mask);
+            break;
+        case RCC_BDCR:
+            rcc->bdcr = ((rcc->bdcr & ~mask) | (value & mask)) & ~RCC_BDCR_LSERDY;
+            rcc->bdcr |= (rcc->bdcr & RCC_BDCR_LSEON) ? RCC_BDCR_LSERDY : 0;
+            break;
+        case RCC_CSR:
+            {
+                const uint32_t flags = (value & mask & RCC_CSR_RMVF) ? 0 : rcc->csr & RCC_CSR_FLAGS;
+                rcc->csr = ((rcc->csr & ~mask) | (value & mask)) & ~(RCC_CSR_LSIRDY | RCC_CSR_RMVF | RCC_CSR_FLAGS);
+                rcc->csr |= flags | ((rcc->csr & RCC_CSR_LSION) ? RCC_CSR_LSIRDY : 0);
+            }
+            break;
+        case RCC_AHBRSTR:
+            rcc->ahbrstr = (rcc->ahbrstr & ~mask) | (value & mask);
+            break;
+        case RCC_CFGR2:
+            rcc->cfgr2 = ((rcc->cfgr2 & ~mask) | (value & mask)) & 0xf;
+            return _rcc_update(rcc);
+        case RCC_CFGR3:
+            rcc->cfgr3 = (rcc->cfgr3 & ~mask) | (value & mask);
+            return _rcc_update(rcc);
+        case RCC_CR2:
+            rcc->cr2 = ((rcc->cr2 & ~mask) | (value & mask)) & ~RCC_CR2_HSI14RDY;
+            rcc->cr2 |= (rcc->cr2 & RCC_CR2_HSI14ON) ? RCC_CR2_HSI14RDY : 0;
+            break;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int libarmvm_rcc_init(struct armvm *armvm, struct libarmvm_rcc *rcc)
+{
+    assert(armvm);
+
+    memset(rcc, 0, sizeof(*rcc));
+    rcc->armvm = armvm;
+
+    const struct libarmvm_memory_peripheral periph = { _rcc_read, _rcc_write, rcc };
+    return libarmvm_memory_add_peripheral(armvm, LIBARMVM_RCC_BASE_ADDR, LIBARMVM_RCC_SIZE, &periph);
+}
+
+
+int libarmvm_rcc_reset(struct libarmvm_rcc *rcc)
+{
+    const struct libarmvm_ci *ci = rcc->armvm->ci->data;
+
+    rcc->cr = RCC_CR_HSION | RCC_CR_HSIRDY | (16 << 3);
+    rcc->cfgr = 0;
+    rcc->cir = 0;
+    rcc->apb2rstr = 0;
+    rcc->apb1rstr = 0;
+    rcc->ahbenr = 0x14;
+    rcc->apb2enr = 0;
+    rcc->apb1enr = 0;
+    rcc->bdcr = 0;
+    rcc->csr = RCC_CSR_RESET;
+    rcc->ahbrstr = 0;
+    rcc->cfgr2 = 0;
+    rcc->cfgr3 = 0;
+    rcc->cr2 = 0x80;
+
+    rcc->sysclk = ci->core_clock;
+    rcc->hclk = ci->core_clock;
+    rcc->pclk = ci->core_clock;
+    rcc->usart_clock = ci->core_clock;
+
+    return _rcc_apply(rcc);
+}
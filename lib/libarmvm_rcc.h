@@ -0,0 +1,89 @@
+/** @file */
+#ifndef __LIBARMVM_RCC_H__
+#define __LIBARMVM_RCC_H__
+
+#include <armvm.h>
+
+/**
+ * @brief First address of the reset and clock control of the STM32F070.
+ */
+#define LIBARMVM_RCC_BASE_ADDR (0x40021000)
+#define LIBARMVM_RCC_SIZE      (0x400)
+
+/*
+ * Frequencies of the oscillators in Hz. The HSE is the crystal of the usual boards.
+ */
+#define LIBARMVM_RCC_HSI   (8000000)
+#define LIBARMVM_RCC_HSE   (8000000)
+#define LIBARMVM_RCC_LSE   (32768)
+
+/**
+ * @brief A ratio of the core clock to the clock of a peripheral is a fixed point value with
+ * LIBARMVM_RCC_RATIO_SHIFT fractional bits: core cycles per cycle of the peripheral clock.
+ */
+#define LIBARMVM_RCC_RATIO_SHIFT (16)
+#define LIBARMVM_RCC_RATIO_ONE   (1 << LIBARMVM_RCC_RATIO_SHIFT)
+
+
+/**
+ * @brief Reset and clock control with the register layout of the STM32F070.
+ * The frequencies of SYSCLK, HCLK and PCLK are only computed, when the clock configuration is written.
+ * A change is passed on at once: HCLK becomes the frequency of the core clock (see libarmvm_ci_set_core_clock()),
+ * the timers, the USARTs and the ADC get the ratios of their clocks to the core clock.
+ *
+ * After the reset, the core clock is armvm->opts.core_clock and all peripherals are clocked by it,
+ * until the program changes the clock configuration. The oscillators and the PLL are ready as soon as
+ * they are switched on. The clock security system and the reset flags of the peripherals are not modeled.
+ */
+struct libarmvm_rcc {
+    struct armvm *armvm;
+
+    uint32_t cr;
+    uint32_t cfgr;
+    uint32_t cir;
+    uint32_t apb2rstr;
+    uint32_t apb1rstr;
+    uint32_t ahbenr;
+    uint32_t apb2enr;
+    uint32_t apb1enr;
+    uint32_t bdcr;
+    uint32_t csr;
+    uint32_t ahbrstr;
+    uint32_t cfgr2;
+    uint32_t cfgr3;
+    uint32_t cr2;
+
+    uint64_t sysclk;       /**< Frequency of SYSCLK in Hz. */
+    uint64_t hclk;         /**< Frequency of HCLK (core and AHB) in Hz. */
+    uint64_t pclk;         /**< Frequency of PCLK (APB) in Hz. */
+    uint64_t usart_clock;  /**< Frequency of the clock of USART1 in Hz. USART2 is clocked by PCLK. */
+};
+
+
+/**
+ * @brief Returns the cycles of the core clock, which pass during clocks cycles of a peripheral clock with
+ * the ratio ratio (see LIBARMVM_RCC_RATIO_SHIFT). A started cycle of the core clock counts as whole cycle.
+ */
+static inline uint64_t libarmvm_rcc_cycles(uint64_t ratio, uint64_t clocks)
+{
+    return (clocks * ratio + LIBARMVM_RCC_RATIO_ONE - 1) >> LIBARMVM_RCC_RATIO_SHIFT;
+}
+
+
+/**
+ * @brief Initializes the reset and clock control and maps its registers to LIBARMVM_RCC_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_rcc_init(struct armvm *armvm, struct libarmvm_rcc *rcc);
+
+
+/**
+ * @brief Resets the registers and clocks all peripherals with the core clock after the reset.
+ * Has to be called after the control interface reset the core clock and after the resets of the other peripherals.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_rcc_reset(struct libarmvm_rcc *rcc);
+
+#endif
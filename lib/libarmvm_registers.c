@@ -1,6 +1,9 @@
 #include <libarmvm_registers.h>
+#include <libarmvm_ci.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <inttypes.h>
+#include <assert.h>
 
 #define REG_PC (0b1111)
 #define REG_SP (0b1101)
@@ -145,6 +148,74 @@ int _write_sp_process(void *data, const uint32_t *src)
 }
 
 
+void _stack_update(struct libarmvm_registers *regs, struct libarmvm_stack_usage *stack, uint32_t sp, const char *name)
+{
+    if (!stack->top) {
+        stack->top = sp;
+        stack->lowest = sp;
+    }
+
+    if (sp < stack->lowest) {
+        stack->lowest = sp;
+    }
+
+    if (stack->guard && sp < stack->guard) {
+        if (!stack->overflows) {
+            stack->guard_pc = regs->gpr[REG_PC];
+        }
+        stack->overflows++;
+        fprintf(stderr, "ERROR:0x%08x: Stack overflow: %s 0x%08x is below the guard 0x%08x.\n",
+                        regs->gpr[REG_PC], name, sp, stack->guard);
+        // the registers may be used without a control interface
+        if (regs->armvm->ci) {
+            libarmvm_ci_stack_overflow(regs->armvm);
+        }
+    }
+}
+
+
+void _stack_update_active(struct libarmvm_registers *regs)
+{
+    if (regs->control & REG_CONTROL_SPSEL) {
+        _stack_update(regs, &regs->stack_process, regs->gpr[REG_SP], "PSP");
+    } else {
+        _stack_update(regs, &regs->stack_main, regs->gpr[REG_SP], "MSP");
+    }
+}
+
+
+int _write_gpr_tracked(void *data, uint8_t reg_id, const uint32_t *src)
+{
+    int ret = _write_gpr(data, reg_id, src);
+    if (ARMVM_RET_SUCCESS == ret && REG_SP == reg_id) {
+        _stack_update_active(data);
+    }
+    return ret;
+}
+
+
+int _write_sp_main_tracked(void *data, const uint32_t *src)
+{
+    struct libarmvm_registers *regs = data;
+    int ret = _write_sp_main(data, src);
+    if (ARMVM_RET_SUCCESS == ret) {
+        _stack_update(regs, &regs->stack_main, *src, "MSP");
+    }
+    return ret;
+}
+
+
+int _write_sp_process_tracked(void *data, const uint32_t *src)
+{
+    struct libarmvm_registers *regs = data;
+    int ret = _write_sp_process(data, src);
+    if (ARMVM_RET_SUCCESS == ret) {
+        _stack_update(regs, &regs->stack_process, *src, "PSP");
+    }
+    return ret;
+}
+
+
 int libarmvm_registers_init(struct armvm *armvm)
 {
     int ret = ARMVM_RET_SUCCESS;
@@ -194,6 +265,60 @@ err:
 }
 
 
+int libarmvm_registers_stack_enable(struct armvm *armvm, uint32_t guard_main, uint32_t guard_process)
+{
+    assert(armvm);
+    assert(armvm->regs);
+    assert(armvm->regs->data);
+
+    struct libarmvm_registers *regs = armvm->regs->data;
+
+    regs->stack_main.guard = guard_main;
+    regs->stack_process.guard = guard_process;
+    regs->armvm = armvm;
+
+    armvm->regs->write_gpr = _write_gpr_tracked;
+    armvm->regs->write_sp_main = _write_sp_main_tracked;
+    armvm->regs->write_sp_process = _write_sp_process_tracked;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _stack_report(const struct libarmvm_stack_usage *stack, const char *name, FILE *out)
+{
+    if (!stack->top) {
+        fprintf(out, "%s: not used\n", name);
+        return;
+    }
+
+    fprintf(out, "%s: top 0x%08x, lowest 0x%08x, max. usage %u bytes\n", name, stack->top, stack->lowest, stack->top - stack->lowest);
+    if (stack->guard) {
+        if (stack->overflows) {
+            fprintf(out, "%s: crossed the guard 0x%08x %" PRIu64 " times, first at 0x%08x\n", name, stack->guard, stack->overflows, stack->guard_pc);
+        } else {
+            fprintf(out, "%s: %u bytes left above the guard 0x%08x\n", name, stack->lowest - stack->guard, stack->guard);
+        }
+    }
+}
+
+
+int libarmvm_registers_stack_report(struct armvm *armvm, FILE *out)
+{
+    assert(armvm);
+    assert(armvm->regs);
+    assert(armvm->regs->data);
+
+    struct libarmvm_registers *regs = armvm->regs->data;
+
+    fprintf(out, "# libarmvm stack report\n");
+    _stack_report(&regs->stack_main, "MSP", out);
+    _stack_report(&regs->stack_process, "PSP", out);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
 int libarmvm_registers_cleanup(struct armvm *armvm)
 {
     if (armvm->regs) {
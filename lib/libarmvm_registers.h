@@ -17,9 +17,22 @@
 #define __LIBARMVM_REGISTERS_H__
 
 #include <armvm.h>
+#include <stdio.h>
 
 #define LIBARMVM_GPR_SIZE 16
 
+/**
+ * @brief Usage of one stack (main or process stack).
+ */
+struct libarmvm_stack_usage {
+    uint32_t top;       /**< First value written to the stack pointer. 0 if the stack was never set. */
+    uint32_t lowest;    /**< Lowest value of the stack pointer (high-water mark). */
+    uint32_t guard;     /**< The stack pointer must not be lower than this address. 0 if there is no guard. */
+    uint32_t guard_pc;  /**< Address of the instruction which crossed the guard first. */
+    uint64_t overflows; /**< How often the stack pointer crossed the guard. */
+};
+
+
 /**
  * @brief This struct holds the data of the registers
  */
@@ -29,6 +42,14 @@ struct libarmvm_registers {
     uint32_t control;     /**< CONTROL register */
     uint32_t SP_main;
     uint32_t SP_process;
+
+    /**
+     * @brief Usage of the main and the process stack.
+     * Is only updated after libarmvm_registers_stack_enable() was called.
+     */
+    struct libarmvm_stack_usage stack_main;
+    struct libarmvm_stack_usage stack_process;
+    struct armvm *armvm; /**< Is stopped when a stack pointer crosses its guard. Is set by libarmvm_registers_stack_enable(). */
 };
 
 /**
@@ -40,6 +61,29 @@ struct libarmvm_registers {
 int libarmvm_registers_init(struct armvm *armvm);
 
 
+/**
+ * @brief Enables the tracking of the stack usage.
+ * After this call, every write to the stack pointers updates libarmvm_registers.stack_main
+ * and libarmvm_registers.stack_process. A message is printed every time a stack pointer
+ * crosses its guard and the vm stops with ARMVM_RET_STACK_OVERFLOW after the instruction
+ * (see libarmvm_ci_stack_overflow()). Without this call, the writes have no additional overhead.
+ *
+ * @param guard_main Guard address of the main stack or 0.
+ * @param guard_process Guard address of the process stack or 0.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_registers_stack_enable(struct armvm *armvm, uint32_t guard_main, uint32_t guard_process);
+
+
+/**
+ * @brief Writes the high-water marks of both stacks.
+ *
+ * @param out Destination of the report.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_registers_stack_report(struct armvm *armvm, FILE *out);
+
+
 /**
  * @brief Cleans up the register model.
  *
@@ -0,0 +1,148 @@
+#include <libarmvm_ring.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * Wakes up the other side, if it sleeps. Is called after a transfer.
+ */
+void _ring_signal(struct libarmvm_ring *ring)
+{
+    // the transfer and this load are sequentially consistent, therefore a side which goes to sleep
+    // either sees the transfer or is seen here
+    if (atomic_load(&ring->waiting)) {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+
+int libarmvm_ring_init(struct libarmvm_ring *ring, size_t size)
+{
+    assert(size && !(size & (size - 1)));
+
+    memset(ring, 0, sizeof(*ring));
+    ring->buffer = malloc(size);
+    if (!ring->buffer) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+    ring->size = size;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->waiting, 0);
+    atomic_init(&ring->closed, 0);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->cond, NULL);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+size_t libarmvm_ring_write(struct libarmvm_ring *ring, const uint8_t *data, size_t len)
+{
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const size_t space = ring->size - (head - tail);
+
+    if (len > space) {
+        len = space;
+    }
+    if (!len) {
+        return 0;
+    }
+
+    const size_t pos = head & (ring->size - 1);
+    const size_t first = len < ring->size - pos ? len : ring->size - pos;
+    memcpy(ring->buffer + pos, data, first);
+    memcpy(ring->buffer, data + first, len - first);
+
+    atomic_store(&ring->head, head + len);
+    _ring_signal(ring);
+
+    return len;
+}
+
+
+size_t libarmvm_ring_read(struct libarmvm_ring *ring, uint8_t *data, size_t len)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (len > head - tail) {
+        len = head - tail;
+    }
+    if (!len) {
+        return 0;
+    }
+
+    const size_t pos = tail & (ring->size - 1);
+    const size_t first = len < ring->size - pos ? len : ring->size - pos;
+    memcpy(data, ring->buffer + pos, first);
+    memcpy(data + first, ring->buffer, len - first);
+
+    atomic_store(&ring->tail, tail + len);
+    _ring_signal(ring);
+
+    return len;
+}
+
+
+size_t libarmvm_ring_readable(struct libarmvm_ring *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_acquire) - atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+
+int libarmvm_ring_wait_readable(struct libarmvm_ring *ring)
+{
+    if (libarmvm_ring_readable(ring)) {
+        return 1;
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_add(&ring->waiting, 1);
+    while (atomic_load(&ring->head) == atomic_load(&ring->tail) && !atomic_load(&ring->closed)) {
+        pthread_cond_wait(&ring->cond, &ring->lock);
+    }
+    atomic_fetch_sub(&ring->waiting, 1);
+    pthread_mutex_unlock(&ring->lock);
+
+    return 0 != libarmvm_ring_readable(ring);
+}
+
+
+int libarmvm_ring_wait_writable(struct libarmvm_ring *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_add(&ring->waiting, 1);
+    while (atomic_load(&ring->head) - atomic_load(&ring->tail) == ring->size && !atomic_load(&ring->closed)) {
+        pthread_cond_wait(&ring->cond, &ring->lock);
+    }
+    atomic_fetch_sub(&ring->waiting, 1);
+    pthread_mutex_unlock(&ring->lock);
+
+    return !atomic_load(&ring->closed);
+}
+
+
+void libarmvm_ring_close(struct libarmvm_ring *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    atomic_store(&ring->closed, 1);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+
+void libarmvm_ring_cleanup(struct libarmvm_ring *ring)
+{
+    if (ring->buffer) {
+        pthread_mutex_destroy(&ring->lock);
+        pthread_cond_destroy(&ring->cond);
+        free(ring->buffer);
+        ring->buffer = NULL;
+    }
+}
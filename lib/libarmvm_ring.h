@@ -0,0 +1,88 @@
+/** @file */
+#ifndef __LIBARMVM_RING_H__
+#define __LIBARMVM_RING_H__
+
+#include <armvm.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/**
+ * @brief Lock-free ring buffer of bytes with a single producer and a single consumer thread.
+ * Both sides transfer bytes without a lock. Only a side which waits for data or space, takes
+ * the lock and sleeps on the condition until the other side signals a transfer.
+ */
+struct libarmvm_ring {
+    uint8_t *buffer;
+    size_t size;  /**< Size of the buffer (power of two). */
+
+    _Alignas(64) atomic_size_t head;  /**< Total amount of written bytes. Is only written by the producer. */
+    _Alignas(64) atomic_size_t tail;  /**< Total amount of read bytes. Is only written by the consumer. */
+
+    _Alignas(64) atomic_int waiting;  /**< Amount of sides, which sleep on cond. */
+    atomic_int closed;                /**< Is set by libarmvm_ring_close(). */
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+
+/**
+ * @brief Initializes an empty ring.
+ *
+ * @param size Size of the buffer in bytes (power of two).
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_ring_init(struct libarmvm_ring *ring, size_t size);
+
+
+/**
+ * @brief Writes up to len bytes to the ring without blocking. Must only be called by the producer.
+ *
+ * @return Amount of written bytes.
+ */
+size_t libarmvm_ring_write(struct libarmvm_ring *ring, const uint8_t *data, size_t len);
+
+
+/**
+ * @brief Reads up to len bytes from the ring without blocking. Must only be called by the consumer.
+ *
+ * @return Amount of read bytes.
+ */
+size_t libarmvm_ring_read(struct libarmvm_ring *ring, uint8_t *data, size_t len);
+
+
+/**
+ * @brief Returns the amount of bytes, which can be read. Must only be called by the consumer.
+ */
+size_t libarmvm_ring_readable(struct libarmvm_ring *ring);
+
+
+/**
+ * @brief Blocks the consumer until the ring is not empty or it is closed.
+ *
+ * @return 0 if the ring is closed and empty.
+ */
+int libarmvm_ring_wait_readable(struct libarmvm_ring *ring);
+
+
+/**
+ * @brief Blocks the producer until the ring is not full or it is closed.
+ *
+ * @return 0 if the ring is closed.
+ */
+int libarmvm_ring_wait_writable(struct libarmvm_ring *ring);
+
+
+/**
+ * @brief Closes the ring and wakes up both sides. The consumer can read the remaining bytes.
+ */
+void libarmvm_ring_close(struct libarmvm_ring *ring);
+
+
+/**
+ * @brief Frees the buffer of the ring. Both sides have to be stopped before.
+ */
+void libarmvm_ring_cleanup(struct libarmvm_ring *ring);
+
+#endif
@@ -0,0 +1,473 @@
+#include <libarmvm_semihosting.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * @brief Name of the console in SYS_OPEN.
+ */
+#define SEMIHOSTING_CONSOLE ":tt"
+
+#define SEMIHOSTING_MAX_NAME (4096)
+
+#define SEMIHOSTING_ERROR (0xffffffff)
+
+#define SEMIHOSTING_WRITE0_BLOCK (256)
+
+
+int libarmvm_semihosting_init(struct libarmvm_semihosting *semihosting)
+{
+    for (size_t i = 0; i < LIBARMVM_SEMIHOSTING_FILES; ++i) {
+        semihosting->fds[i] = -1;
+    }
+
+    semihosting->buffer = malloc(LIBARMVM_SEMIHOSTING_BUFFER_SIZE);
+    if (!semihosting->buffer) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return ARMVM_RET_NO_MEM;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _semihosting_close(struct libarmvm_semihosting *semihosting, size_t idx)
+{
+    const int fd = semihosting->fds[idx];
+    if (fd != STDIN_FILENO && fd != STDOUT_FILENO && fd != STDERR_FILENO) {
+        close(fd);
+    }
+    semihosting->fds[idx] = -1;
+}
+
+
+void libarmvm_semihosting_cleanup(struct libarmvm_semihosting *semihosting)
+{
+    for (size_t i = 0; i < LIBARMVM_SEMIHOSTING_FILES; ++i) {
+        if (0 <= semihosting->fds[i]) {
+            _semihosting_close(semihosting, i);
+        }
+    }
+    free(semihosting->buffer);
+    semihosting->buffer = NULL;
+}
+
+
+/**
+ * @brief Returns the file descriptor of a handle or -1, if the handle is not open.
+ */
+static inline int _semihosting_fd(const struct libarmvm_semihosting *semihosting, uint32_t handle)
+{
+    if (!handle || handle > LIBARMVM_SEMIHOSTING_FILES) {
+        return -1;
+    }
+    return semihosting->fds[handle - 1];
+}
+
+
+/**
+ * @brief Reads the parameter block of an operation.
+ */
+int _semihosting_params(struct armvm *armvm, uint32_t addr, uint32_t *params, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        int ret = armvm->mem->read_word(armvm->mem->data, addr + 4 * i, &params[i]);
+        if (ret) {
+            fprintf(stderr, "WARN: Invalid parameter block of a semihosting operation: 0x%08x\n", addr);
+            return ret;
+        }
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Appends a result of the vm to the log of the reference instance.
+ */
+int _semihosting_replay_append(struct libarmvm_semihosting_replay *replay, const void *data, size_t size)
+{
+    if (replay->size + size > replay->capacity) {
+        size_t capacity = replay->capacity ? 2 * replay->capacity : LIBARMVM_SEMIHOSTING_BUFFER_SIZE;
+        while (capacity < replay->size + size) {
+            capacity *= 2;
+        }
+        uint8_t *log = realloc(replay->data, capacity);
+        if (!log) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return ARMVM_RET_NO_MEM;
+        }
+        replay->data = log;
+        replay->capacity = capacity;
+    }
+
+    memcpy(replay->data + replay->size, data, size);
+    replay->size += size;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Takes the next size bytes of the log in the reference instance.
+ * The bytes stay valid until the vm appends the next result.
+ *
+ * @return Pointer to the bytes or NULL, if the vm did not log them.
+ */
+const uint8_t *_semihosting_replay_take(struct libarmvm_semihosting_replay *replay, size_t size)
+{
+    if (replay->pos + size > replay->size) {
+        return NULL;
+    }
+    const uint8_t *data = replay->data + replay->pos;
+    replay->pos += size;
+
+    // the log is empty, when the reference instance caught up
+    if (replay->pos == replay->size) {
+        replay->pos = 0;
+        replay->size = 0;
+    }
+
+    return data;
+}
+
+
+/**
+ * @brief Replays the next read of the vm in the reference instance.
+ * If the vm did not read, the read ends at the end of the file.
+ */
+uint32_t _semihosting_replay_read(struct armvm *armvm, struct libarmvm_semihosting_replay *replay, const uint32_t *params)
+{
+    uint32_t count;
+
+    const uint8_t *logged = _semihosting_replay_take(replay, sizeof(count));
+    if (!logged) {
+        return params[2];
+    }
+    memcpy(&count, logged, sizeof(count));
+
+    logged = _semihosting_replay_take(replay, count);
+    if (!logged) {
+        return params[2];
+    }
+    if (count && libarmvm_memory_write_bytes(armvm, params[1], logged, count)) {
+        fprintf(stderr, "WARN: Invalid buffer of SYS_READ: 0x%08x\n", params[1]);
+    }
+
+    return params[2] - count;
+}
+
+
+/**
+ * @brief Opens a file, which may be written and read back. The vm logs whether the file was opened,
+ * the reference instance replays it and opens /dev/null instead.
+ */
+int _semihosting_open_replayed(struct libarmvm_semihosting_replay *replay, int reference, const char *name, int flags)
+{
+    uint32_t opened;
+
+    if (reference) {
+        const uint8_t *logged = replay ? _semihosting_replay_take(replay, sizeof(opened)) : NULL;
+        if (logged) {
+            memcpy(&opened, logged, sizeof(opened));
+        }
+        return logged && !opened ? -1 : open("/dev/null", O_RDWR);
+    }
+
+    const int fd = open(name, flags, 0644);
+    opened = 0 <= fd;
+    if (replay && _semihosting_replay_append(replay, &opened, sizeof(opened))) {
+        if (0 <= fd) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    return fd;
+}
+
+
+uint32_t _semihosting_open(struct armvm *armvm, struct libarmvm_semihosting *semihosting, uint32_t addr, int reference)
+{
+    // O_* flags of the ISO C modes "r", "rb", "r+", "r+b", "w", "wb", "w+", "w+b", "a", "ab", "a+" and "a+b"
+    static const int flags[] = { O_RDONLY, O_RDWR, O_WRONLY | O_CREAT | O_TRUNC, O_RDWR | O_CREAT | O_TRUNC,
+                                 O_WRONLY | O_CREAT | O_APPEND, O_RDWR | O_CREAT | O_APPEND };
+    uint32_t params[3];
+    char name[SEMIHOSTING_MAX_NAME + 1];
+
+    if (_semihosting_params(armvm, addr, params, 3)) {
+        return SEMIHOSTING_ERROR;
+    }
+    if (params[1] > 11 || params[2] > SEMIHOSTING_MAX_NAME) {
+        return SEMIHOSTING_ERROR;
+    }
+    if (libarmvm_memory_read_bytes(armvm, params[0], (uint8_t *)name, params[2])) {
+        fprintf(stderr, "WARN: Invalid file name of SYS_OPEN: 0x%08x\n", params[0]);
+        return SEMIHOSTING_ERROR;
+    }
+    name[params[2]] = '\0';
+
+    size_t idx = 0;
+    while (idx < LIBARMVM_SEMIHOSTING_FILES && 0 <= semihosting->fds[idx]) {
+        idx++;
+    }
+    if (LIBARMVM_SEMIHOSTING_FILES == idx) {
+        return SEMIHOSTING_ERROR;
+    }
+
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const int mode_flags = flags[params[1] / 2];
+    int replayed = 0;
+    int fd;
+    if (0 == strcmp(SEMIHOSTING_CONSOLE, name)) {
+        // the console is stdin for "r", stdout for "w" and stderr for "a". The reference instance replays stdin
+        const int fds[] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+        fd = reference && params[1] / 4 ? open("/dev/null", O_RDWR) : fds[params[1] / 4];
+        replayed = STDIN_FILENO == fds[params[1] / 4];
+    } else if (O_RDONLY != mode_flags) {
+        fd = _semihosting_open_replayed(ci->replay, reference, name, mode_flags);
+        replayed = 1;
+    } else {
+        fd = open(name, mode_flags, 0644);
+    }
+    if (0 > fd) {
+        return SEMIHOSTING_ERROR;
+    }
+
+    semihosting->fds[idx] = fd;
+    semihosting->replayed[idx] = replayed;
+    return idx + 1;
+}
+
+
+uint32_t _semihosting_write(struct armvm *armvm, struct libarmvm_semihosting *semihosting, uint32_t addr)
+{
+    uint32_t params[3];
+
+    if (_semihosting_params(armvm, addr, params, 3)) {
+        return SEMIHOSTING_ERROR;
+    }
+
+    const int fd = _semihosting_fd(semihosting, params[0]);
+    if (0 > fd) {
+        return params[2];
+    }
+
+    // the result is the amount of bytes, which were not written
+    uint32_t done = 0;
+    while (done < params[2]) {
+        uint32_t len = params[2] - done;
+        if (len > LIBARMVM_SEMIHOSTING_BUFFER_SIZE) {
+            len = LIBARMVM_SEMIHOSTING_BUFFER_SIZE;
+        }
+        if (libarmvm_memory_read_bytes(armvm, params[1] + done, semihosting->buffer, len)) {
+            fprintf(stderr, "WARN: Invalid buffer of SYS_WRITE: 0x%08x\n", params[1] + done);
+            break;
+        }
+
+        uint32_t written = 0;
+        while (written < len) {
+            const ssize_t n = write(fd, semihosting->buffer + written, len - written);
+            if (0 > n) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                return params[2] - done - written;
+            }
+            written += n;
+        }
+        done += len;
+    }
+
+    return params[2] - done;
+}
+
+
+uint32_t _semihosting_read(struct armvm *armvm, struct libarmvm_semihosting *semihosting, uint32_t addr)
+{
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    uint32_t params[3];
+
+    if (_semihosting_params(armvm, addr, params, 3)) {
+        return SEMIHOSTING_ERROR;
+    }
+
+    const int fd = _semihosting_fd(semihosting, params[0]);
+    if (0 > fd) {
+        return params[2];
+    }
+
+    struct libarmvm_semihosting_replay *replay = semihosting->replayed[params[0] - 1] ? ci->replay : NULL;
+    if (ci->reference && semihosting->replayed[params[0] - 1]) {
+        return replay ? _semihosting_replay_read(armvm, replay, params) : params[2];
+    }
+
+    size_t header = 0;
+    if (replay) {
+        // the amount of read bytes is patched after the read
+        const uint32_t count = 0;
+        header = replay->size;
+        if (_semihosting_replay_append(replay, &count, sizeof(count))) {
+            return SEMIHOSTING_ERROR;
+        }
+    }
+
+    // the result is the amount of bytes, which were not read. A short read (e.g. of a terminal) ends the operation
+    uint32_t done = 0;
+    while (done < params[2]) {
+        uint32_t len = params[2] - done;
+        if (len > LIBARMVM_SEMIHOSTING_BUFFER_SIZE) {
+            len = LIBARMVM_SEMIHOSTING_BUFFER_SIZE;
+        }
+
+        const ssize_t n = read(fd, semihosting->buffer, len);
+        if (0 > n) {
+            if (EINTR == errno) {
+                continue;
+            }
+            break;
+        }
+        if (libarmvm_memory_write_bytes(armvm, params[1] + done, semihosting->buffer, n)) {
+            fprintf(stderr, "WARN: Invalid buffer of SYS_READ: 0x%08x\n", params[1] + done);
+            break;
+        }
+        if (replay && _semihosting_replay_append(replay, semihosting->buffer, n)) {
+            break;
+        }
+        done += n;
+        if ((uint32_t)n < len) {
+            break;
+        }
+    }
+
+    if (replay) {
+        memcpy(replay->data + header, &done, sizeof(done));
+    }
+
+    return params[2] - done;
+}
+
+
+void _semihosting_write0(struct armvm *armvm, struct libarmvm_semihosting *semihosting, uint32_t addr, int reference)
+{
+    // the string is read in aligned blocks, which are small, because most strings are short
+    while (1) {
+        const uint32_t len = SEMIHOSTING_WRITE0_BLOCK - (addr & (SEMIHOSTING_WRITE0_BLOCK - 1));
+        size_t size = len;
+
+        if (libarmvm_memory_read_bytes(armvm, addr, semihosting->buffer, len)) {
+            // the block leaves the memory area, the string may end before
+            for (size = 0; size < len; ++size) {
+                if (armvm->mem->read_byte(armvm->mem->data, addr + size, &semihosting->buffer[size])) {
+                    fprintf(stderr, "WARN: Invalid string of SYS_WRITE0: 0x%08x\n", (uint32_t)(addr + size));
+                    return;
+                }
+                if (!semihosting->buffer[size]) {
+                    size++;
+                    break;
+                }
+            }
+        }
+
+        const uint8_t *end = memchr(semihosting->buffer, 0, size);
+        const size_t n = end ? (size_t)(end - semihosting->buffer) : size;
+        if (!reference && n != fwrite(semihosting->buffer, 1, n, stdout)) {
+            fprintf(stderr, "WARN: Could not write the string of SYS_WRITE0.\n");
+        }
+        if (end) {
+            break;
+        }
+        addr += len;
+    }
+    fflush(stdout);
+}
+
+
+int libarmvm_semihosting_call(struct armvm *armvm)
+{
+    struct libarmvm_ci *ci = armvm->ci->data;
+    uint32_t op;
+    uint32_t param;
+    uint32_t result = 0;
+    int ret = ARMVM_RET_SUCCESS;
+
+    if (!ci->semihosting) {
+        ci->semihosting = calloc(1, sizeof(*ci->semihosting));
+        if (!ci->semihosting) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return ARMVM_RET_NO_MEM;
+        }
+        ret = libarmvm_semihosting_init(ci->semihosting);
+        if (ret) {
+            free(ci->semihosting);
+            ci->semihosting = NULL;
+            return ret;
+        }
+    }
+    struct libarmvm_semihosting *semihosting = ci->semihosting;
+
+    if (armvm->regs->read_gpr(armvm->regs->data, 0, &op) || armvm->regs->read_gpr(armvm->regs->data, 1, &param)) {
+        fprintf(stderr, "ERROR: Could not read gpr.\n");
+        return ARMVM_RET_FAIL;
+    }
+
+    switch (op) {
+        case LIBARMVM_SYS_OPEN:
+            result = _semihosting_open(armvm, semihosting, param, ci->reference);
+            break;
+        case LIBARMVM_SYS_CLOSE:
+            {
+                uint32_t handle;
+                if (_semihosting_params(armvm, param, &handle, 1) || 0 > _semihosting_fd(semihosting, handle)) {
+                    result = SEMIHOSTING_ERROR;
+                } else {
+                    _semihosting_close(semihosting, handle - 1);
+                }
+            }
+            break;
+        case LIBARMVM_SYS_WRITE0:
+            _semihosting_write0(armvm, semihosting, param, ci->reference);
+            return ARMVM_RET_SUCCESS;
+        case LIBARMVM_SYS_WRITE:
+            result = _semihosting_write(armvm, semihosting, param);
+            break;
+        case LIBARMVM_SYS_READ:
+            result = _semihosting_read(armvm, semihosting, param);
+            break;
+        case LIBARMVM_SYS_CLOCK:
+            {
+                // centiseconds of simulated time
+                uint64_t ns;
+                armvm->ci->get_time(armvm, &ns);
+                result = ns / 10000000;
+            }
+            break;
+        case LIBARMVM_SYS_EXIT:
+            armvm->exit_code = LIBARMVM_SEMIHOSTING_APPLICATION_EXIT == param ? 0 : 1;
+            return ARMVM_RET_EXIT;
+        case LIBARMVM_SYS_EXIT_EXTENDED:
+            {
+                uint32_t params[2];
+                if (_semihosting_params(armvm, param, params, 2)) {
+                    return ARMVM_RET_FAIL;
+                }
+                armvm->exit_code = LIBARMVM_SEMIHOSTING_APPLICATION_EXIT == params[0] ? (int)params[1] : 1;
+            }
+            return ARMVM_RET_EXIT;
+        default:
+            fprintf(stderr, "WARN: Unsupported semihosting operation: 0x%02x\n", op);
+            result = SEMIHOSTING_ERROR;
+            break;
+    }
+
+    if (armvm->regs->write_gpr(armvm->regs->data, 0, &result)) {
+        fprintf(stderr, "ERROR: Could not write gpr.\n");
+        return ARMVM_RET_FAIL;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
@@ -0,0 +1,95 @@
+/** @file */
+#ifndef __LIBARMVM_SEMIHOSTING_H__
+#define __LIBARMVM_SEMIHOSTING_H__
+
+#include <armvm.h>
+
+/**
+ * @brief Immediate of the BKPT instruction, which requests a semihosting operation.
+ */
+#define LIBARMVM_SEMIHOSTING_BKPT (0xab)
+
+/*
+ * Semihosting operations (R0), which are implemented.
+ */
+#define LIBARMVM_SYS_OPEN          (0x01)
+#define LIBARMVM_SYS_CLOSE         (0x02)
+#define LIBARMVM_SYS_WRITE0        (0x04)
+#define LIBARMVM_SYS_WRITE         (0x05)
+#define LIBARMVM_SYS_READ          (0x06)
+#define LIBARMVM_SYS_CLOCK         (0x10)
+#define LIBARMVM_SYS_EXIT          (0x18)
+#define LIBARMVM_SYS_EXIT_EXTENDED (0x20)
+
+/**
+ * @brief Reason of SYS_EXIT for a normal end of the program (ADP_Stopped_ApplicationExit).
+ */
+#define LIBARMVM_SEMIHOSTING_APPLICATION_EXIT (0x20026)
+
+/**
+ * @brief Maximal amount of files, which are open at the same time.
+ */
+#define LIBARMVM_SEMIHOSTING_FILES (32)
+
+/**
+ * @brief Size of the buffer, through which the data is copied between the memory and the files.
+ */
+#define LIBARMVM_SEMIHOSTING_BUFFER_SIZE (1 << 16)
+
+
+/**
+ * @brief Files of the host, which were opened by the program.
+ * The handle of a file is its index plus one. The data of SYS_READ and SYS_WRITE is copied
+ * between the memory and the file in blocks of LIBARMVM_SEMIHOSTING_BUFFER_SIZE bytes.
+ */
+struct libarmvm_semihosting {
+    int fds[LIBARMVM_SEMIHOSTING_FILES];  /**< File descriptors. -1 if the handle is not used. */
+    uint8_t replayed[LIBARMVM_SEMIHOSTING_FILES]; /**< 1 if the reads of the handle are logged by the vm and replayed by the reference instance. */
+    uint8_t *buffer;
+};
+
+
+/**
+ * @brief Results of the host in the lockstep mode, which the reference instance replays instead of
+ * accessing the host. The vm logs every SYS_READ of the console (stdin) and of files, which are
+ * opened for writing, as the amount of read bytes followed by the bytes, and the success of SYS_OPEN
+ * of these files. The reference instance runs behind the vm, therefore the log holds the results,
+ * which the reference instance did not get yet.
+ */
+struct libarmvm_semihosting_replay {
+    uint8_t *data;
+    size_t size;      /**< Amount of logged bytes. */
+    size_t capacity;  /**< Size of data. */
+    size_t pos;       /**< Position of the next read of the reference instance. */
+};
+
+
+/**
+ * @brief Initializes the semihosting without any open file.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_semihosting_init(struct libarmvm_semihosting *semihosting);
+
+
+/**
+ * @brief Frees the buffer and closes all files, which were opened by the program.
+ */
+void libarmvm_semihosting_cleanup(struct libarmvm_semihosting *semihosting);
+
+
+/**
+ * @brief Executes the semihosting operation R0 with the parameter R1 and writes the result to R0.
+ * Is called by BKPT 0xAB. The semihosting is initialized at the first call.
+ *
+ * The reference instance of the lockstep mode does not write anything to the host. Files, which are
+ * written, are replaced by /dev/null. Opening them and the reads of them and of the console are
+ * replayed from the results of the vm (see libarmvm_semihosting_replay), therefore both instances
+ * get the same results, even if a file is read back after it was written.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ *         ARMVM_RET_EXIT if the program stopped the vm (SYS_EXIT). The exit code is stored in armvm->exit_code.
+ */
+int libarmvm_semihosting_call(struct armvm *armvm);
+
+#endif
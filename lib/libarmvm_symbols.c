@@ -0,0 +1,864 @@
+#include <libarmvm_symbols.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// DWARF constants which are used by the line table parser
+#define DW_LNS_copy               (0x01)
+#define DW_LNS_advance_pc         (0x02)
+#define DW_LNS_advance_line       (0x03)
+#define DW_LNS_set_file           (0x04)
+#define DW_LNS_const_add_pc       (0x08)
+#define DW_LNS_fixed_advance_pc   (0x09)
+#define DW_LNE_end_sequence       (0x01)
+#define DW_LNE_set_address        (0x02)
+#define DW_LNCT_path              (0x1)
+#define DW_LNCT_directory_index   (0x2)
+#define DW_FORM_block             (0x09)
+#define DW_FORM_data1             (0x0b)
+#define DW_FORM_data2             (0x05)
+#define DW_FORM_data4             (0x06)
+#define DW_FORM_data8             (0x07)
+#define DW_FORM_data16            (0x1e)
+#define DW_FORM_string            (0x08)
+#define DW_FORM_strp              (0x0e)
+#define DW_FORM_line_strp         (0x1f)
+#define DW_FORM_udata             (0x0f)
+
+
+int _symbols_compare(const void *a, const void *b)
+{
+    const struct libarmvm_symbol *sym_a = a;
+    const struct libarmvm_symbol *sym_b = b;
+
+    if (sym_a->addr < sym_b->addr) {
+        return -1;
+    }
+    return sym_a->addr > sym_b->addr;
+}
+
+
+int _symbols_check_header(const uint8_t *file, size_t size)
+{
+    if (size < sizeof(Elf32_Ehdr)) {
+        return ARMVM_RET_FAIL;
+    }
+
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)file;
+    if (   0 != memcmp(ehdr->e_ident, ELFMAG, SELFMAG)
+        || ELFCLASS32 != ehdr->e_ident[EI_CLASS]
+        || ELFDATA2LSB != ehdr->e_ident[EI_DATA]
+        || EM_ARM != ehdr->e_machine) {
+        return ARMVM_RET_FAIL;
+    }
+
+    if (   sizeof(Elf32_Shdr) != ehdr->e_shentsize
+        || ehdr->e_shoff + (size_t)ehdr->e_shnum * sizeof(Elf32_Shdr) > size) {
+        return ARMVM_RET_FAIL;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _symbols_read_symtab(struct libarmvm_symbols *symbols, const uint8_t *file, size_t size)
+{
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)file;
+    const Elf32_Shdr *shdr = (const Elf32_Shdr *)(file + ehdr->e_shoff);
+
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+        if (SHT_SYMTAB != shdr[i].sh_type) {
+            continue;
+        }
+
+        if (   shdr[i].sh_link >= ehdr->e_shnum
+            || shdr[i].sh_offset + shdr[i].sh_size > size
+            || shdr[shdr[i].sh_link].sh_offset + shdr[shdr[i].sh_link].sh_size > size) {
+            return ARMVM_RET_FAIL;
+        }
+
+        const Elf32_Sym *syms = (const Elf32_Sym *)(file + shdr[i].sh_offset);
+        const size_t syms_size = shdr[i].sh_size / sizeof(Elf32_Sym);
+        const char *strtab = (const char *)(file + shdr[shdr[i].sh_link].sh_offset);
+        const size_t strtab_size = shdr[shdr[i].sh_link].sh_size;
+
+        symbols->symbols = calloc(syms_size, sizeof(*symbols->symbols));
+        if (!symbols->symbols) {
+            fprintf(stderr, "ERROR: Not enough memory.\n");
+            return ARMVM_RET_NO_MEM;
+        }
+
+        for (size_t j = 0; j < syms_size; ++j) {
+            if (   STT_FUNC != ELF32_ST_TYPE(syms[j].st_info)
+                || SHN_UNDEF == syms[j].st_shndx
+                || syms[j].st_name >= strtab_size) {
+                continue;
+            }
+
+            const char *name = strtab + syms[j].st_name;
+            struct libarmvm_symbol *sym = &symbols->symbols[symbols->symbols_size];
+            sym->addr = syms[j].st_value & ~((uint32_t)0x1);
+            sym->size = syms[j].st_size;
+            sym->name = strndup(name, strtab_size - syms[j].st_name);
+            if (!sym->name) {
+                fprintf(stderr, "ERROR: Not enough memory.\n");
+                return ARMVM_RET_NO_MEM;
+            }
+            symbols->symbols_size++;
+        }
+
+        qsort(symbols->symbols, symbols->symbols_size, sizeof(*symbols->symbols), _symbols_compare);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Bounds checked reader for DWARF data. error is set on every read beyond end.
+ */
+struct _dwarf_reader {
+    const uint8_t *pos;
+    const uint8_t *end;
+    int error;
+};
+
+
+/**
+ * @brief Sections which are referenced by the line table.
+ */
+struct _dwarf_sections {
+    const uint8_t *line_str;
+    size_t line_str_size;
+    const uint8_t *str;
+    size_t str_size;
+};
+
+
+uint64_t _dwarf_read(struct _dwarf_reader *reader, size_t size)
+{
+    uint64_t value = 0;
+
+    if ((size_t)(reader->end - reader->pos) < size) {
+        reader->error = 1;
+        reader->pos = reader->end;
+        return 0;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        value |= (uint64_t)reader->pos[i] << (8 * i);
+    }
+    reader->pos += size;
+
+    return value;
+}
+
+
+uint64_t _dwarf_read_uleb128(struct _dwarf_reader *reader)
+{
+    uint64_t value = 0;
+    unsigned shift = 0;
+
+    while (reader->pos < reader->end) {
+        uint8_t byte = *reader->pos++;
+        if (shift < 64) {
+            value |= (uint64_t)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+
+    reader->error = 1;
+    return 0;
+}
+
+
+int64_t _dwarf_read_sleb128(struct _dwarf_reader *reader)
+{
+    uint64_t value = 0;
+    unsigned shift = 0;
+
+    while (reader->pos < reader->end) {
+        uint8_t byte = *reader->pos++;
+        if (shift < 64) {
+            value |= (uint64_t)(byte & 0x7f) << shift;
+        }
+        shift += 7;
+        if (!(byte & 0x80)) {
+            if (shift < 64 && (byte & 0x40)) {
+                value |= ~(uint64_t)0 << shift;
+            }
+            return (int64_t)value;
+        }
+    }
+
+    reader->error = 1;
+    return 0;
+}
+
+
+const char *_dwarf_read_string(struct _dwarf_reader *reader)
+{
+    const char *str = (const char *)reader->pos;
+    const uint8_t *nul = memchr(reader->pos, 0, reader->end - reader->pos);
+
+    if (!nul) {
+        reader->error = 1;
+        reader->pos = reader->end;
+        return "";
+    }
+    reader->pos = nul + 1;
+
+    return str;
+}
+
+
+void _dwarf_skip(struct _dwarf_reader *reader, uint64_t size)
+{
+    if ((uint64_t)(reader->end - reader->pos) < size) {
+        reader->error = 1;
+        reader->pos = reader->end;
+        return;
+    }
+    reader->pos += size;
+}
+
+
+const char *_dwarf_section_string(const uint8_t *section, size_t section_size, uint64_t offset)
+{
+    if (!section || offset >= section_size || !memchr(section + offset, 0, section_size - offset)) {
+        return NULL;
+    }
+    return (const char *)section + offset;
+}
+
+
+/**
+ * @brief Reads one attribute of a directory or file name entry (DWARF 5).
+ * Strings are stored in str, constants in value. All other forms are skipped.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int _dwarf_read_form(struct _dwarf_reader *reader, uint64_t form, size_t offset_size, const struct _dwarf_sections *sections, const char **str, uint64_t *value)
+{
+    switch (form) {
+        case DW_FORM_string:
+            *str = _dwarf_read_string(reader);
+            break;
+        case DW_FORM_line_strp:
+            *str = _dwarf_section_string(sections->line_str, sections->line_str_size, _dwarf_read(reader, offset_size));
+            if (!*str) {
+                return ARMVM_RET_FAIL;
+            }
+            break;
+        case DW_FORM_strp:
+            *str = _dwarf_section_string(sections->str, sections->str_size, _dwarf_read(reader, offset_size));
+            if (!*str) {
+                return ARMVM_RET_FAIL;
+            }
+            break;
+        case DW_FORM_udata:
+            *value = _dwarf_read_uleb128(reader);
+            break;
+        case DW_FORM_data1:
+            *value = _dwarf_read(reader, 1);
+            break;
+        case DW_FORM_data2:
+            *value = _dwarf_read(reader, 2);
+            break;
+        case DW_FORM_data4:
+            *value = _dwarf_read(reader, 4);
+            break;
+        case DW_FORM_data8:
+            *value = _dwarf_read(reader, 8);
+            break;
+        case DW_FORM_data16:
+            _dwarf_skip(reader, 16);
+            break;
+        case DW_FORM_block:
+            _dwarf_skip(reader, _dwarf_read_uleb128(reader));
+            break;
+        default:
+            return ARMVM_RET_FAIL;
+    }
+
+    return reader->error ? ARMVM_RET_FAIL : ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Returns the index of the source file dir/name in symbols->files and adds it if necessary.
+ *
+ * @param dir Directory of the file or NULL.
+ * @return Index of the file or -1 if there is not enough memory.
+ */
+ssize_t _symbols_add_file(struct libarmvm_symbols *symbols, const char *dir, const char *name)
+{
+    char *path;
+
+    if ('/' == name[0] || !dir || !dir[0]) {
+        path = strdup(name);
+    } else {
+        path = malloc(strlen(dir) + strlen(name) + 2);
+        if (path) {
+            sprintf(path, "%s/%s", dir, name);
+        }
+    }
+    if (!path) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < symbols->files_size; ++i) {
+        if (0 == strcmp(symbols->files[i], path)) {
+            free(path);
+            return i;
+        }
+    }
+
+    char **files = realloc(symbols->files, (symbols->files_size + 1) * sizeof(*files));
+    if (!files) {
+        free(path);
+        return -1;
+    }
+    files[symbols->files_size] = path;
+    symbols->files = files;
+
+    return symbols->files_size++;
+}
+
+
+/**
+ * @brief Appends one row to the line table. A row at the same address as the previous row of
+ * the same sequence replaces it, since the previous row does not cover any address.
+ *
+ * @param sequence Index of the first row of the current sequence.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int _symbols_add_line(struct libarmvm_symbols *symbols, size_t *capacity, size_t sequence, const struct libarmvm_line *line)
+{
+    if (symbols->lines_size > sequence && symbols->lines[symbols->lines_size - 1].addr == line->addr) {
+        symbols->lines[symbols->lines_size - 1] = *line;
+        return ARMVM_RET_SUCCESS;
+    }
+
+    if (symbols->lines_size == *capacity) {
+        size_t new_capacity = *capacity ? 2 * *capacity : 1024;
+        struct libarmvm_line *lines = realloc(symbols->lines, new_capacity * sizeof(*lines));
+        if (!lines) {
+            return ARMVM_RET_NO_MEM;
+        }
+        symbols->lines = lines;
+        *capacity = new_capacity;
+    }
+    symbols->lines[symbols->lines_size++] = *line;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+/**
+ * @brief Reads the directory and file name tables of a line table header.
+ * files is set to a vector which maps the file numbers of the unit to indexes in symbols->files.
+ * For versions before 5, files[0] is unused since the file numbers start at 1.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int _symbols_read_line_files(struct libarmvm_symbols *symbols, struct _dwarf_reader *reader, unsigned version, size_t offset_size, const struct _dwarf_sections *sections, uint32_t **files, size_t *files_size)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    const char **dirs = NULL;
+    size_t dirs_size = 0;
+
+    *files = NULL;
+    *files_size = 0;
+
+    if (version < 5) {
+        // the compilation directory (index 0) is not part of the table
+        dirs_size = 1;
+        while (1) {
+            const char *dir = _dwarf_read_string(reader);
+            if (reader->error || !dir[0]) {
+                break;
+            }
+            const char **new_dirs = realloc(dirs, (dirs_size + 1) * sizeof(*dirs));
+            if (!new_dirs) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            dirs = new_dirs;
+            dirs[dirs_size++] = dir;
+        }
+
+        *files_size = 1;
+        while (1) {
+            const char *name = _dwarf_read_string(reader);
+            if (reader->error || !name[0]) {
+                break;
+            }
+            uint64_t dir = _dwarf_read_uleb128(reader);
+            _dwarf_read_uleb128(reader); // modification time
+            _dwarf_read_uleb128(reader); // size
+
+            uint32_t *new_files = realloc(*files, (*files_size + 1) * sizeof(**files));
+            if (!new_files) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            *files = new_files;
+
+            ssize_t idx = _symbols_add_file(symbols, dir && dir < dirs_size ? dirs[dir] : NULL, name);
+            if (0 > idx) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            (*files)[(*files_size)++] = idx;
+        }
+
+        if (reader->error) {
+            ret = ARMVM_RET_FAIL;
+        }
+        goto err;
+    }
+
+    for (int table = 0; table < 2; ++table) {
+        uint64_t formats[2 * 16];
+        uint8_t formats_size = _dwarf_read(reader, 1);
+        if (formats_size > 16) {
+            ret = ARMVM_RET_FAIL;
+            goto err;
+        }
+        for (size_t i = 0; i < 2 * (size_t)formats_size; ++i) {
+            formats[i] = _dwarf_read_uleb128(reader);
+        }
+
+        uint64_t entries_size = _dwarf_read_uleb128(reader);
+        if (reader->error || entries_size > (uint64_t)(reader->end - reader->pos)) {
+            ret = ARMVM_RET_FAIL;
+            goto err;
+        }
+
+        if (0 == table) {
+            dirs = calloc(entries_size ? entries_size : 1, sizeof(*dirs));
+            if (!dirs) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            dirs_size = entries_size;
+        } else {
+            *files = calloc(entries_size ? entries_size : 1, sizeof(**files));
+            if (!*files) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            *files_size = entries_size;
+        }
+
+        for (uint64_t i = 0; i < entries_size; ++i) {
+            const char *path = "";
+            uint64_t dir = 0;
+
+            for (size_t j = 0; j < formats_size; ++j) {
+                const char *str = NULL;
+                uint64_t value = 0;
+                if (_dwarf_read_form(reader, formats[2 * j + 1], offset_size, sections, &str, &value)) {
+                    ret = ARMVM_RET_FAIL;
+                    goto err;
+                }
+                if (DW_LNCT_path == formats[2 * j] && str) {
+                    path = str;
+                } else if (DW_LNCT_directory_index == formats[2 * j]) {
+                    dir = value;
+                }
+            }
+
+            if (0 == table) {
+                dirs[i] = path;
+                continue;
+            }
+
+            // directories are relative to the compilation directory (index 0)
+            char *dir_path = NULL;
+            if (dir < dirs_size && dir && '/' != dirs[dir][0] && dirs[0][0]) {
+                dir_path = malloc(strlen(dirs[0]) + strlen(dirs[dir]) + 2);
+                if (!dir_path) {
+                    ret = ARMVM_RET_NO_MEM;
+                    goto err;
+                }
+                sprintf(dir_path, "%s/%s", dirs[0], dirs[dir]);
+            }
+
+            ssize_t idx = _symbols_add_file(symbols, dir_path ? dir_path : (dir < dirs_size ? dirs[dir] : NULL), path);
+            free(dir_path);
+            if (0 > idx) {
+                ret = ARMVM_RET_NO_MEM;
+                goto err;
+            }
+            (*files)[i] = idx;
+        }
+    }
+
+err:
+    free(dirs);
+    if (ret) {
+        free(*files);
+        *files = NULL;
+        *files_size = 0;
+    }
+    return ret;
+}
+
+
+/**
+ * @brief Executes the line number program of one unit and appends its rows to symbols->lines.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int _symbols_read_line_unit(struct libarmvm_symbols *symbols, size_t *capacity, const uint8_t *unit, size_t unit_size, const struct _dwarf_sections *sections)
+{
+    int ret = ARMVM_RET_SUCCESS;
+    struct _dwarf_reader reader = { unit, unit + unit_size, 0 };
+    size_t offset_size = 4;
+    uint32_t *files = NULL;
+    size_t files_size = 0;
+
+    uint64_t length = _dwarf_read(&reader, 4);
+    if (0xffffffff == length) {
+        offset_size = 8;
+        length = _dwarf_read(&reader, 8);
+    }
+    if (reader.error || length > (uint64_t)(reader.end - reader.pos)) {
+        return ARMVM_RET_FAIL;
+    }
+    reader.end = reader.pos + length;
+
+    unsigned version = _dwarf_read(&reader, 2);
+    if (version < 2 || version > 5) {
+        return ARMVM_RET_FAIL;
+    }
+    if (version >= 5) {
+        _dwarf_read(&reader, 1); // address_size
+        _dwarf_read(&reader, 1); // segment_selector_size
+    }
+
+    uint64_t header_length = _dwarf_read(&reader, offset_size);
+    if (reader.error || header_length > (uint64_t)(reader.end - reader.pos)) {
+        return ARMVM_RET_FAIL;
+    }
+    const uint8_t *program = reader.pos + header_length;
+
+    const uint8_t min_instruction_length = _dwarf_read(&reader, 1);
+    if (version >= 4) {
+        _dwarf_read(&reader, 1); // maximum_operations_per_instruction
+    }
+    _dwarf_read(&reader, 1); // default_is_stmt
+    const int8_t line_base = _dwarf_read(&reader, 1);
+    const uint8_t line_range = _dwarf_read(&reader, 1);
+    const uint8_t opcode_base = _dwarf_read(&reader, 1);
+    const uint8_t *opcode_lengths = reader.pos;
+    if (reader.error || !line_range || !opcode_base) {
+        return ARMVM_RET_FAIL;
+    }
+    _dwarf_skip(&reader, opcode_base - 1);
+
+    ret = _symbols_read_line_files(symbols, &reader, version, offset_size, sections, &files, &files_size);
+    if (ret) {
+        return ret;
+    }
+
+    reader.pos = program;
+
+    // state machine of the line number program
+    uint32_t addr = 0;
+    uint64_t file = 1;
+    int64_t line = 1;
+    size_t sequence = symbols->lines_size;
+
+    while (reader.pos < reader.end && !reader.error) {
+        uint8_t opcode = _dwarf_read(&reader, 1);
+        int emit = 0;
+        int end = 0;
+
+        if (opcode >= opcode_base) {
+            const uint8_t adjusted = opcode - opcode_base;
+            addr += (adjusted / line_range) * min_instruction_length;
+            line += line_base + adjusted % line_range;
+            emit = 1;
+
+        } else if (DW_LNS_copy == opcode) {
+            emit = 1;
+
+        } else if (DW_LNS_advance_pc == opcode) {
+            addr += _dwarf_read_uleb128(&reader) * min_instruction_length;
+
+        } else if (DW_LNS_advance_line == opcode) {
+            line += _dwarf_read_sleb128(&reader);
+
+        } else if (DW_LNS_set_file == opcode) {
+            file = _dwarf_read_uleb128(&reader);
+
+        } else if (DW_LNS_const_add_pc == opcode) {
+            addr += ((255 - opcode_base) / line_range) * min_instruction_length;
+
+        } else if (DW_LNS_fixed_advance_pc == opcode) {
+            addr += _dwarf_read(&reader, 2);
+
+        } else if (0 == opcode) {
+            // extended opcode
+            uint64_t size = _dwarf_read_uleb128(&reader);
+            if (!size || size > (uint64_t)(reader.end - reader.pos)) {
+                ret = ARMVM_RET_FAIL;
+                goto err;
+            }
+            const uint8_t *next = reader.pos + size;
+            uint8_t sub_opcode = _dwarf_read(&reader, 1);
+
+            if (DW_LNE_end_sequence == sub_opcode) {
+                emit = 1;
+                end = 1;
+            } else if (DW_LNE_set_address == sub_opcode) {
+                addr = _dwarf_read(&reader, size - 1 > 4 ? 4 : size - 1);
+            }
+            reader.pos = next;
+
+        } else {
+            // all other standard opcodes only have ULEB128 operands
+            for (size_t i = 0; i < opcode_lengths[opcode - 1]; ++i) {
+                _dwarf_read_uleb128(&reader);
+            }
+        }
+
+        if (!emit) {
+            continue;
+        }
+
+        if (file >= files_size || (version < 5 && !file)) {
+            ret = ARMVM_RET_FAIL;
+            goto err;
+        }
+
+        const struct libarmvm_line row = { addr, (uint32_t)line, files[file], end };
+        ret = _symbols_add_line(symbols, capacity, sequence, &row);
+        if (ret) {
+            goto err;
+        }
+
+        if (end) {
+            addr = 0;
+            file = 1;
+            line = 1;
+            sequence = symbols->lines_size;
+        }
+    }
+
+    if (reader.error) {
+        ret = ARMVM_RET_FAIL;
+    }
+
+err:
+    free(files);
+    return ret;
+}
+
+
+int _symbols_line_compare(const void *a, const void *b)
+{
+    const struct libarmvm_line *line_a = a;
+    const struct libarmvm_line *line_b = b;
+
+    if (line_a->addr != line_b->addr) {
+        return line_a->addr < line_b->addr ? -1 : 1;
+    }
+    // the end of a sequence comes before the start of the next one
+    return (int)line_b->end - (int)line_a->end;
+}
+
+
+int _symbols_read_lines(struct libarmvm_symbols *symbols, const uint8_t *file, size_t size)
+{
+    const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)file;
+    const Elf32_Shdr *shdr = (const Elf32_Shdr *)(file + ehdr->e_shoff);
+    const Elf32_Shdr *debug_line = NULL;
+    struct _dwarf_sections sections;
+    size_t capacity = 0;
+
+    memset(&sections, 0, sizeof(sections));
+
+    if (   ehdr->e_shstrndx >= ehdr->e_shnum
+        || shdr[ehdr->e_shstrndx].sh_offset + shdr[ehdr->e_shstrndx].sh_size > size) {
+        return ARMVM_RET_FAIL;
+    }
+    const uint8_t *shstrtab = file + shdr[ehdr->e_shstrndx].sh_offset;
+    const size_t shstrtab_size = shdr[ehdr->e_shstrndx].sh_size;
+
+    for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+        const char *name = _dwarf_section_string(shstrtab, shstrtab_size, shdr[i].sh_name);
+        if (!name || SHT_NOBITS == shdr[i].sh_type || shdr[i].sh_offset + shdr[i].sh_size > size) {
+            continue;
+        }
+
+        if (0 == strcmp(".debug_line", name)) {
+            debug_line = &shdr[i];
+        } else if (0 == strcmp(".debug_line_str", name)) {
+            sections.line_str = file + shdr[i].sh_offset;
+            sections.line_str_size = shdr[i].sh_size;
+        } else if (0 == strcmp(".debug_str", name)) {
+            sections.str = file + shdr[i].sh_offset;
+            sections.str_size = shdr[i].sh_size;
+        }
+    }
+
+    if (!debug_line) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    const uint8_t *unit = file + debug_line->sh_offset;
+    const uint8_t *end = unit + debug_line->sh_size;
+    while (unit < end) {
+        struct _dwarf_reader reader = { unit, end, 0 };
+        uint64_t length = _dwarf_read(&reader, 4);
+        if (0xffffffff == length) {
+            length = _dwarf_read(&reader, 8);
+        }
+        if (reader.error || length > (uint64_t)(end - reader.pos)) {
+            return ARMVM_RET_FAIL;
+        }
+
+        int ret = _symbols_read_line_unit(symbols, &capacity, unit, reader.pos + length - unit, &sections);
+        if (ret) {
+            return ret;
+        }
+        unit = reader.pos + length;
+    }
+
+    qsort(symbols->lines, symbols->lines_size, sizeof(*symbols->lines), _symbols_line_compare);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void _symbols_cleanup_lines(struct libarmvm_symbols *symbols)
+{
+    free(symbols->lines);
+    symbols->lines = NULL;
+    symbols->lines_size = 0;
+
+    if (symbols->files) {
+        for (size_t i = 0; i < symbols->files_size; ++i) {
+            free(symbols->files[i]);
+        }
+        free(symbols->files);
+        symbols->files = NULL;
+    }
+    symbols->files_size = 0;
+}
+
+
+int libarmvm_symbols_load(struct libarmvm_symbols *symbols, const char *elf_file)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    memset(symbols, 0, sizeof(*symbols));
+
+    if (!elf_file) {
+        ret = ARMVM_RET_INVALID_PARAM;
+        goto err;
+    }
+
+    struct stat stats;
+    if (0 > stat(elf_file, &stats)) {
+        fprintf(stderr, "ERROR: Could not get file statistics for '%s'\n", elf_file);
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    int fd = open(elf_file, O_RDONLY);
+    if (0 > fd) {
+        fprintf(stderr, "ERROR: Could not open file: %s\n", elf_file);
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    uint8_t *file = mmap(0, stats.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == file) {
+        fprintf(stderr, "ERROR: mmap() failed for: %s\n", elf_file);
+        ret = ARMVM_RET_FAIL;
+        goto err_fd;
+    }
+
+    if (_symbols_check_header(file, stats.st_size)) {
+        fprintf(stderr, "ERROR: Not a 32bit little endian ARM ELF file: %s\n", elf_file);
+        ret = ARMVM_RET_FAIL;
+        goto err_mmap;
+    }
+
+    ret = _symbols_read_symtab(symbols, file, stats.st_size);
+    if (ret) {
+        fprintf(stderr, "ERROR: Could not read symbol table of: %s\n", elf_file);
+        libarmvm_symbols_cleanup(symbols);
+        goto err_mmap;
+    }
+
+    if (_symbols_read_lines(symbols, file, stats.st_size)) {
+        fprintf(stderr, "WARN: Could not read the line table of: %s\n", elf_file);
+        _symbols_cleanup_lines(symbols);
+    }
+
+err_mmap:
+    munmap(file, stats.st_size);
+err_fd:
+    close(fd);
+err:
+    return ret;
+}
+
+
+int libarmvm_symbols_cleanup(struct libarmvm_symbols *symbols)
+{
+    if (symbols->symbols) {
+        for (size_t i = 0; i < symbols->symbols_size; ++i) {
+            free(symbols->symbols[i].name);
+        }
+        free(symbols->symbols);
+        symbols->symbols = NULL;
+    }
+    symbols->symbols_size = 0;
+
+    _symbols_cleanup_lines(symbols);
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+const struct libarmvm_symbol *libarmvm_symbols_lookup(const struct libarmvm_symbols *symbols, uint32_t addr)
+{
+    size_t lower = 0;
+    size_t upper = symbols->symbols_size;
+
+    // find the first symbol with a start address larger than addr
+    while (lower < upper) {
+        size_t mid = lower + (upper - lower) / 2;
+        if (symbols->symbols[mid].addr <= addr) {
+            lower = mid + 1;
+        } else {
+            upper = mid;
+        }
+    }
+
+    if (0 == lower) {
+        return NULL;
+    }
+
+    const struct libarmvm_symbol *sym = &symbols->symbols[lower - 1];
+    if (sym->size && addr - sym->addr >= sym->size) {
+        return NULL;
+    }
+
+    return sym;
+}
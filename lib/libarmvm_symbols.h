@@ -0,0 +1,96 @@
+/** @file */
+#ifndef __LIBARMVM_SYMBOLS_H__
+#define __LIBARMVM_SYMBOLS_H__
+
+#include <armvm.h>
+#include <stdlib.h>
+
+/**
+ * @brief One function symbol of the loaded program.
+ */
+struct libarmvm_symbol {
+    uint32_t addr; /**< Start address of the function (without the thumb bit). */
+    uint32_t size; /**< Size of the function in bytes. 0 if unknown. */
+    char *name;    /**< Name of the function. */
+};
+
+
+/**
+ * @brief One row of the DWARF line table of the loaded program.
+ * A row covers all addresses from addr up to the address of the next row.
+ */
+struct libarmvm_line {
+    uint32_t addr; /**< First address of the row. */
+    uint32_t line; /**< Source line of the instructions. */
+    uint32_t file; /**< Index of the source file in libarmvm_symbols.files. */
+    uint8_t end;   /**< Set if addr is the first address after a sequence of instructions. */
+};
+
+
+/**
+ * @brief Holds the function symbols and the line table of a program.
+ */
+struct libarmvm_symbols {
+    /**
+     * @brief Vector of all function symbols.
+     * The vector is ordered ascending by addr.
+     */
+    struct libarmvm_symbol *symbols;
+
+    /**
+     * @brief Size of the symbols vector.
+     */
+    size_t symbols_size;
+
+    /**
+     * @brief Vector of the rows of the line table (.debug_line).
+     * The vector is ordered ascending by addr. At the same address, rows which end a
+     * sequence come first. Is empty if the program has no line information.
+     */
+    struct libarmvm_line *lines;
+
+    /**
+     * @brief Size of the lines vector.
+     */
+    size_t lines_size;
+
+    /**
+     * @brief Vector of the paths of all source files referenced by the line table.
+     */
+    char **files;
+
+    /**
+     * @brief Size of the files vector.
+     */
+    size_t files_size;
+};
+
+
+/**
+ * @brief Loads the function symbols from the symbol table of an ELF file.
+ * If the file contains a DWARF line table (version 2 to 5), it is loaded too.
+ * Only 32bit little endian ARM ELF files are supported.
+ *
+ * @param symbols Pointer to the destination. The content will be overwritten.
+ * @param elf_file Path to the ELF file.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_symbols_load(struct libarmvm_symbols *symbols, const char *elf_file);
+
+
+/**
+ * @brief Frees all memory allocated by libarmvm_symbols_load().
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_symbols_cleanup(struct libarmvm_symbols *symbols);
+
+
+/**
+ * @brief Returns the function which contains addr.
+ *
+ * @return Pointer to the symbol or NULL, if no function contains addr.
+ */
+const struct libarmvm_symbol *libarmvm_symbols_lookup(const struct libarmvm_symbols *symbols, uint32_t addr);
+
+#endif
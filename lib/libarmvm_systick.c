@@ -0,0 +1,192 @@
+#include <libarmvm_systick.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers to LIBARMVM_SYSTICK_BASE_ADDR.
+ */
+#define SYSTICK_CSR   (0x0)
+#define SYSTICK_RVR   (0x4)
+#define SYSTICK_CVR   (0x8)
+#define SYSTICK_CALIB (0xc)
+
+#define SYSTICK_MASK (0x00ffffff)
+
+/**
+ * @brief TENMS of the STM32F0: 6000 ticks of the 6 MHz reference clock (HCLK / 8) are 1 ms.
+ */
+#define SYSTICK_CALIB_VALUE (6000)
+
+#define SYSTICK_CSR_WRITABLE (LIBARMVM_SYSTICK_CSR_ENABLE | LIBARMVM_SYSTICK_CSR_TICKINT | LIBARMVM_SYSTICK_CSR_CLKSOURCE)
+
+
+static inline uint64_t _systick_divider(const struct libarmvm_systick *systick)
+{
+    return (systick->csr & LIBARMVM_SYSTICK_CSR_CLKSOURCE) ? 1 : 8;
+}
+
+
+static inline uint64_t _systick_cycles(const struct libarmvm_systick *systick)
+{
+    return ((const struct libarmvm_ci *)systick->armvm->ci->data)->cycles;
+}
+
+
+/**
+ * @brief Returns the current value of the counter.
+ */
+uint32_t _systick_current(const struct libarmvm_systick *systick)
+{
+    if (!(systick->csr & LIBARMVM_SYSTICK_CSR_ENABLE)) {
+        return systick->cvr;
+    }
+
+    const uint64_t ticks = (_systick_cycles(systick) - systick->anchor) / _systick_divider(systick);
+    if (ticks <= systick->cvr) {
+        return systick->cvr - ticks;
+    }
+    if (!systick->rvr) {
+        return 0;
+    }
+
+    // the counter is reloaded with rvr one tick after it reached 0
+    return systick->rvr - (ticks - systick->cvr - 1) % ((uint64_t)systick->rvr + 1);
+}
+
+
+/**
+ * @brief Keeps the current value of the counter as cvr at the last tick, so the counter does not drift.
+ */
+void _systick_anchor(struct libarmvm_systick *systick)
+{
+    const uint64_t cycles = _systick_cycles(systick);
+
+    if (!(systick->csr & LIBARMVM_SYSTICK_CSR_ENABLE)) {
+        systick->anchor = cycles;
+        return;
+    }
+
+    const uint64_t divider = _systick_divider(systick);
+    systick->cvr = _systick_current(systick);
+    systick->anchor += (cycles - systick->anchor) / divider * divider;
+}
+
+
+/**
+ * @brief Schedules the next transition of the counter from 1 to 0, if the timer is enabled.
+ */
+int _systick_schedule(struct libarmvm_systick *systick)
+{
+    struct armvm *armvm = systick->armvm;
+
+    // a counter at 0 is reloaded with rvr first, it stays at 0 if rvr is 0
+    const uint64_t ticks = systick->cvr ? systick->cvr : (uint64_t)systick->rvr + 1;
+    if (!(systick->csr & LIBARMVM_SYSTICK_CSR_ENABLE) || (!systick->cvr && !systick->rvr)) {
+        libarmvm_peripherals_cancel(armvm, &systick->event);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    return libarmvm_peripherals_schedule(armvm, &systick->event, systick->anchor + ticks * _systick_divider(systick));
+}
+
+
+int _systick_wrap(struct armvm *armvm, void *data)
+{
+    struct libarmvm_systick *systick = data;
+
+    systick->anchor = systick->event.cycles;
+    systick->cvr = 0;
+    systick->csr |= LIBARMVM_SYSTICK_CSR_COUNTFLAG;
+
+    if (systick->csr & LIBARMVM_SYSTICK_CSR_TICKINT) {
+        libarmvm_nvic_set_pending(armvm, ARMV6M_EXCEPTION_SYSTICK);
+    }
+
+    return _systick_schedule(systick);
+}
+
+
+int _systick_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    struct libarmvm_systick *systick = data;
+    uint32_t word = 0;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case SYSTICK_CSR:
+            // COUNTFLAG is cleared by the read
+            word = systick->csr;
+            systick->csr &= ~LIBARMVM_SYSTICK_CSR_COUNTFLAG;
+            break;
+        case SYSTICK_RVR:
+            word = systick->rvr;
+            break;
+        case SYSTICK_CVR:
+            word = _systick_current(systick);
+            break;
+        case SYSTICK_CALIB:
+            word = SYSTICK_CALIB_VALUE;
+            break;
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _systick_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_systick *systick = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+
+    value <<= shift;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case SYSTICK_CSR:
+            // the counter keeps its value, if the timer is disabled or the clock source changes
+            _systick_anchor(systick);
+            systick->csr = (systick->csr & ~(mask & SYSTICK_CSR_WRITABLE)) | (value & mask & SYSTICK_CSR_WRITABLE);
+            break;
+        case SYSTICK_RVR:
+            // the reload value is used at the next reload, a counter which stopped at 0 starts again
+            _systick_anchor(systick);
+            systick->rvr = ((systick->rvr & ~mask) | (value & mask)) & SYSTICK_MASK;
+            break;
+        case SYSTICK_CVR:
+            // any write clears the counter and COUNTFLAG
+            _systick_anchor(systick);
+            systick->cvr = 0;
+            systick->csr &= ~LIBARMVM_SYSTICK_CSR_COUNTFLAG;
+            break;
+        default:
+            return ARMVM_RET_SUCCESS;
+    }
+
+    return _systick_schedule(systick);
+}
+
+
+int libarmvm_systick_init(struct armvm *armvm, struct libarmvm_systick *systick)
+{
+    assert(armvm);
+
+    memset(systick, 0, sizeof(*systick));
+    systick->armvm = armvm;
+    libarmvm_peripherals_event_init(&systick->event, _systick_wrap, systick);
+
+    const struct libarmvm_memory_peripheral periph = { _systick_read, _systick_write, systick };
+    return libarmvm_memory_add_peripheral(armvm, LIBARMVM_SYSTICK_BASE_ADDR, LIBARMVM_SYSTICK_SIZE, &periph);
+}
+
+
+void libarmvm_systick_reset(struct libarmvm_systick *systick)
+{
+    systick->csr = 0;
+    systick->rvr = 0;
+    systick->cvr = 0;
+    systick->anchor = 0;
+}
@@ -0,0 +1,53 @@
+/** @file */
+#ifndef __LIBARMVM_SYSTICK_H__
+#define __LIBARMVM_SYSTICK_H__
+
+#include <armvm.h>
+#include <libarmvm_event.h>
+
+/**
+ * @brief First address of the SysTick registers (CSR, RVR, CVR and CALIB).
+ */
+#define LIBARMVM_SYSTICK_BASE_ADDR (0xE000E010)
+#define LIBARMVM_SYSTICK_SIZE      (0x10)
+
+#define LIBARMVM_SYSTICK_CSR_ENABLE    (0x1 << 0)
+#define LIBARMVM_SYSTICK_CSR_TICKINT   (0x1 << 1)
+#define LIBARMVM_SYSTICK_CSR_CLKSOURCE (0x1 << 2)   /**< Set: core clock, clear: core clock / 8 (STM32F0). */
+#define LIBARMVM_SYSTICK_CSR_COUNTFLAG (0x1 << 16)
+
+
+/**
+ * @brief SysTick timer.
+ * The counter is not decremented per step. While the timer is enabled, the counter had the value
+ * cvr at the cycle anchor and its current value is derived from the cycle counter on a read. The
+ * next transition from 1 to 0 is an event of the scheduler, which sets COUNTFLAG, pends the
+ * SysTick exception and schedules the following transition.
+ */
+struct libarmvm_systick {
+    struct armvm *armvm;
+
+    struct libarmvm_peripherals_event event;  /**< Next transition of the counter from 1 to 0. */
+
+    uint32_t csr;     /**< Control and status register. */
+    uint32_t rvr;     /**< Reload value register (24 bits). */
+    uint32_t cvr;     /**< Value of the counter at anchor. Is the current value if the timer is disabled. */
+    uint64_t anchor;  /**< Value of the cycle counter at which the counter had the value cvr. */
+};
+
+
+/**
+ * @brief Initializes the SysTick timer and maps its registers to LIBARMVM_SYSTICK_BASE_ADDR.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_systick_init(struct armvm *armvm, struct libarmvm_systick *systick);
+
+
+/**
+ * @brief Resets the SysTick timer. The timer is disabled.
+ * Has to be called after the scheduled events were removed.
+ */
+void libarmvm_systick_reset(struct libarmvm_systick *systick);
+
+#endif
@@ -0,0 +1,645 @@
+#include <libarmvm_tim.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <assert.h>
+#include <string.h>
+
+/*
+ * Offsets of the registers to the base address.
+ */
+#define TIM_CR1   (0x00)
+#define TIM_CR2   (0x04)
+#define TIM_SMCR  (0x08)
+#define TIM_DIER  (0x0c)
+#define TIM_SR    (0x10)
+#define TIM_EGR   (0x14)
+#define TIM_CCMR1 (0x18)
+#define TIM_CCMR2 (0x1c)
+#define TIM_CCER  (0x20)
+#define TIM_CNT   (0x24)
+#define TIM_PSC   (0x28)
+#define TIM_ARR   (0x2c)
+#define TIM_RCR   (0x30)
+#define TIM_CCR1  (0x34)
+#define TIM_CCR4  (0x40)
+#define TIM_BDTR  (0x44)
+#define TIM_DCR   (0x48)
+
+#define TIM_CR1_CEN  (0x1 << 0)
+#define TIM_CR1_UDIS (0x1 << 1)
+#define TIM_CR1_URS  (0x1 << 2)
+#define TIM_CR1_OPM  (0x1 << 3)
+#define TIM_CR1_DIR  (0x1 << 4)
+#define TIM_CR1_CMS  (0x3 << 5)
+#define TIM_CR1_ARPE (0x1 << 7)
+#define TIM_CR1_CKD  (0x3 << 8)
+
+#define TIM_SR_UIF   (0x1 << 0)
+#define TIM_SR_CC1IF (0x1 << 1)
+#define TIM_SR_CC1OF (0x1 << 9)
+#define TIM_SR_MASK  (0x1eff)
+
+/**
+ * @brief Flags, which raise the interrupt of the update (UIF, COMIF, TIF and BIF) or of the channels (CCxIF).
+ * Their enable bits in DIER have the same positions.
+ */
+#define TIM_UP_FLAGS (0xe1)
+#define TIM_CC_FLAGS (0x1e)
+
+#define TIM_DIER_MASK (0x7fff)
+
+#define TIM_EGR_UG   (0x1 << 0)
+#define TIM_EGR_CC1G (0x1 << 1)
+
+#define TIM_CCMR_CCS  (0x3)
+#define TIM_CCMR_OCPE (0x1 << 3)
+
+
+static inline uint64_t _tim_cycles(const struct libarmvm_tim *tim)
+{
+    return ((const struct libarmvm_ci *)tim->armvm->ci->data)->cycles;
+}
+
+
+/**
+ * @brief The counter is stopped, if it is disabled or the auto-reload value is 0.
+ */
+static inline int _tim_running(const struct libarmvm_tim *tim)
+{
+    return (tim->cr1 & TIM_CR1_CEN) && tim->arr_active;
+}
+
+
+/**
+ * @brief Returns the amount of ticks of a cycle of the counter.
+ * The edge-aligned counter wraps after ARR + 1 ticks, the center-aligned counter counts up and down in 2 * ARR ticks.
+ */
+static inline uint32_t _tim_cycle_ticks(const struct libarmvm_tim *tim)
+{
+    return (tim->cr1 & TIM_CR1_CMS) ? 2 * tim->arr_active : tim->arr_active + 1;
+}
+
+
+/**
+ * @brief Returns the amount of ticks between two overflows or underflows.
+ * They are at the positions which are a multiple of it.
+ */
+static inline uint32_t _tim_flow_ticks(const struct libarmvm_tim *tim)
+{
+    return (tim->cr1 & TIM_CR1_CMS) ? tim->arr_active : tim->arr_active + 1;
+}
+
+
+/**
+ * @brief Returns the mode of a channel (CCxS). 0 is the output compare mode, the others are input capture modes.
+ */
+static inline uint32_t _tim_ccs(const struct libarmvm_tim *tim, uint32_t channel)
+{
+    return (tim->ccmr[channel / 2] >> (8 * (channel % 2))) & TIM_CCMR_CCS;
+}
+
+
+/**
+ * @brief Returns the value of the counter at the position pos.
+ */
+uint32_t _tim_counter(const struct libarmvm_tim *tim, uint32_t pos)
+{
+    const uint32_t arr = tim->arr_active;
+
+    if (tim->cr1 & TIM_CR1_CMS) {
+        return pos <= arr ? pos : 2 * arr - pos;
+    }
+    return (tim->cr1 & TIM_CR1_DIR) ? arr - pos : pos;
+}
+
+
+/**
+ * @brief Returns the position of the counter value cnt. The center-aligned counter keeps its direction.
+ */
+uint32_t _tim_position(const struct libarmvm_tim *tim, uint32_t cnt)
+{
+    const uint32_t arr = tim->arr_active;
+
+    if (!arr) {
+        return 0;
+    }
+
+    // a counter above the auto-reload value is not modeled, it is wrapped
+    cnt %= arr + 1;
+    if (tim->cr1 & TIM_CR1_CMS) {
+        return (tim->pos >= arr && cnt) ? 2 * arr - cnt : cnt;
+    }
+    return (tim->cr1 & TIM_CR1_DIR) ? arr - cnt : cnt;
+}
+
+
+/**
+ * @brief Returns the amount of ticks from the position pos to the position target (1 to a cycle).
+ */
+static inline uint64_t _tim_ticks_to(const struct libarmvm_tim *tim, uint32_t pos, uint32_t target)
+{
+    const uint32_t cycle = _tim_cycle_ticks(tim);
+    const uint32_t ticks = (target + cycle - pos) % cycle;
+
+    return ticks ? ticks : cycle;
+}
+
+
+/**
+ * @brief Returns the amount of ticks until the next compare match of a channel or UINT64_MAX, if it never matches.
+ */
+uint64_t _tim_match_ticks(const struct libarmvm_tim *tim, uint32_t channel)
+{
+    const uint32_t arr = tim->arr_active;
+    const uint32_t ccr = tim->ccr_active[channel];
+
+    if (ccr > arr) {
+        return UINT64_MAX;
+    }
+
+    if (tim->cr1 & TIM_CR1_CMS) {
+        // the center-aligned counter passes the value twice, on the way up and down
+        const uint64_t up = _tim_ticks_to(tim, tim->pos, ccr);
+        if (!ccr || ccr == arr) {
+            return up;
+        }
+        const uint64_t down = _tim_ticks_to(tim, tim->pos, 2 * arr - ccr);
+        return up < down ? up : down;
+    }
+
+    return _tim_ticks_to(tim, tim->pos, (tim->cr1 & TIM_CR1_DIR) ? arr - ccr : ccr);
+}
+
+
+/**
+ * @brief Returns the amount of ticks until the next update event or UINT64_MAX, if the updates are disabled.
+ * The update happens at the overflow or underflow, at which the repetition counter is 0.
+ */
+static inline uint64_t _tim_update_ticks(const struct libarmvm_tim *tim)
+{
+    if (tim->cr1 & TIM_CR1_UDIS) {
+        return UINT64_MAX;
+    }
+
+    const uint32_t flow = _tim_flow_ticks(tim);
+    return flow - tim->pos % flow + (uint64_t)tim->rep * flow;
+}
+
+
+/**
+ * @brief Returns whether the counter or the channels change at the next update event.
+ */
+int _tim_changes_at_update(const struct libarmvm_tim *tim)
+{
+    return    tim->psc != tim->psc_active
+           || tim->arr != tim->arr_active
+           || memcmp(tim->ccr, tim->ccr_active, sizeof(tim->ccr))
+           || (tim->cr1 & TIM_CR1_OPM);
+}
+
+
+/**
+ * @brief Sets the flags of the channels in output compare mode, which match during the next ticks.
+ */
+void _tim_compare(struct libarmvm_tim *tim, uint64_t ticks)
+{
+    if (!ticks) {
+        return;
+    }
+    for (uint32_t i = 0; i < tim->channels; ++i) {
+        if (!_tim_ccs(tim, i) && _tim_match_ticks(tim, i) <= ticks) {
+            tim->sr |= TIM_SR_CC1IF << i;
+        }
+    }
+}
+
+
+/**
+ * @brief Returns the cycles of the core clock per tick of the counter.
+ */
+static inline uint64_t _tim_tick_cycles(const struct libarmvm_tim *tim)
+{
+    return ((uint64_t)tim->psc_active + 1) * tim->clock_cycles;
+}
+
+
+/**
+ * @brief Moves the counter and the anchor by ticks.
+ */
+static inline void _tim_move(struct libarmvm_tim *tim, uint64_t ticks)
+{
+    tim->pos = ((uint64_t)tim->pos + ticks) % _tim_cycle_ticks(tim);
+    tim->anchor += ticks * _tim_tick_cycles(tim);
+}
+
+
+/**
+ * @brief Transfers the preloaded registers at an update event and reloads the repetition counter.
+ */
+void _tim_update(struct libarmvm_tim *tim)
+{
+    tim->psc_active = tim->psc;
+    tim->rep = tim->rcr;
+    memcpy(tim->ccr_active, tim->ccr, sizeof(tim->ccr));
+
+    // the center-aligned counter turns at the new auto-reload value
+    if (tim->arr_active != tim->arr) {
+        if (tim->pos && (tim->cr1 & TIM_CR1_CMS)) {
+            tim->pos = tim->arr;
+        }
+        tim->arr_active = tim->arr;
+    }
+}
+
+
+/**
+ * @brief Advances the counter to the last tick at or before cycles.
+ * The flags of the updates and compare matches on the way are set, and the preloaded registers
+ * are transferred at the updates. After the first update, all following updates are equal,
+ * therefore the counter skips them at once.
+ */
+void _tim_advance(struct libarmvm_tim *tim, uint64_t cycles)
+{
+    while (_tim_running(tim)) {
+        const uint64_t ticks = (cycles - tim->anchor) / _tim_tick_cycles(tim);
+        const uint64_t update = _tim_update_ticks(tim);
+
+        if (ticks < update) {
+            // the repetition counter is decremented at every overflow and underflow
+            if (!(tim->cr1 & TIM_CR1_UDIS)) {
+                const uint32_t flow = _tim_flow_ticks(tim);
+                tim->rep -= (tim->pos % flow + ticks) / flow;
+            }
+            _tim_compare(tim, ticks);
+            _tim_move(tim, ticks);
+            return;
+        }
+
+        _tim_compare(tim, update);
+        _tim_move(tim, update);
+        _tim_update(tim);
+        tim->sr |= TIM_SR_UIF;
+
+        if (tim->cr1 & TIM_CR1_OPM) {
+            tim->cr1 &= ~TIM_CR1_CEN;
+            break;
+        }
+        if (!_tim_running(tim)) {
+            break;
+        }
+
+        const uint64_t period = ((uint64_t)tim->rep + 1) * _tim_flow_ticks(tim);
+        const uint64_t skipped = (cycles - tim->anchor) / _tim_tick_cycles(tim) / period;
+        if (skipped) {
+            _tim_compare(tim, skipped * period);
+            _tim_move(tim, skipped * period);
+        }
+    }
+
+    // a stopped counter starts at the next access
+    tim->anchor = cycles;
+}
+
+
+/**
+ * @brief Captures the counter into the register of an input channel and sets its flag.
+ * The overcapture flag is set, if the flag was not cleared since the last capture.
+ */
+void _tim_capture(struct libarmvm_tim *tim, uint32_t channel)
+{
+    if (tim->sr & (TIM_SR_CC1IF << channel)) {
+        tim->sr |= TIM_SR_CC1OF << channel;
+    }
+    tim->ccr[channel] = _tim_counter(tim, tim->pos);
+    tim->ccr_active[channel] = tim->ccr[channel];
+    tim->sr |= TIM_SR_CC1IF << channel;
+}
+
+
+/**
+ * @brief Pends the interrupts of the flags, which are set and enabled.
+ */
+void _tim_update_irq(struct libarmvm_tim *tim)
+{
+    const uint32_t flags = tim->sr & tim->dier;
+
+    if (flags & TIM_UP_FLAGS) {
+        libarmvm_nvic_set_pending(tim->armvm, ARMV6M_EXCEPTION_IRQ0 + tim->irq);
+    }
+    if (flags & TIM_CC_FLAGS) {
+        libarmvm_nvic_set_pending(tim->armvm, ARMV6M_EXCEPTION_IRQ0 + tim->cc_irq);
+    }
+}
+
+
+/**
+ * @brief Schedules the next update or compare match, whose flag is clear or whose interrupt is enabled.
+ * A flag is set by an event, even if its interrupt is disabled. Therefore, SR only changes at the events
+ * and a loop, which polls it, is not skipped beyond the change (see _tim_time_invariant()).
+ */
+int _tim_schedule(struct libarmvm_tim *tim)
+{
+    uint64_t ticks = UINT64_MAX;
+
+    if (_tim_running(tim)) {
+        const uint32_t watched = tim->dier | ~tim->sr;
+        for (uint32_t i = 0; i < tim->channels; ++i) {
+            if ((watched & (TIM_SR_CC1IF << i)) && !_tim_ccs(tim, i)) {
+                const uint64_t match = _tim_match_ticks(tim, i);
+                ticks = match < ticks ? match : ticks;
+            }
+        }
+
+        // the matches are computed with the registers, which may change at the update. The one-pulse mode clears CEN
+        if (   (watched & TIM_SR_UIF)
+            || (tim->cr1 & TIM_CR1_OPM)
+            || (UINT64_MAX != ticks && _tim_changes_at_update(tim))) {
+            const uint64_t update = _tim_update_ticks(tim);
+            ticks = update < ticks ? update : ticks;
+        }
+    }
+
+    if (UINT64_MAX == ticks) {
+        libarmvm_peripherals_cancel(tim->armvm, &tim->event);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    return libarmvm_peripherals_schedule(tim->armvm, &tim->event, tim->anchor + ticks * _tim_tick_cycles(tim));
+}
+
+
+/**
+ * @brief Only the counter and the direction of the center-aligned counter change with the cycles.
+ * The other registers only change by writes or at the events (see _tim_schedule()).
+ */
+int _tim_time_invariant(void *data, uint32_t offset)
+{
+    const struct libarmvm_tim *tim = data;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+
+    return TIM_CNT != reg && !(TIM_CR1 == reg && (tim->cr1 & TIM_CR1_CMS));
+}
+
+
+int _tim_event(struct armvm *armvm, void *data)
+{
+    struct libarmvm_tim *tim = data;
+
+    _tim_advance(tim, _tim_cycles(tim));
+    _tim_update_irq(tim);
+
+    return _tim_schedule(tim);
+}
+
+
+int _tim_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    struct libarmvm_tim *tim = data;
+    uint32_t word = 0;
+
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+
+    _tim_advance(tim, _tim_cycles(tim));
+
+    switch (reg) {
+        case TIM_CR1:
+            // the direction of the center-aligned counter is read-only
+            word = tim->cr1;
+            if (tim->cr1 & TIM_CR1_CMS) {
+                word &= ~TIM_CR1_DIR;
+                if (tim->arr_active && tim->pos >= tim->arr_active) {
+                    word |= TIM_CR1_DIR;
+                }
+            }
+            break;
+        case TIM_CR2:
+            word = tim->cr2;
+            break;
+        case TIM_SMCR:
+            word = tim->smcr;
+            break;
+        case TIM_DIER:
+            word = tim->dier;
+            break;
+        case TIM_SR:
+            word = tim->sr;
+            break;
+        case TIM_CCMR1:
+            word = tim->ccmr[0];
+            break;
+        case TIM_CCMR2:
+            word = tim->ccmr[1];
+            break;
+        case TIM_CCER:
+            word = tim->ccer;
+            break;
+        case TIM_CNT:
+            word = _tim_counter(tim, tim->pos);
+            break;
+        case TIM_PSC:
+            word = tim->psc;
+            break;
+        case TIM_ARR:
+            word = tim->arr;
+            break;
+        case TIM_RCR:
+            word = tim->rcr;
+            break;
+        case TIM_BDTR:
+            word = tim->bdtr;
+            break;
+        case TIM_DCR:
+            word = tim->dcr;
+            break;
+        default:
+            if (reg >= TIM_CCR1 && reg <= TIM_CCR4) {
+                word = tim->ccr[(reg - TIM_CCR1) / 4];
+            }
+            break;
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _tim_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_tim *tim = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+    const uint32_t reg = offset & ~(uint32_t)0x3;
+
+    value <<= shift;
+
+    // the counter reaches the current cycle with the old registers
+    _tim_advance(tim, _tim_cycles(tim));
+
+    switch (reg) {
+        case TIM_CR1:
+            {
+                // the counter keeps its value, if the direction or the mode changes
+                const uint32_t writable = TIM_CR1_CEN | TIM_CR1_UDIS | TIM_CR1_URS | TIM_CR1_OPM | TIM_CR1_ARPE | TIM_CR1_CKD
+                                          | ((tim->features & LIBARMVM_TIM_FEATURE_DIR) ? TIM_CR1_DIR | TIM_CR1_CMS : 0);
+                const uint32_t cnt = _tim_counter(tim, tim->pos);
+                tim->cr1 = (tim->cr1 & ~(mask & writable)) | (value & mask & writable);
+                tim->pos = _tim_position(tim, cnt);
+            }
+            break;
+        case TIM_CR2:
+            tim->cr2 = (tim->cr2 & ~mask) | (value & mask);
+            break;
+        case TIM_SMCR:
+            tim->smcr = (tim->smcr & ~mask) | (value & mask);
+            break;
+        case TIM_DIER:
+            tim->dier = ((tim->dier & ~mask) | (value & mask)) & TIM_DIER_MASK;
+            break;
+        case TIM_SR:
+            // the flags are cleared by writing 0
+            tim->sr &= ~(~value & mask);
+            break;
+        case TIM_EGR:
+            value &= mask;
+            if (value & TIM_EGR_UG) {
+                // the counter and the prescaler restart, UDIS only blocks the transfer of the preloaded registers
+                if (!(tim->cr1 & TIM_CR1_UDIS)) {
+                    _tim_update(tim);
+                    if (!(tim->cr1 & TIM_CR1_URS)) {
+                        tim->sr |= TIM_SR_UIF;
+                    }
+                }
+                tim->pos = 0;
+                tim->anchor = _tim_cycles(tim);
+            }
+            for (uint32_t i = 0; i < tim->channels; ++i) {
+                if (value & (TIM_EGR_CC1G << i)) {
+                    if (_tim_ccs(tim, i)) {
+                        _tim_capture(tim, i);
+                    } else {
+                        tim->sr |= TIM_SR_CC1IF << i;
+                    }
+                }
+            }
+            break;
+        case TIM_CCMR1:
+            tim->ccmr[0] = (tim->ccmr[0] & ~mask) | (value & mask);
+            break;
+        case TIM_CCMR2:
+            tim->ccmr[1] = (tim->ccmr[1] & ~mask) | (value & mask);
+            break;
+        case TIM_CCER:
+            tim->ccer = (tim->ccer & ~mask) | (value & mask);
+            break;
+        case TIM_CNT:
+            tim->pos = _tim_position(tim, ((_tim_counter(tim, tim->pos) & ~mask) | (value & mask)) & 0xffff);
+            break;
+        case TIM_PSC:
+            // the prescaler is always preloaded
+            tim->psc = ((tim->psc & ~mask) | (value & mask)) & 0xffff;
+            break;
+        case TIM_ARR:
+            tim->arr = ((tim->arr & ~mask) | (value & mask)) & 0xffff;
+            if (!(tim->cr1 & TIM_CR1_ARPE)) {
+                const uint32_t cnt = _tim_counter(tim, tim->pos);
+                tim->arr_active = tim->arr;
+                tim->pos = _tim_position(tim, cnt);
+            }
+            break;
+        case TIM_RCR:
+            if (tim->features & LIBARMVM_TIM_FEATURE_RCR) {
+                tim->rcr = ((tim->rcr & ~mask) | (value & mask)) & 0xff;
+            }
+            break;
+        case TIM_BDTR:
+            tim->bdtr = (tim->bdtr & ~mask) | (value & mask);
+            break;
+        case TIM_DCR:
+            tim->dcr = (tim->dcr & ~mask) | (value & mask);
+            break;
+        default:
+            if (reg >= TIM_CCR1 && reg <= TIM_CCR4) {
+                // the registers of input channels are read-only
+                const uint32_t i = (reg - TIM_CCR1) / 4;
+                if (i >= tim->channels || _tim_ccs(tim, i)) {
+                    return ARMVM_RET_SUCCESS;
+                }
+                tim->ccr[i] = ((tim->ccr[i] & ~mask) | (value & mask)) & 0xffff;
+                if (!((tim->ccmr[i / 2] >> (8 * (i % 2))) & TIM_CCMR_OCPE)) {
+                    tim->ccr_active[i] = tim->ccr[i];
+                }
+                break;
+            }
+            return ARMVM_RET_SUCCESS;
+    }
+
+    _tim_update_irq(tim);
+
+    return _tim_schedule(tim);
+}
+
+
+int libarmvm_tim_init(struct armvm *armvm, struct libarmvm_tim *tim, uint32_t addr, uint32_t irq, uint32_t cc_irq,
+                      uint32_t channels, uint32_t features)
+{
+    assert(armvm);
+    assert(channels <= LIBARMVM_TIM_CHANNELS);
+
+    memset(tim, 0, sizeof(*tim));
+    tim->armvm = armvm;
+    tim->irq = irq;
+    tim->cc_irq = cc_irq;
+    tim->channels = channels;
+    tim->features = features;
+    tim->clock_cycles = 1;
+    libarmvm_peripherals_event_init(&tim->event, _tim_event, tim);
+    libarmvm_tim_reset(tim);
+
+    const struct libarmvm_memory_peripheral periph = { _tim_read, _tim_write, tim, NULL, _tim_time_invariant };
+    return libarmvm_memory_add_peripheral(armvm, addr, LIBARMVM_TIM_SIZE, &periph);
+}
+
+
+void libarmvm_tim_reset(struct libarmvm_tim *tim)
+{
+    tim->cr1 = 0;
+    tim->cr2 = 0;
+    tim->smcr = 0;
+    tim->dier = 0;
+    tim->sr = 0;
+    tim->ccmr[0] = 0;
+    tim->ccmr[1] = 0;
+    tim->ccer = 0;
+    tim->psc = 0;
+    tim->arr = 0xffff;
+    tim->rcr = 0;
+    memset(tim->ccr, 0, sizeof(tim->ccr));
+    tim->bdtr = 0;
+    tim->dcr = 0;
+
+    tim->psc_active = 0;
+    tim->arr_active = 0xffff;
+    memset(tim->ccr_active, 0, sizeof(tim->ccr_active));
+    tim->rep = 0;
+    tim->pos = 0;
+    tim->anchor = 0;
+}
+
+
+int libarmvm_tim_set_clock(struct libarmvm_tim *tim, uint32_t cycles)
+{
+    assert(cycles);
+
+    if (tim->clock_cycles == cycles) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    // the ticks until now are counted with the old clock
+    _tim_advance(tim, _tim_cycles(tim));
+    tim->clock_cycles = cycles;
+    _tim_update_irq(tim);
+
+    return _tim_schedule(tim);
+}
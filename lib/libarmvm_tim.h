@@ -0,0 +1,117 @@
+/** @file */
+#ifndef __LIBARMVM_TIM_H__
+#define __LIBARMVM_TIM_H__
+
+#include <armvm.h>
+#include <libarmvm_event.h>
+
+/**
+ * @brief First addresses and interrupts of the timers of the STM32F070.
+ * TIM1 has a separate interrupt for the capture/compare channels.
+ */
+#define LIBARMVM_TIM1_BASE_ADDR  (0x40012C00)
+#define LIBARMVM_TIM1_IRQ        (13)
+#define LIBARMVM_TIM1_CC_IRQ     (14)
+#define LIBARMVM_TIM3_BASE_ADDR  (0x40000400)
+#define LIBARMVM_TIM3_IRQ        (16)
+#define LIBARMVM_TIM14_BASE_ADDR (0x40002000)
+#define LIBARMVM_TIM14_IRQ       (19)
+#define LIBARMVM_TIM15_BASE_ADDR (0x40014000)
+#define LIBARMVM_TIM15_IRQ       (20)
+#define LIBARMVM_TIM16_BASE_ADDR (0x40014400)
+#define LIBARMVM_TIM16_IRQ       (21)
+#define LIBARMVM_TIM17_BASE_ADDR (0x40014800)
+#define LIBARMVM_TIM17_IRQ       (22)
+#define LIBARMVM_TIM_SIZE        (0x400)
+
+/**
+ * @brief Amount of timers (TIM1, TIM3, TIM14, TIM15, TIM16 and TIM17).
+ */
+#define LIBARMVM_TIMS (6)
+
+/**
+ * @brief Maximal amount of capture/compare channels of a timer.
+ */
+#define LIBARMVM_TIM_CHANNELS (4)
+
+/*
+ * Features, in which the timers differ.
+ */
+#define LIBARMVM_TIM_FEATURE_RCR (0x1 << 0)  /**< Repetition counter. */
+#define LIBARMVM_TIM_FEATURE_DIR (0x1 << 1)  /**< Down and center-aligned counting. */
+
+
+/**
+ * @brief General-purpose or advanced-control timer with the register layout of the STM32F0.
+ * The counter is not incremented per step. While the timer runs, the counter had the position pos
+ * in its cycle at the cycle anchor and its current value, the flags of the passed updates and
+ * compare matches and the transfers of the preloaded registers are derived from the cycle counter,
+ * when a register is accessed. The next update or compare match is an event of the scheduler, if it
+ * sets a flag or raises an enabled interrupt, so a loop which polls the flags sees them in time.
+ *
+ * The counter is clocked by the timer clock, which is clock_cycles cycles of the core clock long
+ * (see libarmvm_tim_set_clock()). Slave modes, DMA requests and the outputs are not modeled.
+ */
+struct libarmvm_tim {
+    struct armvm *armvm;
+    uint32_t irq;       /**< Number of the interrupt of the update (IRQn). */
+    uint32_t cc_irq;    /**< Number of the interrupt of the capture/compare channels. Is irq for most timers. */
+    uint32_t channels;  /**< Amount of capture/compare channels. */
+    uint32_t features;  /**< LIBARMVM_TIM_FEATURE_* */
+    uint32_t clock_cycles;  /**< Cycles of the core clock per cycle of the timer clock. */
+
+    struct libarmvm_peripherals_event event;  /**< Next update or compare match, which raises an enabled interrupt. */
+
+    uint32_t cr1;
+    uint32_t cr2;
+    uint32_t smcr;
+    uint32_t dier;
+    uint32_t sr;
+    uint32_t ccmr[2];
+    uint32_t ccer;
+    uint32_t psc;   /**< Preload of the prescaler. */
+    uint32_t arr;   /**< Preload of the auto-reload register. */
+    uint32_t rcr;   /**< Preload of the repetition counter. */
+    uint32_t ccr[LIBARMVM_TIM_CHANNELS];  /**< Preloads of the capture/compare registers. */
+    uint32_t bdtr;
+    uint32_t dcr;
+
+    uint32_t psc_active;  /**< Prescaler, which is used by the counter. */
+    uint32_t arr_active;  /**< Auto-reload value, which is used by the counter. */
+    uint32_t ccr_active[LIBARMVM_TIM_CHANNELS];  /**< Compare values, which are used by the channels. */
+
+    uint32_t rep;     /**< Repetition counter at anchor. */
+    uint32_t pos;     /**< Position of the counter in its cycle at anchor (the ticks since the last wrap). */
+    uint64_t anchor;  /**< Value of the cycle counter at a tick of the counter. */
+};
+
+
+/**
+ * @brief Initializes a timer and maps its registers to addr.
+ *
+ * @param irq Number of the interrupt of the update (IRQn).
+ * @param cc_irq Number of the interrupt of the capture/compare channels (IRQn).
+ * @param channels Amount of capture/compare channels.
+ * @param features LIBARMVM_TIM_FEATURE_* of the timer.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_tim_init(struct armvm *armvm, struct libarmvm_tim *tim, uint32_t addr, uint32_t irq, uint32_t cc_irq,
+                      uint32_t channels, uint32_t features);
+
+
+/**
+ * @brief Resets the registers of the timer. The timer is disabled.
+ * Has to be called after the scheduled events were removed.
+ */
+void libarmvm_tim_reset(struct libarmvm_tim *tim);
+
+
+/**
+ * @brief Sets the cycles of the core clock per cycle of the timer clock.
+ * The counter counts the ticks until the current cycle with the previous clock.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_tim_set_clock(struct libarmvm_tim *tim, uint32_t cycles);
+
+#endif
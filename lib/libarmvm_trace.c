@@ -0,0 +1,192 @@
+#include <libarmvm_trace.h>
+#include <libarmvm_memory.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+void _trace_flush(struct libarmvm_trace *trace)
+{
+    if (trace->buf_size && !trace->error) {
+        if (trace->buf_size != fwrite(trace->buf, 1, trace->buf_size, trace->file)) {
+            fprintf(stderr, "ERROR: Could not write trace file.\n");
+            trace->error = 1;
+        }
+    }
+    trace->buf_size = 0;
+}
+
+
+static inline void _trace_put(struct libarmvm_trace *trace, uint8_t byte)
+{
+    if (LIBARMVM_TRACE_BUFFER_SIZE == trace->buf_size) {
+        _trace_flush(trace);
+    }
+    trace->buf[trace->buf_size++] = byte;
+}
+
+
+void _trace_put_leb128(struct libarmvm_trace *trace, uint32_t value)
+{
+    while (value >= 0x80) {
+        _trace_put(trace, 0x80 | (value & 0x7f));
+        value >>= 7;
+    }
+    _trace_put(trace, value);
+}
+
+
+void _trace_put_zigzag(struct libarmvm_trace *trace, int32_t value)
+{
+    _trace_put_leb128(trace, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+
+void _trace_put_run(struct libarmvm_trace *trace)
+{
+    if (trace->run) {
+        _trace_put(trace, LIBARMVM_TRACE_TAG_RUN | (trace->run - 1));
+        trace->run = 0;
+    }
+}
+
+
+void _trace_write_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    struct libarmvm_trace *trace = data;
+
+    _trace_put_run(trace);
+    _trace_put(trace, LIBARMVM_TRACE_TAG_WRITE | (size >> 1));
+    _trace_put_zigzag(trace, addr - trace->write_addr);
+    _trace_put_leb128(trace, value);
+    trace->write_addr = addr;
+}
+
+
+void _trace_put_uint32(uint8_t *dest, uint32_t value)
+{
+    dest[0] = value;
+    dest[1] = value >> 8;
+    dest[2] = value >> 16;
+    dest[3] = value >> 24;
+}
+
+
+int libarmvm_trace_init(struct armvm *armvm, struct libarmvm_trace *trace)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    assert(armvm);
+    assert(armvm->opts.trace_file);
+
+    memset(trace, 0, sizeof(*trace));
+    trace->flags = armvm->opts.trace_flags;
+
+    trace->buf = malloc(LIBARMVM_TRACE_BUFFER_SIZE);
+    if (!trace->buf) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        ret = ARMVM_RET_NO_MEM;
+        goto err;
+    }
+
+    trace->file = fopen(armvm->opts.trace_file, "wb");
+    if (!trace->file) {
+        fprintf(stderr, "ERROR: Could not open trace file: %s\n", armvm->opts.trace_file);
+        ret = ARMVM_RET_FAIL;
+        goto err;
+    }
+
+    uint8_t *header = trace->buf;
+    memset(header, 0, LIBARMVM_TRACE_HEADER_SIZE);
+    memcpy(header, LIBARMVM_TRACE_MAGIC, 8);
+    _trace_put_uint32(header + 8, LIBARMVM_TRACE_VERSION);
+    _trace_put_uint32(header + 12, trace->flags);
+    _trace_put_uint32(header + 16, armvm->opts.program_address);
+    trace->buf_size = LIBARMVM_TRACE_HEADER_SIZE;
+
+    if (ARMVM_TRACE_MEMORY & trace->flags) {
+        const struct libarmvm_memory_observer observer = { NULL, _trace_write_observe, trace };
+        ret = libarmvm_memory_add_observer(armvm, &observer);
+        if (ret) {
+            goto err;
+        }
+    }
+
+    return ret;
+err:
+    if (trace->file) {
+        fclose(trace->file);
+        trace->file = NULL;
+    }
+    free(trace->buf);
+    trace->buf = NULL;
+    return ret;
+}
+
+
+int libarmvm_trace_cleanup(struct libarmvm_trace *trace)
+{
+    int ret = ARMVM_RET_SUCCESS;
+
+    if (trace->file) {
+        _trace_put_run(trace);
+        _trace_put(trace, LIBARMVM_TRACE_TAG_END);
+        _trace_flush(trace);
+        if (fclose(trace->file) || trace->error) {
+            ret = ARMVM_RET_FAIL;
+        }
+        trace->file = NULL;
+    }
+
+    free(trace->buf);
+    trace->buf = NULL;
+
+    return ret;
+}
+
+
+void libarmvm_trace_instruction(struct libarmvm_trace *trace, const struct libarmvm_registers *regs, const struct armv6m_instruction *instruction)
+{
+    if (!trace->started) {
+        // the state after reset
+        libarmvm_trace_registers(trace, regs);
+        trace->started = 1;
+    }
+
+    if (instruction->addr != trace->next_addr) {
+        _trace_put_run(trace);
+        _trace_put(trace, LIBARMVM_TRACE_TAG_BRANCH);
+        _trace_put_zigzag(trace, (int32_t)(instruction->addr - trace->next_addr) >> 1);
+    }
+
+    if (LIBARMVM_TRACE_RUN_MAX == trace->run) {
+        _trace_put_run(trace);
+    }
+    trace->run++;
+    trace->next_addr = instruction->addr + (instruction->is32Bit ? 4 : 2);
+}
+
+
+void libarmvm_trace_registers(struct libarmvm_trace *trace, const struct libarmvm_registers *regs)
+{
+    if (!(ARMVM_TRACE_REGISTERS & trace->flags)) {
+        return;
+    }
+
+    // the PC is covered by runs and branches
+    for (uint8_t i = 0; i < LIBARMVM_GPR_SIZE - 1; ++i) {
+        if (regs->gpr[i] != trace->gpr[i]) {
+            _trace_put_run(trace);
+            _trace_put(trace, LIBARMVM_TRACE_TAG_GPR | i);
+            _trace_put_leb128(trace, regs->gpr[i] ^ trace->gpr[i]);
+            trace->gpr[i] = regs->gpr[i];
+        }
+    }
+
+    if (regs->psr != trace->psr) {
+        _trace_put_run(trace);
+        _trace_put(trace, LIBARMVM_TRACE_TAG_PSR);
+        _trace_put_leb128(trace, regs->psr ^ trace->psr);
+        trace->psr = regs->psr;
+    }
+}
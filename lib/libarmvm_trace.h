@@ -0,0 +1,98 @@
+/** @file
+ * Compact binary execution trace.
+ *
+ * A trace file starts with a header of LIBARMVM_TRACE_HEADER_SIZE bytes:
+ *   offset  0: magic "ARMVMTRC"
+ *   offset  8: version (uint32_t, little endian)
+ *   offset 12: flags (uint32_t, little endian, ARMVM_TRACE_*)
+ *   offset 16: program address (uint32_t, little endian)
+ *   offset 20: reserved, 0
+ *
+ * The header is followed by a stream of records. Every record starts with one tag byte:
+ *   0b00nnnnnn  Run of n + 1 sequentially executed instructions.
+ *   0x40        Branch: the next instruction is at (expected address + 2 * delta).
+ *               Followed by delta as zigzag encoded LEB128.
+ *   0b1000rrrr  Register r changed. Followed by (old value ^ new value) as LEB128.
+ *   0x90        PSR changed. Followed by (old value ^ new value) as LEB128.
+ *   0b101000ss  Memory write of (1 << ss) bytes. Followed by the difference to the address
+ *               of the previous write as zigzag encoded LEB128 and the value as LEB128.
+ *   0xff        End of the trace.
+ *
+ * Register and memory records belong to the last instruction of the preceding run. Register
+ * records in front of the first run describe the state after reset (relative to 0).
+ * The PC is never traced as register, since it is covered by the runs and branches.
+ */
+#ifndef __LIBARMVM_TRACE_H__
+#define __LIBARMVM_TRACE_H__
+
+#include <armvm.h>
+#include <stdio.h>
+#include <isa/armv6_m.h>
+#include <libarmvm_registers.h>
+
+#define LIBARMVM_TRACE_MAGIC        "ARMVMTRC"
+#define LIBARMVM_TRACE_VERSION      (1)
+#define LIBARMVM_TRACE_HEADER_SIZE  (32)
+
+#define LIBARMVM_TRACE_TAG_RUN      (0x00)
+#define LIBARMVM_TRACE_TAG_BRANCH   (0x40)
+#define LIBARMVM_TRACE_TAG_GPR      (0x80)
+#define LIBARMVM_TRACE_TAG_PSR      (0x90)
+#define LIBARMVM_TRACE_TAG_WRITE    (0xa0)
+#define LIBARMVM_TRACE_TAG_END      (0xff)
+
+#define LIBARMVM_TRACE_RUN_MAX      (64)
+
+/**
+ * @brief Size of the output buffer. The trace file is only written if the buffer is full.
+ */
+#define LIBARMVM_TRACE_BUFFER_SIZE  (1024 * 1024)
+
+/**
+ * @brief State of the trace writer.
+ */
+struct libarmvm_trace {
+    FILE *file;
+    uint8_t *buf;            /**< Output buffer of LIBARMVM_TRACE_BUFFER_SIZE bytes. */
+    size_t buf_size;         /**< Amount of used bytes in buf. */
+    uint32_t flags;          /**< ARMVM_TRACE_* */
+    uint32_t next_addr;      /**< Address of the next instruction if no branch is taken. */
+    uint32_t run;            /**< Amount of instructions which are not written yet. */
+    uint32_t gpr[LIBARMVM_GPR_SIZE]; /**< Last traced values of the registers. */
+    uint32_t psr;            /**< Last traced value of the PSR. */
+    uint32_t write_addr;     /**< Address of the last traced memory write. */
+    uint8_t started;         /**< Set after the first instruction was traced. */
+    uint8_t error;           /**< Set if writing the trace file failed. */
+};
+
+
+/**
+ * @brief Opens armvm->opts.trace_file and writes the header.
+ * If ARMVM_TRACE_MEMORY is set in armvm->opts.trace_flags, the trace is registered as
+ * memory observer. Therefore, armvm->mem has to be initialized.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_trace_init(struct armvm *armvm, struct libarmvm_trace *trace);
+
+
+/**
+ * @brief Writes the end of the trace and closes the trace file.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_trace_cleanup(struct libarmvm_trace *trace);
+
+
+/**
+ * @brief Traces the execution of an instruction. Has to be called before the instruction is executed.
+ */
+void libarmvm_trace_instruction(struct libarmvm_trace *trace, const struct libarmvm_registers *regs, const struct armv6m_instruction *instruction);
+
+
+/**
+ * @brief Traces the changed registers. Has to be called after an instruction was executed.
+ */
+void libarmvm_trace_registers(struct libarmvm_trace *trace, const struct libarmvm_registers *regs);
+
+#endif
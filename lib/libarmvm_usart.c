@@ -0,0 +1,647 @@
+#include <libarmvm_usart.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_rcc.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Offsets of the registers to the base address.
+ */
+#define USART_CR1  (0x00)
+#define USART_CR2  (0x04)
+#define USART_CR3  (0x08)
+#define USART_BRR  (0x0c)
+#define USART_GTPR (0x10)
+#define USART_RTOR (0x14)
+#define USART_RQR  (0x18)
+#define USART_ISR  (0x1c)
+#define USART_ICR  (0x20)
+#define USART_RDR  (0x24)
+#define USART_TDR  (0x28)
+
+#define USART_CR1_UE     (0x1 << 0)
+#define USART_CR1_RE     (0x1 << 2)
+#define USART_CR1_TE     (0x1 << 3)
+#define USART_CR1_IDLEIE (0x1 << 4)
+#define USART_CR1_RXNEIE (0x1 << 5)
+#define USART_CR1_TCIE   (0x1 << 6)
+#define USART_CR1_TXEIE  (0x1 << 7)
+#define USART_CR1_M0     (0x1 << 12)
+#define USART_CR1_OVER8  (0x1 << 15)
+#define USART_CR1_M1     (0x1 << 28)
+
+#define USART_CR2_STOP_SHIFT (12)
+
+#define USART_CR3_DMAR (0x1 << 6)
+#define USART_CR3_DMAT (0x1 << 7)
+
+#define USART_ISR_ORE   (0x1 << 3)
+#define USART_ISR_IDLE  (0x1 << 4)
+#define USART_ISR_RXNE  (0x1 << 5)
+#define USART_ISR_TC    (0x1 << 6)
+#define USART_ISR_TXE   (0x1 << 7)
+#define USART_ISR_TEACK (0x1 << 21)
+#define USART_ISR_REACK (0x1 << 22)
+
+#define USART_RQR_RXFRQ (0x1 << 3)
+
+#define USART_ICR_MASK (USART_ISR_ORE | USART_ISR_IDLE | USART_ISR_TC)
+
+/**
+ * @brief The smallest divider of the baud rate, which is allowed by the reference manual.
+ */
+#define USART_MIN_DIV (16)
+
+#define USART_HOST_CHUNK (4096)
+
+
+static inline uint64_t _usart_cycles(const struct libarmvm_usart *usart)
+{
+    return ((const struct libarmvm_ci *)usart->armvm->ci->data)->cycles;
+}
+
+
+static inline uint32_t _usart_enabled(const struct libarmvm_usart *usart, uint32_t direction)
+{
+    return (usart->cr1 & (USART_CR1_UE | direction)) == (USART_CR1_UE | direction);
+}
+
+
+static inline uint16_t _usart_data_mask(const struct libarmvm_usart *usart)
+{
+    if (usart->cr1 & USART_CR1_M1) {
+        return 0x7f;
+    }
+    return (usart->cr1 & USART_CR1_M0) ? 0x1ff : 0xff;
+}
+
+
+/**
+ * @brief Returns the amount of core cycles of one frame (start bit, data bits and stop bits).
+ * The USART is clocked by a clock with clock_ratio core cycles per cycle.
+ */
+uint64_t _usart_frame_cycles(const struct libarmvm_usart *usart)
+{
+    static const uint64_t stop_half_bits[] = { 2, 1, 4, 3 };
+
+    uint64_t div = usart->brr & 0xffff;
+    uint64_t data_bits = 8;
+
+    if (usart->cr1 & USART_CR1_OVER8) {
+        div = (div & 0xfff0) | ((div & 0x7) << 1);
+    }
+    if (div < USART_MIN_DIV) {
+        div = USART_MIN_DIV;
+    }
+    if (usart->cr1 & USART_CR1_M1) {
+        data_bits = 7;
+    } else if (usart->cr1 & USART_CR1_M0) {
+        data_bits = 9;
+    }
+
+    // a bit takes div cycles of the USART clock, or div / 2 cycles with oversampling by 8
+    const uint64_t half_bits = 2 * (1 + data_bits) + stop_half_bits[(usart->cr2 >> USART_CR2_STOP_SHIFT) & 0x3];
+    return (half_bits * div * usart->clock_ratio / ((usart->cr1 & USART_CR1_OVER8) ? 4 : 2)) >> LIBARMVM_RCC_RATIO_SHIFT;
+}
+
+
+/**
+ * @brief Pends the interrupt, if one of the enabled flags is set.
+ */
+void _usart_update_irq(struct libarmvm_usart *usart)
+{
+    const uint32_t isr = usart->isr;
+    const uint32_t cr1 = usart->cr1;
+
+    if (   ((isr & USART_ISR_TXE) && (cr1 & USART_CR1_TXEIE))
+        || ((isr & USART_ISR_TC) && (cr1 & USART_CR1_TCIE))
+        || ((isr & (USART_ISR_RXNE | USART_ISR_ORE)) && (cr1 & USART_CR1_RXNEIE))
+        || ((isr & USART_ISR_IDLE) && (cr1 & USART_CR1_IDLEIE))) {
+        libarmvm_nvic_set_pending(usart->armvm, ARMV6M_EXCEPTION_IRQ0 + usart->irq);
+    }
+}
+
+
+/**
+ * @brief Moves the byte of TDR into the shift register, if the transmitter is enabled and idle.
+ * With DMA, an empty TDR takes the next block of the DMA channel instead.
+ */
+int _usart_tx_start(struct libarmvm_usart *usart, uint64_t cycles)
+{
+    if (usart->tx_busy || !_usart_enabled(usart, USART_CR1_TE)) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    if (!(usart->isr & USART_ISR_TXE)) {
+        usart->tx_shift = usart->tdr;
+        usart->tx_busy = 1;
+        usart->isr |= USART_ISR_TXE;
+        usart->isr &= ~USART_ISR_TC;
+
+        return libarmvm_peripherals_schedule(usart->armvm, &usart->tx_event, cycles + _usart_frame_cycles(usart));
+    }
+
+    if (!(usart->cr3 & USART_CR3_DMAT)) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    uint32_t size = libarmvm_dma_capacity(usart->armvm, usart->tx_dma, LIBARMVM_DMA_FROM_MEMORY);
+    if (!size) {
+        return ARMVM_RET_SUCCESS;
+    }
+    if (size > LIBARMVM_USART_DMA_BLOCK) {
+        size = LIBARMVM_USART_DMA_BLOCK;
+    }
+
+    // the bytes are sent back to back, the block ends after one frame per byte
+    const uint64_t frame = _usart_frame_cycles(usart);
+    int ret = libarmvm_dma_pull(usart->armvm, usart->tx_dma, usart->tx_block, size, frame);
+    if (ret) {
+        return ret;
+    }
+    usart->tx_block_size = size;
+    usart->tx_busy = 1;
+    usart->isr &= ~USART_ISR_TC;
+
+    return libarmvm_peripherals_schedule(usart->armvm, &usart->tx_event, cycles + size * frame);
+}
+
+
+/**
+ * @brief Schedules the reception of the next byte, if the receiver is enabled and idle and the host provided a byte.
+ */
+int _usart_rx_start(struct libarmvm_usart *usart)
+{
+    if (!usart->rx || usart->rx_event.heap_idx || !_usart_enabled(usart, USART_CR1_RE)) {
+        return ARMVM_RET_SUCCESS;
+    }
+    if (!libarmvm_ring_readable(&usart->rx->ring)) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    return libarmvm_peripherals_schedule(usart->armvm, &usart->rx_event, _usart_cycles(usart) + _usart_frame_cycles(usart));
+}
+
+
+/**
+ * @brief Writes transmitted bytes to the ring of the host. The 9th data bit is dropped, because a byte is the smallest unit of the host.
+ * Blocks the vm, while the ring is full, until the host thread made space for all bytes.
+ */
+void _usart_tx_write(struct libarmvm_usart *usart, const uint8_t *bytes, size_t size)
+{
+    size_t written = 0;
+
+    while (written < size) {
+        written += libarmvm_ring_write(&usart->tx->ring, bytes + written, size - written);
+        if (written < size && !libarmvm_ring_wait_writable(&usart->tx->ring)) {
+            break;
+        }
+    }
+}
+
+
+int _usart_tx_done(struct armvm *armvm, void *data)
+{
+    struct libarmvm_usart *usart = data;
+    int ret = ARMVM_RET_SUCCESS;
+
+    if (usart->tx) {
+        uint8_t bytes[LIBARMVM_USART_DMA_BLOCK];
+        size_t size = 1;
+
+        if (usart->tx_block_size) {
+            size = usart->tx_block_size;
+            for (size_t i = 0; i < size; ++i) {
+                bytes[i] = usart->tx_block[i];
+            }
+        } else {
+            bytes[0] = usart->tx_shift;
+        }
+        _usart_tx_write(usart, bytes, size);
+    }
+
+    usart->tx_busy = 0;
+    usart->tx_block_size = 0;
+    ret = _usart_tx_start(usart, usart->tx_event.cycles);
+    if (!usart->tx_busy) {
+        usart->isr |= USART_ISR_TC;
+    }
+    _usart_update_irq(usart);
+
+    return ret;
+}
+
+
+int _usart_rx_done(struct armvm *armvm, void *data)
+{
+    struct libarmvm_usart *usart = data;
+    const uint64_t frame = _usart_frame_cycles(usart);
+    uint8_t bytes[LIBARMVM_USART_DMA_BLOCK];
+    uint32_t capacity = 0;
+    size_t size = 1;
+
+    // the DMA receives the bytes, which are in the ring, back to back
+    if ((usart->cr3 & USART_CR3_DMAR) && !(usart->isr & USART_ISR_RXNE)) {
+        capacity = libarmvm_dma_capacity(armvm, usart->rx_dma, LIBARMVM_DMA_TO_MEMORY);
+        if (capacity) {
+            size = capacity < sizeof(bytes) ? capacity : sizeof(bytes);
+        }
+    }
+
+    // the line was idle for one frame after the last byte
+    size = libarmvm_ring_read(&usart->rx->ring, bytes, size);
+    if (!size) {
+        usart->isr |= USART_ISR_IDLE;
+        _usart_update_irq(usart);
+        return ARMVM_RET_SUCCESS;
+    }
+
+    if (capacity) {
+        uint32_t values[LIBARMVM_USART_DMA_BLOCK];
+        for (size_t i = 0; i < size; ++i) {
+            values[i] = bytes[i] & _usart_data_mask(usart);
+        }
+        int ret = libarmvm_dma_push(armvm, usart->rx_dma, values, size, frame);
+        if (ret) {
+            return ret;
+        }
+    } else if (usart->isr & USART_ISR_RXNE) {
+        usart->isr |= USART_ISR_ORE;
+    } else {
+        usart->rdr = bytes[0] & _usart_data_mask(usart);
+        usart->isr |= USART_ISR_RXNE;
+    }
+    _usart_update_irq(usart);
+
+    return libarmvm_peripherals_schedule(armvm, &usart->rx_event, usart->rx_event.cycles + size * frame);
+}
+
+
+/**
+ * @brief Serves the requests of the USART, when one of its DMA channels is enabled or the DMA is enabled in CR3.
+ * A byte, which waits in RDR, is received first.
+ */
+int _usart_dma_request(void *data)
+{
+    struct libarmvm_usart *usart = data;
+    int ret = ARMVM_RET_SUCCESS;
+
+    if (   (usart->cr3 & USART_CR3_DMAR)
+        && (usart->isr & USART_ISR_RXNE)
+        && libarmvm_dma_capacity(usart->armvm, usart->rx_dma, LIBARMVM_DMA_TO_MEMORY)) {
+        const uint32_t value = usart->rdr;
+        usart->isr &= ~USART_ISR_RXNE;
+        ret = libarmvm_dma_push(usart->armvm, usart->rx_dma, &value, 1, 0);
+    }
+
+    return ret ? ret : _usart_tx_start(usart, _usart_cycles(usart));
+}
+
+
+int _usart_read(void *data, uint32_t offset, uint8_t size, uint32_t *value)
+{
+    struct libarmvm_usart *usart = data;
+    uint32_t word = 0;
+    int ret = ARMVM_RET_SUCCESS;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case USART_CR1:
+            word = usart->cr1;
+            break;
+        case USART_CR2:
+            word = usart->cr2;
+            break;
+        case USART_CR3:
+            word = usart->cr3;
+            break;
+        case USART_BRR:
+            word = usart->brr;
+            break;
+        case USART_GTPR:
+            word = usart->gtpr;
+            break;
+        case USART_RTOR:
+            word = usart->rtor;
+            break;
+        case USART_ISR:
+            // a program which polls RXNE notices the bytes of the host without a notification
+            ret = _usart_rx_start(usart);
+            word = usart->isr;
+            if (_usart_enabled(usart, USART_CR1_TE)) {
+                word |= USART_ISR_TEACK;
+            }
+            if (_usart_enabled(usart, USART_CR1_RE)) {
+                word |= USART_ISR_REACK;
+            }
+            break;
+        case USART_RDR:
+            // RXNE is cleared by the read
+            word = usart->rdr;
+            usart->isr &= ~USART_ISR_RXNE;
+            break;
+        case USART_TDR:
+            word = usart->tdr;
+            break;
+    }
+
+    *value = word >> (8 * (offset & 0x3));
+
+    return ret;
+}
+
+
+int _usart_write(void *data, uint32_t offset, uint8_t size, uint32_t value)
+{
+    struct libarmvm_usart *usart = data;
+    const unsigned shift = 8 * (offset & 0x3);
+    const uint32_t mask = (4 == size ? 0xffffffff : (((uint32_t)1 << (8 * size)) - 1)) << shift;
+    int ret = ARMVM_RET_SUCCESS;
+
+    value <<= shift;
+
+    switch (offset & ~(uint32_t)0x3) {
+        case USART_CR1:
+            usart->cr1 = (usart->cr1 & ~mask) | (value & mask);
+            if (!_usart_enabled(usart, USART_CR1_RE)) {
+                libarmvm_peripherals_cancel(usart->armvm, &usart->rx_event);
+            }
+            ret = _usart_tx_start(usart, _usart_cycles(usart));
+            if (!ret) {
+                ret = _usart_rx_start(usart);
+            }
+            break;
+        case USART_CR2:
+            usart->cr2 = (usart->cr2 & ~mask) | (value & mask);
+            break;
+        case USART_CR3:
+            usart->cr3 = (usart->cr3 & ~mask) | (value & mask);
+            ret = _usart_dma_request(usart);
+            break;
+        case USART_BRR:
+            usart->brr = ((usart->brr & ~mask) | (value & mask)) & 0xffff;
+            break;
+        case USART_GTPR:
+            usart->gtpr = ((usart->gtpr & ~mask) | (value & mask)) & 0xffff;
+            break;
+        case USART_RTOR:
+            usart->rtor = (usart->rtor & ~mask) | (value & mask);
+            break;
+        case USART_RQR:
+            if (value & mask & USART_RQR_RXFRQ) {
+                usart->isr &= ~USART_ISR_RXNE;
+            }
+            break;
+        case USART_ICR:
+            usart->isr &= ~(value & mask & USART_ICR_MASK);
+            break;
+        case USART_TDR:
+            usart->tdr = value & mask & 0x1ff;
+            usart->isr &= ~(USART_ISR_TXE | USART_ISR_TC);
+            ret = _usart_tx_start(usart, _usart_cycles(usart));
+            break;
+        default:
+            return ARMVM_RET_SUCCESS;
+    }
+
+    _usart_update_irq(usart);
+
+    return ret;
+}
+
+
+void *_usart_tx_thread(void *arg)
+{
+    struct libarmvm_usart_host *host = arg;
+    uint8_t buffer[USART_HOST_CHUNK];
+    int failed = 0;
+
+    // the bytes are drained even if writing failed, so the vm never waits for the ring
+    while (libarmvm_ring_wait_readable(&host->ring)) {
+        const size_t len = libarmvm_ring_read(&host->ring, buffer, sizeof(buffer));
+        size_t written = 0;
+        while (!failed && written < len) {
+            const ssize_t n = write(host->fd, buffer + written, len - written);
+            if (0 > n) {
+                if (EINTR == errno) {
+                    continue;
+                }
+                fprintf(stderr, "WARN: Could not write the output of the USART: %s\n", strerror(errno));
+                failed = 1;
+                break;
+            }
+            written += n;
+        }
+    }
+
+    return NULL;
+}
+
+
+void *_usart_rx_thread(void *arg)
+{
+    struct libarmvm_usart_host *host = arg;
+    uint8_t buffer[USART_HOST_CHUNK];
+
+    while (libarmvm_ring_wait_writable(&host->ring)) {
+        struct pollfd fds[2] = { { host->fd, POLLIN, 0 }, { host->stop[0], POLLIN, 0 } };
+        if (0 > poll(fds, 2, -1)) {
+            if (EINTR == errno) {
+                continue;
+            }
+            fprintf(stderr, "WARN: Could not wait for the input of the USART: %s\n", strerror(errno));
+            break;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+
+        const ssize_t n = read(host->fd, buffer, sizeof(buffer));
+        if (0 > n && EINTR == errno) {
+            continue;
+        }
+        if (0 >= n) {
+            if (n) {
+                fprintf(stderr, "WARN: Could not read the input of the USART: %s\n", strerror(errno));
+            }
+            break;
+        }
+
+        size_t written = libarmvm_ring_write(&host->ring, buffer, n);
+        libarmvm_ci_notify_host_input(host->armvm);
+        while (written < (size_t)n && libarmvm_ring_wait_writable(&host->ring)) {
+            written += libarmvm_ring_write(&host->ring, buffer + written, n - written);
+            libarmvm_ci_notify_host_input(host->armvm);
+        }
+    }
+
+    // the vm does not wait for this input anymore
+    libarmvm_ci_remove_host_input(host->armvm);
+
+    return NULL;
+}
+
+
+void _usart_host_close(struct libarmvm_usart_host *host)
+{
+    if (host->fd != STDIN_FILENO && host->fd != STDOUT_FILENO) {
+        close(host->fd);
+    }
+    if (0 <= host->stop[0]) {
+        close(host->stop[0]);
+        close(host->stop[1]);
+    }
+    libarmvm_ring_cleanup(&host->ring);
+    free(host);
+}
+
+
+/**
+ * @brief Opens the file of the host and starts the thread, which transfers the bytes between the file and the ring.
+ *
+ * @param input If set, the thread reads from the file, otherwise it writes to the file.
+ */
+struct libarmvm_usart_host *_usart_host_open(struct armvm *armvm, const char *file, int input)
+{
+    struct libarmvm_usart_host *host = calloc(1, sizeof(*host));
+    if (!host) {
+        fprintf(stderr, "ERROR: Not enough memory.\n");
+        return NULL;
+    }
+    host->armvm = armvm;
+    host->stop[0] = -1;
+    host->stop[1] = -1;
+
+    if (libarmvm_ring_init(&host->ring, LIBARMVM_USART_RING_SIZE)) {
+        free(host);
+        return NULL;
+    }
+
+    if (0 == strcmp("-", file)) {
+        host->fd = input ? STDIN_FILENO : STDOUT_FILENO;
+    } else {
+        host->fd = input ? open(file, O_RDONLY) : open(file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (0 > host->fd) {
+            fprintf(stderr, "ERROR: Could not open the file of the USART: %s\n", file);
+            host->fd = STDIN_FILENO;
+            goto err;
+        }
+    }
+
+    if (input && pipe(host->stop)) {
+        fprintf(stderr, "ERROR: Could not create a pipe: %s\n", strerror(errno));
+        host->stop[0] = -1;
+        goto err;
+    }
+
+    if (pthread_create(&host->thread, NULL, input ? _usart_rx_thread : _usart_tx_thread, host)) {
+        fprintf(stderr, "ERROR: Could not start the thread of the USART.\n");
+        goto err;
+    }
+
+    return host;
+err:
+    _usart_host_close(host);
+    return NULL;
+}
+
+
+/**
+ * @brief Stops the thread of the host. An output thread writes the remaining bytes before.
+ */
+void _usart_host_stop(struct libarmvm_usart_host *host)
+{
+    libarmvm_ring_close(&host->ring);
+    if (0 <= host->stop[1]) {
+        const uint8_t stop = 1;
+        if (1 != write(host->stop[1], &stop, 1)) {
+            fprintf(stderr, "WARN: Could not stop the input thread of the USART.\n");
+        }
+    }
+    pthread_join(host->thread, NULL);
+    _usart_host_close(host);
+}
+
+
+int libarmvm_usart_init(struct armvm *armvm, struct libarmvm_usart *usart, uint32_t addr, uint32_t irq,
+                        uint32_t tx_dma, uint32_t rx_dma)
+{
+    assert(armvm);
+
+    memset(usart, 0, sizeof(*usart));
+    usart->armvm = armvm;
+    usart->irq = irq;
+    usart->tx_dma = tx_dma;
+    usart->rx_dma = rx_dma;
+    usart->clock_ratio = LIBARMVM_RCC_RATIO_ONE;
+    libarmvm_peripherals_event_init(&usart->tx_event, _usart_tx_done, usart);
+    libarmvm_peripherals_event_init(&usart->rx_event, _usart_rx_done, usart);
+    libarmvm_dma_connect(armvm, tx_dma, _usart_dma_request, usart);
+    libarmvm_dma_connect(armvm, rx_dma, _usart_dma_request, usart);
+
+    const struct libarmvm_memory_peripheral periph = { _usart_read, _usart_write, usart };
+    return libarmvm_memory_add_peripheral(armvm, addr, LIBARMVM_USART_SIZE, &periph);
+}
+
+
+int libarmvm_usart_connect(struct libarmvm_usart *usart, const char *output, const char *input)
+{
+    if (output) {
+        usart->tx = _usart_host_open(usart->armvm, output, 0);
+        if (!usart->tx) {
+            return ARMVM_RET_FAIL;
+        }
+    }
+
+    if (input) {
+        usart->rx = _usart_host_open(usart->armvm, input, 1);
+        if (!usart->rx) {
+            return ARMVM_RET_FAIL;
+        }
+        return libarmvm_ci_add_host_input(usart->armvm);
+    }
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+void libarmvm_usart_reset(struct libarmvm_usart *usart)
+{
+    usart->cr1 = 0;
+    usart->cr2 = 0;
+    usart->cr3 = 0;
+    usart->brr = 0;
+    usart->gtpr = 0;
+    usart->rtor = 0;
+    usart->isr = USART_ISR_TXE | USART_ISR_TC;
+    usart->rdr = 0;
+    usart->tdr = 0;
+    usart->tx_busy = 0;
+    usart->tx_shift = 0;
+    usart->tx_block_size = 0;
+}
+
+
+int libarmvm_usart_poll(struct libarmvm_usart *usart)
+{
+    return _usart_rx_start(usart);
+}
+
+
+void libarmvm_usart_disconnect(struct libarmvm_usart *usart)
+{
+    if (usart->tx) {
+        _usart_host_stop(usart->tx);
+        usart->tx = NULL;
+    }
+    if (usart->rx) {
+        _usart_host_stop(usart->rx);
+        usart->rx = NULL;
+    }
+}
@@ -0,0 +1,130 @@
+/** @file */
+#ifndef __LIBARMVM_USART_H__
+#define __LIBARMVM_USART_H__
+
+#include <armvm.h>
+#include <libarmvm_event.h>
+#include <libarmvm_dma.h>
+#include <libarmvm_ring.h>
+#include <pthread.h>
+
+/**
+ * @brief First addresses and interrupts of the USARTs of the STM32F070.
+ */
+#define LIBARMVM_USART1_BASE_ADDR (0x40013800)
+#define LIBARMVM_USART1_IRQ       (27)
+#define LIBARMVM_USART2_BASE_ADDR (0x40004400)
+#define LIBARMVM_USART2_IRQ       (28)
+#define LIBARMVM_USART_SIZE       (0x400)
+
+/**
+ * @brief Size of the rings between a USART and its host thread.
+ */
+#define LIBARMVM_USART_RING_SIZE (1 << 16)
+
+/**
+ * @brief Maximal amount of bytes, which are transferred by the DMA as one block.
+ */
+#define LIBARMVM_USART_DMA_BLOCK (256)
+
+
+/**
+ * @brief Connection of one direction of a USART to a file or pipe of the host.
+ * A host thread drains the ring to the file (transmitter) or fills it from the file (receiver),
+ * so the thread which executes the vm does not wait for the I/O of the host, as long as the ring
+ * has space. If the ring of a transmitter is full, because the file is slower than the vm, the vm
+ * waits until the host thread drained enough bytes (backpressure). No transmitted byte is lost.
+ */
+struct libarmvm_usart_host {
+    struct armvm *armvm;
+    struct libarmvm_ring ring;
+    int fd;
+    int stop[2];        /**< Pipe which stops the receiving thread, while it waits for input. */
+    pthread_t thread;
+};
+
+
+/**
+ * @brief USART with the register layout of the STM32F0.
+ * The transmitter and the receiver need one frame per byte. The end of the frame is an event of
+ * the scheduler, whose time is computed from BRR, the frame format and the clock of the USART.
+ * With DMA, the bytes are transferred in blocks, which are sent or received back to back, and
+ * only the end of a block is an event.
+ */
+struct libarmvm_usart {
+    struct armvm *armvm;
+    uint32_t irq;     /**< Number of the interrupt (IRQn). */
+    uint32_t tx_dma;  /**< DMA channel of the transmitter. */
+    uint32_t rx_dma;  /**< DMA channel of the receiver. */
+    uint64_t clock_ratio;  /**< Core cycles per cycle of the USART clock (see LIBARMVM_RCC_RATIO_SHIFT). */
+
+    struct libarmvm_peripherals_event tx_event;  /**< End of the frame in the transmit shift register. */
+    struct libarmvm_peripherals_event rx_event;  /**< End of the frame of the next received byte. */
+
+    uint32_t cr1;
+    uint32_t cr2;
+    uint32_t cr3;
+    uint32_t brr;
+    uint32_t gtpr;
+    uint32_t rtor;
+    uint32_t isr;
+    uint16_t rdr;
+    uint16_t tdr;
+
+    uint8_t tx_busy;    /**< Set while the shift register transmits tx_shift or tx_block. */
+    uint16_t tx_shift;
+
+    uint32_t tx_block[LIBARMVM_USART_DMA_BLOCK];  /**< Bytes, which the DMA transfers to the transmitter. */
+    uint32_t tx_block_size;                       /**< Amount of bytes in tx_block. 0 without DMA. */
+
+    struct libarmvm_usart_host *tx;  /**< Destination of the transmitted bytes. NULL if they are dropped. */
+    struct libarmvm_usart_host *rx;  /**< Source of the received bytes. NULL if nothing is received. */
+};
+
+
+/**
+ * @brief Initializes a USART, maps its registers to addr and connects it to its DMA channels.
+ * Has to be called after libarmvm_dma_init().
+ *
+ * @param irq Number of the interrupt (IRQn).
+ * @param tx_dma DMA channel of the transmitter.
+ * @param rx_dma DMA channel of the receiver.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_usart_init(struct armvm *armvm, struct libarmvm_usart *usart, uint32_t addr, uint32_t irq,
+                        uint32_t tx_dma, uint32_t rx_dma);
+
+
+/**
+ * @brief Connects the USART to files or pipes of the host and starts the host threads.
+ * Has to be called after libarmvm_ci_init().
+ *
+ * @param output File or pipe to which the transmitted bytes are written ("-" for stdout). May be NULL.
+ * @param input File or pipe from which the received bytes are read ("-" for stdin). May be NULL.
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_usart_connect(struct libarmvm_usart *usart, const char *output, const char *input);
+
+
+/**
+ * @brief Resets the registers of the USART. Bytes in the rings are kept.
+ * Has to be called after the scheduled events were removed.
+ */
+void libarmvm_usart_reset(struct libarmvm_usart *usart);
+
+
+/**
+ * @brief Starts the reception, if the host provided new bytes. Is called when the host input was notified.
+ *
+ * @return ARMVM_RET_SUCCESS on success.
+ */
+int libarmvm_usart_poll(struct libarmvm_usart *usart);
+
+
+/**
+ * @brief Stops the host threads and closes the files. The transmitted bytes are written before.
+ * Nothing happens if the USART is not connected.
+ */
+void libarmvm_usart_disconnect(struct libarmvm_usart *usart);
+
+#endif
@@ -0,0 +1,110 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_memory.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test converts the channels 0 and 1 of the ADC continuously and transfers 8 conversions with
+ * channel 1 of the DMA to the RAM. Channel 0 has a raw sample file, channel 1 a CSV file. After the
+ * DMA transfer is complete, the data is not read anymore and the ADC reports an overrun.
+ */
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x4809,         // 0x08000008: LDR R0, =0x40020000 (DMA1)
+    0x490a,         // 0x0800000a: LDR R1, =0x40012440 (ADC_DR)
+    0x6101,         // 0x0800000c: STR R1, [R0, #0x10] (CPAR1)
+    0x490a,         // 0x0800000e: LDR R1, =0x20000100
+    0x6141,         // 0x08000010: STR R1, [R0, #0x14] (CMAR1)
+    0x2108,         // 0x08000012: MOVS R1, #8
+    0x60c1,         // 0x08000014: STR R1, [R0, #0x0c] (CNDTR1)
+    0x4909,         // 0x08000016: LDR R1, =0x00000581 (16 bit, MINC, EN)
+    0x6081,         // 0x08000018: STR R1, [R0, #0x08] (CCR1)
+    0x4809,         // 0x0800001a: LDR R0, =0x40012400 (ADC)
+    0x2103,         // 0x0800001c: MOVS R1, #3
+    0x6281,         // 0x0800001e: STR R1, [R0, #0x28] (CHSELR: channels 0 and 1)
+    0x4908,         // 0x08000020: LDR R1, =0x00002001 (CONT, DMAEN)
+    0x60c1,         // 0x08000022: STR R1, [R0, #0x0c] (CFGR1)
+    0x2101,         // 0x08000024: MOVS R1, #1
+    0x6081,         // 0x08000026: STR R1, [R0, #0x08] (CR: ADEN)
+    0x2105,         // 0x08000028: MOVS R1, #5
+    0x6081,         // 0x0800002a: STR R1, [R0, #0x08] (CR: ADSTART)
+    0xe7fe,         // 0x0800002c: B 0x0800002c
+    0xbf00,         // 0x0800002e: NOP
+    0x0000, 0x4002, // 0x08000030
+    0x2440, 0x4001, // 0x08000034
+    0x0100, 0x2000, // 0x08000038
+    0x0581, 0x0000, // 0x0800003c
+    0x2400, 0x4001, // 0x08000040
+    0x2001, 0x0000, // 0x08000044
+};
+
+static const int16_t samples[] = { -32768, 0, 32767, 16 };
+
+static const char csv[] = "100, 200\n-100\n";
+
+/*
+ * The 12 bit conversions of both channels in the order of the sequence.
+ */
+static const uint16_t conversions[] = { 0, 2054, 2048, 2060, 4095, 2041, 2049, 2054 };
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    uint16_t data[8];
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+    const char *raw_file = test_vm_file(&vm, "", samples, sizeof(samples));
+    const char *csv_file = test_vm_file(&vm, ".csv", csv, sizeof(csv) - 1);
+    if (!raw_file || !csv_file) {
+        goto err;
+    }
+    armvm->opts.adc_input[0] = strdup(raw_file);
+    armvm->opts.adc_input[1] = strdup(csv_file);
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // a conversion takes 14 cycles of the ADC clock, which are 8 cycles of the core clock
+    if (armvm->ci->run(armvm, 200, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    if (   libarmvm_memory_read_bytes(armvm, 0x20000100, (uint8_t *)data, sizeof(data))
+        || memcmp(conversions, data, sizeof(data))) {
+        fprintf(stderr, "Unexpected conversions in the RAM (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // ADRDY, EOSMP, EOC, EOSEQ and OVR
+    uint32_t isr;
+    uint32_t cndtr;
+    if (   armvm->mem->read_word(armvm->mem->data, 0x40012400, &isr)
+        || armvm->mem->read_word(armvm->mem->data, 0x4002000c, &cndtr)
+        || 0x1f != isr
+        || 0 != cndtr) {
+        fprintf(stderr, "Unexpected ISR 0x%08x or CNDTR %u (line: %u).\n", isr, cndtr, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
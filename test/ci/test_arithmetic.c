@@ -0,0 +1,100 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <isa/armv6_m.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test executes the register forms of MOV, ADD and SUB and MULS step by step and checks,
+ * that they write their result to the destination register and that MULS updates N and Z.
+ */
+
+#define APSR_N (0x1u << 31)
+#define APSR_Z (0x1u << 30)
+
+/**
+ * @brief The flags of the step are not checked.
+ */
+#define FLAGS_UNCHECKED (0xffffffff)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2006,         // 0x08000008: MOVS R0, #6
+    0x2107,         // 0x0800000a: MOVS R1, #7
+    0x4680,         // 0x0800000c: MOV R8, R0
+    0x000a,         // 0x0800000e: MOVS R2, R1
+    0x1843,         // 0x08000010: ADDS R3, R0, R1
+    0x1a44,         // 0x08000012: SUBS R4, R0, R1
+    0x0026,         // 0x08000014: MOVS R6, R4
+    0x4341,         // 0x08000016: MULS R1, R0
+    0x464d,         // 0x08000018: MOV R5, R9
+    0x4345,         // 0x0800001a: MULS R5, R0
+    0xe7fe,         // 0x0800001c: B .
+};
+
+
+struct _arithmetic_step {
+    uint8_t reg;      /**< Destination register of the instruction. */
+    uint32_t value;   /**< Expected value of the destination register. */
+    uint32_t flags;   /**< Expected N and Z flags after the instruction or FLAGS_UNCHECKED. */
+};
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    // the flags of MOV R8, R0 and MOV R5, R9 are kept from the previous instruction,
+    // MOVS R6, R4 sets N, which MULS has to clear again
+    static const struct _arithmetic_step expected[] = {
+        { 0, 6, 0 },
+        { 1, 7, 0 },
+        { 8, 6, 0 },
+        { 2, 7, 0 },
+        { 3, 13, 0 },
+        { 4, 0xffffffff, FLAGS_UNCHECKED },
+        { 6, 0xffffffff, APSR_N },
+        { 1, 42, 0 },
+        { 5, 0, 0 },
+        { 5, 0, APSR_Z },
+    };
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        if (armvm->ci->run(armvm, 1, &executed)) {
+            fprintf(stderr, "run() failed at step %zu (line: %u).\n", i, __LINE__);
+            goto err;
+        }
+
+        const uint32_t flags = regs->psr & (APSR_N | APSR_Z);
+        if (   regs->gpr[expected[i].reg] != expected[i].value
+            || (FLAGS_UNCHECKED != expected[i].flags && flags != expected[i].flags)) {
+            fprintf(stderr, "Step %zu: R%u 0x%08x, flags 0x%08x, expected 0x%08x, flags 0x%08x (line: %u).\n",
+                    i, expected[i].reg, regs->gpr[expected[i].reg], flags, expected[i].value, expected[i].flags, __LINE__);
+            goto err;
+        }
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
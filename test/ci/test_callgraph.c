@@ -0,0 +1,207 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_callgraph.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test profiles the calls of main -> f -> g and main -> g, where g returns with BX LR and
+ * f with POP {PC}, and checks the counts per function of the report and the folded stacks.
+ * A second program calls itself endlessly and exceeds the depth of the shadow call stack.
+ */
+
+/*
+ * One iteration of main executes 8 instructions in 27 cycles.
+ */
+#define STEPS (100000)
+#define ITERATIONS (STEPS / 8)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0xf000, 0xf803, // 0x08000008: BL f (0x08000012)
+    0xf000, 0xf805, // 0x0800000c: BL g (0x0800001a)
+    0xe7fa,         // 0x08000010: B 0x08000008
+    0xb500,         // 0x08000012: f: PUSH {LR}
+    0xf000, 0xf801, // 0x08000014: BL g (0x0800001a)
+    0xbd00,         // 0x08000018: POP {PC}
+    0x4770,         // 0x0800001a: g: BX LR
+};
+
+static const uint16_t recursive_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0xf7ff, 0xfffe, // 0x08000008: BL 0x08000008
+};
+
+#define RECURSIVE_STEPS (LIBARMVM_CALLGRAPH_MAX_DEPTH + 76)
+
+/*
+ * Expected line of the report of one function.
+ */
+struct _callgraph_row {
+    uint64_t calls;
+    uint64_t incl_cycles;
+    uint64_t excl_cycles;
+    uint64_t incl_instructions;
+    uint64_t excl_instructions;
+    const char *function;
+};
+
+static const struct _callgraph_row rows[] = {
+    { 1,              27 * ITERATIONS, 11 * ITERATIONS, 8 * ITERATIONS, 3 * ITERATIONS, "0x08000008" },
+    { ITERATIONS,     13 * ITERATIONS, 10 * ITERATIONS, 4 * ITERATIONS, 3 * ITERATIONS, "0x08000012" },
+    { 2 * ITERATIONS,  6 * ITERATIONS,  6 * ITERATIONS, 2 * ITERATIONS, 2 * ITERATIONS, "0x0800001a" },
+};
+
+
+/**
+ * @brief Executes the program with the call graph profiler and reads its report into report.
+ * The folded stacks are only written and read into folded, if it is not NULL.
+ */
+static int _run(struct test_vm *vm, const uint16_t *program, size_t size, uint64_t steps, char *report, char *folded, size_t report_size)
+{
+    struct armvm *armvm = &vm->armvm;
+    uint64_t executed;
+
+    if (test_vm_init(vm, program, size)) {
+        return FAIL;
+    }
+
+    const char *report_file = test_vm_file(vm, ".txt", "", 0);
+    const char *folded_file = folded ? test_vm_file(vm, ".folded", "", 0) : NULL;
+    if (!report_file || (folded && !folded_file)) {
+        return FAIL;
+    }
+    armvm->opts.callgraph_file = strdup(report_file);
+    if (folded) {
+        armvm->opts.folded_file = strdup(folded_file);
+    }
+
+    if (test_vm_start(vm)) {
+        return FAIL;
+    }
+
+    if (armvm->ci->run(armvm, steps, &executed) || steps != executed || _libarmvm_report(armvm)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        return FAIL;
+    }
+
+    if (   0 > test_vm_read_file(report_file, report, report_size)
+        || (folded && 0 > test_vm_read_file(folded_file, folded, report_size))) {
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+
+static int _test_calls(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    char report[4096];
+    char folded[4096];
+    char expected[512];
+
+    if (_run(&vm, program, sizeof(program), STEPS, report, folded, sizeof(report))) {
+        goto err;
+    }
+
+    // every call was matched by its return
+    const struct libarmvm_callgraph *callgraph = ((const struct libarmvm_ci *)vm.armvm.ci->data)->callgraph;
+    if (callgraph->depth || callgraph->current || callgraph->overflows || 4 != callgraph->nodes_size) {
+        fprintf(stderr, "Depth %zu, node %zu, %" PRIu64 " overflows and %zu nodes after the run (line: %u).\n",
+                callgraph->depth, callgraph->current, callgraph->overflows, callgraph->nodes_size, __LINE__);
+        goto err;
+    }
+
+    // the functions are ordered by their inclusive cycles
+    const char *line = strstr(report, "  function\n");
+    line = line ? strchr(line, '\n') : NULL;
+    for (size_t i = 0; i < sizeof(rows) / sizeof(rows[0]); ++i) {
+        struct _callgraph_row row;
+        char function[32];
+        double percent;
+        if (   !line
+            || 8 != sscanf(line + 1, "%" SCNu64 " %" SCNu64 " %lf%% %" SCNu64 " %lf%% %" SCNu64 " %" SCNu64 " %31s",
+                          &row.calls, &row.incl_cycles, &percent, &row.excl_cycles, &percent,
+                          &row.incl_instructions, &row.excl_instructions, function)
+            || row.calls != rows[i].calls
+            || row.incl_cycles != rows[i].incl_cycles
+            || row.excl_cycles != rows[i].excl_cycles
+            || row.incl_instructions != rows[i].incl_instructions
+            || row.excl_instructions != rows[i].excl_instructions
+            || strcmp(function, rows[i].function)) {
+            fprintf(stderr, "Unexpected row %zu of the report (line: %u):\n%s\n", i, __LINE__, report);
+            goto err;
+        }
+        line = strchr(line + 1, '\n');
+    }
+
+    snprintf(expected, sizeof(expected),
+             "0x08000008 %u\n"
+             "0x08000008;0x08000012 %u\n"
+             "0x08000008;0x08000012;0x0800001a %u\n"
+             "0x08000008;0x0800001a %u\n",
+             11 * ITERATIONS, 10 * ITERATIONS, 3 * ITERATIONS, 3 * ITERATIONS);
+    if (strcmp(expected, folded)) {
+        fprintf(stderr, "Unexpected folded stacks (line: %u):\n%s\n", __LINE__, folded);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_overflow(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    char report[4096];
+    char expected[128];
+
+    if (_run(&vm, recursive_program, sizeof(recursive_program), RECURSIVE_STEPS, report, NULL, sizeof(report))) {
+        goto err;
+    }
+
+    // the calls beyond the maximal depth are accounted to the deepest frame
+    const struct libarmvm_callgraph *callgraph = ((const struct libarmvm_ci *)vm.armvm.ci->data)->callgraph;
+    snprintf(expected, sizeof(expected), "# calls deeper than %u frames (not tracked): %u\n",
+             LIBARMVM_CALLGRAPH_MAX_DEPTH, RECURSIVE_STEPS - LIBARMVM_CALLGRAPH_MAX_DEPTH);
+    if (   LIBARMVM_CALLGRAPH_MAX_DEPTH != callgraph->depth
+        || RECURSIVE_STEPS - LIBARMVM_CALLGRAPH_MAX_DEPTH != callgraph->overflows
+        || LIBARMVM_CALLGRAPH_MAX_DEPTH + 1 != callgraph->nodes_size
+        || RECURSIVE_STEPS - LIBARMVM_CALLGRAPH_MAX_DEPTH != callgraph->nodes[LIBARMVM_CALLGRAPH_MAX_DEPTH].instructions
+        || !strstr(report, expected)) {
+        fprintf(stderr, "Depth %zu, %" PRIu64 " overflows and %zu nodes after the run (line: %u):\n%s\n",
+                callgraph->depth, callgraph->overflows, callgraph->nodes_size, __LINE__, report);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_calls() || _test_overflow()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
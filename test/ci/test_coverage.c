@@ -0,0 +1,423 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_symbols.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <elf.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test loads the symbols and the line table of an ELF file, which is built by the test:
+ * main.c is described by a DWARF 3 unit and lib/util.c by a DWARF 5 unit of .debug_line.
+ * It executes the program with the coverage and checks the lcov and the drcov report.
+ * A truncated and a malformed .debug_line drop the line table, but keep the symbols.
+ */
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2000,         // 0x08000008: MOVS R0, #0       main.c:10
+    0x3001,         // 0x0800000a: ADDS R0, #1       main.c:11
+    0x2803,         // 0x0800000c: CMP R0, #3        main.c:12
+    0xd1fc,         // 0x0800000e: BNE 0x0800000a    main.c:12
+    0xf000, 0xf802, // 0x08000010: BL 0x08000018     main.c:13
+    0xe7fe,         // 0x08000014: B .               main.c:14
+    0xbf00,         // 0x08000016: NOP               main.c:15
+    0x2101,         // 0x08000018: MOVS R1, #1       lib/util.c:3
+    0x4770,         // 0x0800001a: BX LR             lib/util.c:4
+    0x2202,         // 0x0800001c: MOVS R2, #2       lib/util.c:5
+};
+
+/*
+ * Units of .debug_line with line_base -5, line_range 14 and opcode_base 13.
+ * The special opcode 0x2f advances the address by 2 and the line by 1, 0x4b the address by 4 and the line by 1.
+ */
+#define LINE_HEADER 0x01, 0xfb, 0x0e, 0x0d, 0x00, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x01
+
+static const uint8_t debug_line[] = {
+    // DWARF 3
+    0x3c, 0x00, 0x00, 0x00,             // unit_length
+    0x03, 0x00,                         // version
+    0x22, 0x00, 0x00, 0x00,             // header_length
+    0x01,                               // minimum_instruction_length
+    LINE_HEADER,
+    '/', 's', 'r', 'c', 0x00, 0x00,     // include_directories
+    'm', 'a', 'i', 'n', '.', 'c', 0x00, 0x01, 0x00, 0x00, 0x00, // file_names
+    0x00, 0x05, 0x02, 0x08, 0x00, 0x00, 0x08, // DW_LNE_set_address 0x08000008
+    0x03, 0x09,                         // DW_LNS_advance_line 9
+    0x01,                               // DW_LNS_copy: 0x08000008, 10
+    0x2f,                               // 0x0800000a, 11
+    0x2f,                               // 0x0800000c, 12
+    0x4b,                               // 0x08000010, 13
+    0x4b,                               // 0x08000014, 14
+    0x2f,                               // 0x08000016, 15
+    0x02, 0x02,                         // DW_LNS_advance_pc 2
+    0x00, 0x01, 0x01,                   // DW_LNE_end_sequence: 0x08000018
+
+    // DWARF 5
+    0x48, 0x00, 0x00, 0x00,             // unit_length
+    0x05, 0x00,                         // version
+    0x04, 0x00,                         // address_size, segment_selector_size
+    0x2d, 0x00, 0x00, 0x00,             // header_length
+    0x01,                               // minimum_instruction_length
+    0x01,                               // maximum_operations_per_instruction
+    LINE_HEADER,
+    0x01, 0x01, 0x08,                   // directory_entry_format: DW_LNCT_path, DW_FORM_string
+    0x02, '/', 's', 'r', 'c', 0x00, 'l', 'i', 'b', 0x00, // directories
+    0x02, 0x01, 0x08, 0x02, 0x0b,       // file_name_entry_format: DW_LNCT_path, DW_FORM_string, DW_LNCT_directory_index, DW_FORM_data1
+    0x01, 'u', 't', 'i', 'l', '.', 'c', 0x00, 0x01, // file_names
+    0x04, 0x00,                         // DW_LNS_set_file 0
+    0x00, 0x05, 0x02, 0x18, 0x00, 0x00, 0x08, // DW_LNE_set_address 0x08000018
+    0x03, 0x02,                         // DW_LNS_advance_line 2
+    0x01,                               // DW_LNS_copy: 0x08000018, 3
+    0x2f,                               // 0x0800001a, 4
+    0x2f,                               // 0x0800001c, 5
+    0x02, 0x02,                         // DW_LNS_advance_pc 2
+    0x00, 0x01, 0x01,                   // DW_LNE_end_sequence: 0x0800001e
+};
+
+/*
+ * Offset of the version of the DWARF 5 unit in debug_line.
+ */
+#define DWARF5_VERSION (0x44)
+
+static const char strtab[] = "\0main\0func";
+static const char shstrtab[] = "\0.debug_line\0.symtab\0.strtab\0.shstrtab";
+
+static const char lcov[] =
+    "TN:\n"
+    "SF:/src/main.c\n"
+    "DA:10,1\n"
+    "DA:11,1\n"
+    "DA:12,1\n"
+    "BRDA:12,0,0,1\n"
+    "BRDA:12,0,1,1\n"
+    "DA:13,1\n"
+    "DA:14,1\n"
+    "DA:15,0\n"
+    "BRF:2\n"
+    "BRH:2\n"
+    "LF:6\n"
+    "LH:5\n"
+    "end_of_record\n"
+    "SF:/src/lib/util.c\n"
+    "DA:3,1\n"
+    "DA:4,1\n"
+    "DA:5,0\n"
+    "LF:3\n"
+    "LH:2\n"
+    "end_of_record\n";
+
+#define STEPS (30)
+
+/*
+ * Damages of .debug_line.
+ */
+enum _elf_debug_line {
+    ELF_DEBUG_LINE_VALID = 0,
+    ELF_DEBUG_LINE_TRUNCATED, /**< The section ends in the middle of the DWARF 5 unit. */
+    ELF_DEBUG_LINE_MALFORMED, /**< The DWARF 5 unit has the unknown version 6. */
+};
+
+#define ELF_SECTIONS (5)
+
+struct _elf {
+    Elf32_Ehdr ehdr;
+    uint8_t debug_line[sizeof(debug_line)];
+    Elf32_Sym symtab[3];
+    char strtab[sizeof(strtab)];
+    char shstrtab[sizeof(shstrtab)];
+    Elf32_Shdr shdr[ELF_SECTIONS];
+};
+
+
+static void _elf_section(struct _elf *elf, size_t idx, const char *name, uint32_t type, const void *data, size_t size)
+{
+    Elf32_Shdr *shdr = &elf->shdr[idx];
+
+    for (shdr->sh_name = 1; strcmp(shstrtab + shdr->sh_name, name); shdr->sh_name += strlen(shstrtab + shdr->sh_name) + 1);
+    shdr->sh_type = type;
+    shdr->sh_offset = (const uint8_t *)data - (const uint8_t *)elf;
+    shdr->sh_size = size;
+}
+
+
+/**
+ * @brief Builds an ELF file of the program with the function symbols main and func and the line table.
+ */
+static void _elf_build(struct _elf *elf, enum _elf_debug_line damage)
+{
+    memset(elf, 0, sizeof(*elf));
+
+    memcpy(elf->ehdr.e_ident, ELFMAG, SELFMAG);
+    elf->ehdr.e_ident[EI_CLASS] = ELFCLASS32;
+    elf->ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    elf->ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    elf->ehdr.e_type = ET_EXEC;
+    elf->ehdr.e_machine = EM_ARM;
+    elf->ehdr.e_version = EV_CURRENT;
+    elf->ehdr.e_entry = 0x08000009;
+    elf->ehdr.e_ehsize = sizeof(Elf32_Ehdr);
+    elf->ehdr.e_shoff = offsetof(struct _elf, shdr);
+    elf->ehdr.e_shentsize = sizeof(Elf32_Shdr);
+    elf->ehdr.e_shnum = ELF_SECTIONS;
+    elf->ehdr.e_shstrndx = 4;
+
+    memcpy(elf->debug_line, debug_line, sizeof(debug_line));
+    memcpy(elf->strtab, strtab, sizeof(strtab));
+    memcpy(elf->shstrtab, shstrtab, sizeof(shstrtab));
+
+    elf->symtab[1].st_name = 1;
+    elf->symtab[1].st_value = 0x08000009;
+    elf->symtab[1].st_size = 0x10;
+    elf->symtab[1].st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+    elf->symtab[1].st_shndx = 1;
+    elf->symtab[2].st_name = 6;
+    elf->symtab[2].st_value = 0x08000019;
+    elf->symtab[2].st_size = 0x6;
+    elf->symtab[2].st_info = ELF32_ST_INFO(STB_GLOBAL, STT_FUNC);
+    elf->symtab[2].st_shndx = 1;
+
+    size_t debug_line_size = sizeof(debug_line);
+    if (ELF_DEBUG_LINE_TRUNCATED == damage) {
+        debug_line_size = DWARF5_VERSION + 0x20;
+    } else if (ELF_DEBUG_LINE_MALFORMED == damage) {
+        elf->debug_line[DWARF5_VERSION] = 6;
+    }
+
+    _elf_section(elf, 1, ".debug_line", SHT_PROGBITS, elf->debug_line, debug_line_size);
+    _elf_section(elf, 2, ".symtab", SHT_SYMTAB, elf->symtab, sizeof(elf->symtab));
+    _elf_section(elf, 3, ".strtab", SHT_STRTAB, elf->strtab, sizeof(elf->strtab));
+    _elf_section(elf, 4, ".shstrtab", SHT_STRTAB, elf->shstrtab, sizeof(elf->shstrtab));
+    elf->shdr[2].sh_link = 3;
+    elf->shdr[2].sh_entsize = sizeof(Elf32_Sym);
+}
+
+
+static int _test_symbols(void)
+{
+    int ret = FAIL;
+    struct _elf elf;
+    struct test_vm vm;
+    struct libarmvm_symbols symbols;
+
+    // expected rows of the line table
+    static const struct libarmvm_line lines[] = {
+        { 0x08000008, 10, 0, 0 },
+        { 0x0800000a, 11, 0, 0 },
+        { 0x0800000c, 12, 0, 0 },
+        { 0x08000010, 13, 0, 0 },
+        { 0x08000014, 14, 0, 0 },
+        { 0x08000016, 15, 0, 0 },
+        { 0x08000018, 15, 0, 1 },
+        { 0x08000018,  3, 1, 0 },
+        { 0x0800001a,  4, 1, 0 },
+        { 0x0800001c,  5, 1, 0 },
+        { 0x0800001e,  5, 1, 1 },
+    };
+
+    memset(&symbols, 0, sizeof(symbols));
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    for (int damage = ELF_DEBUG_LINE_VALID; damage <= ELF_DEBUG_LINE_MALFORMED; ++damage) {
+        _elf_build(&elf, damage);
+        const char *elf_file = test_vm_file(&vm, ".elf", &elf, sizeof(elf));
+        if (!elf_file || libarmvm_symbols_load(&symbols, elf_file)) {
+            fprintf(stderr, "Could not load the symbols %d (line: %u).\n", damage, __LINE__);
+            goto err;
+        }
+
+        const struct libarmvm_symbol *main_sym = libarmvm_symbols_lookup(&symbols, 0x08000016);
+        const struct libarmvm_symbol *func_sym = libarmvm_symbols_lookup(&symbols, 0x08000018);
+        if (   2 != symbols.symbols_size
+            || !main_sym || strcmp("main", main_sym->name)
+            || !func_sym || strcmp("func", func_sym->name)
+            || libarmvm_symbols_lookup(&symbols, 0x0800001e)) {
+            fprintf(stderr, "Unexpected symbols %d (line: %u).\n", damage, __LINE__);
+            goto err;
+        }
+
+        // a damaged line table is dropped as a whole
+        if (ELF_DEBUG_LINE_VALID != damage) {
+            if (symbols.lines_size || symbols.files_size) {
+                fprintf(stderr, "The damaged line table %d has %zu rows (line: %u).\n", damage, symbols.lines_size, __LINE__);
+                goto err;
+            }
+            libarmvm_symbols_cleanup(&symbols);
+            continue;
+        }
+
+        if (   2 != symbols.files_size
+            || strcmp("/src/main.c", symbols.files[0])
+            || strcmp("/src/lib/util.c", symbols.files[1])
+            || sizeof(lines) / sizeof(lines[0]) != symbols.lines_size) {
+            fprintf(stderr, "Unexpected %zu files or %zu rows (line: %u).\n", symbols.files_size, symbols.lines_size, __LINE__);
+            goto err;
+        }
+        for (size_t i = 0; i < symbols.lines_size; ++i) {
+            const struct libarmvm_line *line = &symbols.lines[i];
+            if (   line->addr != lines[i].addr
+                || line->file != lines[i].file
+                || line->end != lines[i].end
+                || line->line != lines[i].line) {
+                fprintf(stderr, "Row %zu: 0x%08x %u:%u end %u, expected 0x%08x %u:%u end %u (line: %u).\n",
+                        i, line->addr, line->file, line->line, line->end,
+                        lines[i].addr, lines[i].file, lines[i].line, lines[i].end, __LINE__);
+                goto err;
+            }
+        }
+        libarmvm_symbols_cleanup(&symbols);
+    }
+
+    ret = SUCCESS;
+
+err:
+    libarmvm_symbols_cleanup(&symbols);
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_lcov(enum _elf_debug_line damage)
+{
+    int ret = FAIL;
+    struct _elf elf;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    char report[2 * sizeof(lcov)];
+
+    _elf_build(&elf, damage);
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    const char *elf_file = test_vm_file(&vm, ".elf", &elf, sizeof(elf));
+    const char *coverage_file = test_vm_file(&vm, ".info", "", 0);
+    if (!elf_file || !coverage_file) {
+        goto err;
+    }
+    armvm->opts.symbol_file = strdup(elf_file);
+    armvm->opts.coverage_file = strdup(coverage_file);
+    armvm->opts.coverage_format = ARMVM_COVERAGE_LCOV;
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, STEPS, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // without the line table, there is no lcov report
+    const int report_ret = _libarmvm_report(armvm);
+    if (ELF_DEBUG_LINE_VALID != damage) {
+        if (!report_ret) {
+            fprintf(stderr, "The lcov report %d was written without the line table (line: %u).\n", damage, __LINE__);
+            goto err;
+        }
+        ret = SUCCESS;
+        goto err;
+    }
+
+    const long size = test_vm_read_file(coverage_file, report, sizeof(report));
+    if (   report_ret
+        || sizeof(lcov) - 1 != size
+        || memcmp(lcov, report, size)) {
+        fprintf(stderr, "Unexpected lcov report (line: %u):\n%.*s\n", __LINE__, (int)(size > 0 ? size : 0), report);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_drcov(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    char expected[512];
+    char report[512];
+
+    // the blocks start at the reset, after BNE, at the call of func and at the return from it
+    static const uint8_t blocks[] = {
+        0x08, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+        0x0a, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00,
+        0x14, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+        0x18, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+    };
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    const char *coverage_file = test_vm_file(&vm, ".log", "", 0);
+    if (!coverage_file) {
+        goto err;
+    }
+    armvm->opts.coverage_file = strdup(coverage_file);
+    armvm->opts.coverage_format = ARMVM_COVERAGE_DRCOV;
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, STEPS, &executed) || _libarmvm_report(armvm)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    struct libarmvm_memory_flash flash;
+    if (libarmvm_memory_get_flash(armvm->mem->data, &flash)) {
+        goto err;
+    }
+    int header = snprintf(expected, sizeof(expected),
+                          "DRCOV VERSION: 2\n"
+                          "DRCOV FLAVOR: drcov\n"
+                          "Module Table: version 2, count 1\n"
+                          "Columns: id, base, end, entry, path\n"
+                          "  0, 0x%08x, 0x%08x, 0x%08x, %s\n"
+                          "BB Table: 4 bbs\n",
+                          flash.base, flash.base + flash.size, 0, vm.program_file);
+    memcpy(expected + header, blocks, sizeof(blocks));
+
+    const long size = test_vm_read_file(coverage_file, report, sizeof(report));
+    if (header + sizeof(blocks) != (size_t)size || memcmp(expected, report, size)) {
+        fprintf(stderr, "Unexpected drcov report of %ld bytes (line: %u).\n", size, __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (   _test_symbols()
+        || _test_lcov(ELF_DEBUG_LINE_VALID)
+        || _test_lcov(ELF_DEBUG_LINE_TRUNCATED)
+        || _test_drcov()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
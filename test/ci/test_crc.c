@@ -0,0 +1,158 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_ci.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test lets channel 1 of the DMA feed the program itself from the flash to the CRC (memory-to-memory)
+ * and compares the result with a bitwise CRC. Afterwards, the check values of some common CRCs are
+ * computed through the registers with the reversal of the data and other polynomials.
+ */
+
+#define CRC_ADDR (0x40023000)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x4805,         // 0x08000008: LDR R0, =0x40020000 (DMA1)
+    0x4906,         // 0x0800000a: LDR R1, =0x40023000 (CRC_DR)
+    0x6101,         // 0x0800000c: STR R1, [R0, #0x10] (CPAR1)
+    0x4906,         // 0x0800000e: LDR R1, =0x08000000
+    0x6141,         // 0x08000010: STR R1, [R0, #0x14] (CMAR1)
+    0x210c,         // 0x08000012: MOVS R1, #12
+    0x60c1,         // 0x08000014: STR R1, [R0, #0x0c] (CNDTR1)
+    0x4905,         // 0x08000016: LDR R1, =0x00004a91 (MEM2MEM, 32 bit, MINC, DIR, EN)
+    0x6081,         // 0x08000018: STR R1, [R0, #0x08] (CCR1)
+    0x4802,         // 0x0800001a: LDR R0, =0x40023000
+    0x6804,         // 0x0800001c: LDR R4, [R0] (CRC_DR)
+    0xe7fe,         // 0x0800001e: B 0x0800001e
+    0x0000, 0x4002, // 0x08000020
+    0x3000, 0x4002, // 0x08000024
+    0x0000, 0x0800, // 0x08000028
+    0x4a91, 0x0000, // 0x0800002c
+};
+
+static const char check[] = "123456789";
+
+
+/*
+ * Bitwise CRC of words, which are processed from their most significant bit on.
+ */
+static uint32_t crc32_words(uint32_t crc, const uint32_t *words, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        crc ^= words[i];
+        for (int j = 0; j < 32; ++j) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+
+static int write_bytes(struct armvm *armvm, const char *bytes)
+{
+    for (; *bytes; ++bytes) {
+        const uint8_t byte = *bytes;
+        if (armvm->mem->write_byte(armvm->mem->data, CRC_ADDR, &byte)) {
+            return FAIL;
+        }
+    }
+    return SUCCESS;
+}
+
+
+static int write_reg(struct armvm *armvm, uint32_t offset, uint32_t value)
+{
+    return armvm->mem->write_word(armvm->mem->data, CRC_ADDR + offset, &value) ? FAIL : SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    uint32_t words[sizeof(program) / 4];
+    uint32_t dr;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const struct libarmvm_registers *regs = armvm->regs->data;
+
+    if (armvm->ci->run(armvm, 100, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    memcpy(words, program, sizeof(words));
+    if (crc32_words(0xffffffff, words, 12) != regs->gpr[4]) {
+        fprintf(stderr, "Unexpected CRC of the program 0x%08x (line: %u).\n", regs->gpr[4], __LINE__);
+        goto err;
+    }
+
+    // an odd amount of words with the bits reversed per word
+    uint32_t reversed[5];
+    for (size_t i = 0; i < 5; ++i) {
+        reversed[i] = 0;
+        for (int j = 0; j < 32; ++j) {
+            reversed[i] |= ((words[i] >> j) & 0x1) << (31 - j);
+        }
+    }
+    if (   write_reg(armvm, 0x08, 0x61)
+        || libarmvm_memory_write_fifo(armvm, CRC_ADDR, 4, words, 5)
+        || armvm->mem->read_word(armvm->mem->data, CRC_ADDR, &dr)
+        || crc32_words(0xffffffff, reversed, 5) != dr) {
+        fprintf(stderr, "Unexpected CRC with reversed words 0x%08x (line: %u).\n", dr, __LINE__);
+        goto err;
+    }
+
+    // CRC-32/MPEG-2
+    if (   write_reg(armvm, 0x08, 0x01)
+        || write_bytes(armvm, check)
+        || armvm->mem->read_word(armvm->mem->data, CRC_ADDR, &dr)
+        || 0x0376e6e7 != dr) {
+        fprintf(stderr, "Unexpected CRC-32/MPEG-2 0x%08x (line: %u).\n", dr, __LINE__);
+        goto err;
+    }
+
+    // CRC-32 of zlib without the final inversion: the bits of the bytes and of the output are reversed
+    if (   write_reg(armvm, 0x08, 0xa1)
+        || write_bytes(armvm, check)
+        || armvm->mem->read_word(armvm->mem->data, CRC_ADDR, &dr)
+        || (0xcbf43926 ^ 0xffffffff) != dr) {
+        fprintf(stderr, "Unexpected CRC-32 0x%08x (line: %u).\n", dr, __LINE__);
+        goto err;
+    }
+
+    // CRC-16/CCITT-FALSE
+    if (   write_reg(armvm, 0x14, 0x1021)
+        || write_reg(armvm, 0x10, 0xffff)
+        || write_reg(armvm, 0x08, 0x09)
+        || write_bytes(armvm, check)
+        || armvm->mem->read_word(armvm->mem->data, CRC_ADDR, &dr)
+        || 0x29b1 != dr) {
+        fprintf(stderr, "Unexpected CRC-16/CCITT-FALSE 0x%08x (line: %u).\n", dr, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,73 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test executes a small program and checks the cycles which are charged
+ * for each instruction against the Cortex-M0 timings.
+ */
+
+static const uint16_t program[] = {
+    0x4000, 0x2000, // initial SP: 0x20004000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2001,         // MOVS R0, #1      1 cycle
+    0xb501,         // PUSH {R0, LR}    1 + 2 cycles
+    0x9800,         // LDR R0, [SP, #0] 2 cycles
+    0x2800,         // CMP R0, #0       1 cycle
+    0xd0fe,         // BEQ .            1 cycle (not taken)
+    0xe7fe,         // B .              3 cycles
+};
+
+static const uint64_t expected[] = { 1, 3, 2, 1, 1, 3, 3 };
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+    armvm->opts.core_clock = 1000000;
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    uint64_t cycles;
+    uint64_t total = 0;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        if (armvm->ci->step(armvm)) {
+            fprintf(stderr, "step() failed (line: %u).\n", __LINE__);
+            goto err;
+        }
+        total += expected[i];
+
+        armvm->ci->get_cycles(armvm, &cycles);
+        if (total != cycles) {
+            fprintf(stderr, "Instruction %zu: expected %" PRIu64 " cycles, got %" PRIu64 " (line: %u).\n", i, total, cycles, __LINE__);
+            goto err;
+        }
+    }
+
+    uint64_t ns;
+    armvm->ci->get_time(armvm, &ns);
+    if (total * 1000 != ns) {
+        fprintf(stderr, "Expected %" PRIu64 " ns, got %" PRIu64 " (line: %u).\n", total * 1000, ns, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,184 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_memory.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test copies 64 words of the flash to the RAM with a memory-to-memory transfer of DMA1 channel 1.
+ * The words are copied at once, but CNDTR and the transfer complete interrupt follow the modeled time.
+ * A second transfer without interrupts polls ISR, once with run() and once with step() for every step.
+ */
+
+#define DMA_WORDS (64)
+#define DMA_DATA  (0x100)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0069, 0x0800, // reset vector: 0x08000068 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x0089, 0x0800, // DMA1 channel 1 vector (IRQ9): 0x08000088 (thumb)
+    0x4808,         // 0x08000068: LDR R0, =0x40020000 (DMA1)
+    0x4909,         // 0x0800006a: LDR R1, =0x08000100
+    0x6101,         // 0x0800006c: STR R1, [R0, #0x10] (CPAR1)
+    0x4909,         // 0x0800006e: LDR R1, =0x20000100
+    0x6141,         // 0x08000070: STR R1, [R0, #0x14] (CMAR1)
+    0x2140,         // 0x08000072: MOVS R1, #64
+    0x60c1,         // 0x08000074: STR R1, [R0, #0x0c] (CNDTR1)
+    0x4908,         // 0x08000076: LDR R1, =0x00004ac3 (MEM2MEM, 32 bit, MINC, PINC, TCIE, EN)
+    0x4a08,         // 0x08000078: LDR R2, =0xe000e100 (ISER)
+    0x4b09,         // 0x0800007a: LDR R3, =0x00000200
+    0x6013,         // 0x0800007c: STR R3, [R2]
+    0x6081,         // 0x0800007e: STR R1, [R0, #0x08] (CCR1)
+    0x68c6,         // 0x08000080: LDR R6, [R0, #0x0c] (CNDTR1)
+    0x2400,         // 0x08000082: MOVS R4, #0
+    0xbf30,         // 0x08000084: WFI
+    0xe7fd,         // 0x08000086: B 0x08000084
+    0x3401,         // 0x08000088: ADDS R4, #1
+    0x4770,         // 0x0800008a: BX LR
+    0x0000, 0x4002, // 0x0800008c
+    0x0100, 0x0800, // 0x08000090
+    0x0100, 0x2000, // 0x08000094
+    0x4ac3, 0x0000, // 0x08000098
+    0xe100, 0xe000, // 0x0800009c
+    0x0200, 0x0000, // 0x080000a0
+};
+
+static const uint16_t poll_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x480b,         // 0x08000008: LDR R0, =0x40020000 (DMA1)
+    0x490c,         // 0x0800000a: LDR R1, =0x08000100
+    0x6101,         // 0x0800000c: STR R1, [R0, #0x10] (CPAR1)
+    0x490c,         // 0x0800000e: LDR R1, =0x20000100
+    0x6141,         // 0x08000010: STR R1, [R0, #0x14] (CMAR1)
+    0x2140,         // 0x08000012: MOVS R1, #64
+    0x60c1,         // 0x08000014: STR R1, [R0, #0x0c] (CNDTR1)
+    0x490b,         // 0x08000016: LDR R1, =0x00004ac1 (MEM2MEM, 32 bit, MINC, PINC, EN)
+    0x6081,         // 0x08000018: STR R1, [R0, #0x08] (CCR1)
+    0x6801,         // 0x0800001a: LDR R1, [R0] (ISR)
+    0x074a,         // 0x0800001c: LSLS R2, R1, #29
+    0x0fd2,         // 0x0800001e: LSRS R2, R2, #31 (HTIF1)
+    0x2a00,         // 0x08000020: CMP R2, #0
+    0xd0fa,         // 0x08000022: BEQ 0x0800001a
+    0x2403,         // 0x08000024: MOVS R4, #3
+    0x6801,         // 0x08000026: LDR R1, [R0] (ISR)
+    0x078a,         // 0x08000028: LSLS R2, R1, #30
+    0x0fd2,         // 0x0800002a: LSRS R2, R2, #31 (TCIF1)
+    0x2a00,         // 0x0800002c: CMP R2, #0
+    0xd0fa,         // 0x0800002e: BEQ 0x08000026
+    0x68c6,         // 0x08000030: LDR R6, [R0, #0x0c] (CNDTR1)
+    0x2507,         // 0x08000032: MOVS R5, #7
+    0xe7fe,         // 0x08000034: B .
+    0xbf00,         // 0x08000036: NOP
+    0x0000, 0x4002, // 0x08000038
+    0x0100, 0x0800, // 0x0800003c
+    0x0100, 0x2000, // 0x08000040
+    0x4ac1, 0x0000, // 0x08000044
+};
+
+
+/**
+ * @brief Returns an image with the program and the words to copy, which follow it.
+ */
+static void _image(uint32_t *image, const uint16_t *program, size_t size)
+{
+    memset(image, 0, (DMA_DATA / 4 + DMA_WORDS) * sizeof(*image));
+    memcpy(image, program, size);
+    for (uint32_t i = 0; i < DMA_WORDS; ++i) {
+        image[DMA_DATA / 4 + i] = 0xdeadbeef ^ (i * 0x01010101);
+    }
+}
+
+
+static int _test_interrupt(void)
+{
+    int ret = FAIL;
+    uint32_t image[DMA_DATA / 4 + DMA_WORDS];
+    uint32_t words[DMA_WORDS];
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    _image(image, program, sizeof(program));
+
+    if (test_vm_init(&vm, image, sizeof(image))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // 64 words take 128 cycles
+    if (armvm->ci->run(armvm, 1000, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    if (1 != regs->gpr[4] || !regs->gpr[6] || regs->gpr[6] >= DMA_WORDS) {
+        fprintf(stderr, "Unexpected interrupts %u or CNDTR %u after the start (line: %u).\n", regs->gpr[4], regs->gpr[6], __LINE__);
+        goto err;
+    }
+
+    if (   libarmvm_memory_read_words(armvm, 0x20000100, words, DMA_WORDS)
+        || memcmp(&image[DMA_DATA / 4], words, sizeof(words))) {
+        fprintf(stderr, "Unexpected data in the RAM (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // half and complete transfer flags of channel 1
+    uint32_t cndtr;
+    uint32_t isr;
+    if (   armvm->mem->read_word(armvm->mem->data, 0x4002000c, &cndtr)
+        || armvm->mem->read_word(armvm->mem->data, 0x40020000, &isr)
+        || 0 != cndtr
+        || 0x7 != isr) {
+        fprintf(stderr, "Unexpected CNDTR %u or ISR 0x%08x (line: %u).\n", cndtr, isr, __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_polling(void)
+{
+    uint32_t image[DMA_DATA / 4 + DMA_WORDS];
+    uint32_t gpr[LIBARMVM_GPR_SIZE];
+
+    _image(image, poll_program, sizeof(poll_program));
+
+    // the flags are set without their interrupts, so both loops end within the steps
+    if (test_vm_compare_run(image, sizeof(image), 2000, gpr)) {
+        fprintf(stderr, "Polling ISR differs between run() and step() (line: %u).\n", __LINE__);
+        return FAIL;
+    }
+    if (3 != gpr[4] || 7 != gpr[5] || 0 != gpr[6]) {
+        fprintf(stderr, "Unexpected R4 %u, R5 %u or CNDTR %u after polling (line: %u).\n", gpr[4], gpr[5], gpr[6], __LINE__);
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_interrupt() || _test_polling()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
@@ -0,0 +1,157 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <isa/armv6_m.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test takes the SVCall exception with a stack pointer which is not aligned
+ * to 8 bytes and checks the exception frame, the Handler mode and the return with POP.
+ * A second program calls SVC with PRIMASK set, which escalates the SVCall to a HardFault.
+ */
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0041, 0x0800, // reset vector: 0x08000040 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x004d, 0x0800, // SVCall vector: 0x0800004c (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0x2001,         // 0x08000040: MOVS R0, #1
+    0xb081,         // 0x08000042: SUB SP, #4
+    0xdf00,         // 0x08000044: SVC #0
+    0x3001,         // 0x08000046: ADDS R0, #1
+    0xb001,         // 0x08000048: ADD SP, #4
+    0xe7fe,         // 0x0800004a: B .
+    0xb500,         // 0x0800004c: PUSH {LR}
+    0x300a,         // 0x0800004e: ADDS R0, #10
+    0xbd00,         // 0x08000050: POP {PC}
+};
+
+static const uint16_t escalation_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0011, 0x0800, // reset vector: 0x08000010 (thumb)
+    0x0000, 0x0000, // NMI vector
+    0x0017, 0x0800, // HardFault vector: 0x08000016 (thumb)
+    0xb672,         // 0x08000010: CPSID i
+    0xdf00,         // 0x08000012: SVC #0
+    0xe7fe,         // 0x08000014: B .
+    0xe7fe,         // 0x08000016: B .
+};
+
+
+int _check(struct armvm *armvm, uint32_t r0, uint32_t sp, uint32_t lr, uint32_t pc, uint32_t ipsr, unsigned line)
+{
+    const struct libarmvm_registers *regs = armvm->regs->data;
+
+    if (   regs->gpr[0] != r0
+        || regs->gpr[ARMV6M_REG_SP] != sp
+        || regs->gpr[ARMV6M_REG_LR] != lr
+        || regs->gpr[ARMV6M_REG_PC] != pc
+        || (regs->psr & 0x3f) != ipsr) {
+        fprintf(stderr, "Unexpected registers: R0 0x%08x, SP 0x%08x, LR 0x%08x, PC 0x%08x, IPSR %u (line: %u).\n",
+                regs->gpr[0], regs->gpr[ARMV6M_REG_SP], regs->gpr[ARMV6M_REG_LR], regs->gpr[ARMV6M_REG_PC],
+                regs->psr & 0x3f, line);
+        return FAIL;
+    }
+    return SUCCESS;
+}
+
+
+static int _test_svc(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // MOVS, SUB, SVC and the exception entry
+    if (armvm->ci->run(armvm, 4, &executed) || _check(armvm, 1, 0x20000fd8, 0xfffffff9, 0x0800004c, 11, __LINE__)) {
+        goto err;
+    }
+
+    // the frame is aligned to 8 bytes and the alignment is recorded in bit 9 of the stacked xPSR
+    uint32_t frame[8];
+    for (size_t i = 0; i < 8; ++i) {
+        if (armvm->mem->read_word(armvm->mem->data, 0x20000fd8 + 4 * i, &frame[i])) {
+            fprintf(stderr, "Could not read the exception frame (line: %u).\n", __LINE__);
+            goto err;
+        }
+    }
+    if (frame[0] != 1 || frame[6] != 0x08000046 || !(frame[7] & (0x1 << 9))) {
+        fprintf(stderr, "Unexpected exception frame: R0 0x%08x, PC 0x%08x, xPSR 0x%08x (line: %u).\n",
+                frame[0], frame[6], frame[7], __LINE__);
+        goto err;
+    }
+
+    // PUSH, ADDS and the exception return with POP, R0 is restored from the frame
+    if (armvm->ci->run(armvm, 3, &executed) || _check(armvm, 1, 0x20000ffc, 0, 0x08000046, 0, __LINE__)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, 2, &executed) || _check(armvm, 2, 0x20001000, 0, 0x0800004a, 0, __LINE__)) {
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_escalation(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, escalation_program, sizeof(escalation_program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // CPSID, SVC and the entry of the HardFault, the return address is the instruction after SVC
+    if (armvm->ci->run(armvm, 3, &executed) || _check(armvm, 0, 0x20000fe0, 0xfffffff9, 0x08000016, 3, __LINE__)) {
+        goto err;
+    }
+
+    uint32_t return_addr;
+    if (armvm->mem->read_word(armvm->mem->data, 0x20000fe0 + 4 * 6, &return_addr) || 0x08000014 != return_addr) {
+        fprintf(stderr, "Unexpected return address of the HardFault (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_svc() || _test_escalation()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
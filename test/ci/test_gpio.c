@@ -0,0 +1,138 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_ci.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test toggles PA5 of GPIOA and drives PA0 by a stimulus file. Only the changes of the pins
+ * have to be in the VCD file, writes which keep the state of the pins add nothing.
+ */
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x4805,         // 0x08000008: LDR R0, =0x48000000 (GPIOA)
+    0x4906,         // 0x0800000a: LDR R1, =0x28000400
+    0x6001,         // 0x0800000c: STR R1, [R0] (MODER: PA5 output)
+    0x2120,         // 0x0800000e: MOVS R1, #0x20
+    0x6181,         // 0x08000010: STR R1, [R0, #0x18] (BSRR: set PA5)
+    0x6181,         // 0x08000012: STR R1, [R0, #0x18] (BSRR: no change)
+    0x6141,         // 0x08000014: STR R1, [R0, #0x14] (ODR: no change)
+    0x8341,         // 0x08000016: STRH R1, [R0, #0x1a] (BSRR: reset PA5)
+    0x6281,         // 0x08000018: STR R1, [R0, #0x28] (BRR: no change)
+    0x6905,         // 0x0800001a: LDR R5, [R0, #0x10] (IDR)
+    0xe7fe,         // 0x0800001c: B 0x0800001c
+    0xbf00,         // 0x0800001e: NOP
+    0x0000, 0x4800, // 0x08000020
+    0x0400, 0x2800, // 0x08000024
+};
+
+static const char stimulus[] =
+    "# pulse on PA0\n"
+    "100 PA0 1\n"
+    "\n"
+    "200 PA0 z\n";
+
+/*
+ * The changes after the dump of the initial values. PA13 has a pull-up after the reset.
+ */
+static const char changes[] =
+    "#7\n"
+    "1a5\n"
+    "#13\n"
+    "0a5\n"
+    "#100\n"
+    "1a0\n"
+    "#200\n"
+    "0a0\n";
+
+
+int _test_gpio_run(struct armvm *armvm, uint64_t cycles)
+{
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    uint64_t executed;
+
+    while (ci->cycles < cycles) {
+        if (armvm->ci->run(armvm, 1, &executed)) {
+            return FAIL;
+        }
+    }
+
+    return SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    char vcd[8192];
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint32_t idr;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+    const char *stimulus_file = test_vm_file(&vm, "", stimulus, sizeof(stimulus) - 1);
+    const char *vcd_file = test_vm_file(&vm, ".vcd", "", 0);
+    if (!stimulus_file || !vcd_file) {
+        goto err;
+    }
+    armvm->opts.gpio_vcd_file = strdup(vcd_file);
+    armvm->opts.gpio_stimulus_file = strdup(stimulus_file);
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const struct libarmvm_registers *regs = armvm->regs->data;
+
+    if (   _test_gpio_run(armvm, 150)
+        || armvm->mem->read_word(armvm->mem->data, 0x48000010, &idr)
+        || 0x2000 != regs->gpr[5]
+        || 0x2001 != idr) {
+        fprintf(stderr, "Unexpected IDR 0x%08x and 0x%08x (line: %u).\n", regs->gpr[5], idr, __LINE__);
+        goto err;
+    }
+
+    if (   _test_gpio_run(armvm, 250)
+        || armvm->mem->read_word(armvm->mem->data, 0x48000010, &idr)
+        || 0x2000 != idr) {
+        fprintf(stderr, "Unexpected IDR 0x%08x after the release of PA0 (line: %u).\n", idr, __LINE__);
+        goto err;
+    }
+
+    // writes the rest of the VCD file
+    test_vm_stop(&vm);
+
+    FILE *f = fopen(vcd_file, "r");
+    if (!f) {
+        fprintf(stderr, "Could not open VCD file (line: %u).\n", __LINE__);
+        goto err;
+    }
+    const size_t size = fread(vcd, 1, sizeof(vcd) - 1, f);
+    fclose(f);
+    vcd[size] = 0;
+
+    const char *dump = strstr(vcd, "$dumpvars\n");
+    const char *end = dump ? strstr(dump, "$end\n") : NULL;
+    if (   !end
+        || !strstr(vcd, "$var wire 1 a5 PA5 $end\n")
+        || !strstr(dump, "1ad\n")
+        || strcmp(end + 5, changes)) {
+        fprintf(stderr, "Unexpected VCD file (line: %u):\n%s\n", __LINE__, vcd);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
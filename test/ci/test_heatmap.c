@@ -0,0 +1,188 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_heatmap.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test counts the accesses per bucket of 16 bytes. The program is executed from the region
+ * at 0x00000000, which is remapped to the FLASH, and reads and writes the RAM with every access
+ * width in different buckets. A second read observer sees the addresses of the remapped region,
+ * while the heatmap accounts the same reads to the FLASH.
+ */
+
+#define STEPS (20)
+#define BUCKET_SIZE (16)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0000, // reset vector: 0x00000008 (thumb, remapped FLASH)
+    0x4804,         // 0x00000008: LDR R0, =0x20000000
+    0x215a,         // 0x0000000a: MOVS R1, #0x5a
+    0x7001,         // 0x0000000c: STRB R1, [R0, #0]
+    0x8201,         // 0x0000000e: STRH R1, [R0, #0x10]
+    0x6201,         // 0x00000010: STR R1, [R0, #0x20]
+    0x7802,         // 0x00000012: LDRB R2, [R0, #0]
+    0x8a02,         // 0x00000014: LDRH R2, [R0, #0x10]
+    0x6a02,         // 0x00000016: LDR R2, [R0, #0x20]
+    0xe7fe,         // 0x00000018: B .
+    0xbf00,         // 0x0000001a: NOP
+    0x0000, 0x2000, // 0x0000001c
+};
+
+/*
+ * Expected counters (rd8, rd16, rd32, wr8, wr16, wr32) of the accessed buckets.
+ */
+struct _heatmap_bucket {
+    uint32_t addr;
+    uint64_t counters[LIBARMVM_HEATMAP_COUNTERS];
+};
+
+static const struct _heatmap_bucket buckets[] = {
+    // 4 instructions and the reset vector, which is read at the reset
+    { 0x08000000, { 0,  4, 2, 0, 0, 0 } },
+    // 5 instructions, 11 more iterations of B . and the literal
+    { 0x08000010, { 0, 16, 1, 0, 0, 0 } },
+    { 0x20000000, { 1,  0, 0, 1, 0, 0 } },
+    { 0x20000010, { 0,  1, 0, 0, 1, 0 } },
+    { 0x20000020, { 0,  0, 1, 0, 0, 1 } },
+};
+
+
+/**
+ * @brief Reads seen by the second observer.
+ */
+struct _reads {
+    uint64_t total;
+    uint64_t remapped; /**< Reads of the region at 0x00000000. */
+};
+
+
+static void _read_observe(void *data, uint32_t addr, uint8_t size, uint32_t value)
+{
+    struct _reads *reads = data;
+    reads->total++;
+    if (addr < 0x08000000) {
+        reads->remapped++;
+    }
+}
+
+
+/**
+ * @brief Returns the counters of the bucket at addr or NULL.
+ */
+static const uint64_t *_bucket(const struct libarmvm_heatmap *heatmap, uint32_t addr)
+{
+    for (size_t i = 0; i < heatmap->regions_size; ++i) {
+        const uint32_t offset = addr - heatmap->regions[i].addr;
+        if (offset < heatmap->regions[i].size) {
+            return heatmap->regions[i].buckets[offset >> heatmap->bucket_shift];
+        }
+    }
+    return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    struct _reads reads;
+    uint64_t executed;
+    char report[8192];
+    char expected[256];
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    const char *report_file = test_vm_file(&vm, ".txt", "", 0);
+    if (!report_file) {
+        goto err;
+    }
+    armvm->opts.heatmap_file = strdup(report_file);
+    armvm->opts.heatmap_bucket_size = BUCKET_SIZE;
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    memset(&reads, 0, sizeof(reads));
+    const struct libarmvm_memory_observer observer = { _read_observe, NULL, &reads };
+    if (libarmvm_memory_add_observer(armvm, &observer)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, STEPS, &executed) || STEPS != executed || _libarmvm_report(armvm)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // every bucket, which is not expected, was not accessed
+    const struct libarmvm_heatmap *heatmap = ((const struct libarmvm_memory *)armvm->mem->data)->heatmap;
+    uint64_t heatmap_total = 0;
+    uint64_t heatmap_reads = 0;
+    for (size_t i = 0; i < heatmap->regions_size; ++i) {
+        const struct libarmvm_heatmap_region *region = &heatmap->regions[i];
+        for (size_t j = 0; j <= (region->size - 1) / BUCKET_SIZE; ++j) {
+            for (size_t k = 0; k < LIBARMVM_HEATMAP_COUNTERS; ++k) {
+                heatmap_total += region->buckets[j][k];
+                heatmap_reads += k <= LIBARMVM_HEATMAP_READ_32 ? region->buckets[j][k] : 0;
+            }
+        }
+    }
+
+    uint64_t expected_total = 0;
+    for (size_t i = 0; i < sizeof(buckets) / sizeof(buckets[0]); ++i) {
+        const uint64_t *counters = _bucket(heatmap, buckets[i].addr);
+        if (!counters || memcmp(counters, buckets[i].counters, sizeof(buckets[i].counters))) {
+            fprintf(stderr, "Unexpected counters of the bucket 0x%08x (line: %u).\n", buckets[i].addr, __LINE__);
+            goto err;
+        }
+        for (size_t k = 0; k < LIBARMVM_HEATMAP_COUNTERS; ++k) {
+            expected_total += counters[k];
+        }
+    }
+    if (expected_total != heatmap_total) {
+        fprintf(stderr, "%" PRIu64 " accesses, expected %" PRIu64 " (line: %u).\n", heatmap_total, expected_total, __LINE__);
+        goto err;
+    }
+
+    // the observer was added after the reset, the instructions and the literal were read through the remapped region
+    if (heatmap_reads != reads.total + 2 || STEPS + 1 != reads.remapped) {
+        fprintf(stderr, "The observer saw %" PRIu64 " reads, %" PRIu64 " remapped, the heatmap %" PRIu64 " (line: %u).\n",
+                reads.total, reads.remapped, heatmap_reads, __LINE__);
+        goto err;
+    }
+
+    if (0 > test_vm_read_file(report_file, report, sizeof(report))) {
+        goto err;
+    }
+    if (   !strstr(report, "# bucket size: 16 bytes\n")
+        || !strstr(report, "#   reads : 0 (8bit), 20 (16bit), 3 (32bit)\n")
+        || !strstr(report, "#   reads : 1 (8bit), 1 (16bit), 1 (32bit)\n")
+        || !strstr(report, "#   writes: 1 (8bit), 1 (16bit), 1 (32bit)\n")) {
+        fprintf(stderr, "Unexpected report (line: %u):\n%s\n", __LINE__, report);
+        goto err;
+    }
+
+    // the hottest bucket has the full bar
+    snprintf(expected, sizeof(expected), "0x08000010 %12u %12u %12u %12u %12u %12u  ########################################\n", 0, 16, 1, 0, 0, 0);
+    if (!strstr(report, expected)) {
+        fprintf(stderr, "Missing line '%s' in the report (line: %u):\n%s\n", expected, __LINE__, report);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,166 @@
+#include <armvm.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test registers hooks of every kind through the public API and checks how
+ * often they are called while a small program is executed.
+ */
+
+static const uint16_t program[] = {
+    0x4000, 0x2000, // initial SP: 0x20004000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2001,         // 0x08000008: MOVS R0, #1
+    0xb501,         // 0x0800000a: PUSH {R0, LR}
+    0x9800,         // 0x0800000c: LDR R0, [SP, #0]
+    0x2800,         // 0x0800000e: CMP R0, #0
+    0xd0fe,         // 0x08000010: BEQ . (not taken)
+    0xe7fe,         // 0x08000012: B .
+};
+
+#define STEPS 8
+
+/**
+ * @brief Return value of the breakpoint, which armvm_start() passes through.
+ */
+#define BREAKPOINT_RET (42)
+
+struct counters {
+    uint64_t events[ARMVM_HOOK_TYPES];
+    int stop_ret;
+};
+
+
+int _count(struct armvm *armvm, const struct armvm_hook_event *event, void *data)
+{
+    struct counters *counters = data;
+    counters->events[event->type]++;
+    if (ARMVM_HOOK_STOP == event->type) {
+        counters->stop_ret = event->ret;
+    }
+    return ARMVM_RET_SUCCESS;
+}
+
+
+int _breakpoint(struct armvm *armvm, const struct armvm_hook_event *event, void *data)
+{
+    return BREAKPOINT_RET;
+}
+
+
+int _run(const char *program_file, struct counters *counters, int with_breakpoint, uint32_t lockstep)
+{
+    int ret;
+    struct armvm armvm;
+    struct armvm_opts opts;
+    struct armvm_hook hook;
+
+    armvm_opts_init(&opts);
+    opts.program_file = strdup(program_file);
+    opts.device_id = strdup("STM32F070CB");
+    opts.steps = STEPS;
+    opts.lockstep = lockstep;
+
+    memset(counters, 0, sizeof(*counters));
+    memset(&hook, 0, sizeof(hook));
+    hook.callback = _count;
+    hook.data = counters;
+
+    for (int type = 0; type < ARMVM_HOOK_TYPES; ++type) {
+        hook.type = type;
+        hook.begin = 0;
+        hook.end = 0;
+        if (ARMVM_HOOK_MEMORY_READ == type || ARMVM_HOOK_MEMORY_WRITE == type) {
+            // only RAM, without the instruction fetches
+            hook.begin = 0x20000000;
+            hook.end = 0x20004000;
+        }
+        armvm_opts_add_hook(&opts, &hook);
+    }
+
+    if (with_breakpoint) {
+        hook.type = ARMVM_HOOK_INSTRUCTION;
+        hook.begin = 0x0800000c;
+        hook.end = 0x0800000e;
+        hook.callback = _breakpoint;
+        armvm_opts_add_hook(&opts, &hook);
+    }
+
+    ret = armvm_start(&armvm, &opts);
+    armvm_opts_cleanup(&opts);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct counters counters;
+
+    // the vm is started by armvm_start(), only the program file is used
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (_run(vm.program_file, &counters, 0, 0)) {
+        fprintf(stderr, "armvm_start() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    const uint64_t expected[ARMVM_HOOK_TYPES] = {
+        [ARMVM_HOOK_INSTRUCTION] = STEPS,
+        [ARMVM_HOOK_BASIC_BLOCK] = 3,     // reset, two iterations of B .
+        [ARMVM_HOOK_MEMORY_READ] = 1,     // LDR
+        [ARMVM_HOOK_MEMORY_WRITE] = 2,    // PUSH
+        [ARMVM_HOOK_STOP] = 1,
+    };
+    for (int type = 0; type < ARMVM_HOOK_TYPES; ++type) {
+        if (expected[type] != counters.events[type]) {
+            fprintf(stderr, "Hook type %d: expected %" PRIu64 " calls, got %" PRIu64 " (line: %u).\n", type, expected[type], counters.events[type], __LINE__);
+            goto err;
+        }
+    }
+    if (ARMVM_RET_SUCCESS != counters.stop_ret) {
+        fprintf(stderr, "Stop hook got %d (line: %u).\n", counters.stop_ret, __LINE__);
+        goto err;
+    }
+
+    // a hook which returns an error stops the vm before the instruction is executed
+    const int breakpoint_ret = _run(vm.program_file, &counters, 1, 0);
+    if (BREAKPOINT_RET != breakpoint_ret) {
+        fprintf(stderr, "armvm_start() returned %d instead of the value of the hook (line: %u).\n", breakpoint_ret, __LINE__);
+        goto err;
+    }
+    if (3 != counters.events[ARMVM_HOOK_INSTRUCTION] || 0 != counters.events[ARMVM_HOOK_MEMORY_READ]) {
+        fprintf(stderr, "The breakpoint did not stop the vm (line: %u).\n", __LINE__);
+        goto err;
+    }
+    if (1 != counters.events[ARMVM_HOOK_STOP] || BREAKPOINT_RET != counters.stop_ret) {
+        fprintf(stderr, "The stop hook was not called with the error (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // the comparison of the written memory in the lockstep mode is not seen by the memory hooks
+    if (_run(vm.program_file, &counters, 0, 2)) {
+        fprintf(stderr, "armvm_start() failed in lockstep (line: %u).\n", __LINE__);
+        goto err;
+    }
+    if (   expected[ARMVM_HOOK_MEMORY_READ] != counters.events[ARMVM_HOOK_MEMORY_READ]
+        || expected[ARMVM_HOOK_MEMORY_WRITE] != counters.events[ARMVM_HOOK_MEMORY_WRITE]) {
+        fprintf(stderr, "Memory hooks in lockstep: %" PRIu64 " reads, %" PRIu64 " writes (line: %u).\n",
+                counters.events[ARMVM_HOOK_MEMORY_READ], counters.events[ARMVM_HOOK_MEMORY_WRITE], __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,92 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test executes idle loops once with run(), which skips them, and once with step() for every
+ * instruction, and checks that both reach the same cycle and the same registers.
+ * The first loop polls a flag in the RAM, which the SysTick handler sets. The second loop polls
+ * the counter of TIM3, which changes with the cycles and therefore must not be skipped.
+ */
+
+#define STEPS (20000)
+
+static const uint16_t ram_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0041, 0x0800, // reset vector: 0x08000040 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x0057, 0x0800, // SysTick vector: 0x08000056 (thumb)
+    0x4806,         // 0x08000040: LDR R0, =0xe000e010 (SysTick)
+    0x4907,         // 0x08000042: LDR R1, =10000
+    0x6041,         // 0x08000044: STR R1, [R0, #4] (RVR)
+    0x2107,         // 0x08000046: MOVS R1, #7
+    0x6001,         // 0x08000048: STR R1, [R0] (CSR: ENABLE, TICKINT, CLKSOURCE)
+    0x4a06,         // 0x0800004a: LDR R2, =0x20000000
+    0x6813,         // 0x0800004c: LDR R3, [R2]
+    0x2b00,         // 0x0800004e: CMP R3, #0
+    0xd0fc,         // 0x08000050: BEQ 0x0800004c
+    0x2507,         // 0x08000052: MOVS R5, #7
+    0xe7fe,         // 0x08000054: B .
+    0x2101,         // 0x08000056: MOVS R1, #1
+    0x6011,         // 0x08000058: STR R1, [R2]
+    0x4770,         // 0x0800005a: BX LR
+    0xe010, 0xe000, // 0x0800005c
+    0x2710, 0x0000, // 0x08000060
+    0x0000, 0x2000, // 0x08000064
+};
+
+static const uint16_t tim_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x4806,         // 0x08000008: LDR R0, =0x40000400 (TIM3)
+    0x2163,         // 0x0800000a: MOVS R1, #99
+    0x6281,         // 0x0800000c: STR R1, [R0, #0x28] (PSC)
+    0x21ff,         // 0x0800000e: MOVS R1, #255
+    0x62c1,         // 0x08000010: STR R1, [R0, #0x2c] (ARR)
+    0x2101,         // 0x08000012: MOVS R1, #1
+    0x6141,         // 0x08000014: STR R1, [R0, #0x14] (EGR: UG loads PSC)
+    0x6001,         // 0x08000016: STR R1, [R0] (CR1: CEN)
+    0x6a41,         // 0x08000018: LDR R1, [R0, #0x24] (CNT)
+    0x2905,         // 0x0800001a: CMP R1, #5
+    0xd3fc,         // 0x0800001c: BCC 0x08000018
+    0x2507,         // 0x0800001e: MOVS R5, #7
+    0xe7fe,         // 0x08000020: B .
+    0xbf00,         // 0x08000022: NOP
+    0x0400, 0x4000, // 0x08000024
+};
+
+
+static int _compare(const uint16_t *program, size_t size, unsigned line)
+{
+    uint32_t gpr[LIBARMVM_GPR_SIZE];
+
+    if (test_vm_compare_run(program, size, STEPS, gpr)) {
+        fprintf(stderr, "run() and step() differ (line: %u).\n", line);
+        return FAIL;
+    }
+
+    // both loops end within the steps
+    if (7 != gpr[5]) {
+        fprintf(stderr, "The loop did not end (line: %u).\n", line);
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (   _compare(ram_program, sizeof(ram_program), __LINE__)
+        || _compare(tim_program, sizeof(tim_program), __LINE__)) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
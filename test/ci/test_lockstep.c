@@ -0,0 +1,130 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_lockstep.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test runs a program in lockstep with the reference instance. The hooks are only called in
+ * the vm, therefore an instruction hook, which changes a register or the memory, lets both
+ * instances diverge. Without a change, both instances have to run to the end.
+ */
+
+#define STEPS (100)
+#define LOCKSTEP (4)
+
+/*
+ * The hook changes the vm when it is called the n-th time.
+ */
+#define HOOK_CALL (10)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x4902,         // 0x08000008: LDR R1, =0x20000000
+    0x2000,         // 0x0800000a: MOVS R0, #0
+    0x3001,         // 0x0800000c: ADDS R0, #1
+    0x6008,         // 0x0800000e: STR R0, [R1]
+    0xe7fc,         // 0x08000010: B 0x0800000c
+    0xbf00,         // 0x08000012: NOP
+    0x0000, 0x2000, // 0x08000014
+};
+
+enum _change {
+    CHANGE_NONE = 0,
+    CHANGE_REGISTER,
+    CHANGE_MEMORY,
+};
+
+struct _hook_data {
+    enum _change change;
+    unsigned calls;
+};
+
+
+static int _change(struct armvm *armvm, const struct armvm_hook_event *event, void *data)
+{
+    struct _hook_data *hook_data = data;
+
+    if (HOOK_CALL != ++hook_data->calls) {
+        return ARMVM_RET_SUCCESS;
+    }
+
+    // R2 and the word at 0x20000100 are not used by the program
+    const uint32_t value = 0xdeadbeef;
+    switch (hook_data->change) {
+        case CHANGE_REGISTER:
+            return armvm->regs->write_gpr(armvm->regs->data, 2, &value);
+        case CHANGE_MEMORY:
+            return armvm->mem->write_word(armvm->mem->data, 0x20000100, &value);
+        default:
+            return ARMVM_RET_SUCCESS;
+    }
+}
+
+
+static int _run(enum _change change, int expected_ret, unsigned line)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    struct armvm_hook hook;
+    struct _hook_data hook_data;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+    armvm->opts.steps = STEPS;
+    armvm->opts.lockstep = LOCKSTEP;
+
+    memset(&hook_data, 0, sizeof(hook_data));
+    hook_data.change = change;
+    memset(&hook, 0, sizeof(hook));
+    hook.type = ARMVM_HOOK_INSTRUCTION;
+    hook.begin = 0x0800000e;
+    hook.end = 0x08000010;
+    hook.callback = _change;
+    hook.data = &hook_data;
+    if (armvm_opts_add_hook(&armvm->opts, &hook)) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const int run_ret = libarmvm_lockstep_run(armvm);
+    if (expected_ret != run_ret) {
+        fprintf(stderr, "libarmvm_lockstep_run() returned %d, expected %d (line: %u).\n", run_ret, expected_ret, line);
+        goto err;
+    }
+
+    // the STR is executed every 3 steps from step 4 on, a divergence stops both instances at the next comparison
+    if (   (CHANGE_NONE == change && (STEPS - 1) / 3 != hook_data.calls)
+        || (CHANGE_NONE != change && HOOK_CALL + 1 < hook_data.calls)) {
+        fprintf(stderr, "The hook was called %u times (line: %u).\n", hook_data.calls, line);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (   _run(CHANGE_NONE, ARMVM_RET_SUCCESS, __LINE__)
+        || _run(CHANGE_REGISTER, ARMVM_RET_DIVERGED, __LINE__)
+        || _run(CHANGE_MEMORY, ARMVM_RET_DIVERGED, __LINE__)) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
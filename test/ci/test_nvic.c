@@ -0,0 +1,110 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <isa/armv6_m.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test pends two interrupts with different priorities while PRIMASK is set and checks,
+ * that they are taken after CPSIE ordered by their priority and tail-chained.
+ */
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0049, 0x0800, // reset vector: 0x08000048 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x0061, 0x0800, // IRQ0 vector: 0x08000060 (thumb)
+    0x0067, 0x0800, // IRQ1 vector: 0x08000066 (thumb)
+    0x4808,         // 0x08000048: LDR R0, =0xe000e100 (ISER)
+    0x4909,         // 0x0800004a: LDR R1, =0xe000e200 (ISPR)
+    0x4a09,         // 0x0800004c: LDR R2, =0xe000e400 (IPR0)
+    0x2380,         // 0x0800004e: MOVS R3, #0x80
+    0x6013,         // 0x08000050: STR R3, [R2] (IRQ0: 0x80, IRQ1: 0x00)
+    0x2303,         // 0x08000052: MOVS R3, #3
+    0x6003,         // 0x08000054: STR R3, [R0]
+    0xb672,         // 0x08000056: CPSID i
+    0x600b,         // 0x08000058: STR R3, [R1]
+    0x2400,         // 0x0800005a: MOVS R4, #0
+    0xb662,         // 0x0800005c: CPSIE i
+    0xe7fe,         // 0x0800005e: B .
+    0x0124,         // 0x08000060: LSLS R4, R4, #4
+    0x3401,         // 0x08000062: ADDS R4, #1
+    0x4770,         // 0x08000064: BX LR
+    0x0124,         // 0x08000066: LSLS R4, R4, #4
+    0x3402,         // 0x08000068: ADDS R4, #2
+    0x4770,         // 0x0800006a: BX LR
+    0xe100, 0xe000, // 0x0800006c
+    0xe200, 0xe000, // 0x08000070
+    0xe400, 0xe000, // 0x08000074
+};
+
+
+int _check_nvic(struct armvm *armvm, uint32_t r4, uint32_t pc, uint32_t ipsr, unsigned line)
+{
+    const struct libarmvm_registers *regs = armvm->regs->data;
+
+    if (regs->gpr[4] != r4 || regs->gpr[ARMV6M_REG_PC] != pc || (regs->psr & 0x3f) != ipsr) {
+        fprintf(stderr, "Unexpected registers: R4 0x%08x, PC 0x%08x, IPSR %u (line: %u).\n",
+                regs->gpr[4], regs->gpr[ARMV6M_REG_PC], regs->psr & 0x3f, line);
+        return FAIL;
+    }
+    return SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // the interrupts are pending, but masked by PRIMASK
+    if (armvm->ci->run(armvm, 10, &executed) || _check_nvic(armvm, 0, 0x0800005c, 0, __LINE__)) {
+        goto err;
+    }
+
+    uint32_t ispr;
+    if (armvm->mem->read_word(armvm->mem->data, 0xe000e200, &ispr) || 0x3 != ispr) {
+        fprintf(stderr, "Unexpected ISPR: 0x%08x (line: %u).\n", ispr, __LINE__);
+        goto err;
+    }
+
+    // CPSIE and the entry of IRQ1, which has the higher priority
+    if (armvm->ci->run(armvm, 2, &executed) || _check_nvic(armvm, 0, 0x08000066, 17, __LINE__)) {
+        goto err;
+    }
+
+    // IRQ1 returns and IRQ0 is taken
+    if (armvm->ci->run(armvm, 4, &executed) || _check_nvic(armvm, 0x2, 0x08000060, 16, __LINE__)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, 3, &executed) || _check_nvic(armvm, 0x21, 0x0800005e, 0, __LINE__)) {
+        goto err;
+    }
+
+    if (armvm->mem->read_word(armvm->mem->data, 0xe000e200, &ispr) || ispr) {
+        fprintf(stderr, "Unexpected ISPR: 0x%08x (line: %u).\n", ispr, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,140 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_profile.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test counts the executed instructions per address. The program starts in the region which
+ * is remapped to the FLASH at 0x00000000, branches to the FLASH and continues in the RAM, whose
+ * zeros are executed as MOVS R0, R0. The instructions of the remapped region are counted at their
+ * FLASH address, the instructions in the RAM are counted outside of the FLASH.
+ */
+
+#define STEPS (100)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0000, // reset vector: 0x00000008 (thumb, remapped FLASH)
+    0x2003,         // 0x00000008: MOVS R0, #3
+    0x3801,         // 0x0000000a: SUBS R0, #1
+    0xd1fd,         // 0x0000000c: BNE 0x0000000a
+    0x4902,         // 0x0000000e: LDR R1, =0x08000015
+    0x4708,         // 0x00000010: BX R1
+    0xbf00,         // 0x00000012: NOP
+    0x4a01,         // 0x08000014: LDR R2, =0x20000001
+    0x4710,         // 0x08000016: BX R2
+    0x0015, 0x0800, // 0x08000018
+    0x0001, 0x2000, // 0x0800001c
+};
+
+/*
+ * Executions per address of the FLASH.
+ */
+struct _profile_count {
+    uint32_t addr;
+    uint64_t count;
+};
+
+static const struct _profile_count counts[] = {
+    { 0x08000008, 1 },
+    { 0x0800000a, 3 },
+    { 0x0800000c, 3 },
+    { 0x0800000e, 1 },
+    { 0x08000010, 1 },
+    { 0x08000014, 1 },
+    { 0x08000016, 1 },
+};
+
+#define FLASH_STEPS (11)
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    char report[4096];
+    char expected[128];
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    const char *report_file = test_vm_file(&vm, ".txt", "", 0);
+    if (!report_file) {
+        goto err;
+    }
+    armvm->opts.profile_file = strdup(report_file);
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, STEPS, &executed) || STEPS != executed || _libarmvm_report(armvm)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    const struct libarmvm_profile *profile = ((const struct libarmvm_ci *)armvm->ci->data)->profile;
+    uint64_t total = 0;
+    for (size_t i = 0; i < profile->size / 2; ++i) {
+        total += profile->counts[i];
+    }
+    if (FLASH_STEPS != total || STEPS - FLASH_STEPS != profile->outside) {
+        fprintf(stderr, "%" PRIu64 " instructions in and %" PRIu64 " outside of the FLASH (line: %u).\n", total, profile->outside, __LINE__);
+        goto err;
+    }
+
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        const uint64_t count = profile->counts[(counts[i].addr - profile->base) / 2];
+        if (count != counts[i].count) {
+            fprintf(stderr, "0x%08x was executed %" PRIu64 " times, expected %" PRIu64 " (line: %u).\n", counts[i].addr, count, counts[i].count, __LINE__);
+            goto err;
+        }
+    }
+
+    if (0 > test_vm_read_file(report_file, report, sizeof(report))) {
+        goto err;
+    }
+
+    snprintf(expected, sizeof(expected), "# executed outside of FLASH (0x%08x - 0x%08x): %u\n",
+             profile->base, profile->base + profile->size - 1, STEPS - FLASH_STEPS);
+    if (!strstr(report, "# executed instructions: 100\n") || !strstr(report, expected)) {
+        fprintf(stderr, "Unexpected report (line: %u):\n%s\n", __LINE__, report);
+        goto err;
+    }
+
+    // the order of addresses with the same count is not defined
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        snprintf(expected, sizeof(expected), "%20" PRIu64 " %7.2f%%  0x%08x\n",
+                 counts[i].count, 100.0 * counts[i].count / STEPS, counts[i].addr);
+        if (!strstr(report, expected)) {
+            fprintf(stderr, "Missing line '%s' in the report (line: %u):\n%s\n", expected, __LINE__, report);
+            goto err;
+        }
+    }
+
+    // the loop at 0x0800000a and 0x0800000c is the hottest spot
+    static const char hottest[] = "                   3    3.00%  0x0800000";
+    const char *first = strstr(report, "# Hot spots by address");
+    first = first ? strchr(first, '\n') : NULL;
+    first = first ? strchr(first + 1, '\n') : NULL;
+    if (!first || 0 != strncmp(first + 1, hottest, sizeof(hottest) - 1)) {
+        fprintf(stderr, "The hottest address is not first (line: %u):\n%s\n", __LINE__, report);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
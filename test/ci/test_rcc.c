@@ -0,0 +1,97 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_peripherals.h>
+#include <libarmvm_ci.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test switches SYSCLK to the PLL (HSI / 2 * 12 = 48 MHz) with HCLK = SYSCLK / 2 and
+ * PCLK = HCLK / 4. Afterwards, the core clock is 24 MHz, the timers count every 2nd core cycle
+ * and the USARTs need 4 core cycles per cycle of PCLK.
+ */
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x4805,         // 0x08000008: LDR R0, =0x40021000 (RCC)
+    0x4906,         // 0x0800000a: LDR R1, =0x00280000 (PLLMUL 12)
+    0x6041,         // 0x0800000c: STR R1, [R0, #4] (CFGR)
+    0x6802,         // 0x0800000e: LDR R2, [R0] (CR)
+    0x4b05,         // 0x08000010: LDR R3, =0x01000000 (PLLON)
+    0x431a,         // 0x08000012: ORRS R2, R3
+    0x6002,         // 0x08000014: STR R2, [R0] (CR)
+    0x4905,         // 0x08000016: LDR R1, =0x00280582 (PPRE /4, HPRE /2, SW PLL)
+    0x6041,         // 0x08000018: STR R1, [R0, #4] (CFGR)
+    0x6844,         // 0x0800001a: LDR R4, [R0, #4] (CFGR)
+    0xe7fe,         // 0x0800001c: B 0x0800001c
+    0xbf00,         // 0x0800001e: NOP
+    0x1000, 0x4002, // 0x08000020
+    0x0000, 0x0028, // 0x08000024
+    0x0000, 0x0100, // 0x08000028
+    0x0582, 0x0028, // 0x0800002c
+};
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    const struct libarmvm_peripherals *periph = armvm->periph->data;
+
+    if (armvm->ci->run(armvm, 100, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // SWS follows SW
+    if (0x0028058a != regs->gpr[4] || 24000000 != ci->core_clock) {
+        fprintf(stderr, "Unexpected CFGR 0x%08x or core clock %llu (line: %u).\n",
+                regs->gpr[4], (unsigned long long)ci->core_clock, __LINE__);
+        goto err;
+    }
+
+    if (   2 != periph->tim[1].clock_cycles
+        || (4 << LIBARMVM_RCC_RATIO_SHIFT) != periph->usart[0].clock_ratio
+        || (4 << LIBARMVM_RCC_RATIO_SHIFT) != periph->usart[1].clock_ratio) {
+        fprintf(stderr, "Unexpected clocks of the peripherals (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // 24000 cycles are 1 ms
+    uint64_t start;
+    uint64_t end;
+    const uint64_t cycles = ci->cycles;
+    if (   armvm->ci->get_time(armvm, &start)
+        || armvm->ci->run(armvm, 24000, &executed)
+        || armvm->ci->get_time(armvm, &end)
+        || (ci->cycles - cycles) * 1000 / 24 > end - start + 1
+        || (ci->cycles - cycles) * 1000 / 24 + 1 < end - start) {
+        fprintf(stderr, "Unexpected simulated time (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,173 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_ci.h>
+#include <libarmvm_peripherals.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test schedules, moves and cancels events in a random order and checks, that the handlers
+ * are called in the order of the cycles of the events while the core executes an idle loop.
+ * A second program sleeps after the last event, which has to stop a run without a limit of steps.
+ */
+
+#define EVENTS (64)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0xe7fe,         // 0x08000008: B .
+};
+
+static const uint16_t sleep_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0xbf30,         // 0x08000008: WFI
+    0xe7fd,         // 0x0800000a: B 0x08000008
+};
+
+
+struct _scheduler_test {
+    struct libarmvm_peripherals_event events[EVENTS];
+    uint64_t called[EVENTS];  /**< Value of the cycle counter at the call of the handler. 0 if not called. */
+    size_t order[EVENTS];
+    size_t calls;
+};
+
+
+static struct _scheduler_test scheduler_test;
+
+
+int _scheduler_test_handler(struct armvm *armvm, void *data)
+{
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const size_t idx = (struct libarmvm_peripherals_event *)data - scheduler_test.events;
+
+    scheduler_test.called[idx] = ci->cycles;
+    scheduler_test.order[scheduler_test.calls++] = idx;
+
+    return ARMVM_RET_SUCCESS;
+}
+
+
+static int _test_order(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // every event is scheduled twice, every fourth one is cancelled
+    uint32_t x = 0x12345678;
+    for (int pass = 0; pass < 2; ++pass) {
+        for (size_t i = 0; i < EVENTS; ++i) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            if (!pass) {
+                libarmvm_peripherals_event_init(&scheduler_test.events[i], _scheduler_test_handler, &scheduler_test.events[i]);
+            }
+            if (libarmvm_peripherals_schedule(armvm, &scheduler_test.events[i], 100 + x % 100000)) {
+                fprintf(stderr, "libarmvm_peripherals_schedule() failed (line: %u).\n", __LINE__);
+                goto err;
+            }
+        }
+    }
+    for (size_t i = 0; i < EVENTS; i += 4) {
+        libarmvm_peripherals_cancel(armvm, &scheduler_test.events[i]);
+    }
+
+    if (armvm->ci->run(armvm, 1000000, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    if (scheduler_test.calls != EVENTS - EVENTS / 4) {
+        fprintf(stderr, "Unexpected amount of calls: %zu (line: %u).\n", scheduler_test.calls, __LINE__);
+        goto err;
+    }
+
+    for (size_t i = 0; i < scheduler_test.calls; ++i) {
+        const struct libarmvm_peripherals_event *event = &scheduler_test.events[scheduler_test.order[i]];
+        const uint64_t called = scheduler_test.called[scheduler_test.order[i]];
+
+        // the handler is called before the first step (B takes 3 cycles), which starts at or after the event
+        if (   called < event->cycles
+            || called >= event->cycles + 3
+            || (i && event->cycles < scheduler_test.events[scheduler_test.order[i - 1]].cycles)) {
+            fprintf(stderr, "Event %zu at %llu was called at %llu (line: %u).\n", scheduler_test.order[i],
+                    (unsigned long long)event->cycles, (unsigned long long)called, __LINE__);
+            goto err;
+        }
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_sleep(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+
+    if (test_vm_init(&vm, sleep_program, sizeof(sleep_program))) {
+        goto err;
+    }
+    armvm->opts.steps = 0;
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // the event does not raise an interrupt, the core sleeps forever afterwards
+    memset(&scheduler_test, 0, sizeof(scheduler_test));
+    libarmvm_peripherals_event_init(&scheduler_test.events[0], _scheduler_test_handler, &scheduler_test.events[0]);
+    if (libarmvm_peripherals_schedule(armvm, &scheduler_test.events[0], 1000)) {
+        fprintf(stderr, "libarmvm_peripherals_schedule() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    if (_libarmvm_run(armvm)) {
+        fprintf(stderr, "_libarmvm_run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    if (1 != scheduler_test.calls || !(ci->pending & LIBARMVM_CI_PENDING_SLEEP)) {
+        fprintf(stderr, "The core did not sleep after the event (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_order() || _test_sleep()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
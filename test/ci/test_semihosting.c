@@ -0,0 +1,346 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_memory.h>
+#include <libarmvm_lockstep.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+ * This test writes a buffer to a file through the semihosting, reads it back into the RAM
+ * and stops the vm with SYS_EXIT_EXTENDED and the exit code 42.
+ * A second program reads the console in the lockstep mode, where the reference instance has to
+ * get the same bytes as the vm. A third program reads a file back in the lockstep mode, which it
+ * opened with "w+", "r+" and "a+".
+ */
+
+#define SEMIHOSTING_DATA "semihosting ok!\n"
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2001,         // 0x08000008: MOVS R0, #1 (SYS_OPEN)
+    0x490a,         // 0x0800000a: LDR R1, =0x0800004c
+    0xbeab,         // 0x0800000c: BKPT 0xab
+    0x2005,         // 0x0800000e: MOVS R0, #5 (SYS_WRITE)
+    0x4909,         // 0x08000010: LDR R1, =0x08000064
+    0xbeab,         // 0x08000012: BKPT 0xab
+    0x0004,         // 0x08000014: MOVS R4, R0
+    0x2002,         // 0x08000016: MOVS R0, #2 (SYS_CLOSE)
+    0x4908,         // 0x08000018: LDR R1, =0x08000070
+    0xbeab,         // 0x0800001a: BKPT 0xab
+    0x2001,         // 0x0800001c: MOVS R0, #1 (SYS_OPEN)
+    0x4908,         // 0x0800001e: LDR R1, =0x08000058
+    0xbeab,         // 0x08000020: BKPT 0xab
+    0x2006,         // 0x08000022: MOVS R0, #6 (SYS_READ)
+    0x4907,         // 0x08000024: LDR R1, =0x08000074
+    0xbeab,         // 0x08000026: BKPT 0xab
+    0x0005,         // 0x08000028: MOVS R5, R0
+    0x2020,         // 0x0800002a: MOVS R0, #0x20 (SYS_EXIT_EXTENDED)
+    0x4906,         // 0x0800002c: LDR R1, =0x08000080
+    0xbeab,         // 0x0800002e: BKPT 0xab
+    0xe7fe,         // 0x08000030: B .
+    0xbf00,         // 0x08000032: NOP
+    0x004c, 0x0800, // 0x08000034
+    0x0064, 0x0800, // 0x08000038
+    0x0070, 0x0800, // 0x0800003c
+    0x0058, 0x0800, // 0x08000040
+    0x0074, 0x0800, // 0x08000044
+    0x0080, 0x0800, // 0x08000048
+    0x0098, 0x0800, 0x0004, 0x0000, 0x0000, 0x0000, // 0x0800004c: open "w", the length of the name is patched
+    0x0098, 0x0800, 0x0000, 0x0000, 0x0000, 0x0000, // 0x08000058: open "r", the length of the name is patched
+    0x0001, 0x0000, 0x0088, 0x0800, 0x0010, 0x0000, // 0x08000064: write 16 bytes of 0x08000088 to handle 1
+    0x0001, 0x0000,                                 // 0x08000070: close handle 1
+    0x0001, 0x0000, 0x0100, 0x2000, 0x0010, 0x0000, // 0x08000074: read 16 bytes of handle 1 to 0x20000100
+    0x0026, 0x0002, 0x002a, 0x0000,                 // 0x08000080: ADP_Stopped_ApplicationExit, 42
+};
+
+#define CONSOLE_DATA "console\n"
+
+static const uint16_t console_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2001,         // 0x08000008: MOVS R0, #1 (SYS_OPEN)
+    0x4905,         // 0x0800000a: LDR R1, =0x0800002c
+    0xbeab,         // 0x0800000c: BKPT 0xab
+    0x2006,         // 0x0800000e: MOVS R0, #6 (SYS_READ)
+    0x4904,         // 0x08000010: LDR R1, =0x08000038
+    0xbeab,         // 0x08000012: BKPT 0xab
+    0x0004,         // 0x08000014: MOVS R4, R0
+    0x2020,         // 0x08000016: MOVS R0, #0x20 (SYS_EXIT_EXTENDED)
+    0x4903,         // 0x08000018: LDR R1, =0x08000048
+    0xbeab,         // 0x0800001a: BKPT 0xab
+    0xe7fe,         // 0x0800001c: B .
+    0xbf00,         // 0x0800001e: NOP
+    0x002c, 0x0800, // 0x08000020
+    0x0038, 0x0800, // 0x08000024
+    0x0048, 0x0800, // 0x08000028
+    0x0044, 0x0800, 0x0000, 0x0000, 0x0003, 0x0000, // 0x0800002c: open ":tt" with "r"
+    0x0001, 0x0000, 0x0100, 0x2000, 0x0008, 0x0000, // 0x08000038: read 8 bytes of handle 1 to 0x20000100
+    0x743a, 0x0074,                                 // 0x08000044: ":tt"
+    0x0026, 0x0002, 0x0000, 0x0000,                 // 0x08000048: ADP_Stopped_ApplicationExit, 0
+};
+
+
+static const uint16_t read_back_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2001,         // 0x08000008: MOVS R0, #1 (SYS_OPEN)
+    0x4910,         // 0x0800000a: LDR R1, =0x0800006c
+    0xbeab,         // 0x0800000c: BKPT 0xab
+    0x2005,         // 0x0800000e: MOVS R0, #5 (SYS_WRITE)
+    0x490f,         // 0x08000010: LDR R1, =0x08000090
+    0xbeab,         // 0x08000012: BKPT 0xab
+    0x2002,         // 0x08000014: MOVS R0, #2 (SYS_CLOSE)
+    0x490f,         // 0x08000016: LDR R1, =0x0800009c
+    0xbeab,         // 0x08000018: BKPT 0xab
+    0x2001,         // 0x0800001a: MOVS R0, #1 (SYS_OPEN)
+    0x490e,         // 0x0800001c: LDR R1, =0x08000078
+    0xbeab,         // 0x0800001e: BKPT 0xab
+    0x2006,         // 0x08000020: MOVS R0, #6 (SYS_READ)
+    0x490e,         // 0x08000022: LDR R1, =0x080000a0
+    0xbeab,         // 0x08000024: BKPT 0xab
+    0x0004,         // 0x08000026: MOVS R4, R0
+    0x2002,         // 0x08000028: MOVS R0, #2 (SYS_CLOSE)
+    0x490a,         // 0x0800002a: LDR R1, =0x0800009c
+    0xbeab,         // 0x0800002c: BKPT 0xab
+    0x2001,         // 0x0800002e: MOVS R0, #1 (SYS_OPEN)
+    0x490b,         // 0x08000030: LDR R1, =0x08000084
+    0xbeab,         // 0x08000032: BKPT 0xab
+    0x2006,         // 0x08000034: MOVS R0, #6 (SYS_READ)
+    0x490b,         // 0x08000036: LDR R1, =0x080000ac
+    0xbeab,         // 0x08000038: BKPT 0xab
+    0x0005,         // 0x0800003a: MOVS R5, R0
+    0x2005,         // 0x0800003c: MOVS R0, #5 (SYS_WRITE)
+    0x4904,         // 0x0800003e: LDR R1, =0x08000090
+    0xbeab,         // 0x08000040: BKPT 0xab
+    0x0006,         // 0x08000042: MOVS R6, R0
+    0x2020,         // 0x08000044: MOVS R0, #0x20 (SYS_EXIT_EXTENDED)
+    0x4908,         // 0x08000046: LDR R1, =0x080000b8
+    0xbeab,         // 0x08000048: BKPT 0xab
+    0xe7fe,         // 0x0800004a: B .
+    0x006c, 0x0800, // 0x0800004c
+    0x0090, 0x0800, // 0x08000050
+    0x009c, 0x0800, // 0x08000054
+    0x0078, 0x0800, // 0x08000058
+    0x00a0, 0x0800, // 0x0800005c
+    0x0084, 0x0800, // 0x08000060
+    0x00ac, 0x0800, // 0x08000064
+    0x00b8, 0x0800, // 0x08000068
+    0x00d0, 0x0800, 0x0006, 0x0000, 0x0000, 0x0000, // 0x0800006c: open "w+", the length of the name is patched
+    0x00d0, 0x0800, 0x0002, 0x0000, 0x0000, 0x0000, // 0x08000078: open "r+", the length of the name is patched
+    0x00d0, 0x0800, 0x000a, 0x0000, 0x0000, 0x0000, // 0x08000084: open "a+", the length of the name is patched
+    0x0001, 0x0000, 0x00c0, 0x0800, 0x0010, 0x0000, // 0x08000090: write 16 bytes of 0x080000c0 to handle 1
+    0x0001, 0x0000,                                 // 0x0800009c: close handle 1
+    0x0001, 0x0000, 0x0100, 0x2000, 0x0008, 0x0000, // 0x080000a0: read 8 bytes of handle 1 to 0x20000100
+    0x0001, 0x0000, 0x0110, 0x2000, 0x0010, 0x0000, // 0x080000ac: read 16 bytes of handle 1 to 0x20000110
+    0x0026, 0x0002, 0x0000, 0x0000,                 // 0x080000b8: ADP_Stopped_ApplicationExit, 0
+};
+
+
+/**
+ * @brief Writes the program again, followed by the data and the name of the data file.
+ * The lengths of the name in the SYS_OPEN parameter blocks at the offsets opens are patched.
+ */
+static int _write_program(const struct test_vm *vm, const uint16_t *program, size_t size, const char *data_file,
+                          const uint32_t *opens, size_t opens_size)
+{
+    uint8_t image[256 + 16 + TEST_VM_NAME_SIZE];
+
+    const uint32_t name_len = strlen(data_file);
+    if (size + 16 + name_len > sizeof(image)) {
+        return FAIL;
+    }
+    memcpy(image, program, size);
+    memcpy(image + size, SEMIHOSTING_DATA, 16);
+    memcpy(image + size + 16, data_file, name_len);
+    for (size_t i = 0; i < opens_size; ++i) {
+        memcpy(image + opens[i] + 8, &name_len, 4);
+    }
+
+    FILE *f = fopen(vm->program_file, "w");
+    if (!f || size + 16 + name_len != fwrite(image, 1, size + 16 + name_len, f)) {
+        fprintf(stderr, "Could not write program file (line: %u).\n", __LINE__);
+        if (f) {
+            fclose(f);
+        }
+        return FAIL;
+    }
+    fclose(f);
+
+    return SUCCESS;
+}
+
+
+static int _test_files(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    char data[sizeof(SEMIHOSTING_DATA)];
+    static const uint32_t opens[] = { 0x4c, 0x58 };
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+    const char *data_file = test_vm_file(&vm, "", "", 0);
+    if (!data_file || _write_program(&vm, program, sizeof(program), data_file, opens, sizeof(opens) / sizeof(opens[0]))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // the steps do not include the BKPT, which stopped the vm
+    int run_ret = armvm->ci->run(armvm, 100, &executed);
+    if (ARMVM_RET_EXIT != run_ret || 42 != armvm->exit_code || 19 != executed) {
+        fprintf(stderr, "Unexpected end: return %d, exit code %d, %llu steps (line: %u).\n",
+                run_ret, armvm->exit_code, (unsigned long long)executed, __LINE__);
+        goto err;
+    }
+
+    // SYS_WRITE and SYS_READ transferred all bytes
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    if (regs->gpr[4] || regs->gpr[5]) {
+        fprintf(stderr, "Unexpected results: SYS_WRITE %u, SYS_READ %u (line: %u).\n", regs->gpr[4], regs->gpr[5], __LINE__);
+        goto err;
+    }
+
+    if (libarmvm_memory_read_bytes(armvm, 0x20000100, (uint8_t *)data, 16) || memcmp(SEMIHOSTING_DATA, data, 16)) {
+        fprintf(stderr, "Unexpected data in the RAM (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    FILE *f = fopen(data_file, "r");
+    if (!f || 16 != fread(data, 1, sizeof(data), f) || memcmp(SEMIHOSTING_DATA, data, 16)) {
+        fprintf(stderr, "Unexpected data in the file (line: %u).\n", __LINE__);
+        if (f) {
+            fclose(f);
+        }
+        goto err;
+    }
+    fclose(f);
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_console(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    char data[sizeof(CONSOLE_DATA)];
+
+    if (test_vm_init(&vm, console_program, sizeof(console_program))) {
+        goto err;
+    }
+    armvm->opts.lockstep = 1;
+
+    // the console input is a file
+    const char *input_file = test_vm_file(&vm, "", CONSOLE_DATA, 8);
+    const int fd = input_file ? open(input_file, O_RDONLY) : -1;
+    if (0 > fd || 0 > dup2(fd, STDIN_FILENO)) {
+        fprintf(stderr, "Could not redirect stdin (line: %u).\n", __LINE__);
+        goto err;
+    }
+    close(fd);
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // the reference instance would diverge with the EOF of a console, which it does not read
+    const int run_ret = libarmvm_lockstep_run(armvm);
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    if (ARMVM_RET_EXIT != run_ret || 0 != armvm->exit_code || 0 != regs->gpr[4]) {
+        fprintf(stderr, "Unexpected end in lockstep: return %d, exit code %d, SYS_READ %u (line: %u).\n",
+                run_ret, armvm->exit_code, regs->gpr[4], __LINE__);
+        goto err;
+    }
+
+    if (libarmvm_memory_read_bytes(armvm, 0x20000100, (uint8_t *)data, 8) || memcmp(CONSOLE_DATA, data, 8)) {
+        fprintf(stderr, "Unexpected console input in the RAM (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_read_back(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    char data[2 * 16 + 1];
+    static const uint32_t opens[] = { 0x6c, 0x78, 0x84 };
+
+    if (test_vm_init(&vm, read_back_program, sizeof(read_back_program))) {
+        goto err;
+    }
+    armvm->opts.lockstep = 1;
+
+    const char *data_file = test_vm_file(&vm, "", "", 0);
+    if (!data_file || _write_program(&vm, read_back_program, sizeof(read_back_program), data_file, opens, sizeof(opens) / sizeof(opens[0]))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // the reference instance does not write the file, it replays the opens and reads of the vm
+    const int run_ret = libarmvm_lockstep_run(armvm);
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    if (ARMVM_RET_EXIT != run_ret || 0 != armvm->exit_code || regs->gpr[4] || regs->gpr[5] || regs->gpr[6]) {
+        fprintf(stderr, "Unexpected end in lockstep: return %d, exit code %d, SYS_READ %u and %u, SYS_WRITE %u (line: %u).\n",
+                run_ret, armvm->exit_code, regs->gpr[4], regs->gpr[5], regs->gpr[6], __LINE__);
+        goto err;
+    }
+
+    if (   libarmvm_memory_read_bytes(armvm, 0x20000100, (uint8_t *)data, 8) || memcmp(SEMIHOSTING_DATA, data, 8)
+        || libarmvm_memory_read_bytes(armvm, 0x20000110, (uint8_t *)data, 16) || memcmp(SEMIHOSTING_DATA, data, 16)) {
+        fprintf(stderr, "Unexpected data in the RAM (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // "a+" appended the data
+    if (   2 * 16 != test_vm_read_file(data_file, data, sizeof(data))
+        || memcmp(SEMIHOSTING_DATA, data, 16) || memcmp(SEMIHOSTING_DATA, data + 16, 16)) {
+        fprintf(stderr, "Unexpected data in the file (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_files() || _test_console() || _test_read_back()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
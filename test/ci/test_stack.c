@@ -0,0 +1,203 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test tracks the usage of the main and the process stack. The program pushes onto the MSP,
+ * enters the SVC handler and returns with EXC_RETURN 0xfffffffd to the Thread mode with the PSP,
+ * where it pushes and pops in a loop. MSR is not implemented, therefore the test sets the PSP to
+ * the exception frame, which the program prepared, before the run.
+ * With a guard of the PSP, which the loop crosses, every run() stops after the crossing PUSH.
+ */
+
+#define STEPS (100)
+
+#define PSP_FRAME (0x200007e0)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0031, 0x0800, // reset vector: 0x08000030 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x0041, 0x0800, // SVCall vector: 0x08000040 (thumb)
+    0xb4f0,         // 0x08000030: PUSH {R4-R7}
+    0xbcf0,         // 0x08000032: POP {R4-R7}
+    0x4807,         // 0x08000034: LDR R0, =0x200007e0 (exception frame)
+    0x4908,         // 0x08000036: LDR R1, =0x08000045
+    0x6181,         // 0x08000038: STR R1, [R0, #0x18] (PC)
+    0x4908,         // 0x0800003a: LDR R1, =0x01000000
+    0x61c1,         // 0x0800003c: STR R1, [R0, #0x1c] (xPSR: T)
+    0xdf00,         // 0x0800003e: SVC #0
+    0x4807,         // 0x08000040: LDR R0, =0xfffffffd
+    0x4700,         // 0x08000042: BX R0 (Thread mode, PSP)
+    0xb40f,         // 0x08000044: PUSH {R0-R3}
+    0xb40f,         // 0x08000046: PUSH {R0-R3}
+    0xb40f,         // 0x08000048: PUSH {R0-R3}
+    0xbc0f,         // 0x0800004a: POP {R0-R3}
+    0xbc0f,         // 0x0800004c: POP {R0-R3}
+    0xbc0f,         // 0x0800004e: POP {R0-R3}
+    0xe7f8,         // 0x08000050: B 0x08000044
+    0xbf00,         // 0x08000052: NOP
+    0x07e0, 0x2000, // 0x08000054
+    0x0045, 0x0800, // 0x08000058
+    0x0000, 0x0100, // 0x0800005c
+    0xfffd, 0xffff, // 0x08000060
+};
+
+/*
+ * The exception frame of the SVC lowers the MSP by 32 bytes, the three pushes lower the PSP by 48
+ * bytes below the end of the exception frame.
+ */
+#define MSP_LOWEST (0x20000fe0)
+#define PSP_LOWEST (PSP_FRAME + 0x20 - 48)
+
+/*
+ * The third PUSH crosses this guard once per iteration of the loop.
+ */
+#define PSP_GUARD (0x200007d8)
+#define PSP_GUARD_PC (0x08000048)
+
+/*
+ * Reset, 8 instructions, the SVC entry, 2 instructions of the handler and 3 pushes.
+ */
+#define GUARD_STEPS (14)
+#define LOOP_STEPS (7)
+
+
+/**
+ * @brief Initializes the vm with the guards and sets the PSP to the exception frame.
+ */
+static int _start(struct test_vm *vm, uint32_t guard_main, uint32_t guard_process, const char **report_file)
+{
+    struct armvm *armvm = &vm->armvm;
+
+    if (test_vm_init(vm, program, sizeof(program))) {
+        return FAIL;
+    }
+
+    *report_file = test_vm_file(vm, ".txt", "", 0);
+    if (!*report_file) {
+        return FAIL;
+    }
+    armvm->opts.stack_file = strdup(*report_file);
+    armvm->opts.stack_guard_main = guard_main;
+    armvm->opts.stack_guard_process = guard_process;
+
+    if (test_vm_start(vm)) {
+        return FAIL;
+    }
+
+    const uint32_t psp = PSP_FRAME;
+    if (armvm->regs->write_sp_process(armvm->regs->data, &psp)) {
+        fprintf(stderr, "Could not write the PSP (line: %u).\n", __LINE__);
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+
+static int _test_usage(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    const char *report_file;
+    char report[1024];
+    uint64_t executed;
+
+    if (_start(&vm, 0x20000f00, 0x20000700, &report_file)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, STEPS, &executed) || STEPS != executed || _libarmvm_report(armvm)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    if (   0x20001000 != regs->stack_main.top || MSP_LOWEST != regs->stack_main.lowest || regs->stack_main.overflows
+        || PSP_FRAME != regs->stack_process.top || PSP_LOWEST != regs->stack_process.lowest || regs->stack_process.overflows) {
+        fprintf(stderr, "MSP: top 0x%08x, lowest 0x%08x, PSP: top 0x%08x, lowest 0x%08x (line: %u).\n",
+                regs->stack_main.top, regs->stack_main.lowest, regs->stack_process.top, regs->stack_process.lowest, __LINE__);
+        goto err;
+    }
+
+    if (0 > test_vm_read_file(report_file, report, sizeof(report))) {
+        goto err;
+    }
+    if (   !strstr(report, "MSP: top 0x20001000, lowest 0x20000fe0, max. usage 32 bytes\n")
+        || !strstr(report, "MSP: 224 bytes left above the guard 0x20000f00\n")
+        || !strstr(report, "PSP: top 0x200007e0, lowest 0x200007d0, max. usage 16 bytes\n")
+        || !strstr(report, "PSP: 208 bytes left above the guard 0x20000700\n")) {
+        fprintf(stderr, "Unexpected report (line: %u):\n%s\n", __LINE__, report);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_guard(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    const char *report_file;
+    char report[1024];
+    char expected[128];
+    uint64_t executed;
+
+    if (_start(&vm, 0, PSP_GUARD, &report_file)) {
+        goto err;
+    }
+
+    // the run stops after the crossing PUSH, the next run() continues until the next crossing
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    for (uint64_t i = 0; i < 2; ++i) {
+        const uint64_t steps = i ? LOOP_STEPS : GUARD_STEPS;
+        const int run_ret = armvm->ci->run(armvm, STEPS, &executed);
+        if (   ARMVM_RET_STACK_OVERFLOW != run_ret || steps != executed
+            || PSP_GUARD_PC + 2 != regs->gpr[15] || PSP_GUARD - 8 != regs->gpr[13]
+            || PSP_GUARD_PC != regs->stack_process.guard_pc || i + 1 != regs->stack_process.overflows) {
+            fprintf(stderr, "run() returned %d after %" PRIu64 " steps at 0x%08x with %" PRIu64 " overflows (line: %u).\n",
+                    run_ret, executed, regs->gpr[15], regs->stack_process.overflows, __LINE__);
+            goto err;
+        }
+    }
+
+    if (_libarmvm_report(armvm) || 0 > test_vm_read_file(report_file, report, sizeof(report))) {
+        goto err;
+    }
+    snprintf(expected, sizeof(expected), "PSP: crossed the guard 0x%08x 2 times, first at 0x%08x\n", PSP_GUARD, PSP_GUARD_PC);
+    if (!strstr(report, expected)) {
+        fprintf(stderr, "Unexpected report (line: %u):\n%s\n", __LINE__, report);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_usage() || _test_guard()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_ci.h>
+#include <isa/armv6_m.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test lets SysTick interrupt a core, which sleeps in WFI, every 100 cycles and checks the
+ * amount of interrupts, the counter and COUNTFLAG.
+ */
+
+#define SYSTICK_PERIOD (100)
+#define SYSTICK_CYCLES (100000)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0041, 0x0800, // reset vector: 0x08000040 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x0051, 0x0800, // SysTick vector: 0x08000050 (thumb)
+    0x4804,         // 0x08000040: LDR R0, =0xe000e010 (CSR)
+    0x2163,         // 0x08000042: MOVS R1, #99
+    0x6041,         // 0x08000044: STR R1, [R0, #4] (RVR)
+    0x2107,         // 0x08000046: MOVS R1, #7
+    0x6001,         // 0x08000048: STR R1, [R0] (ENABLE, TICKINT, CLKSOURCE)
+    0x2400,         // 0x0800004a: MOVS R4, #0
+    0xbf30,         // 0x0800004c: WFI
+    0xe7fd,         // 0x0800004e: B 0x0800004c
+    0x3401,         // 0x08000050: ADDS R4, #1
+    0x4770,         // 0x08000052: BX LR
+    0xe010, 0xe000, // 0x08000054
+};
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct libarmvm_registers *regs = armvm->regs->data;
+
+    // the timer is enabled by the STR to CSR, which ends in cycle 6
+    while (ci->cycles < SYSTICK_CYCLES) {
+        if (armvm->ci->run(armvm, 1000, &executed)) {
+            fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+            goto err;
+        }
+    }
+
+    const uint64_t interrupts = (ci->cycles - 6) / SYSTICK_PERIOD;
+    if (regs->gpr[4] + 1 < interrupts || regs->gpr[4] > interrupts) {
+        fprintf(stderr, "Unexpected amount of interrupts: %u, expected: %llu (line: %u).\n",
+                regs->gpr[4], (unsigned long long)interrupts, __LINE__);
+        goto err;
+    }
+
+    uint32_t cvr;
+    uint32_t csr;
+    if (   armvm->mem->read_word(armvm->mem->data, 0xe000e018, &cvr)
+        || armvm->mem->read_word(armvm->mem->data, 0xe000e010, &csr)
+        || cvr >= SYSTICK_PERIOD
+        || 0x10007 != csr) {
+        fprintf(stderr, "Unexpected CVR 0x%08x or CSR 0x%08x (line: %u).\n", cvr, csr, __LINE__);
+        goto err;
+    }
+
+    // COUNTFLAG is cleared by the read
+    if (armvm->mem->read_word(armvm->mem->data, 0xe000e010, &csr) || 0x7 != csr) {
+        fprintf(stderr, "Unexpected CSR 0x%08x (line: %u).\n", csr, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,166 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_ci.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test lets the update of TIM3 interrupt a core, which sleeps in WFI, every 1000 cycles
+ * (PSC 9, ARR 99). Channel 1 compares with 50 without an interrupt, so its flag is only derived
+ * from the cycle counter, when SR is read.
+ * A second program polls CC1IF and UIF without interrupts, which has to leave its loops at the same
+ * cycle with run(), which skips idle loops, as with step().
+ */
+
+#define TIM_PERIOD (1000)
+#define TIM_CYCLES (100000)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0089, 0x0800, // reset vector: 0x08000088 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0x00b1, 0x0800, // TIM3 vector (IRQ16): 0x080000b0 (thumb)
+    0, 0,
+    0x480c,         // 0x08000088: LDR R0, =0x40000400 (TIM3)
+    0x2109,         // 0x0800008a: MOVS R1, #9
+    0x6281,         // 0x0800008c: STR R1, [R0, #0x28] (PSC)
+    0x2163,         // 0x0800008e: MOVS R1, #99
+    0x62c1,         // 0x08000090: STR R1, [R0, #0x2c] (ARR)
+    0x2132,         // 0x08000092: MOVS R1, #50
+    0x6341,         // 0x08000094: STR R1, [R0, #0x34] (CCR1)
+    0x2101,         // 0x08000096: MOVS R1, #1
+    0x6141,         // 0x08000098: STR R1, [R0, #0x14] (EGR: UG loads PSC)
+    0x2100,         // 0x0800009a: MOVS R1, #0
+    0x6101,         // 0x0800009c: STR R1, [R0, #0x10] (SR)
+    0x2101,         // 0x0800009e: MOVS R1, #1
+    0x60c1,         // 0x080000a0: STR R1, [R0, #0x0c] (DIER: UIE)
+    0x6001,         // 0x080000a2: STR R1, [R0] (CR1: CEN)
+    0x4806,         // 0x080000a4: LDR R0, =0xe000e100 (ISER)
+    0x4907,         // 0x080000a6: LDR R1, =0x00010000
+    0x6001,         // 0x080000a8: STR R1, [R0]
+    0x2400,         // 0x080000aa: MOVS R4, #0
+    0xbf30,         // 0x080000ac: WFI
+    0xe7fd,         // 0x080000ae: B 0x080000ac
+    0x4802,         // 0x080000b0: LDR R0, =0x40000400
+    0x21fe,         // 0x080000b2: MOVS R1, #0xfe
+    0x7401,         // 0x080000b4: STRB R1, [R0, #0x10] (SR: clear UIF)
+    0x3401,         // 0x080000b6: ADDS R4, #1
+    0x4770,         // 0x080000b8: BX LR
+    0xbf00,         // 0x080000ba: NOP
+    0x0400, 0x4000, // 0x080000bc
+    0xe100, 0xe000, // 0x080000c0
+    0x0000, 0x0001, // 0x080000c4
+};
+
+static const uint16_t poll_program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x480a,         // 0x08000008: LDR R0, =0x40000400 (TIM3)
+    0x2109,         // 0x0800000a: MOVS R1, #9
+    0x6281,         // 0x0800000c: STR R1, [R0, #0x28] (PSC)
+    0x2163,         // 0x0800000e: MOVS R1, #99
+    0x62c1,         // 0x08000010: STR R1, [R0, #0x2c] (ARR)
+    0x2132,         // 0x08000012: MOVS R1, #50
+    0x6341,         // 0x08000014: STR R1, [R0, #0x34] (CCR1)
+    0x2101,         // 0x08000016: MOVS R1, #1
+    0x6141,         // 0x08000018: STR R1, [R0, #0x14] (EGR: UG loads PSC)
+    0x2100,         // 0x0800001a: MOVS R1, #0
+    0x6101,         // 0x0800001c: STR R1, [R0, #0x10] (SR)
+    0x2101,         // 0x0800001e: MOVS R1, #1
+    0x6001,         // 0x08000020: STR R1, [R0] (CR1: CEN)
+    0x6901,         // 0x08000022: LDR R1, [R0, #0x10] (SR)
+    0x078a,         // 0x08000024: LSLS R2, R1, #30 (CC1IF)
+    0xd5fc,         // 0x08000026: BPL 0x08000022
+    0x2403,         // 0x08000028: MOVS R4, #3
+    0x6901,         // 0x0800002a: LDR R1, [R0, #0x10] (SR)
+    0x084a,         // 0x0800002c: LSRS R2, R1, #1 (UIF)
+    0xd3fc,         // 0x0800002e: BCC 0x0800002a
+    0x2507,         // 0x08000030: MOVS R5, #7
+    0xe7fe,         // 0x08000032: B .
+    0x0400, 0x4000, // 0x08000034
+};
+
+
+static int _test_interrupt(void)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    const struct libarmvm_ci *ci = armvm->ci->data;
+    const struct libarmvm_registers *regs = armvm->regs->data;
+
+    while (ci->cycles < TIM_CYCLES) {
+        if (armvm->ci->run(armvm, 1000, &executed)) {
+            fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+            goto err;
+        }
+    }
+
+    // the timer is enabled in the first period
+    const uint64_t interrupts = ci->cycles / TIM_PERIOD;
+    if (regs->gpr[4] + 1 < interrupts || regs->gpr[4] > interrupts) {
+        fprintf(stderr, "Unexpected amount of interrupts: %u, expected: %llu (line: %u).\n",
+                regs->gpr[4], (unsigned long long)interrupts, __LINE__);
+        goto err;
+    }
+
+    uint32_t cnt;
+    uint32_t sr;
+    if (   armvm->mem->read_word(armvm->mem->data, 0x40000424, &cnt)
+        || armvm->mem->read_word(armvm->mem->data, 0x40000410, &sr)
+        || cnt > 99
+        || !(sr & 0x2)) {
+        fprintf(stderr, "Unexpected CNT %u or SR 0x%08x (line: %u).\n", cnt, sr, __LINE__);
+        goto err;
+    }
+
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
+
+
+static int _test_polling(void)
+{
+    uint32_t gpr[LIBARMVM_GPR_SIZE];
+
+    if (test_vm_compare_run(poll_program, sizeof(poll_program), 20000, gpr)) {
+        fprintf(stderr, "Polling SR differs between run() and step() (line: %u).\n", __LINE__);
+        return FAIL;
+    }
+    if (3 != gpr[4] || 7 != gpr[5]) {
+        fprintf(stderr, "The polling loops did not end (line: %u).\n", __LINE__);
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+
+int main(int argc, char **argv)
+{
+    if (_test_interrupt() || _test_polling()) {
+        return FAIL;
+    }
+
+    printf("SUCCESS\n");
+    return SUCCESS;
+}
@@ -0,0 +1,173 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <isa/armv6_m.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test writes the trace of a small program with its registers and memory writes and decodes it
+ * with arm-vm-trace, whose path is the first argument. The decoded instructions, their disassembly,
+ * the final values of the registers and the memory write have to match the execution.
+ */
+
+#define STEPS (20)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x0009, 0x0800, // reset vector: 0x08000008 (thumb)
+    0x2000,         // 0x08000008: MOVS R0, #0
+    0x2103,         // 0x0800000a: MOVS R1, #3
+    0x3002,         // 0x0800000c: ADDS R0, #2
+    0x3901,         // 0x0800000e: SUBS R1, #1
+    0x2900,         // 0x08000010: CMP R1, #0
+    0xd1fb,         // 0x08000012: BNE 0x0800000c
+    0x4a01,         // 0x08000014: LDR R2, =0x20000000
+    0x6010,         // 0x08000016: STR R0, [R2]
+    0xe7fe,         // 0x08000018: B .
+    0xbf00,         // 0x0800001a: NOP
+    0x0000, 0x2000, // 0x0800001c
+};
+
+/*
+ * Lines of the decoded trace, which have to appear in this order.
+ */
+static const char *const lines[] = {
+    "0x08000008: MOVS R0, #0",
+    "0x0800000c: ADDS R0, #2",
+    "0x0800000e: SUBS R1, #1",
+    "0x08000012: BNE 0x800000c",
+    "0x0800000c: ADDS R0, #2",
+    "0x08000014: LDR R2, [PC, #4] ; load from 0x800001c",
+    "0x08000016: STR R0, [R2, #0]",
+    "    [0x20000000] <- 0x00000006",
+    "0x08000018: B 0x8000018",
+    "0x08000018: B 0x8000018",
+};
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    char cmd[512];
+    char line[256];
+    FILE *decoder = NULL;
+
+    if (2 != argc) {
+        fprintf(stderr, "Usage: %s ARM-VM-TRACE\n", argv[0]);
+        return FAIL;
+    }
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+
+    const char *trace_file = test_vm_file(&vm, ".trc", "", 0);
+    if (!trace_file) {
+        goto err;
+    }
+    armvm->opts.trace_file = strdup(trace_file);
+    armvm->opts.trace_flags = ARMVM_TRACE_REGISTERS | ARMVM_TRACE_MEMORY;
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    if (armvm->ci->run(armvm, STEPS, &executed) || STEPS != executed) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    const struct libarmvm_registers *regs = armvm->regs->data;
+    uint32_t gpr[LIBARMVM_GPR_SIZE];
+    const uint32_t expected_psr = regs->psr;
+    memcpy(gpr, regs->gpr, sizeof(gpr));
+
+    // writes the end of the trace
+    test_vm_stop(&vm);
+
+    snprintf(cmd, sizeof(cmd), "%s -p %s %s", argv[1], vm.program_file, trace_file);
+    decoder = popen(cmd, "r");
+    if (!decoder) {
+        fprintf(stderr, "Could not execute %s (line: %u).\n", cmd, __LINE__);
+        goto err;
+    }
+
+    // every instruction is disassembled into one line, a register line follows the instruction, which changed it
+    uint32_t decoded[LIBARMVM_GPR_SIZE];
+    uint32_t decoded_mask = 0;
+    uint32_t psr = 0;
+    unsigned long instructions = 0;
+    unsigned long count = 0;
+    size_t next_line = 0;
+    while (fgets(line, sizeof(line), decoder)) {
+        line[strcspn(line, "\n")] = 0;
+
+        if (next_line < sizeof(lines) / sizeof(lines[0]) && 0 == strcmp(lines[next_line], line)) {
+            next_line++;
+        }
+
+        char reg[8];
+        uint32_t value;
+        if (0 == strncmp("0x", line, 2)) {
+            count++;
+        } else if (2 == sscanf(line, "    %7s = 0x%x", reg, &value)) {
+            if (0 == strcmp("PSR", reg)) {
+                psr = value;
+            }
+            for (uint8_t i = 0; i < ARMV6M_REG_PC; ++i) {
+                if (0 == strcmp(armv6m_reg_idx_to_string(i), reg)) {
+                    decoded[i] = value;
+                    decoded_mask |= 0x1u << i;
+                }
+            }
+        } else {
+            sscanf(line, "%lu instructions.", &instructions);
+        }
+    }
+
+    if (pclose(decoder)) {
+        decoder = NULL;
+        fprintf(stderr, "%s failed (line: %u).\n", cmd, __LINE__);
+        goto err;
+    }
+    decoder = NULL;
+
+    if (STEPS != instructions || STEPS != count) {
+        fprintf(stderr, "Decoded %lu instructions in %lu lines, expected %u (line: %u).\n", instructions, count, STEPS, __LINE__);
+        goto err;
+    }
+    if (sizeof(lines) / sizeof(lines[0]) != next_line) {
+        fprintf(stderr, "Missing line '%s' (line: %u).\n", lines[next_line], __LINE__);
+        goto err;
+    }
+
+    // R0 to R2 and SP were changed, the registers which were not traced are still 0
+    for (uint8_t i = 0; i < ARMV6M_REG_PC; ++i) {
+        const uint32_t value = (decoded_mask & (0x1u << i)) ? decoded[i] : 0;
+        if (value != gpr[i] || (i <= 2 && !(decoded_mask & (0x1u << i)))) {
+            fprintf(stderr, "Decoded %s 0x%08x, expected 0x%08x (line: %u).\n", armv6m_reg_idx_to_string(i), value, gpr[i], __LINE__);
+            goto err;
+        }
+    }
+    if (psr != expected_psr) {
+        fprintf(stderr, "Decoded PSR 0x%08x, expected 0x%08x (line: %u).\n", psr, expected_psr, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    if (decoder) {
+        pclose(decoder);
+    }
+    test_vm_cleanup(&vm);
+    return ret;
+}
@@ -0,0 +1,107 @@
+#include <armvm.h>
+#include <libarmvm.h>
+#include <libarmvm_peripherals.h>
+#include <test_header.h>
+#include "test_vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * This test lets USART1 receive bytes from a file. The RXNE interrupt echoes every byte plus one,
+ * which is written to another file. A frame takes 1000 cycles (BRR 100, 10 bits).
+ */
+
+#define USART_FRAME (1000)
+
+static const uint16_t program[] = {
+    0x1000, 0x2000, // initial SP: 0x20001000
+    0x00c1, 0x0800, // reset vector: 0x080000c0 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0,
+    0x00d5, 0x0800, // USART1 vector (IRQ27): 0x080000d4 (thumb)
+    0, 0, 0, 0, 0, 0, 0, 0,
+    0x4807,         // 0x080000c0: LDR R0, =0x40013800 (USART1)
+    0x2164,         // 0x080000c2: MOVS R1, #100
+    0x60c1,         // 0x080000c4: STR R1, [R0, #12] (BRR)
+    0x212d,         // 0x080000c6: MOVS R1, #0x2d
+    0x6001,         // 0x080000c8: STR R1, [R0] (CR1: UE, RE, TE, RXNEIE)
+    0x4806,         // 0x080000ca: LDR R0, =0xe000e100 (ISER)
+    0x4906,         // 0x080000cc: LDR R1, =0x08000000
+    0x6001,         // 0x080000ce: STR R1, [R0]
+    0xbf30,         // 0x080000d0: WFI
+    0xe7fd,         // 0x080000d2: B 0x080000d0
+    0x4802,         // 0x080000d4: LDR R0, =0x40013800
+    0x6a41,         // 0x080000d6: LDR R1, [R0, #0x24] (RDR)
+    0x3101,         // 0x080000d8: ADDS R1, #1
+    0x6281,         // 0x080000da: STR R1, [R0, #0x28] (TDR)
+    0x4770,         // 0x080000dc: BX LR
+    0xbf00,         // 0x080000de: NOP
+    0x3800, 0x4001, // 0x080000e0
+    0xe100, 0xe000, // 0x080000e4
+    0x0000, 0x0800, // 0x080000e8
+};
+
+
+int main(int argc, char **argv)
+{
+    int ret = FAIL;
+    struct test_vm vm;
+    struct armvm *armvm = &vm.armvm;
+    uint64_t executed;
+    char output[16];
+
+    if (test_vm_init(&vm, program, sizeof(program))) {
+        goto err;
+    }
+    const char *input_file = test_vm_file(&vm, "", "abc", 3);
+    const char *output_file = test_vm_file(&vm, "", "", 0);
+    if (!input_file || !output_file) {
+        goto err;
+    }
+    armvm->opts.usart_input[0] = strdup(input_file);
+    armvm->opts.usart_output[0] = strdup(output_file);
+
+    if (test_vm_start(&vm)) {
+        goto err;
+    }
+
+    // the core sleeps until the input is read, every byte takes one frame
+    if (armvm->ci->run(armvm, 20 * USART_FRAME, &executed)) {
+        fprintf(stderr, "run() failed (line: %u).\n", __LINE__);
+        goto err;
+    }
+
+    // the last echo ends one frame after the last byte was received
+    const struct libarmvm_peripherals *periph = armvm->periph->data;
+    const uint64_t end = periph->usart[0].tx_event.cycles;
+    if (end < 4 * USART_FRAME || end > 4 * USART_FRAME + 200) {
+        fprintf(stderr, "Unexpected end of the transmission: %llu (line: %u).\n", (unsigned long long)end, __LINE__);
+        goto err;
+    }
+
+    // the output is written by the host thread, which is stopped by the cleanup
+    test_vm_stop(&vm);
+
+    FILE *f = fopen(output_file, "r");
+    if (!f) {
+        fprintf(stderr, "Could not open output file (line: %u).\n", __LINE__);
+        goto err;
+    }
+    const size_t len = fread(output, 1, sizeof(output), f);
+    fclose(f);
+    if (3 != len || memcmp("bcd", output, 3)) {
+        fprintf(stderr, "Unexpected output: %.*s (line: %u).\n", (int)len, output, __LINE__);
+        goto err;
+    }
+
+    printf("SUCCESS\n");
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&vm);
+    return ret;
+}
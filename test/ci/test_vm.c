@@ -0,0 +1,162 @@
+#include "test_vm.h"
+#include <libarmvm.h>
+#include <libarmvm_registers.h>
+#include <libarmvm_ci.h>
+#include <test_header.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+int test_vm_init(struct test_vm *vm, const void *program, size_t size)
+{
+    memset(vm, 0, sizeof(*vm));
+    armvm_opts_init(&vm->armvm.opts);
+
+    vm->program_file = test_vm_file(vm, "", program, size);
+    if (!vm->program_file) {
+        return FAIL;
+    }
+
+    vm->armvm.opts.program_file = strdup(vm->program_file);
+    vm->armvm.opts.device_id = strdup("STM32F070CB");
+    if (!vm->armvm.opts.program_file || !vm->armvm.opts.device_id) {
+        fprintf(stderr, "Not enough memory.\n");
+        return FAIL;
+    }
+
+    return SUCCESS;
+}
+
+
+const char *test_vm_file(struct test_vm *vm, const char *suffix, const void *data, size_t size)
+{
+    if (TEST_VM_FILES == vm->files_size) {
+        fprintf(stderr, "Too many temporary files.\n");
+        return NULL;
+    }
+
+    char *name = vm->files[vm->files_size];
+    snprintf(name, sizeof(vm->files[0]), "/tmp/test_vm_XXXXXX%s", suffix);
+
+    int fd = mkstemps(name, strlen(suffix));
+    if (0 > fd) {
+        fprintf(stderr, "Could not create temporary file.\n");
+        return NULL;
+    }
+    vm->files_size++;
+
+    if (size != (size_t)write(fd, data, size)) {
+        fprintf(stderr, "Could not write temporary file %s.\n", name);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+
+    return name;
+}
+
+
+int test_vm_start(struct test_vm *vm)
+{
+    if (_libarmvm_init(&vm->armvm)) {
+        fprintf(stderr, "_libarmvm_init() failed.\n");
+        return FAIL;
+    }
+    vm->initialized = 1;
+
+    return SUCCESS;
+}
+
+
+void test_vm_stop(struct test_vm *vm)
+{
+    if (vm->initialized) {
+        _libarmvm_cleanup(&vm->armvm);
+        vm->initialized = 0;
+    }
+}
+
+
+void test_vm_cleanup(struct test_vm *vm)
+{
+    test_vm_stop(vm);
+    armvm_opts_cleanup(&vm->armvm.opts);
+
+    for (size_t i = 0; i < vm->files_size; ++i) {
+        unlink(vm->files[i]);
+    }
+    vm->files_size = 0;
+}
+
+
+long test_vm_read_file(const char *file, void *buf, size_t size)
+{
+    FILE *in = fopen(file, "rb");
+    if (!in) {
+        fprintf(stderr, "Could not open %s.\n", file);
+        return -1;
+    }
+
+    const size_t read = fread(buf, 1, size, in);
+    fclose(in);
+    if (read < size) {
+        ((char *)buf)[read] = 0;
+    }
+
+    return read;
+}
+
+
+int test_vm_compare_run(const void *program, size_t size, uint64_t steps, uint32_t *gpr)
+{
+    int ret = FAIL;
+    struct test_vm run_vm;
+    struct test_vm step_vm;
+    uint64_t executed;
+
+    memset(&step_vm, 0, sizeof(step_vm));
+    if (test_vm_init(&run_vm, program, size) || test_vm_start(&run_vm)) {
+        goto err;
+    }
+    if (test_vm_init(&step_vm, program, size) || test_vm_start(&step_vm)) {
+        goto err;
+    }
+
+    struct armvm *run_armvm = &run_vm.armvm;
+    struct armvm *step_armvm = &step_vm.armvm;
+    if (run_armvm->ci->run(run_armvm, steps, &executed) || steps != executed) {
+        fprintf(stderr, "run() failed.\n");
+        goto err;
+    }
+    for (uint64_t i = 0; i < steps; ++i) {
+        if (step_armvm->ci->step(step_armvm)) {
+            fprintf(stderr, "step() failed.\n");
+            goto err;
+        }
+    }
+
+    const struct libarmvm_ci *run_ci = run_armvm->ci->data;
+    const struct libarmvm_ci *step_ci = step_armvm->ci->data;
+    const struct libarmvm_registers *run_regs = run_armvm->regs->data;
+    const struct libarmvm_registers *step_regs = step_armvm->regs->data;
+    if (   run_ci->cycles != step_ci->cycles
+        || memcmp(run_regs->gpr, step_regs->gpr, sizeof(run_regs->gpr))
+        || run_regs->psr != step_regs->psr) {
+        fprintf(stderr, "run() and step() differ: cycles %llu / %llu, R5 %u / %u, PC 0x%08x / 0x%08x.\n",
+                (unsigned long long)run_ci->cycles, (unsigned long long)step_ci->cycles,
+                run_regs->gpr[5], step_regs->gpr[5], run_regs->gpr[ARMV6M_REG_PC], step_regs->gpr[ARMV6M_REG_PC]);
+        goto err;
+    }
+
+    if (gpr) {
+        memcpy(gpr, run_regs->gpr, sizeof(run_regs->gpr));
+    }
+    ret = SUCCESS;
+
+err:
+    test_vm_cleanup(&step_vm);
+    test_vm_cleanup(&run_vm);
+    return ret;
+}
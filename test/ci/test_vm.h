@@ -0,0 +1,77 @@
+#ifndef __TEST_VM_H__
+#define __TEST_VM_H__
+
+#include <armvm.h>
+#include <stddef.h>
+
+/*
+ * Maximal amount of temporary files of one test, including the program.
+ */
+#define TEST_VM_FILES (4)
+
+/*
+ * Maximal size of the name of a temporary file.
+ */
+#define TEST_VM_NAME_SIZE (64)
+
+/*
+ * A vm of the STM32F070CB, which executes a program of the test, and the temporary files of the test.
+ * All temporary files are removed by test_vm_cleanup().
+ */
+struct test_vm {
+    struct armvm armvm;
+    const char *program_file;
+    char files[TEST_VM_FILES][TEST_VM_NAME_SIZE];
+    size_t files_size;
+    int initialized;  /* Set while armvm is initialized by _libarmvm_init(). */
+};
+
+
+/*
+ * Writes the program to a temporary file and initializes the options of the vm with it.
+ * The options may be changed until test_vm_start(). Returns SUCCESS or FAIL,
+ * test_vm_cleanup() has to be called in both cases.
+ */
+int test_vm_init(struct test_vm *vm, const void *program, size_t size);
+
+
+/*
+ * Creates a temporary file with the data and returns its name. The name ends with suffix.
+ * Returns NULL on failure.
+ */
+const char *test_vm_file(struct test_vm *vm, const char *suffix, const void *data, size_t size);
+
+
+/*
+ * Initializes the vm with its options (_libarmvm_init()). Returns SUCCESS or FAIL.
+ */
+int test_vm_start(struct test_vm *vm);
+
+
+/*
+ * Cleans up the vm (_libarmvm_cleanup()), e.g. to flush its output files, but keeps the temporary files.
+ */
+void test_vm_stop(struct test_vm *vm);
+
+
+/*
+ * Stops the vm, frees the options and removes the temporary files.
+ */
+void test_vm_cleanup(struct test_vm *vm);
+
+
+/*
+ * Reads the whole file into buf. The content is terminated with a null byte, if it is shorter than size.
+ * Returns the size of the content or -1, if the file could not be opened.
+ */
+long test_vm_read_file(const char *file, void *buf, size_t size);
+
+
+/*
+ * Executes steps steps of the program in two vms, once with run(), which skips idle loops, and once
+ * with step() for every step. Returns SUCCESS, if both reach the same cycle and the same registers.
+ * The general-purpose registers after run() are copied to gpr, if it is not NULL.
+ */
+int test_vm_compare_run(const void *program, size_t size, uint64_t steps, uint32_t *gpr);
+
+#endif